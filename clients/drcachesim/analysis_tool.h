@@ -81,6 +81,15 @@
  * aggregation across the whole trace should occur here as well, while shard-specific
  * results can be presented in parallel_shard_exit().
  *
+ * A tool whose per-shard results can be computed piecewise can additionally
+ * return true from parallel_subshard_supported() and implement
+ * parallel_shard_merge().  The analyzer may then split a single shard into
+ * contiguous sub-shards, each with its own shard index and shard data, which are
+ * processed concurrently just like separate shards.  Once all workers finish,
+ * the sub-shards are merged back together in trace order, leaving the first
+ * sub-shard holding the data for the whole shard.  This lets a trace with fewer
+ * threads than worker threads still be analyzed concurrently.
+ *
  */
 class analysis_tool_t {
 public:
@@ -123,6 +132,23 @@ public:
      */
     virtual bool
     process_memref(const memref_t &memref) = 0;
+    /**
+     * Operates on \p count consecutive trace entries, in order.  The analyzer
+     * delivers entries through this routine in batches, which lets a tool
+     * process them in a tight loop without a virtual call per entry.  The
+     * default implementation invokes process_memref() on each entry, stopping
+     * at the first failure.  The return value indicates whether it was
+     * successful.  On failure, get_error_string() returns a descriptive message.
+     */
+    virtual bool
+    process_memref_batch(const memref_t *memrefs, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            if (!process_memref(memrefs[i]))
+                return false;
+        }
+        return true;
+    }
     /**
      * This routine reports the results of the trace analysis.
      * It should leave the i/o state in a default format (std::dec) to support
@@ -211,6 +237,53 @@ public:
     {
         return false;
     }
+    /**
+     * Operates on \p count consecutive trace entries from one shard, in order.
+     * The analyzer delivers entries through this routine in batches, which lets
+     * a tool process them in a tight loop without a virtual call per entry.  The
+     * default implementation invokes parallel_shard_memref() on each entry,
+     * stopping at the first failure.  The return value indicates whether this
+     * function was successful.  On failure, parallel_shard_error() returns a
+     * descriptive message.
+     */
+    virtual bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            if (!parallel_shard_memref(shard_data, memrefs[i]))
+                return false;
+        }
+        return true;
+    }
+    /**
+     * Returns whether this tool supports splitting a shard into sub-shards which
+     * are later combined with parallel_shard_merge().  This is only consulted if
+     * parallel_shard_supported() returns true.  A sub-shard other than the first
+     * in its shard does not see the shard's initial markers, and one other than
+     * the last does not see its thread exit.  A shard traced in multiple windows
+     * (see -retrace_every_instrs) is never split.
+     */
+    virtual bool
+    parallel_subshard_supported()
+    {
+        return false;
+    }
+    /**
+     * Combines the data of sub-shard \p src_shard_data into \p dst_shard_data,
+     * both values returned by parallel_shard_init().  \p src_shard_data
+     * immediately follows in the trace all of the sub-shards previously merged
+     * into \p dst_shard_data.  This is invoked after parallel_shard_exit() for
+     * both, from a single thread, prior to print_results().  \p src_shard_data
+     * is not referenced again by the analyzer, and any record of it in a global
+     * table should be removed here, as it is no longer a separate shard.
+     * Returns whether merging was successful.  On failure,
+     * parallel_shard_error() on \p dst_shard_data returns a descriptive message.
+     */
+    virtual bool
+    parallel_shard_merge(void *dst_shard_data, void *src_shard_data)
+    {
+        return false;
+    }
     /** Returns a description of the last error for this shard. */
     virtual std::string
     parallel_shard_error(void *shard_data)
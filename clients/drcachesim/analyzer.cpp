@@ -30,17 +30,30 @@
  * DAMAGE.
  */
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
 #include <thread>
 #include "analysis_tool.h"
 #include "analyzer.h"
 #include "reader/file_reader.h"
 #ifdef HAS_ZLIB
+#    include "reader/chunked_file_reader.h"
 #    include "reader/compressed_file_reader.h"
+#    include "reader/read_ahead_file_reader.h"
 #endif
 #ifdef HAS_SNAPPY
 #    include "reader/snappy_file_reader.h"
 #endif
+#ifdef HAS_ZSTD
+#    include "reader/zstd_file_reader.h"
+#endif
+#ifdef HAS_LZ4
+#    include "reader/lz4_file_reader.h"
+#endif
+#ifdef UNIX
+#    include "reader/mmap_file_reader.h"
+#endif
 #include "common/utils.h"
 
 #ifdef HAS_ZLIB
@@ -58,11 +71,12 @@ analyzer_t::analyzer_t()
     , tools_(NULL)
     , parallel_(true)
     , worker_count_(0)
+    , next_task_(0)
+    , worker_failed_(false)
 {
     /* Nothing else: child class needs to initialize. */
 }
 
-#ifdef HAS_SNAPPY
 static bool
 ends_with(const std::string &str, const std::string &with)
 {
@@ -71,16 +85,30 @@ ends_with(const std::string &str, const std::string &with)
         return false;
     return (pos + with.size() == str.size());
 }
-#endif
 
-static std::unique_ptr<reader_t>
-get_reader(const std::string &path, int verbosity)
+// Returns the suffix of the trace file name that selects its reader, or "" for an
+// uncompressed file.
+static std::string
+get_reader_suffix(const std::string &name)
 {
-#ifdef HAS_SNAPPY
-    if (ends_with(path, ".sz"))
-        return std::unique_ptr<reader_t>(new snappy_file_reader_t(path, verbosity));
-    // If path is a directory, and any file in it ends in .sz, return a snappy reader.
-    if (directory_iterator_t::is_directory(path)) {
+    static const char *const suffixes[] = { ".sz", ".zst", ".lz4", ".chunked", ".gz" };
+    for (const char *suffix : suffixes) {
+        if (ends_with(name, suffix))
+            return suffix;
+    }
+    return "";
+}
+
+std::unique_ptr<reader_t>
+analyzer_t::get_reader(const std::string &path, int verbosity)
+{
+    // A single reader reads every file in a directory, so they must all select
+    // the same reader.  The default reader handles both gzipped and uncompressed
+    // files, so those two can be mixed.
+    std::string suffix = get_reader_suffix(path);
+    bool mappable = ends_with(path, ".trace");
+    bool is_dir = directory_iterator_t::is_directory(path);
+    if (is_dir) {
         directory_iterator_t end;
         directory_iterator_t iter(path);
         if (!iter) {
@@ -88,18 +116,75 @@ get_reader(const std::string &path, int verbosity)
                    iter.error_string().c_str());
             return nullptr;
         }
+        bool first = true;
         for (; iter != end; ++iter) {
-            if (ends_with(*iter, ".sz")) {
-                return std::unique_ptr<reader_t>(
-                    new snappy_file_reader_t(path, verbosity));
+            const std::string fname = *iter;
+            if (fname == "." || fname == "..")
+                continue;
+            const std::string file_suffix = get_reader_suffix(fname);
+            mappable = (first || mappable) && ends_with(fname, ".trace");
+            if (first)
+                suffix = file_suffix;
+            else if (file_suffix != suffix) {
+                if ((suffix.empty() || suffix == ".gz") &&
+                    (file_suffix.empty() || file_suffix == ".gz"))
+                    suffix = ".gz";
+                else {
+                    ERRMSG("Directory %s mixes trace files needing different readers\n",
+                           path.c_str());
+                    return nullptr;
+                }
             }
+            first = false;
         }
     }
+#ifdef HAS_SNAPPY
+    if (suffix == ".sz")
+        return std::unique_ptr<reader_t>(new snappy_file_reader_t(path, verbosity));
+#endif
+#ifdef HAS_ZSTD
+    if (suffix == ".zst") {
+        return std::unique_ptr<reader_t>(
+            new zstd_file_reader_t(path, zstd_dict_path_, verbosity));
+    }
+#endif
+#ifdef HAS_LZ4
+    if (suffix == ".lz4")
+        return std::unique_ptr<reader_t>(new lz4_file_reader_t(path, verbosity));
 #endif
-    // No snappy support, or didn't find a .sz file, try the default reader.
+#ifdef HAS_ZLIB
+    // The seekable chunked format.
+    if (suffix == ".chunked")
+        return std::unique_ptr<reader_t>(new chunked_file_reader_t(path, verbosity));
+#endif
+#ifdef UNIX
+    // Uncompressed files are mapped into memory rather than streamed.
+    if (suffix.empty() && mappable)
+        return std::unique_ptr<reader_t>(new mmap_file_reader_t(path, verbosity));
+#endif
+#ifdef HAS_ZLIB
+    // A directory reader interleaves all of its files, so reading ahead would
+    // cost a thread and its buffers per traced thread while consuming from only
+    // one at a time.  Parallel shards each read one file and are opened only as
+    // workers pick them up, which bounds the threads by the worker count.
+    if (read_ahead_ && !is_dir)
+        return std::unique_ptr<reader_t>(new read_ahead_file_reader_t(path, verbosity));
+#endif
+    // Did not find a specially-handled format: try the default reader.
     return std::unique_ptr<reader_t>(new default_file_reader_t(path, verbosity));
 }
 
+// Returns the size of the file at path, or 0 if it cannot be determined.
+static uint64_t
+get_file_size(const std::string &path)
+{
+    std::ifstream stream(path, std::ifstream::binary | std::ifstream::ate);
+    if (!stream)
+        return 0;
+    std::streamoff size = stream.tellg();
+    return size < 0 ? 0 : static_cast<uint64_t>(size);
+}
+
 bool
 analyzer_t::init_file_reader(const std::string &trace_path, int verbosity)
 {
@@ -115,6 +200,15 @@ analyzer_t::init_file_reader(const std::string &trace_path, int verbosity)
         }
     }
     if (parallel_ && directory_iterator_t::is_directory(trace_path)) {
+        if (worker_count_ <= 0)
+            worker_count_ = std::thread::hardware_concurrency();
+        bool subshard = worker_count_ > 1;
+        for (int i = 0; i < num_tools_; ++i) {
+            if (!tools_[i]->parallel_subshard_supported()) {
+                subshard = false;
+                break;
+            }
+        }
         directory_iterator_t end;
         directory_iterator_t iter(trace_path);
         if (!iter) {
@@ -122,31 +216,46 @@ analyzer_t::init_file_reader(const std::string &trace_path, int verbosity)
                    iter.error_string().c_str());
             return false;
         }
+        std::vector<std::pair<std::string, uint64_t>> files;
+        uint64_t total_size = 0;
         for (; iter != end; ++iter) {
             const std::string fname = *iter;
             if (fname == "." || fname == "..")
                 continue;
             const std::string path = trace_path + DIRSEP + fname;
-            std::unique_ptr<reader_t> reader = get_reader(path, verbosity);
-            if (!reader) {
-                return false;
+            files.emplace_back(path, get_file_size(path));
+            total_size += files.back().second;
+        }
+        for (const auto &file : files) {
+            // With fewer threads than workers, split each file so that its share
+            // of the total trace is spread over a matching share of the workers.
+            int num_pieces = 1;
+            if (subshard && total_size > 0) {
+                num_pieces = static_cast<int>(
+                    (file.second * worker_count_ + total_size - 1) / total_size);
             }
-            thread_data_.push_back(analyzer_shard_data_t(
-                static_cast<int>(thread_data_.size()), std::move(reader), path));
-            VPRINT(this, 2, "Opened reader for %s\n", path.c_str());
+            if (!add_file_shards(file.first, file.second, num_pieces, verbosity))
+                return false;
         }
-        // Like raw2trace, we use a simple round-robin static work assigment.  This
-        // could be improved later with dynamic work queue for better load balancing.
-        if (worker_count_ <= 0)
-            worker_count_ = std::thread::hardware_concurrency();
-        worker_tasks_.resize(worker_count_);
-        int worker = 0;
-        for (size_t i = 0; i < thread_data_.size(); ++i) {
-            VPRINT(this, 2, "Worker %d assigned trace shard %zd\n", worker, i);
-            worker_tasks_[worker].push_back(&thread_data_[i]);
-            thread_data_[i].worker = worker;
-            worker = (worker + 1) % worker_count_;
+        // Shard sizes can be heavily skewed, so rather than a static assignment
+        // we use a shared queue from which idle workers pull the next shard.
+        // We hand out the largest shards first so that the biggest one is not
+        // left until the end to run alone.  The file size is only a proxy for
+        // the amount of work (compression ratios vary) but a good enough one.
+        task_queue_.reserve(thread_data_.size());
+        for (auto &tdata : thread_data_)
+            task_queue_.push_back(&tdata);
+        std::stable_sort(
+            task_queue_.begin(), task_queue_.end(),
+            [](const analyzer_shard_data_t *a, const analyzer_shard_data_t *b) {
+                return a->size > b->size;
+            });
+        for (size_t i = 0; i < task_queue_.size(); ++i) {
+            VPRINT(this, 2, "Queued trace shard %d of size %llu\n",
+                   task_queue_[i]->index,
+                   static_cast<unsigned long long>(task_queue_[i]->size));
         }
+        next_task_ = 0;
     } else {
         parallel_ = false;
         serial_trace_iter_ = get_reader(trace_path, verbosity);
@@ -161,6 +270,72 @@ analyzer_t::init_file_reader(const std::string &trace_path, int verbosity)
     return true;
 }
 
+#ifdef HAS_ZLIB
+// Returns whether the chunked trace file at path was traced in windows.  Each unit
+// header of a windowed trace holds a window marker, so we need only look at the
+// records before the first instruction.
+static bool
+is_windowed_trace(const std::string &path, int verbosity)
+{
+    chunked_file_reader_t reader(path, verbosity);
+    if (!reader.init())
+        return false;
+    for (chunked_file_reader_t end; reader != end; ++reader) {
+        const memref_t &memref = *reader;
+        if (type_is_instr(memref.instr.type))
+            break;
+        if (memref.marker.type == TRACE_TYPE_MARKER &&
+            memref.marker.marker_type == TRACE_MARKER_TYPE_WINDOW_ID)
+            return true;
+    }
+    return false;
+}
+#endif
+
+bool
+analyzer_t::add_file_shards(const std::string &path, uint64_t size, int num_pieces,
+                            int verbosity)
+{
+#ifdef HAS_ZLIB
+    // Only the chunked format can start reading in the middle of a file.  We keep
+    // windowed files whole: a piece after the first cannot tell which window it
+    // starts in, so tools are unable to merge pieces spanning several windows.
+    if (num_pieces > 1 && ends_with(path, ".chunked") &&
+        !is_windowed_trace(path, verbosity)) {
+        size_t num_chunks = chunked_file_reader_t::get_chunk_count(path);
+        if (num_chunks == 0) {
+            ERRMSG("Failed to read the chunk index of %s\n", path.c_str());
+            return false;
+        }
+        size_t pieces = std::min(static_cast<size_t>(num_pieces), num_chunks);
+        int first_index = static_cast<int>(thread_data_.size());
+        for (size_t i = 0; i < pieces; ++i) {
+            size_t first_chunk = num_chunks * i / pieces;
+            size_t end_chunk = num_chunks * (i + 1) / pieces;
+            thread_data_.push_back(analyzer_shard_data_t(
+                static_cast<int>(thread_data_.size()),
+                std::unique_ptr<reader_t>(new chunked_file_reader_t(
+                    path, first_chunk, end_chunk, verbosity)),
+                path));
+            thread_data_.back().size = size / pieces;
+            if (pieces > 1)
+                thread_data_.back().subshard_of = first_index;
+            VPRINT(this, 2, "Opened reader for chunks [%zu, %zu) of %s\n", first_chunk,
+                   end_chunk, path.c_str());
+        }
+        return true;
+    }
+#endif
+    std::unique_ptr<reader_t> reader = get_reader(path, verbosity);
+    if (!reader)
+        return false;
+    thread_data_.push_back(analyzer_shard_data_t(static_cast<int>(thread_data_.size()),
+                                                 std::move(reader), path));
+    thread_data_.back().size = size;
+    VPRINT(this, 2, "Opened reader for %s\n", path.c_str());
+    return true;
+}
+
 analyzer_t::analyzer_t(const std::string &trace_path, analysis_tool_t **tools,
                        int num_tools, int worker_count)
     : success_(true)
@@ -168,6 +343,8 @@ analyzer_t::analyzer_t(const std::string &trace_path, analysis_tool_t **tools,
     , tools_(tools)
     , parallel_(true)
     , worker_count_(worker_count)
+    , next_task_(0)
+    , worker_failed_(false)
 {
     for (int i = 0; i < num_tools; ++i) {
         if (tools_[i] == NULL || !*tools_[i]) {
@@ -195,6 +372,8 @@ analyzer_t::analyzer_t(const std::string &trace_path)
     // This external-iterator interface does not support parallel analysis.
     , parallel_(false)
     , worker_count_(0)
+    , next_task_(0)
+    , worker_failed_(false)
 {
     if (!init_file_reader(trace_path))
         success_ = false;
@@ -231,37 +410,59 @@ analyzer_t::start_reading()
     return true;
 }
 
+analyzer_t::analyzer_shard_data_t *
+analyzer_t::next_task()
+{
+    if (worker_failed_.load(std::memory_order_relaxed))
+        return nullptr;
+    size_t next = next_task_.fetch_add(1, std::memory_order_relaxed);
+    if (next >= task_queue_.size())
+        return nullptr;
+    return task_queue_[next];
+}
+
 void
-analyzer_t::process_tasks(std::vector<analyzer_shard_data_t *> *tasks)
+analyzer_t::process_tasks(int worker_index)
 {
-    if (tasks->empty()) {
-        VPRINT(this, 1, "Worker has no tasks\n");
+    analyzer_shard_data_t *tdata = next_task();
+    if (tdata == nullptr) {
+        VPRINT(this, 1, "Worker %d has no tasks\n", worker_index);
         return;
     }
-    VPRINT(this, 1, "Worker %d assigned %zd task(s)\n", (*tasks)[0]->worker,
-           tasks->size());
     std::vector<void *> worker_data(num_tools_);
     for (int i = 0; i < num_tools_; ++i)
-        worker_data[i] = tools_[i]->parallel_worker_init((*tasks)[0]->worker);
-    for (analyzer_shard_data_t *tdata : *tasks) {
+        worker_data[i] = tools_[i]->parallel_worker_init(worker_index);
+    std::vector<memref_t> batch(MEMREF_BATCH_SIZE);
+    // The last shard we processed holds any worker exit error.
+    analyzer_shard_data_t *last_task = tdata;
+    for (; tdata != nullptr; tdata = next_task()) {
+        last_task = tdata;
+        tdata->worker = worker_index;
         VPRINT(this, 1, "Worker %d starting on trace shard %d\n", tdata->worker,
                tdata->index);
         if (!tdata->iter->init()) {
             tdata->error = "Failed to read from trace" + tdata->trace_file;
+            worker_failed_.store(true, std::memory_order_relaxed);
             return;
         }
-        std::vector<void *> shard_data(num_tools_);
+        std::vector<void *> &shard_data = tdata->shard_data;
+        shard_data.resize(num_tools_);
         for (int i = 0; i < num_tools_; ++i)
             shard_data[i] = tools_[i]->parallel_shard_init(tdata->index, worker_data[i]);
         VPRINT(this, 1, "shard_data[0] is %p\n", shard_data[0]);
-        for (; *tdata->iter != *trace_end_; ++(*tdata->iter)) {
+        size_t count;
+        while ((count = tdata->iter->next_batch(batch.data(), batch.size())) > 0) {
+            // The results are discarded once another worker has failed.
+            if (worker_failed_.load(std::memory_order_relaxed))
+                return;
             for (int i = 0; i < num_tools_; ++i) {
-                const memref_t &memref = **tdata->iter;
-                if (!tools_[i]->parallel_shard_memref(shard_data[i], memref)) {
+                if (!tools_[i]->parallel_shard_memref_batch(shard_data[i], batch.data(),
+                                                            count)) {
                     tdata->error = tools_[i]->parallel_shard_error(shard_data[i]);
                     VPRINT(this, 1,
                            "Worker %d hit shard memref error %s on trace shard %d\n",
                            tdata->worker, tdata->error.c_str(), tdata->index);
+                    worker_failed_.store(true, std::memory_order_relaxed);
                     return;
                 }
             }
@@ -273,6 +474,7 @@ analyzer_t::process_tasks(std::vector<analyzer_shard_data_t *> *tasks)
                 tdata->error = tools_[i]->parallel_shard_error(shard_data[i]);
                 VPRINT(this, 1, "Worker %d hit shard exit error %s on trace shard %d\n",
                        tdata->worker, tdata->error.c_str(), tdata->index);
+                worker_failed_.store(true, std::memory_order_relaxed);
                 return;
             }
         }
@@ -280,8 +482,8 @@ analyzer_t::process_tasks(std::vector<analyzer_shard_data_t *> *tasks)
     for (int i = 0; i < num_tools_; ++i) {
         const std::string error = tools_[i]->parallel_worker_exit(worker_data[i]);
         if (!error.empty()) {
-            (*tasks)[0]->error = error;
-            VPRINT(this, 1, "Worker %d hit worker exit error %s\n", (*tasks)[0]->worker,
+            last_task->error = error;
+            VPRINT(this, 1, "Worker %d hit worker exit error %s\n", worker_index,
                    error.c_str());
             return;
         }
@@ -295,12 +497,14 @@ analyzer_t::run()
     if (!parallel_) {
         if (!start_reading())
             return false;
-        for (; *serial_trace_iter_ != *trace_end_; ++(*serial_trace_iter_)) {
+        std::vector<memref_t> batch(MEMREF_BATCH_SIZE);
+        size_t count;
+        while ((count = serial_trace_iter_->next_batch(batch.data(), batch.size())) >
+               0) {
             for (int i = 0; i < num_tools_; ++i) {
-                memref_t memref = **serial_trace_iter_;
                 // We short-circuit and exit on an error to avoid confusion over
                 // the results and avoid wasted continued work.
-                if (!tools_[i]->process_memref(memref)) {
+                if (!tools_[i]->process_memref_batch(batch.data(), count)) {
                     error_string_ = tools_[i]->get_error_string();
                     return false;
                 }
@@ -315,10 +519,10 @@ analyzer_t::run()
     std::vector<std::thread> threads;
     VPRINT(this, 1, "Creating %d worker threads\n", worker_count_);
     threads.reserve(worker_count_);
-    for (int i = 0; i < worker_count_; ++i) {
-        threads.emplace_back(
-            std::thread(&analyzer_t::process_tasks, this, &worker_tasks_[i]));
-    }
+    next_task_ = 0;
+    worker_failed_ = false;
+    for (int i = 0; i < worker_count_; ++i)
+        threads.emplace_back(std::thread(&analyzer_t::process_tasks, this, i));
     for (std::thread &thread : threads)
         thread.join();
     for (auto &tdata : thread_data_) {
@@ -327,6 +531,26 @@ analyzer_t::run()
             return false;
         }
     }
+    return merge_subshards();
+}
+
+bool
+analyzer_t::merge_subshards()
+{
+    // The pieces of a file are contiguous in thread_data_ and in trace order.
+    for (auto &tdata : thread_data_) {
+        if (tdata.subshard_of < 0 || tdata.subshard_of == tdata.index)
+            continue;
+        analyzer_shard_data_t &dst = thread_data_[tdata.subshard_of];
+        VPRINT(this, 1, "Merging trace shard %d into %d\n", tdata.index, dst.index);
+        for (int i = 0; i < num_tools_; ++i) {
+            if (!tools_[i]->parallel_shard_merge(dst.shard_data[i],
+                                                 tdata.shard_data[i])) {
+                error_string_ = tools_[i]->parallel_shard_error(dst.shard_data[i]);
+                return false;
+            }
+        }
+    }
     return true;
 }
 
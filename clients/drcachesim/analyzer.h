@@ -43,6 +43,7 @@
  * @brief DrMemtrace top-level trace analysis driver.
  */
 
+#include <atomic>
 #include <iterator>
 #include <memory>
 #include <string>
@@ -116,6 +117,8 @@ protected:
                               const std::string &trace_file)
             : index(index)
             , worker(0)
+            , size(0)
+            , subshard_of(-1)
             , iter(std::move(iter))
             , trace_file(trace_file)
         {
@@ -124,16 +127,26 @@ protected:
         {
             index = src.index;
             worker = src.worker;
+            size = src.size;
+            subshard_of = src.subshard_of;
             iter = std::move(src.iter);
+            shard_data = std::move(src.shard_data);
             trace_file = std::move(src.trace_file);
             error = std::move(src.error);
         }
 
         int index;
         int worker;
+        // The on-disk size of the shard's file, used to order the work queue.
+        uint64_t size;
+        // For a piece of a split file, the index of the file's first piece,
+        // into which the others are merged; else -1.
+        int subshard_of;
         std::unique_ptr<reader_t> iter;
         std::string trace_file;
         std::string error;
+        // The tools' data for this shard, kept for merging sub-shards.
+        std::vector<void *> shard_data;
 
     private:
         analyzer_shard_data_t(const analyzer_shard_data_t &) = delete;
@@ -144,13 +157,35 @@ protected:
     bool
     init_file_reader(const std::string &trace_path, int verbosity = 0);
 
+    // Returns a reader for the trace file or directory at path, choosing the
+    // format from the file extensions.
+    std::unique_ptr<reader_t>
+    get_reader(const std::string &path, int verbosity);
+
+    // Adds the shards for the thread file at path, splitting it into up to
+    // num_pieces sub-shards if its format supports that.
+    bool
+    add_file_shards(const std::string &path, uint64_t size, int num_pieces,
+                    int verbosity);
+
+    bool
+    merge_subshards();
+
     // This finalizes the trace_iter setup.  It can block and is meant to be
     // called at the top of run() or begin().
     bool
     start_reading();
 
+    // Returns the next shard from the shared work queue, or nullptr if the
+    // queue is drained.
+    analyzer_shard_data_t *
+    next_task();
+
     void
-    process_tasks(std::vector<analyzer_shard_data_t *> *tasks);
+    process_tasks(int worker_index);
+
+    // The number of records read at once and handed to each tool together.
+    static const size_t MEMREF_BATCH_SIZE = 4096;
 
     bool success_;
     std::string error_string_;
@@ -161,7 +196,20 @@ protected:
     analysis_tool_t **tools_;
     bool parallel_;
     int worker_count_;
-    std::vector<std::vector<analyzer_shard_data_t *>> worker_tasks_;
+    // Shards ordered largest-first.  Workers pull from this shared queue
+    // dynamically via next_task_ so that one huge shard does not leave the
+    // other workers idle behind a static assignment.
+    std::vector<analyzer_shard_data_t *> task_queue_;
+    std::atomic<size_t> next_task_;
+    // Set by a worker that hits an error, so that the others stop picking up
+    // shards rather than running to completion before the error is reported.
+    std::atomic<bool> worker_failed_;
+    // Whether gzip files are decompressed on background threads.  This must be
+    // set before init_file_reader() is called.
+    bool read_ahead_ = false;
+    // The dictionary for zstd-compressed files, if any.  Likewise this must be
+    // set before init_file_reader() is called.
+    std::string zstd_dict_path_;
     int verbosity_ = 0;
     const char *output_prefix_ = "[analyzer]";
 };
@@ -48,6 +48,8 @@
 analyzer_multi_t::analyzer_multi_t()
 {
     worker_count_ = op_jobs.get_value();
+    read_ahead_ = op_read_ahead.get_value();
+    zstd_dict_path_ = op_zstd_dict.get_value();
     // Initial measurements show it's sometimes faster to keep the parallel model
     // of using single-file readers but use them sequentially, as opposed to
     // the every-file interleaving reader, but the user can specify -jobs 1, so
@@ -99,7 +101,9 @@ analyzer_multi_t::analyzer_multi_t()
         }
         if (needs_processing) {
             raw2trace_directory_t dir(op_verbose.get_value());
-            std::string dir_err = dir.initialize(op_indir.get_value(), "");
+            std::string dir_err = dir.initialize(
+                op_indir.get_value(), "", op_chunk_instr_count.get_value(),
+                op_trace_compress.get_value(), op_zstd_dict.get_value());
             if (!dir_err.empty()) {
                 success_ = false;
                 error_string_ = "Directory setup failed: " + dir_err;
@@ -107,7 +111,9 @@ analyzer_multi_t::analyzer_multi_t()
             }
             raw2trace_t raw2trace(dir.modfile_bytes_, dir.in_files_, dir.out_files_,
                                   nullptr, op_verbose.get_value(), op_jobs.get_value(),
-                                  op_alt_module_dir.get_value());
+                                  op_alt_module_dir.get_value(),
+                                  op_decode_cache_dir.get_value());
+            raw2trace.set_thread_file_sizes(dir.in_file_sizes_);
             std::string error = raw2trace.do_conversion();
             if (!error.empty()) {
                 success_ = false;
@@ -121,14 +127,16 @@ analyzer_multi_t::analyzer_multi_t()
         // XXX i#3323: Add parallel analysis support for online tools.
         parallel_ = false;
         serial_trace_iter_ = std::unique_ptr<reader_t>(
-            new ipc_reader_t(op_ipc_name.get_value().c_str(), op_verbose.get_value()));
+            new ipc_reader_t(op_ipc_name.get_value().c_str(), op_verbose.get_value(),
+                             op_ipc_shm_rings.get_value(),
+                             op_ipc_shm_ring_size.get_value()));
         trace_end_ = std::unique_ptr<reader_t>(new ipc_reader_t());
         if (!*serial_trace_iter_) {
             success_ = false;
 #ifdef UNIX
             // This is the most likely cause of the error.
             // XXX: Even better would be to propagate the mkfifo errno here.
-            error_string_ = "try removing stale pipe file " +
+            error_string_ = "try removing stale pipe or ring file " +
                 reinterpret_cast<ipc_reader_t *>(serial_trace_iter_.get())
                     ->get_pipe_name();
 #endif
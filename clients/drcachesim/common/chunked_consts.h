@@ -0,0 +1,80 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/*
+ * chunked_consts: shared layout definitions between the reader and writer for
+ * the seekable chunked final trace format.
+ *
+ * A chunked trace file is a sequence of independently zlib-compressed chunks of
+ * trace_entry_t records, followed by an index with one chunk_index_entry_t per
+ * chunk and finally a fixed-size chunk_footer_t.  Every chunk but the first
+ * begins with a timestamp marker, so a reader can jump to any chunk and resume
+ * decompressing there without any state from earlier chunks.
+ */
+
+#ifndef _CHUNKED_CONSTS_H_
+#define _CHUNKED_CONSTS_H_ 1
+
+#include <cstddef>
+#include <stdint.h>
+
+class chunked_consts_t {
+protected:
+    struct chunk_index_entry_t {
+        // File offset of the start of the chunk's compressed data.
+        uint64_t offset;
+        // The count of instructions in all prior chunks.
+        uint64_t instr_ordinal;
+        // The value of the timestamp marker starting the chunk.  For the first
+        // chunk this is the first timestamp in the file.
+        uint64_t timestamp;
+    };
+
+    struct chunk_footer_t {
+        uint64_t magic;
+        uint64_t version;
+        // The minimum number of instructions per chunk requested of the writer.
+        uint64_t chunk_instr_count;
+        uint64_t num_chunks;
+        // File offset of the first chunk_index_entry_t, which is also the end of
+        // the compressed data.
+        uint64_t index_offset;
+    };
+
+    // "DRCHUNK" plus a trailing zero, identifying a chunked trace file.
+    static constexpr uint64_t magic_ = 0x004b4e5548435244ULL;
+    static constexpr uint64_t version_ = 1;
+    // Size of the i/o buffers on both sides.
+    static constexpr size_t buffer_size_ = 64 * 1024;
+};
+
+#endif /* _CHUNKED_CONSTS_H_ */
@@ -0,0 +1,220 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* chunked_ostream_t: writes final trace files in the seekable chunked format
+ * described in chunked_consts.h while matching the parts of the std::ostream
+ * interface we use for raw2trace.  Callers must write whole trace_entry_t
+ * records, though a record may be split across write calls.
+ * Seeking is not supported.
+ */
+
+#ifndef _CHUNKED_OSTREAM_H_
+#define _CHUNKED_OSTREAM_H_ 1
+
+#ifndef HAS_ZLIB
+#    error HAS_ZLIB is required
+#endif
+#include <string.h>
+#include <fstream>
+#include <vector>
+#include <zlib.h>
+#include "chunked_consts.h"
+#include "trace_entry.h"
+
+/* We need to override the stream buffer class which is where the file
+ * writes happen.  The stream buffer base class writes to pbase()..epptr()
+ * with the next slot at pptr().  We examine each complete record on its way
+ * to the compressor to find the chunk boundaries.
+ */
+class chunked_streambuf_t : public std::basic_streambuf<char, std::char_traits<char>>,
+                            chunked_consts_t {
+public:
+    chunked_streambuf_t(const std::string &path, uint64_t chunk_instr_count)
+        : chunk_instr_count_(chunk_instr_count)
+    {
+        file_.open(path, std::ofstream::binary);
+        if (!file_)
+            return;
+        memset(&zstream_, 0, sizeof(zstream_));
+        if (deflateInit(&zstream_, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            file_.close();
+            return;
+        }
+        buf_ = new char[buffer_size_];
+        buf_compressed_ = new char[buffer_size_];
+        // We leave an extra slot for extra_char on overflow.
+        setp(buf_, buf_ + buffer_size_ - 1);
+        index_.push_back({ 0, 0, 0 });
+    }
+    virtual ~chunked_streambuf_t() override
+    {
+        if (buf_ == nullptr)
+            return;
+        sync();
+        // Any partial record left over is a caller error, but we keep the bytes.
+        if (pptr() > pbase())
+            compress(pbase(), pptr() - pbase(), Z_NO_FLUSH);
+        compress(nullptr, 0, Z_FINISH);
+        deflateEnd(&zstream_);
+        chunk_footer_t footer = { magic_, version_, chunk_instr_count_, index_.size(),
+                                  offset_ };
+        file_.write(reinterpret_cast<const char *>(index_.data()),
+                    index_.size() * sizeof(index_[0]));
+        file_.write(reinterpret_cast<const char *>(&footer), sizeof(footer));
+        delete[] buf_;
+        delete[] buf_compressed_;
+    }
+    virtual int
+    overflow(int extra_char) override
+    {
+        if (buf_ == nullptr)
+            return traits_type::eof();
+        if (extra_char != traits_type::eof()) {
+            // Put the extra char into the buffer.  We left an extra slot for it.
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        int res = traits_type::not_eof(extra_char);
+        size_t pending = pptr() - pbase();
+        size_t whole = pending - pending % sizeof(trace_entry_t);
+        if (whole > 0 && !process_entries(pbase(), whole))
+            res = traits_type::eof();
+        // Carry any partial record over to the next round.
+        memmove(buf_, pbase() + whole, pending - whole);
+        setp(buf_, buf_ + buffer_size_ - 1);
+        pbump(static_cast<int>(pending - whole));
+        return res;
+    }
+    virtual int
+    sync() override
+    {
+        return overflow(traits_type::eof()) == traits_type::eof() ? -1 : 0;
+    }
+    bool
+    is_open()
+    {
+        return buf_ != nullptr;
+    }
+
+private:
+    // Returns how many instructions a reader will present for this record.
+    static uint64_t
+    instr_count(const trace_entry_t &entry)
+    {
+        if (entry.type == TRACE_TYPE_INSTR_BUNDLE)
+            return entry.size;
+        if ((type_is_instr(static_cast<trace_type_t>(entry.type)) ||
+             entry.type == TRACE_TYPE_INSTR_NO_FETCH) &&
+            // A zero-sized instruction only supplies the PC for filtered data.
+            entry.size != 0)
+            return 1;
+        return 0;
+    }
+
+    bool
+    process_entries(const char *start, size_t size)
+    {
+        const trace_entry_t *entry = reinterpret_cast<const trace_entry_t *>(start);
+        const trace_entry_t *end = reinterpret_cast<const trace_entry_t *>(start + size);
+        const trace_entry_t *pending = entry;
+        for (; entry < end; ++entry) {
+            if (entry->type == TRACE_TYPE_MARKER &&
+                entry->size == TRACE_MARKER_TYPE_TIMESTAMP) {
+                if (index_.size() == 1 && index_[0].timestamp == 0)
+                    index_[0].timestamp = entry->addr;
+                // We only split at a timestamp, which the reader needs to see
+                // first when resuming a thread, so a chunk holds at least
+                // chunk_instr_count_ instructions.
+                if (chunk_instrs_ >= chunk_instr_count_) {
+                    if (!compress(reinterpret_cast<const char *>(pending),
+                                  (entry - pending) * sizeof(*entry), Z_FINISH) ||
+                        deflateReset(&zstream_) != Z_OK)
+                        return false;
+                    index_.push_back({ offset_, instr_ordinal_, entry->addr });
+                    chunk_instrs_ = 0;
+                    pending = entry;
+                }
+            }
+            uint64_t count = instr_count(*entry);
+            chunk_instrs_ += count;
+            instr_ordinal_ += count;
+        }
+        return compress(reinterpret_cast<const char *>(pending),
+                        (end - pending) * sizeof(*entry), Z_NO_FLUSH);
+    }
+
+    bool
+    compress(const char *data, size_t size, int flush)
+    {
+        zstream_.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        zstream_.avail_in = static_cast<uInt>(size);
+        do {
+            zstream_.next_out = reinterpret_cast<Bytef *>(buf_compressed_);
+            zstream_.avail_out = static_cast<uInt>(buffer_size_);
+            if (deflate(&zstream_, flush) == Z_STREAM_ERROR)
+                return false;
+            size_t have = buffer_size_ - zstream_.avail_out;
+            if (have > 0) {
+                if (!file_.write(buf_compressed_, have))
+                    return false;
+                offset_ += have;
+            }
+        } while (zstream_.avail_out == 0);
+        return true;
+    }
+
+    std::ofstream file_;
+    z_stream zstream_;
+    char *buf_ = nullptr;
+    char *buf_compressed_ = nullptr;
+    uint64_t chunk_instr_count_;
+    uint64_t chunk_instrs_ = 0;
+    uint64_t instr_ordinal_ = 0;
+    uint64_t offset_ = 0;
+    std::vector<chunk_index_entry_t> index_;
+};
+
+class chunked_ostream_t : public std::ostream {
+public:
+    chunked_ostream_t(const std::string &path, uint64_t chunk_instr_count)
+        : std::ostream(new chunked_streambuf_t(path, chunk_instr_count))
+    {
+        if (!rdbuf() || !static_cast<chunked_streambuf_t *>(rdbuf())->is_open())
+            setstate(std::ios::badbit);
+    }
+    virtual ~chunked_ostream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+#endif /* _CHUNKED_OSTREAM_H_ */
@@ -0,0 +1,145 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* follow_istream_t: reads a file that another process is still appending to,
+ * waiting at the current end of the file for more data until a separate "done"
+ * file appears.  Matches the parts of the std::istream interface we use for
+ * raw2trace.  Supports only limited seeking within the current internal buffer.
+ */
+
+#ifndef _FOLLOW_ISTREAM_H_
+#define _FOLLOW_ISTREAM_H_ 1
+
+#include <chrono>
+#include <cstdio>
+#include <istream>
+#include <string>
+#include <thread>
+
+class follow_istreambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    follow_istreambuf_t(const std::string &path, const std::string &done_path,
+                        int poll_interval_ms)
+        : done_path_(done_path)
+        , poll_interval_ms_(poll_interval_ms)
+    {
+        file_ = fopen(path.c_str(), "rb");
+        if (file_ != nullptr) {
+            buf_ = new char[buffer_size_];
+        }
+    }
+    ~follow_istreambuf_t() override
+    {
+        delete[] buf_;
+        if (file_ != nullptr)
+            fclose(file_);
+    }
+    int
+    underflow() override
+    {
+        if (file_ == nullptr)
+            return traits_type::eof();
+        if (gptr() == egptr()) {
+            size_t len;
+            while ((len = fread(buf_, 1, buffer_size_, file_)) == 0) {
+                if (ferror(file_) || done_)
+                    return traits_type::eof();
+                // Clear the end-of-file indicator so the next fread sees new data.
+                clearerr(file_);
+                // The writer creates the done file only after its last write, so
+                // once we see it one more read picks up anything remaining.
+                done_ = exists(done_path_);
+                if (!done_) {
+                    std::this_thread::sleep_for(
+                        std::chrono::milliseconds(poll_interval_ms_));
+                }
+            }
+            setg(buf_, buf_, buf_ + len);
+        }
+        return traits_type::to_int_type(*gptr());
+    }
+    std::iostream::pos_type
+    seekoff(std::iostream::off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in) override
+    {
+        if (dir == std::ios_base::cur &&
+            ((off >= 0 && gptr() + off <= egptr()) ||
+             (off < 0 && gptr() + off >= eback())))
+            gbump(static_cast<int>(off));
+        else {
+            // Unsupported!
+            return -1;
+        }
+        return gptr() - eback();
+    }
+    bool
+    is_open() const
+    {
+        return file_ != nullptr;
+    }
+
+    static bool
+    exists(const std::string &path)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file == nullptr)
+            return false;
+        fclose(file);
+        return true;
+    }
+
+private:
+    static const int buffer_size_ = 64 * 1024;
+    const std::string done_path_;
+    const int poll_interval_ms_;
+    FILE *file_ = nullptr;
+    char *buf_ = nullptr;
+    bool done_ = false;
+};
+
+class follow_istream_t : public std::istream {
+public:
+    follow_istream_t(const std::string &path, const std::string &done_path,
+                     int poll_interval_ms)
+        : std::istream(new follow_istreambuf_t(path, done_path, poll_interval_ms))
+    {
+        if (!static_cast<follow_istreambuf_t *>(rdbuf())->is_open())
+            setstate(std::ios::badbit);
+    }
+    virtual ~follow_istream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+#endif /* _FOLLOW_ISTREAM_H_ */
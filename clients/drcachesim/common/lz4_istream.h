@@ -102,7 +102,7 @@ public:
             } while (dst_sz == 0);
             setg(buf_uncompressed_, buf_uncompressed_, buf_uncompressed_ + dst_sz);
         }
-        return *gptr();
+        return traits_type::to_int_type(*gptr());
     }
     std::iostream::pos_type
     seekoff(std::iostream::off_type off, std::ios_base::seekdir dir,
@@ -0,0 +1,144 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* lz4_ostream_t: a wrapper around the lz4 frame format to match the parts of
+ * the std::ostream interface we use for raw2trace.
+ * Seeking is not supported.
+ */
+
+#ifndef _LZ4_OSTREAM_H_
+#define _LZ4_OSTREAM_H_ 1
+
+#ifndef HAS_LZ4
+#    error HAS_LZ4 is required
+#endif
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <lz4frame.h>
+
+/* We need to override the stream buffer class which is where the file
+ * writes happen.  The stream buffer base class writes to pbase()..epptr()
+ * with the next slot at pptr().
+ */
+class lz4_ostreambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    lz4_ostreambuf_t(const std::string &path)
+        : file_(path, std::ofstream::binary)
+    {
+        if (!file_)
+            return;
+        if (LZ4F_isError(LZ4F_createCompressionContext(&lzcxt_, LZ4F_VERSION))) {
+            lzcxt_ = nullptr;
+            return;
+        }
+        // The bound covers a flush or the frame end along with a full buffer.
+        out_size_ = std::max<size_t>(LZ4F_compressBound(buffer_size_, nullptr),
+                                     LZ4F_HEADER_SIZE_MAX);
+        buf_ = new char[buffer_size_];
+        out_buf_ = new char[out_size_];
+        size_t res = LZ4F_compressBegin(lzcxt_, out_buf_, out_size_, nullptr);
+        if (LZ4F_isError(res) || !file_.write(out_buf_, res)) {
+            LZ4F_freeCompressionContext(lzcxt_);
+            lzcxt_ = nullptr;
+            return;
+        }
+        // We leave an extra slot for extra_char on overflow.
+        setp(buf_, buf_ + buffer_size_ - 1);
+    }
+    virtual ~lz4_ostreambuf_t() override
+    {
+        if (lzcxt_ != nullptr) {
+            sync();
+            size_t res = LZ4F_compressEnd(lzcxt_, out_buf_, out_size_, nullptr);
+            if (!LZ4F_isError(res))
+                file_.write(out_buf_, res);
+            LZ4F_freeCompressionContext(lzcxt_);
+        }
+        delete[] buf_;
+        delete[] out_buf_;
+    }
+    bool
+    is_open()
+    {
+        return lzcxt_ != nullptr;
+    }
+    virtual int
+    overflow(int extra_char) override
+    {
+        if (lzcxt_ == nullptr)
+            return traits_type::eof();
+        if (extra_char != traits_type::eof()) {
+            // Put the extra char into the buffer.  We left an extra slot for it.
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        int res = traits_type::not_eof(extra_char);
+        if (pptr() > pbase()) {
+            size_t len = LZ4F_compressUpdate(lzcxt_, out_buf_, out_size_, pbase(),
+                                             pptr() - pbase(), nullptr);
+            if (LZ4F_isError(len) || !file_.write(out_buf_, len))
+                res = traits_type::eof();
+        }
+        setp(buf_, buf_ + buffer_size_ - 1);
+        return res;
+    }
+    virtual int
+    sync() override
+    {
+        return overflow(traits_type::eof());
+    }
+
+private:
+    static const int buffer_size_ = 64 * 1024;
+    std::ofstream file_;
+    LZ4F_cctx *lzcxt_ = nullptr;
+    char *buf_ = nullptr;
+    char *out_buf_ = nullptr;
+    size_t out_size_ = 0;
+};
+
+class lz4_ostream_t : public std::ostream {
+public:
+    explicit lz4_ostream_t(const std::string &path)
+        : std::ostream(new lz4_ostreambuf_t(path))
+    {
+        if (!static_cast<lz4_ostreambuf_t *>(rdbuf())->is_open())
+            setstate(std::ios::badbit);
+    }
+    virtual ~lz4_ostream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+#endif /* _LZ4_OSTREAM_H_ */
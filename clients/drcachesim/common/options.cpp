@@ -52,6 +52,23 @@ droption_t<std::string> op_ipc_name(
     "for each instance of the simulator being run at any one time.  On Windows, the name "
     "is limited to 247 characters.");
 
+droption_t<unsigned int> op_ipc_shm_rings(
+    DROPTION_SCOPE_ALL, "ipc_shm_rings", 0, 0, 64,
+    "Number of shared-memory rings for online tracing",
+    "For online tracing on UNIX, if non-zero, sends trace data through this many "
+    "rings in a shared-memory file instead of through the named pipe, avoiding a "
+    "system call per buffer and the pipe's small atomic write size.  The file is "
+    "named after -ipc_name with a .shm suffix.  Each application thread always uses "
+    "the same ring, chosen by its thread id, so using about as many rings as there are "
+    "concurrently running application threads keeps threads from contending for a "
+    "ring.  A thread whose ring is full sleeps until the simulator frees space.");
+
+droption_t<bytesize_t> op_ipc_shm_ring_size(
+    DROPTION_SCOPE_ALL, "ipc_shm_ring_size", 4 * 1024 * 1024,
+    "Size of each ring for -ipc_shm_rings",
+    "The size of each ring used by -ipc_shm_rings, rounded up to a power of two of at "
+    "least 512K.");
+
 droption_t<std::string> op_outdir(
     DROPTION_SCOPE_ALL, "outdir", ".", "Target directory for offline trace files",
     "For the offline analysis mode (when -offline is requested), specifies the path "
@@ -87,6 +104,47 @@ droption_t<int> op_jobs(
     "negative value sets the job count to the number of hardware threads, "
     "with a cap of 16.");
 
+droption_t<bytesize_t> op_chunk_instr_count(
+    DROPTION_SCOPE_FRONTEND, "chunk_instr_count", 0,
+    "Instructions per chunk in a seekable converted trace",
+    "When converting offline raw trace files, a non-zero value produces trace files "
+    "in a seekable chunked format rather than a single gzip stream.  Each chunk is "
+    "compressed independently and holds at least this many instructions, and an "
+    "index at the end of the file allows skipping to any instruction while only "
+    "decompressing the chunk that holds it.  Requires zlib support.");
+
+droption_t<std::string> op_trace_compress(
+    DROPTION_SCOPE_FRONTEND, "trace_compress",
+#ifdef HAS_ZLIB
+    "gzip",
+#else
+    "none",
+#endif
+    "Final trace compression: \"gzip\",\"zstd\",\"lz4\",\"none\"",
+    "Specifies the compression type to use when converting offline raw trace files "
+    "into final trace files: \"gzip\", \"zstd\", \"lz4\", or \"none\".  The "
+    "trace reader picks the matching decompressor from each file's extension.  zstd "
+    "and lz4 files take somewhat more space than gzip but decompress several times "
+    "faster, which pays off for traces analyzed repeatedly.  Only gzip supports "
+    "-chunk_instr_count.");
+
+droption_t<std::string> op_zstd_dict(
+    DROPTION_SCOPE_FRONTEND, "zstd_dict", "", "Dictionary for zstd trace files",
+    "Specifies a dictionary trained with \"zstd --train\" on sample trace files, which "
+    "improves zstd compression of final trace files.  It is used when converting "
+    "with -trace_compress zstd, and must be supplied again when analyzing the "
+    "resulting files.");
+
+droption_t<bool> op_read_ahead(
+    DROPTION_SCOPE_FRONTEND, "read_ahead", false,
+    "Decompress gzip trace files on background threads",
+    "When analyzing gzip-compressed offline trace files, each file being read is "
+    "decompressed ahead of its use by a separate background thread, overlapping "
+    "decompression with the analysis itself.  This uses an extra thread and about "
+    "1MB of buffers per file being read, which in parallel mode is one per worker "
+    "thread.  It is ignored for a directory analyzed serially, where a single reader "
+    "interleaves all of the files.  Requires zlib support.");
+
 droption_t<std::string> op_module_file(
     DROPTION_SCOPE_ALL, "module_file", "", "Path to modules.log for opcode_mix tool",
     "The opcode_mix tool needs the modules.log file (generated by the offline "
@@ -100,6 +158,16 @@ droption_t<std::string> op_alt_module_dir(
     "analysis tools, or in the raw modules file for post-prcoessing of offline "
     "raw trace files.  This directory takes precedence over the recorded path.");
 
+droption_t<std::string> op_decode_cache_dir(
+    DROPTION_SCOPE_FRONTEND, "decode_cache_dir", "",
+    "Directory for decodings kept across runs",
+    "Specifies a directory in which post-processing of offline raw trace files keeps "
+    "the decoded form of each instruction it sees, in one file per module named by "
+    "the module's build ID (or checksum on Windows).  Later post-processing of traces "
+    "of the same binaries reads these files instead of decoding those instructions "
+    "again, as does the opcode_mix tool.  The directory is created if needed and may "
+    "be shared by concurrent runs.");
+
 droption_t<std::string> op_funclist_file(
     DROPTION_SCOPE_ALL, "funclist_file", "",
     "Path to function map file for func_view tool",
@@ -207,6 +275,25 @@ droption_t<bool> op_coherence(
     DROPTION_SCOPE_FRONTEND, "coherence", false, "Model coherence for private caches",
     "Writes to cache lines will invalidate other private caches that hold that line.");
 
+droption_t<unsigned int> op_snoop_filter_size(
+    DROPTION_SCOPE_FRONTEND, "snoop_filter_size", 0,
+    "Snoop filter entries for -coherence, or 0 for unlimited",
+    "The number of lines the snoop filter used by -coherence can track.  The filter is "
+    "16-way set-associative, so this must be a power of 2 multiple of 16.  When a set "
+    "is full, tracking a new line evicts the least recently used line of the set from "
+    "every cache holding it.  0 models a perfect snoop filter that never evicts.  At "
+    "most 256 caches can be snooped.");
+
+droption_t<unsigned int> op_pipeline_workers(
+    DROPTION_SCOPE_FRONTEND, "pipeline_workers", 0,
+    "Threads simulating the L1 caches, or 0 for none",
+    "For the cache simulator, a non-zero value simulates the private L1 caches of "
+    "the cores on this many threads while a further thread simulates the rest of the "
+    "hierarchy, to which the L1 misses are fed in trace order.  The results are "
+    "identical to a serial simulation.  This is not supported with -coherence, with "
+    "-warmup_fraction, or with inclusive caches.  For a configuration file, use the "
+    "pipeline_workers parameter in the file instead.");
+
 droption_t<bool> op_use_physical(
     DROPTION_SCOPE_ALL, "use_physical", false, "Use physical addresses if possible",
     "If available, metadata with virtual-to-physical-address translation information "
@@ -323,6 +410,35 @@ droption_t<std::string> op_raw_compress(
     "for an SSD, zlib and gzip typically add overhead and would only be used if space is "
     "at a premium; snappy_nocrc and lz4 are nearly always performance wins.");
 
+droption_t<unsigned int> op_offline_writer_threads(
+    DROPTION_SCOPE_CLIENT, "offline_writer_threads", 0,
+    "Number of threads compressing and writing offline trace buffers",
+    "By default, each application thread compresses and writes out its own full trace "
+    "buffers for -offline, stalling the application while it does so.  If this is "
+    "non-zero, that many tracer threads are created to compress and write the buffers "
+    "instead, while the application thread continues into a fresh buffer.  Each "
+    "application thread is assigned to one writer thread, which writes that thread's "
+    "buffers in order.  This is ignored for online traces and when the buffer handoff "
+    "interface is in use.  See also -offline_writer_buffers.");
+droption_t<unsigned int> op_offline_writer_buffers(
+    DROPTION_SCOPE_CLIENT, "offline_writer_buffers", 3, 2, 8,
+    "Trace buffers per thread for -offline_writer_threads",
+    "The most trace buffers, between 2 and 8, that each application thread may use "
+    "with -offline_writer_threads, including the one it is filling, so that up to one "
+    "fewer than this number are waiting to be written out.  Spare buffers are only "
+    "allocated when needed.  When all of a thread's buffers are waiting, the thread "
+    "writes out those its writer thread has not yet started on itself, bounding the "
+    "memory used when the writer threads fall behind.");
+droption_t<bool> op_offline_streaming(
+    DROPTION_SCOPE_CLIENT, "offline_streaming", false,
+    "Lay out -offline output for conversion while tracing",
+    "Writes the -offline raw files so that drraw2trace -follow can convert them while "
+    "the application is still running.  The raw files are left uncompressed, as if "
+    "-raw_compress none were passed, so that each buffer can be read as soon as it is "
+    "written; the module list is rewritten to modules.snapshot on each module load; "
+    "and the file streaming.done is created at exit.  Tracing windows are not "
+    "supported in this mode.");
+
 droption_t<bool> op_online_instr_types(
     DROPTION_SCOPE_CLIENT, "online_instr_types", false,
     "Whether online traces should distinguish instr types",
@@ -332,18 +448,95 @@ droption_t<bool> op_online_instr_types(
 
 droption_t<std::string> op_replace_policy(
     DROPTION_SCOPE_FRONTEND, "replace_policy", REPLACE_POLICY_LRU,
-    "Cache replacement policy (LRU, LFU, FIFO)",
+    "Cache replacement policy (LRU, LFU, FIFO, PLRU, SRRIP, BRRIP, DRRIP, SHIP)",
     "Specifies the replacement policy for "
     "caches. Supported policies: LRU (Least Recently Used), LFU (Least Frequently Used), "
-    "FIFO (First-In-First-Out).");
+    "FIFO (First-In-First-Out), PLRU (tree pseudo-LRU), SRRIP (static re-reference "
+    "interval prediction), BRRIP (bimodal RRIP), DRRIP (dynamic RRIP, choosing between "
+    "SRRIP and BRRIP by set dueling), and SHIP (signature-based hit prediction by PC, "
+    "on top of SRRIP).");
 
 droption_t<std::string> op_data_prefetcher(
     DROPTION_SCOPE_FRONTEND, "data_prefetcher", PREFETCH_POLICY_NEXTLINE,
-    "Hardware data prefetcher policy (nextline, none)",
+    "Hardware data prefetcher policy (nextline, stride, stream, none)",
     "Specifies the hardware data "
     "prefetcher policy.  The currently supported policies are 'nextline' (fetch the "
-    "subsequent cache line) and 'none' (disables hardware prefetching).  The prefetcher "
-    "is located between the L1D and LL caches.");
+    "subsequent cache line), 'stride' (detect a constant stride per load or store PC "
+    "and fetch several strides ahead), 'stream' (detect ascending or descending "
+    "accesses within a 4K region and fetch several lines ahead) and 'none' (disables "
+    "hardware prefetching).  The prefetcher is located between the L1D and LL caches.  "
+    "Prefetch accuracy, coverage, and lead time are reported per cache.");
+
+droption_t<std::string> op_save_checkpoint(
+    DROPTION_SCOPE_FRONTEND, "save_checkpoint", "", "Checkpoint the cache simulation",
+    "If non-empty, the cache simulator writes its state to this file: the contents and "
+    "replacement state of every cache, their statistics, the snoop filter, and the "
+    "mapping of threads to cores.  The checkpoint is taken as soon as the warmup "
+    "specified by -warmup_refs or -warmup_fraction completes, or else at the end of "
+    "the simulation.  Not supported with sampling.");
+
+droption_t<std::string> op_restore_checkpoint(
+    DROPTION_SCOPE_FRONTEND, "restore_checkpoint", "", "Resume from a checkpoint",
+    "If non-empty, the cache simulator starts from the state in this file, written by "
+    "-save_checkpoint, and skips the references that simulation had consumed in place "
+    "of -skip_refs.  The trace must be the same, and the caches must have the same "
+    "names, sizes, associativities and replacement policies, but other options such "
+    "as -sim_refs, the prefetcher, or the timing model may differ.  Prefetcher "
+    "training and timing state are not checkpointed.  Not supported with sampling.");
+
+droption_t<bool> op_model_timing(
+    DROPTION_SCOPE_FRONTEND, "model_timing", false, "Estimate cycles per instruction",
+    "If true, the cache simulator adds an interval timing model that estimates each "
+    "core's cycles, CPI, and stall cycles.  Each instruction takes 1/-dispatch_width "
+    "cycles.  Instruction fetch misses stall for their full latency.  Load misses "
+    "within -rob_size instructions of each other overlap, and the core stalls when "
+    "the reorder buffer fills until they complete.  A miss's latency adds up the "
+    "latencies of the caches it visits and -memory_latency if it misses the last "
+    "level, waiting for a free MSHR in each cache it misses and for fill bandwidth.  "
+    "Not supported with -pipeline_workers or sampling.");
+
+droption_t<unsigned int> op_L1_latency(DROPTION_SCOPE_FRONTEND, "L1_latency", 4,
+                                       "L1 cache latency in cycles",
+                                       "Specifies the cycles to look up each L1 cache, "
+                                       "for -model_timing.");
+
+droption_t<unsigned int> op_LL_latency(DROPTION_SCOPE_FRONTEND, "LL_latency", 40,
+                                       "Last-level cache latency in cycles",
+                                       "Specifies the cycles to look up the last-level "
+                                       "cache, for -model_timing.");
+
+droption_t<unsigned int> op_memory_latency(DROPTION_SCOPE_FRONTEND, "memory_latency",
+                                           200, "Memory latency in cycles",
+                                           "Specifies the cycles for main memory to "
+                                           "serve a last-level cache miss, for "
+                                           "-model_timing.");
+
+droption_t<unsigned int> op_L1_mshrs(DROPTION_SCOPE_FRONTEND, "L1_mshrs", 10,
+                                     "Outstanding misses per L1 cache",
+                                     "Specifies the number of MSHRs in each L1 cache, "
+                                     "for -model_timing.  0 means unlimited.");
+
+droption_t<unsigned int> op_LL_mshrs(DROPTION_SCOPE_FRONTEND, "LL_mshrs", 32,
+                                     "Outstanding misses in the last-level cache",
+                                     "Specifies the number of MSHRs in the last-level "
+                                     "cache, shared evenly among the cores, for "
+                                     "-model_timing.  0 means unlimited.");
+
+droption_t<double> op_memory_bandwidth(
+    DROPTION_SCOPE_FRONTEND, "memory_bandwidth", 16.0, "Memory bytes per cycle",
+    "Specifies the bytes per cycle main memory can fill the last-level cache at, "
+    "shared evenly among the cores, for -model_timing.  0 means unlimited.");
+
+droption_t<unsigned int> op_rob_size(DROPTION_SCOPE_FRONTEND, "rob_size", 128,
+                                     "Reorder buffer entries",
+                                     "Specifies the reorder buffer size, which bounds "
+                                     "the load misses that can overlap, for "
+                                     "-model_timing.");
+
+droption_t<unsigned int> op_dispatch_width(DROPTION_SCOPE_FRONTEND, "dispatch_width", 4,
+                                           "Instructions dispatched per cycle",
+                                           "Specifies the instructions each core "
+                                           "dispatches per cycle, for -model_timing.");
 
 droption_t<bytesize_t> op_page_size(DROPTION_SCOPE_FRONTEND, "page_size",
                                     bytesize_t(4 * 1024), "Virtual/physical page size",
@@ -374,6 +567,36 @@ droption_t<unsigned int> op_TLB_L2_assoc(
     DROPTION_SCOPE_FRONTEND, "TLB_L2_assoc", 4, "L2 TLB associativity",
     "Specifies the associativity of each unified L2 TLB.  Must be a power of 2.");
 
+droption_t<unsigned int> op_TLB_L3_entries(
+    DROPTION_SCOPE_FRONTEND, "TLB_L3_entries", 0, "Number of entries in L3 TLB",
+    "Specifies the number of entries in each unified L3 TLB, which sits below the L2 "
+    "TLB.  Must be a power of 2.  0, the default, means there is no L3 TLB.");
+
+droption_t<unsigned int> op_TLB_L3_assoc(
+    DROPTION_SCOPE_FRONTEND, "TLB_L3_assoc", 4, "L3 TLB associativity",
+    "Specifies the associativity of each unified L3 TLB.  Must be a power of 2.");
+
+droption_t<unsigned int> op_TLB_PWC_entries(
+    DROPTION_SCOPE_FRONTEND, "TLB_PWC_entries", 32, "Entries per page walk cache level",
+    "Misses in the last-level TLB walk a simulated 4-level page table.  This specifies "
+    "the number of entries in each of the fully associative page walk caches, which "
+    "hold the upper-level entries (PML4E, PDPTE and PDE) of recent walks so that a "
+    "walk can skip those levels.  0 disables the page walk caches.");
+
+droption_t<std::string> op_TLB_page_size_map(
+    DROPTION_SCOPE_FRONTEND, "TLB_page_size_map", "", "File of huge page ranges",
+    "Specifies a file listing address ranges backed by pages other than -page_size, "
+    "for simulating huge pages.  Each line holds a start address, an end address "
+    "(exclusive) and a page size, such as '0x7f0000000000 0x7f0040000000 0x200000'; '#' "
+    "starts a comment.  The TLBs hold entries of all page sizes and page walks stop "
+    "at the level that maps each page.  The same ranges apply to every process.");
+
+droption_t<bool> op_TLB_walk_caches(
+    DROPTION_SCOPE_FRONTEND, "TLB_walk_caches", false, "Charge page walks to caches",
+    "If true, the page table entries read by page walks are sent to a cache hierarchy "
+    "configured by the cache simulator options, alongside the application's own "
+    "references, and that hierarchy's results are printed after the TLB results.");
+
 droption_t<std::string>
     op_TLB_replace_policy(DROPTION_SCOPE_FRONTEND, "TLB_replace_policy",
                           REPLACE_POLICY_LFU, "TLB replacement policy",
@@ -383,12 +606,13 @@ droption_t<std::string>
 droption_t<std::string>
     op_simulator_type(DROPTION_SCOPE_FRONTEND, "simulator_type", CPU_CACHE,
                       "Simulator type (" CPU_CACHE ", " MISS_ANALYZER ", " TLB
-                      ", " REUSE_DIST ", " REUSE_TIME ", " HISTOGRAM ", " VIEW
-                      ", " FUNC_VIEW ", " BASIC_COUNTS ", or " INVARIANT_CHECKER ").",
+                      ", " REUSE_DIST ", " REUSE_TIME ", " MISS_RATIO_CURVE
+                      ", " HISTOGRAM ", " VIEW ", " FUNC_VIEW ", " BASIC_COUNTS
+                      ", or " INVARIANT_CHECKER ").",
                       "Specifies the type of the simulator. "
                       "Supported types: " CPU_CACHE ", " MISS_ANALYZER ", " TLB
-                      ", " REUSE_DIST ", " REUSE_TIME ", " HISTOGRAM ", " BASIC_COUNTS
-                      ", or " INVARIANT_CHECKER ".");
+                      ", " REUSE_DIST ", " REUSE_TIME ", " MISS_RATIO_CURVE
+                      ", " HISTOGRAM ", " BASIC_COUNTS ", or " INVARIANT_CHECKER ".");
 
 droption_t<unsigned int> op_verbose(DROPTION_SCOPE_ALL, "verbose", 0, 0, 64,
                                     "Verbosity level",
@@ -475,6 +699,31 @@ droption_t<bytesize_t>
                 "The simulated references come after the skipped and warmup references, "
                 "and the references following the simulated ones are dropped.");
 
+droption_t<bytesize_t> op_sample_period(
+    DROPTION_SCOPE_FRONTEND, "sample_period", 0,
+    "Period in memory references of sampled cache simulation",
+    "Enables systematic sampling for the cache simulator, in the style of SMARTS.  Each "
+    "period of this many memory references after the skipped references ends with a "
+    "sampling unit of -sample_warmup_refs references that warm the caches followed by "
+    "-sample_measure_refs references whose statistics are measured.  The remaining "
+    "references of each period are dropped without being simulated.  The reported "
+    "statistics are summed over all units, with 95% confidence intervals for the "
+    "per-unit miss rate and other metrics.  To warm the caches continuously, make the "
+    "warmup and measured references add up to the period.  Sampling is incompatible "
+    "with -warmup_refs and -warmup_fraction.  0 disables sampling.");
+
+droption_t<bytesize_t> op_sample_warmup_refs(
+    DROPTION_SCOPE_FRONTEND, "sample_warmup_refs", 0,
+    "Warmup memory references in each sampling unit",
+    "For -sample_period, the number of memory references simulated to warm up the "
+    "caches before the measured references of each sampling unit.");
+
+droption_t<bytesize_t> op_sample_measure_refs(
+    DROPTION_SCOPE_FRONTEND, "sample_measure_refs", 10000,
+    "Measured memory references in each sampling unit",
+    "For -sample_period, the number of memory references whose statistics are "
+    "measured in each sampling unit.");
+
 droption_t<std::string>
     op_view_syntax(DROPTION_SCOPE_FRONTEND, "view_syntax", "att/arm/dr",
                    "Syntax to use for disassembly.",
@@ -491,6 +740,16 @@ droption_t<std::string>
                    "Cache hierarchy configuration file",
                    "The full path to the cache hierarchy configuration file.");
 
+droption_t<std::string> op_sweep_config(
+    DROPTION_SCOPE_FRONTEND, "sweep_config", DROPTION_FLAG_ACCUMULATE,
+    OP_SWEEP_CONFIG_SEP, "", "Cache hierarchy configuration files to sweep",
+    "The full path to a cache hierarchy configuration file, in the format of "
+    "-config_file.  This option can be repeated: each hierarchy is simulated "
+    "independently over the same single pass through the trace, so a design-space "
+    "sweep only reads and decompresses the trace once.  The simulators are divided "
+    "among -jobs threads.  Each hierarchy's results are printed in turn.  This "
+    "supersedes -config_file and the cache size knobs.");
+
 // XXX: if we separate histogram + reuse_distance we should move this with them.
 droption_t<unsigned int>
     op_report_top(DROPTION_SCOPE_FRONTEND, "report_top", 10,
@@ -636,6 +895,23 @@ droption_t<double> op_confidence_threshold(
     "results. Confidence in a discovered pattern for a load instruction is calculated "
     "as the fraction of the load's misses with the discovered pattern over all the "
     "load's misses.");
+droption_t<unsigned int> op_stride_sketch_size(
+    DROPTION_SCOPE_FRONTEND, "stride_sketch_size", 16,
+    "For cache miss analysis: number of candidate strides tracked per load.",
+    "Specifies how many distinct strides between consecutive LLC misses are tracked "
+    "for each load.  Rather than storing every miss address, the analyzer keeps a "
+    "bounded frequent-items summary of each load's strides, which finds every stride "
+    "that could meet a -confidence_threshold above 1/(N+1) for N candidates.  The "
+    "counts are exact for loads with no more than N distinct strides.");
+droption_t<bool> op_miss_analyzer_shards(
+    DROPTION_SCOPE_FRONTEND, "miss_analyzer_shards", false,
+    "For cache miss analysis: analyze trace shards in parallel.",
+    "When analyzing an offline trace, simulates each trace shard (by default, each "
+    "thread) concurrently in a private single-core cache hierarchy, with the number "
+    "of worker threads controlled by -jobs, and merges the shards' LLC misses before "
+    "searching for patterns.  This ignores contention for the LLC between threads, "
+    "and options such as -skip_refs, -warmup_refs and -sim_refs apply to each shard "
+    "separately.");
 droption_t<bool> op_enable_drstatecmp(
     DROPTION_SCOPE_CLIENT, "enable_drstatecmp", false, "Enable the drstatecmp library.",
     "When true, this option enables the drstatecmp library that performs state "
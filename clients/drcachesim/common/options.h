@@ -39,7 +39,14 @@
 #define REPLACE_POLICY_LRU "LRU"
 #define REPLACE_POLICY_LFU "LFU"
 #define REPLACE_POLICY_FIFO "FIFO"
+#define REPLACE_POLICY_PLRU "PLRU"
+#define REPLACE_POLICY_SRRIP "SRRIP"
+#define REPLACE_POLICY_BRRIP "BRRIP"
+#define REPLACE_POLICY_DRRIP "DRRIP"
+#define REPLACE_POLICY_SHIP "SHIP"
 #define PREFETCH_POLICY_NEXTLINE "nextline"
+#define PREFETCH_POLICY_STRIDE "stride"
+#define PREFETCH_POLICY_STREAM "stream"
 #define PREFETCH_POLICY_NONE "none"
 #define CPU_CACHE "cache"
 #define MISS_ANALYZER "miss_analyzer"
@@ -47,6 +54,7 @@
 #define HISTOGRAM "histogram"
 #define REUSE_DIST "reuse_distance"
 #define REUSE_TIME "reuse_time"
+#define MISS_RATIO_CURVE "miss_ratio_curve"
 #define BASIC_COUNTS "basic_counts"
 #define OPCODE_MIX "opcode_mix"
 #define VIEW "view"
@@ -56,18 +64,23 @@
 #define CACHE_TYPE_DATA "data"
 #define CACHE_TYPE_UNIFIED "unified"
 #define CACHE_PARENT_MEMORY "memory"
+// Separates the accumulated values of -sweep_config.
+#define OP_SWEEP_CONFIG_SEP ","
 
 #include <string>
 #include "droption.h"
 
 extern droption_t<bool> op_offline;
 extern droption_t<std::string> op_ipc_name;
+extern droption_t<unsigned int> op_ipc_shm_rings;
+extern droption_t<bytesize_t> op_ipc_shm_ring_size;
 extern droption_t<std::string> op_outdir;
 extern droption_t<std::string> op_subdir_prefix;
 extern droption_t<std::string> op_infile;
 extern droption_t<std::string> op_indir;
 extern droption_t<std::string> op_module_file;
 extern droption_t<std::string> op_alt_module_dir;
+extern droption_t<std::string> op_decode_cache_dir;
 extern droption_t<std::string> op_funclist_file;
 extern droption_t<unsigned int> op_num_cores;
 extern droption_t<unsigned int> op_line_size;
@@ -85,6 +98,8 @@ extern droption_t<bool> op_L0D_filter;
 extern droption_t<bytesize_t> op_L0D_size;
 extern droption_t<bool> op_instr_only_trace;
 extern droption_t<bool> op_coherence;
+extern droption_t<unsigned int> op_snoop_filter_size;
+extern droption_t<unsigned int> op_pipeline_workers;
 extern droption_t<bool> op_use_physical;
 extern droption_t<unsigned int> op_virt2phys_freq;
 extern droption_t<bool> op_cpu_scheduling;
@@ -96,9 +111,23 @@ extern droption_t<bytesize_t> op_retrace_every_instrs;
 extern droption_t<bool> op_split_windows;
 extern droption_t<bytesize_t> op_exit_after_tracing;
 extern droption_t<std::string> op_raw_compress;
+extern droption_t<unsigned int> op_offline_writer_threads;
+extern droption_t<unsigned int> op_offline_writer_buffers;
+extern droption_t<bool> op_offline_streaming;
 extern droption_t<bool> op_online_instr_types;
 extern droption_t<std::string> op_replace_policy;
 extern droption_t<std::string> op_data_prefetcher;
+extern droption_t<std::string> op_save_checkpoint;
+extern droption_t<std::string> op_restore_checkpoint;
+extern droption_t<bool> op_model_timing;
+extern droption_t<unsigned int> op_L1_latency;
+extern droption_t<unsigned int> op_LL_latency;
+extern droption_t<unsigned int> op_memory_latency;
+extern droption_t<unsigned int> op_L1_mshrs;
+extern droption_t<unsigned int> op_LL_mshrs;
+extern droption_t<double> op_memory_bandwidth;
+extern droption_t<unsigned int> op_rob_size;
+extern droption_t<unsigned int> op_dispatch_width;
 extern droption_t<bytesize_t> op_page_size;
 extern droption_t<unsigned int> op_TLB_L1I_entries;
 extern droption_t<unsigned int> op_TLB_L1D_entries;
@@ -106,11 +135,20 @@ extern droption_t<unsigned int> op_TLB_L1I_assoc;
 extern droption_t<unsigned int> op_TLB_L1D_assoc;
 extern droption_t<unsigned int> op_TLB_L2_entries;
 extern droption_t<unsigned int> op_TLB_L2_assoc;
+extern droption_t<unsigned int> op_TLB_L3_entries;
+extern droption_t<unsigned int> op_TLB_L3_assoc;
+extern droption_t<unsigned int> op_TLB_PWC_entries;
+extern droption_t<std::string> op_TLB_page_size_map;
+extern droption_t<bool> op_TLB_walk_caches;
 extern droption_t<std::string> op_TLB_replace_policy;
 extern droption_t<std::string> op_simulator_type;
 extern droption_t<unsigned int> op_verbose;
 extern droption_t<bool> op_show_func_trace;
 extern droption_t<int> op_jobs;
+extern droption_t<bytesize_t> op_chunk_instr_count;
+extern droption_t<std::string> op_trace_compress;
+extern droption_t<std::string> op_zstd_dict;
+extern droption_t<bool> op_read_ahead;
 extern droption_t<bool> op_test_mode;
 extern droption_t<std::string> op_test_mode_name;
 extern droption_t<bool> op_disable_optimizations;
@@ -125,7 +163,11 @@ extern droption_t<bytesize_t> op_skip_refs;
 extern droption_t<bytesize_t> op_warmup_refs;
 extern droption_t<double> op_warmup_fraction;
 extern droption_t<bytesize_t> op_sim_refs;
+extern droption_t<bytesize_t> op_sample_period;
+extern droption_t<bytesize_t> op_sample_warmup_refs;
+extern droption_t<bytesize_t> op_sample_measure_refs;
 extern droption_t<std::string> op_config_file;
+extern droption_t<std::string> op_sweep_config;
 extern droption_t<unsigned int> op_report_top;
 extern droption_t<unsigned int> op_reuse_distance_threshold;
 extern droption_t<bool> op_reuse_distance_histogram;
@@ -140,5 +182,7 @@ extern droption_t<bool> op_record_replace_retaddr;
 extern droption_t<unsigned int> op_miss_count_threshold;
 extern droption_t<double> op_miss_frac_threshold;
 extern droption_t<double> op_confidence_threshold;
+extern droption_t<unsigned int> op_stride_sketch_size;
+extern droption_t<bool> op_miss_analyzer_shards;
 extern droption_t<bool> op_enable_drstatecmp;
 #endif /* _OPTIONS_H_ */
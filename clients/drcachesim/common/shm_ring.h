@@ -0,0 +1,145 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* shm_ring: a shared-memory alternative to named_pipe_t for sending online
+ * trace data from tracer threads in one or more processes to a single reader.
+ */
+
+#ifndef _SHM_RING_H_
+#define _SHM_RING_H_ 1
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unistd.h> // for ssize_t
+
+// The shared region holds a fixed number of rings, each a byte array of records.
+// Writers pick a ring by a hint such as their thread id, so each writer thread
+// sends all of its records through the same ring in order; a ring may have
+// writers from several threads and processes, which take turns via a spinlock
+// in the ring.  A writer waits for space before taking the lock, and takes over
+// a lock whose owner process has exited.  The single reader takes whole records
+// from the rings in turn.  Each record is copied once into the ring and once out
+// of it, with no system calls unless a ring is full or the reader has run out of
+// data, when the waiting side sleeps on a futex.
+//
+// Usage is as follows:
+// + The reader calls create() up front (and at the end destroy()), and then read().
+// + Each writer process maps the file named by get_name() and calls attach() on
+//   the mapping (and detach() when done), and then write().  A forked child shares
+//   its parent's mapping and must call register_writer() to be counted.
+// The reader sees the end of the data once every writer process has detached or
+// exited and the rings are empty.
+class shm_ring_t {
+public:
+    shm_ring_t();
+    explicit shm_ring_t(const char *name);
+    ~shm_ring_t();
+    bool
+    set_name(const char *name);
+    std::string
+    get_name() const;
+
+    // Creates the shared file and maps it.  The ring size is rounded up to a
+    // power of two.
+    bool
+    create(unsigned int num_rings, size_t ring_size);
+    // Unmaps and removes the shared file.
+    bool
+    destroy();
+
+    // Uses a writable shared mapping of the file created by the reader.  This
+    // lets a caller that must not use the libc allocator or mmap create the
+    // mapping itself.
+    bool
+    attach(void *map, size_t map_size);
+    // Unregisters this process.  The caller then unmaps the mapping.
+    bool
+    detach();
+    bool
+    register_writer();
+
+    // Writes sz bytes, at most get_atomic_write_size(), as one record to the
+    // ring selected by hint, blocking while the ring is full.
+    // Returns < 0 on an error or if the reader has exited.
+    // On success returns sz.
+    ssize_t
+    write(unsigned int hint, const void *buf, size_t sz);
+
+    // Reads as many whole records as fit in sz bytes, which must be at least
+    // get_atomic_write_size(), from the next non-empty ring, blocking while all
+    // rings are empty.
+    // Returns < 0 once all writers are gone and the rings are empty.
+    // Otherwise returns the number of bytes read.
+    ssize_t
+    read(void *buf, size_t sz);
+
+    ssize_t
+    get_atomic_write_size() const;
+
+private:
+    struct header_t;
+    struct ring_t;
+
+    ring_t *
+    get_ring(unsigned int index) const;
+    // These copy to or from the ring at pos, which may wrap around its end.
+    void
+    copy_in(unsigned int index, uint64_t pos, const void *src, size_t size);
+    void
+    copy_out(unsigned int index, uint64_t pos, void *dst, size_t size) const;
+    // Blocks until the ring has room for need bytes.  Returns false if the
+    // reader has exited.
+    bool
+    wait_for_space(ring_t *ring, uint64_t need);
+    void
+    lock_ring(ring_t *ring);
+    bool
+    any_ring_nonempty() const;
+    bool
+    any_writer_registered() const;
+    // Unregisters writer processes that exited without detaching.
+    void
+    clear_exited_writers();
+
+    std::string name_;
+    unsigned char *map_;
+    size_t map_size_;
+    header_t *header_;
+    // Whether we created and so own the mapping.
+    bool is_reader_;
+    // The reader resumes its round-robin scan here.
+    unsigned int next_ring_;
+};
+
+#endif /* _SHM_RING_H_ */
@@ -0,0 +1,498 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <climits>
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef LINUX
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
+#endif
+#include "shm_ring.h"
+
+#define SHM_RING_PERMS 0666
+
+namespace {
+
+const uint32_t SHM_RING_MAGIC = 0x676e6972; // "ring"
+const uint32_t SHM_RING_VERSION = 1;
+const int MAX_WRITER_PROCESSES = 256;
+// Records hold a length followed by the data, padded to keep lengths aligned.
+const size_t RECORD_ALIGN = 8;
+const size_t RECORD_HEADER_SIZE = 8;
+const size_t MAX_RECORD_SIZE = 128 * 1024;
+// Waiters wake up this often to check whether the other side has exited.
+const int WAIT_TIMEOUT_MS = 100;
+// A writer waiting for a ring's lock checks this often whether its owner exited.
+const int LOCK_SPINS_PER_OWNER_CHECK = 1024;
+
+size_t
+align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void
+futex_wait(std::atomic<uint32_t> *word, uint32_t expected)
+{
+#ifdef LINUX
+    struct timespec timeout = { WAIT_TIMEOUT_MS / 1000,
+                                (WAIT_TIMEOUT_MS % 1000) * 1000000L };
+    // The word is shared across processes, so this cannot be FUTEX_WAIT_PRIVATE.
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, expected,
+            &timeout, nullptr, 0);
+#else
+    // Without futexes we poll.
+    if (word->load() == expected)
+        usleep(1000);
+#endif
+}
+
+void
+futex_wake(std::atomic<uint32_t> *word)
+{
+#ifdef LINUX
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT_MAX, nullptr,
+            nullptr, 0);
+#endif
+}
+
+bool
+process_exists(int pid)
+{
+    if (kill(pid, 0) != 0 && errno == ESRCH)
+        return false;
+#ifdef LINUX
+    // A crashed writer that is the reader's own child lingers as a zombie until
+    // the reader's process reaps it, which it only does once we are done.
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return true;
+    char stat[128];
+    ssize_t len = ::read(fd, stat, sizeof(stat) - 1);
+    close(fd);
+    if (len <= 0)
+        return true;
+    stat[len] = '\0';
+    // The state follows the parenthesized command name.
+    const char *state = strrchr(stat, ')');
+    return state == nullptr || state[1] == '\0' || state[2] != 'Z';
+#else
+    return true;
+#endif
+}
+
+const char *
+shm_dir()
+{
+    // Matches the default named pipe directory.
+#ifdef ANDROID
+    return "/data/local/tmp";
+#else
+    return "/tmp";
+#endif
+}
+
+} // namespace
+
+struct shm_ring_t::header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_rings;
+    int32_t reader_pid;
+    uint64_t ring_size;
+    uint64_t data_offset;
+    uint64_t map_size;
+    // Set once any writer registers, so the reader does not see the end of the
+    // data before the first writer arrives.
+    std::atomic<uint32_t> had_writer;
+    // The reader's futex word, bumped by writers that find it waiting.
+    std::atomic<uint32_t> data_seq;
+    std::atomic<uint32_t> reader_waiting;
+    std::atomic<int32_t> writer_pids[MAX_WRITER_PROCESSES];
+};
+
+struct shm_ring_t::ring_t {
+    // Written by writers, holding the lock.
+    alignas(64) std::atomic<uint64_t> tail;
+    // The pid of the writer process holding the lock, or 0.
+    std::atomic<uint32_t> lock;
+    std::atomic<uint32_t> writers_waiting;
+    // Written by the reader.
+    alignas(64) std::atomic<uint64_t> head;
+    // The writers' futex word, bumped by the reader when it frees space.
+    std::atomic<uint32_t> space_seq;
+};
+
+shm_ring_t::shm_ring_t()
+    : map_(nullptr)
+    , map_size_(0)
+    , header_(nullptr)
+    , is_reader_(false)
+    , next_ring_(0)
+{
+}
+
+shm_ring_t::shm_ring_t(const char *name)
+    : shm_ring_t()
+{
+    set_name(name);
+}
+
+shm_ring_t::~shm_ring_t()
+{
+    if (is_reader_ && map_ != nullptr)
+        munmap(map_, map_size_);
+}
+
+bool
+shm_ring_t::set_name(const char *name)
+{
+    if (map_ != nullptr)
+        return false;
+    // We add a suffix to avoid clashing with a named pipe of the same name.
+    if (name[0] == '/')
+        name_ = std::string(name) + ".shm";
+    else
+        name_ = std::string(shm_dir()) + "/" + name + ".shm";
+    return true;
+}
+
+std::string
+shm_ring_t::get_name() const
+{
+    return name_;
+}
+
+bool
+shm_ring_t::create(unsigned int num_rings, size_t ring_size)
+{
+    if (map_ != nullptr || num_rings == 0)
+        return false;
+    size_t size = 4 * MAX_RECORD_SIZE;
+    while (size < ring_size)
+        size *= 2;
+    const size_t data_offset =
+        align_up(align_up(sizeof(header_t), alignof(ring_t)) + num_rings * sizeof(ring_t),
+                 sysconf(_SC_PAGESIZE));
+    const size_t map_size = data_offset + num_rings * size;
+    umask(0);
+    int fd = open(name_.c_str(), O_RDWR | O_CREAT | O_EXCL, SHM_RING_PERMS);
+    if (fd < 0)
+        return false;
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, map_size) == 0)
+        map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        unlink(name_.c_str());
+        return false;
+    }
+    map_ = static_cast<unsigned char *>(map);
+    map_size_ = map_size;
+    is_reader_ = true;
+    header_ = new (map_) header_t();
+    header_->magic = SHM_RING_MAGIC;
+    header_->version = SHM_RING_VERSION;
+    header_->num_rings = num_rings;
+    header_->reader_pid = getpid();
+    header_->ring_size = size;
+    header_->data_offset = data_offset;
+    header_->map_size = map_size;
+    for (unsigned int i = 0; i < num_rings; ++i)
+        new (get_ring(i)) ring_t();
+    return true;
+}
+
+bool
+shm_ring_t::destroy()
+{
+    if (!is_reader_)
+        return false;
+    if (map_ != nullptr)
+        munmap(map_, map_size_);
+    map_ = nullptr;
+    header_ = nullptr;
+    is_reader_ = false;
+    return unlink(name_.c_str()) == 0;
+}
+
+bool
+shm_ring_t::attach(void *map, size_t map_size)
+{
+    if (map_ != nullptr || map_size < sizeof(header_t))
+        return false;
+    header_t *header = static_cast<header_t *>(map);
+    if (header->magic != SHM_RING_MAGIC || header->version != SHM_RING_VERSION ||
+        map_size < header->map_size)
+        return false;
+    map_ = static_cast<unsigned char *>(map);
+    map_size_ = map_size;
+    header_ = header;
+    return register_writer();
+}
+
+bool
+shm_ring_t::register_writer()
+{
+    if (header_ == nullptr)
+        return false;
+    const int32_t pid = getpid();
+    bool registered = false;
+    // After an execve we may already be registered under the same pid.
+    for (int i = 0; i < MAX_WRITER_PROCESSES && !registered; ++i)
+        registered = header_->writer_pids[i].load() == pid;
+    for (int i = 0; i < MAX_WRITER_PROCESSES && !registered; ++i) {
+        int32_t empty = 0;
+        registered = header_->writer_pids[i].compare_exchange_strong(empty, pid);
+    }
+    if (registered)
+        header_->had_writer.store(1);
+    return registered;
+}
+
+bool
+shm_ring_t::detach()
+{
+    if (header_ == nullptr || is_reader_)
+        return false;
+    int32_t pid = getpid();
+    for (int i = 0; i < MAX_WRITER_PROCESSES; ++i) {
+        int32_t expected = pid;
+        if (header_->writer_pids[i].compare_exchange_strong(expected, 0))
+            break;
+    }
+    // Wake the reader so it notices the end of the data promptly.
+    header_->data_seq.fetch_add(1);
+    futex_wake(&header_->data_seq);
+    map_ = nullptr;
+    header_ = nullptr;
+    return true;
+}
+
+shm_ring_t::ring_t *
+shm_ring_t::get_ring(unsigned int index) const
+{
+    return reinterpret_cast<ring_t *>(map_ + align_up(sizeof(header_t), alignof(ring_t)) +
+                                      index * sizeof(ring_t));
+}
+
+void
+shm_ring_t::copy_in(unsigned int index, uint64_t pos, const void *src, size_t size)
+{
+    unsigned char *data = map_ + header_->data_offset + index * header_->ring_size;
+    const size_t offs = pos & (header_->ring_size - 1);
+    const size_t room = header_->ring_size - offs;
+    const size_t first = room < size ? room : size;
+    memcpy(data + offs, src, first);
+    memcpy(data, static_cast<const unsigned char *>(src) + first, size - first);
+}
+
+void
+shm_ring_t::copy_out(unsigned int index, uint64_t pos, void *dst, size_t size) const
+{
+    const unsigned char *data = map_ + header_->data_offset + index * header_->ring_size;
+    const size_t offs = pos & (header_->ring_size - 1);
+    const size_t room = header_->ring_size - offs;
+    const size_t first = room < size ? room : size;
+    memcpy(dst, data + offs, first);
+    memcpy(static_cast<unsigned char *>(dst) + first, data, size - first);
+}
+
+ssize_t
+shm_ring_t::write(unsigned int hint, const void *buf, size_t sz)
+{
+    if (header_ == nullptr || sz > static_cast<size_t>(get_atomic_write_size()))
+        return -1;
+    const unsigned int index = hint % header_->num_rings;
+    ring_t *ring = get_ring(index);
+    const uint64_t need = RECORD_HEADER_SIZE + align_up(sz, RECORD_ALIGN);
+    uint64_t tail;
+    while (true) {
+        // We wait for space without the lock, so a full ring does not leave the
+        // other writers spinning, and re-check once we hold it as another writer
+        // may have filled the space in between.
+        if (!wait_for_space(ring, need))
+            return -1;
+        lock_ring(ring);
+        tail = ring->tail.load(std::memory_order_relaxed);
+        if (tail + need - ring->head.load() <= header_->ring_size)
+            break;
+        ring->lock.store(0, std::memory_order_release);
+    }
+    const uint64_t len = sz;
+    copy_in(index, tail, &len, sizeof(len));
+    copy_in(index, tail + RECORD_HEADER_SIZE, buf, sz);
+    ring->tail.store(tail + need);
+    ring->lock.store(0, std::memory_order_release);
+    if (header_->reader_waiting.load() != 0) {
+        header_->data_seq.fetch_add(1);
+        futex_wake(&header_->data_seq);
+    }
+    return sz;
+}
+
+bool
+shm_ring_t::wait_for_space(ring_t *ring, uint64_t need)
+{
+    while (true) {
+        uint32_t seq = ring->space_seq.load();
+        // We load head first: it never passes the tail, and the tail only grows,
+        // so the difference cannot go negative.
+        uint64_t head = ring->head.load();
+        if (ring->tail.load() + need - head <= header_->ring_size)
+            return true;
+        // The ring is full: wait for the reader to free space.
+        ring->writers_waiting.fetch_add(1);
+        head = ring->head.load();
+        if (ring->tail.load() + need - head > header_->ring_size)
+            futex_wait(&ring->space_seq, seq);
+        ring->writers_waiting.fetch_sub(1);
+        if (ring->space_seq.load() == seq && !process_exists(header_->reader_pid))
+            return false;
+    }
+}
+
+void
+shm_ring_t::lock_ring(ring_t *ring)
+{
+    const uint32_t self = getpid();
+    uint32_t owner = 0;
+    for (int spins = 1;
+         !ring->lock.compare_exchange_weak(owner, self, std::memory_order_acquire);
+         ++spins) {
+        // A writer only advances the tail once its record is complete, so if the
+        // owner died holding the lock we can safely take it over.
+        if (owner != 0 && spins % LOCK_SPINS_PER_OWNER_CHECK == 0 &&
+            !process_exists(owner) &&
+            ring->lock.compare_exchange_strong(owner, self, std::memory_order_acquire))
+            return;
+        owner = 0;
+        sched_yield();
+    }
+}
+
+bool
+shm_ring_t::any_ring_nonempty() const
+{
+    for (unsigned int i = 0; i < header_->num_rings; ++i) {
+        ring_t *ring = get_ring(i);
+        if (ring->head.load(std::memory_order_relaxed) != ring->tail.load())
+            return true;
+    }
+    return false;
+}
+
+bool
+shm_ring_t::any_writer_registered() const
+{
+    for (int i = 0; i < MAX_WRITER_PROCESSES; ++i) {
+        if (header_->writer_pids[i].load() != 0)
+            return true;
+    }
+    return false;
+}
+
+void
+shm_ring_t::clear_exited_writers()
+{
+    for (int i = 0; i < MAX_WRITER_PROCESSES; ++i) {
+        int32_t pid = header_->writer_pids[i].load();
+        if (pid != 0 && !process_exists(pid))
+            header_->writer_pids[i].compare_exchange_strong(pid, 0);
+    }
+}
+
+ssize_t
+shm_ring_t::read(void *buf, size_t sz)
+{
+    if (header_ == nullptr || sz < static_cast<size_t>(get_atomic_write_size()))
+        return -1;
+    while (true) {
+        // We check for writers before looking at the rings, as a writer's final
+        // records are in place before it unregisters.
+        const bool ended = header_->had_writer.load() != 0 && !any_writer_registered();
+        for (unsigned int i = 0; i < header_->num_rings; ++i) {
+            const unsigned int index = (next_ring_ + i) % header_->num_rings;
+            ring_t *ring = get_ring(index);
+            uint64_t head = ring->head.load(std::memory_order_relaxed);
+            const uint64_t tail = ring->tail.load();
+            if (head == tail)
+                continue;
+            size_t copied = 0;
+            while (head != tail) {
+                uint64_t len;
+                copy_out(index, head, &len, sizeof(len));
+                if (copied + len > sz)
+                    break;
+                copy_out(index, head + RECORD_HEADER_SIZE,
+                         static_cast<unsigned char *>(buf) + copied, len);
+                copied += len;
+                head += RECORD_HEADER_SIZE + align_up(len, RECORD_ALIGN);
+            }
+            ring->head.store(head);
+            ring->space_seq.fetch_add(1);
+            if (ring->writers_waiting.load() != 0)
+                futex_wake(&ring->space_seq);
+            next_ring_ = index + 1;
+            return copied;
+        }
+        if (ended)
+            return -1;
+        // Every ring is empty: wait for a writer.
+        uint32_t seq = header_->data_seq.load();
+        header_->reader_waiting.store(1);
+        if (!any_ring_nonempty())
+            futex_wait(&header_->data_seq, seq);
+        header_->reader_waiting.store(0);
+        if (header_->data_seq.load() == seq)
+            clear_exited_writers();
+    }
+}
+
+ssize_t
+shm_ring_t::get_atomic_write_size() const
+{
+    return MAX_RECORD_SIZE;
+}
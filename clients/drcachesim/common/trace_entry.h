@@ -627,4 +627,17 @@ typedef union {
  */
 #define DRMEMTRACE_FUNCTION_LIST_FILENAME "funclist.log"
 
+/**
+ * The name of the file in -offline_streaming mode holding the module list as of
+ * the most recent module load.  It is replaced as a whole on each update, and
+ * lists every module referenced by the thread files written so far.
+ */
+#define DRMEMTRACE_MODULE_SNAPSHOT_FILENAME "modules.snapshot"
+
+/**
+ * The name of the empty file created in -offline_streaming mode once the traced
+ * process has exited and all of its thread files are complete.
+ */
+#define DRMEMTRACE_STREAM_DONE_FILENAME "streaming.done"
+
 #endif /* _TRACE_ENTRY_H_ */
@@ -0,0 +1,135 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* zstd_istream_t: a wrapper around zstd streaming decompression to match the
+ * parts of the std::istream interface we use for file_reader_t.
+ * Seeking is not supported.
+ */
+
+#ifndef _ZSTD_ISTREAM_H_
+#define _ZSTD_ISTREAM_H_ 1
+
+#ifndef HAS_ZSTD
+#    error HAS_ZSTD is required
+#endif
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <zstd.h>
+
+/* We need to override the stream buffer class which is where the file
+ * reads happen.  The stream buffer base class reads from eback()..egptr()
+ * with the next to read at gptr().
+ */
+class zstd_istreambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    // A non-empty dict holds the contents of the dictionary the file was
+    // compressed with.
+    zstd_istreambuf_t(const std::string &path, const std::string &dict)
+        : file_(path, std::ifstream::binary)
+    {
+        if (!file_)
+            return;
+        dctx_ = ZSTD_createDCtx();
+        if (dctx_ == nullptr)
+            return;
+        if (!dict.empty() &&
+            ZSTD_isError(ZSTD_DCtx_loadDictionary(dctx_, dict.data(), dict.size()))) {
+            ZSTD_freeDCtx(dctx_);
+            dctx_ = nullptr;
+            return;
+        }
+        in_size_ = ZSTD_DStreamInSize();
+        buf_compressed_ = new char[in_size_];
+        out_size_ = ZSTD_DStreamOutSize();
+        buf_uncompressed_ = new char[out_size_];
+    }
+    ~zstd_istreambuf_t() override
+    {
+        if (dctx_ != nullptr)
+            ZSTD_freeDCtx(dctx_);
+        delete[] buf_compressed_;
+        delete[] buf_uncompressed_;
+    }
+    bool
+    is_open()
+    {
+        return dctx_ != nullptr;
+    }
+    int
+    underflow() override
+    {
+        if (dctx_ == nullptr)
+            return traits_type::eof();
+        if (gptr() == egptr()) {
+            ZSTD_outBuffer out = { buf_uncompressed_, out_size_, 0 };
+            while (out.pos == 0) {
+                if (in_.pos == in_.size) {
+                    file_.read(buf_compressed_, in_size_);
+                    if (file_.gcount() <= 0)
+                        return traits_type::eof();
+                    in_ = { buf_compressed_, static_cast<size_t>(file_.gcount()), 0 };
+                }
+                size_t res = ZSTD_decompressStream(dctx_, &out, &in_);
+                if (ZSTD_isError(res))
+                    return traits_type::eof();
+            }
+            setg(buf_uncompressed_, buf_uncompressed_, buf_uncompressed_ + out.pos);
+        }
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    std::ifstream file_;
+    ZSTD_DCtx *dctx_ = nullptr;
+    ZSTD_inBuffer in_ = { nullptr, 0, 0 };
+    char *buf_compressed_ = nullptr;
+    char *buf_uncompressed_ = nullptr;
+    size_t in_size_ = 0;
+    size_t out_size_ = 0;
+};
+
+class zstd_istream_t : public std::istream {
+public:
+    explicit zstd_istream_t(const std::string &path, const std::string &dict = "")
+        : std::istream(new zstd_istreambuf_t(path, dict))
+    {
+        if (!static_cast<zstd_istreambuf_t *>(rdbuf())->is_open())
+            setstate(std::ios::badbit);
+    }
+    virtual ~zstd_istream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+#endif /* _ZSTD_ISTREAM_H_ */
@@ -0,0 +1,155 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* zstd_ostream_t: a wrapper around zstd streaming compression to match the
+ * parts of the std::ostream interface we use for raw2trace.
+ * Seeking is not supported.
+ */
+
+#ifndef _ZSTD_OSTREAM_H_
+#define _ZSTD_OSTREAM_H_ 1
+
+#ifndef HAS_ZSTD
+#    error HAS_ZSTD is required
+#endif
+#include <fstream>
+#include <string>
+#include <zstd.h>
+
+/* We need to override the stream buffer class which is where the file
+ * writes happen.  The stream buffer base class writes to pbase()..epptr()
+ * with the next slot at pptr().
+ */
+class zstd_streambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    // A non-empty dict holds the contents of a dictionary trained with
+    // "zstd --train", which must then also be supplied when reading.
+    zstd_streambuf_t(const std::string &path, const std::string &dict)
+        : file_(path, std::ofstream::binary)
+    {
+        if (!file_)
+            return;
+        cctx_ = ZSTD_createCCtx();
+        if (cctx_ == nullptr)
+            return;
+        if (!dict.empty() &&
+            ZSTD_isError(ZSTD_CCtx_loadDictionary(cctx_, dict.data(), dict.size()))) {
+            ZSTD_freeCCtx(cctx_);
+            cctx_ = nullptr;
+            return;
+        }
+        buf_ = new char[buffer_size_];
+        out_size_ = ZSTD_CStreamOutSize();
+        out_buf_ = new char[out_size_];
+        // We leave an extra slot for extra_char on overflow.
+        setp(buf_, buf_ + buffer_size_ - 1);
+    }
+    virtual ~zstd_streambuf_t() override
+    {
+        if (cctx_ != nullptr) {
+            sync();
+            compress(nullptr, 0, ZSTD_e_end);
+            ZSTD_freeCCtx(cctx_);
+        }
+        delete[] buf_;
+        delete[] out_buf_;
+    }
+    bool
+    is_open()
+    {
+        return cctx_ != nullptr;
+    }
+    virtual int
+    overflow(int extra_char) override
+    {
+        if (cctx_ == nullptr)
+            return traits_type::eof();
+        if (extra_char != traits_type::eof()) {
+            // Put the extra char into the buffer.  We left an extra slot for it.
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        int res = traits_type::not_eof(extra_char);
+        if (pptr() > pbase() && !compress(pbase(), pptr() - pbase(), ZSTD_e_continue))
+            res = traits_type::eof();
+        setp(buf_, buf_ + buffer_size_ - 1);
+        return res;
+    }
+    virtual int
+    sync() override
+    {
+        return overflow(traits_type::eof());
+    }
+
+private:
+    // Feeds size bytes at data to the compressor and writes out whatever it
+    // produces.  ZSTD_e_end finishes the frame.
+    bool
+    compress(const char *data, size_t size, ZSTD_EndDirective mode)
+    {
+        ZSTD_inBuffer in = { data, size, 0 };
+        bool done;
+        do {
+            ZSTD_outBuffer out = { out_buf_, out_size_, 0 };
+            size_t remaining = ZSTD_compressStream2(cctx_, &out, &in, mode);
+            if (ZSTD_isError(remaining))
+                return false;
+            if (!file_.write(out_buf_, out.pos))
+                return false;
+            done = (mode == ZSTD_e_end) ? (remaining == 0) : (in.pos == in.size);
+        } while (!done);
+        return true;
+    }
+
+    static const int buffer_size_ = 128 * 1024;
+    std::ofstream file_;
+    ZSTD_CCtx *cctx_ = nullptr;
+    char *buf_ = nullptr;
+    char *out_buf_ = nullptr;
+    size_t out_size_ = 0;
+};
+
+class zstd_ostream_t : public std::ostream {
+public:
+    explicit zstd_ostream_t(const std::string &path, const std::string &dict = "")
+        : std::ostream(new zstd_streambuf_t(path, dict))
+    {
+        if (!static_cast<zstd_streambuf_t *>(rdbuf())->is_open())
+            setstate(std::ios::badbit);
+    }
+    virtual ~zstd_ostream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+#endif /* _ZSTD_OSTREAM_H_ */
@@ -0,0 +1,299 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <algorithm>
+#include "chunked_file_reader.h"
+
+chunked_reader_t::chunked_reader_t(std::ifstream *stream)
+    : fstream_(stream)
+    , zstream_(new z_stream)
+    , compressed_buf_(buffer_size_)
+{
+    memset(zstream_.get(), 0, sizeof(*zstream_));
+    if (inflateInit(zstream_.get()) != Z_OK)
+        at_eof_ = true;
+}
+
+bool
+chunked_reader_t::read_index()
+{
+    if (at_eof_)
+        return false;
+    chunk_footer_t footer;
+    fstream_->seekg(-static_cast<std::streamoff>(sizeof(footer)), fstream_->end);
+    std::streamoff footer_offset = fstream_->tellg();
+    if (!fstream_->read(reinterpret_cast<char *>(&footer), sizeof(footer))) {
+        ERRMSG("Failed to read chunked trace footer\n");
+        return false;
+    }
+    if (footer.magic != magic_ || footer.version > version_) {
+        ERRMSG("Not a chunked trace file or unknown version %zu\n",
+               static_cast<size_t>(footer.version));
+        return false;
+    }
+    if (footer.num_chunks == 0 ||
+        footer.index_offset + footer.num_chunks * sizeof(chunk_index_entry_t) !=
+            static_cast<uint64_t>(footer_offset)) {
+        ERRMSG("Corrupted chunked trace index\n");
+        return false;
+    }
+    index_.resize(footer.num_chunks);
+    fstream_->seekg(footer.index_offset);
+    if (!fstream_->read(reinterpret_cast<char *>(index_.data()),
+                        index_.size() * sizeof(index_[0]))) {
+        ERRMSG("Failed to read chunked trace index\n");
+        return false;
+    }
+    data_end_ = footer.index_offset;
+    end_chunk_ = index_.size();
+    fstream_->seekg(0);
+    file_pos_ = 0;
+    return !!*fstream_;
+}
+
+int
+chunked_reader_t::read(size_t size, OUT void *to)
+{
+    zstream_->next_out = reinterpret_cast<Bytef *>(to);
+    zstream_->avail_out = static_cast<uInt>(size);
+    while (zstream_->avail_out > 0) {
+        if (zstream_->avail_in == 0) {
+            if (file_pos_ >= data_end_) {
+                at_eof_ = true;
+                break;
+            }
+            size_t to_read = static_cast<size_t>(
+                std::min<uint64_t>(buffer_size_, data_end_ - file_pos_));
+            fstream_->read(compressed_buf_.data(), to_read);
+            if (fstream_->gcount() <= 0)
+                return -1;
+            file_pos_ += fstream_->gcount();
+            zstream_->next_in = reinterpret_cast<Bytef *>(compressed_buf_.data());
+            zstream_->avail_in = static_cast<uInt>(fstream_->gcount());
+        }
+        int res = inflate(zstream_.get(), Z_NO_FLUSH);
+        if (res == Z_STREAM_END) {
+            // Each chunk is its own stream and the next one follows directly.
+            // The remaining input, if any, belongs to the next chunk.
+            ++cur_chunk_;
+            if (cur_chunk_ >= end_chunk_) {
+                at_eof_ = true;
+                break;
+            }
+            if (inflateReset(zstream_.get()) != Z_OK)
+                return -1;
+            continue;
+        }
+        if (res != Z_OK && res != Z_BUF_ERROR) {
+            ERRMSG("Failed to decompress chunk %zu: %d\n", cur_chunk_, res);
+            return -1;
+        }
+    }
+    return static_cast<int>(size - zstream_->avail_out);
+}
+
+bool
+chunked_reader_t::seek_to_instruction(uint64_t target_ordinal,
+                                      OUT uint64_t *instrs_before)
+{
+    if (target_ordinal == 0)
+        return false;
+    // Ordinals are relative to the start of any chunk range.
+    target_ordinal += base_ordinal_;
+    // Find the first chunk starting after the target and step back one.
+    auto it = std::upper_bound(
+        index_.begin(), index_.end(), target_ordinal - 1,
+        [](uint64_t ordinal, const chunk_index_entry_t &entry) {
+            return ordinal < entry.instr_ordinal;
+        });
+    if (it == index_.begin())
+        return false;
+    // Stay within any chunk range: the rest of the walk then hits its end.
+    size_t chunk = std::min<size_t>((it - index_.begin()) - 1, end_chunk_ - 1);
+    // We only move forward: the current chunk is already as close as we can get.
+    if (chunk <= cur_chunk_)
+        return false;
+    if (!seek_to_chunk(chunk))
+        return false;
+    *instrs_before = index_[chunk].instr_ordinal - base_ordinal_;
+    return true;
+}
+
+bool
+chunked_reader_t::set_chunk_range(size_t first_chunk, size_t end_chunk)
+{
+    if (first_chunk >= end_chunk || end_chunk > index_.size()) {
+        ERRMSG("Invalid chunk range [%zu, %zu) of %zu chunks\n", first_chunk, end_chunk,
+               index_.size());
+        return false;
+    }
+    end_chunk_ = end_chunk;
+    base_ordinal_ = index_[first_chunk].instr_ordinal;
+    if (first_chunk > cur_chunk_)
+        return seek_to_chunk(first_chunk);
+    return true;
+}
+
+bool
+chunked_reader_t::seek_to_chunk(size_t chunk)
+{
+    fstream_->clear();
+    fstream_->seekg(index_[chunk].offset);
+    if (!*fstream_ || inflateReset(zstream_.get()) != Z_OK)
+        return false;
+    file_pos_ = index_[chunk].offset;
+    zstream_->avail_in = 0;
+    cur_chunk_ = chunk;
+    at_eof_ = false;
+    return true;
+}
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<chunked_reader_t>::~file_reader_t<chunked_reader_t>()
+{
+    delete[] thread_eof_;
+}
+
+template <>
+bool
+file_reader_t<chunked_reader_t>::open_single_file(const std::string &path)
+{
+    std::ifstream *file = new std::ifstream(path, std::ifstream::binary);
+    if (!*file) {
+        delete file;
+        return false;
+    }
+    chunked_reader_t reader(file);
+    if (!reader.read_index())
+        return false;
+    VPRINT(this, 1, "Opened chunked input file %s\n", path.c_str());
+    input_files_.push_back(std::move(reader));
+    return true;
+}
+
+template <>
+bool
+file_reader_t<chunked_reader_t>::read_next_thread_entry(size_t thread_index,
+                                                        OUT trace_entry_t *entry,
+                                                        OUT bool *eof)
+{
+    int len = input_files_[thread_index].read(sizeof(*entry), entry);
+    // Returns less than asked-for for end of file, or –1 for error.
+    if (len < (int)sizeof(*entry)) {
+        *eof = (len >= 0) && input_files_[thread_index].eof();
+        return false;
+    }
+    VPRINT(this, 4, "Read from thread #%zd file: type=%d, size=%d, addr=%zu\n",
+           thread_index, entry->type, entry->size, entry->addr);
+    return true;
+}
+
+template <>
+bool
+file_reader_t<chunked_reader_t>::seek_thread_to_instruction(size_t thread_index,
+                                                            uint64_t target_ordinal,
+                                                            OUT uint64_t *instrs_before)
+{
+    return input_files_[thread_index].seek_to_instruction(target_ordinal,
+                                                          instrs_before);
+}
+
+template <>
+bool
+file_reader_t<chunked_reader_t>::is_complete()
+{
+    // Not supported, similar to gzip reader.
+    return false;
+}
+
+// The subclass members follow the specializations above, which must precede
+// any instantiation of the base class members.
+chunked_file_reader_t::chunked_file_reader_t()
+{
+}
+
+chunked_file_reader_t::chunked_file_reader_t(const std::string &path, int verbosity)
+    : file_reader_t<chunked_reader_t>(path, verbosity)
+{
+}
+
+chunked_file_reader_t::chunked_file_reader_t(const std::string &path,
+                                             size_t first_chunk, size_t end_chunk,
+                                             int verbosity)
+    : file_reader_t<chunked_reader_t>(path, verbosity)
+    , first_chunk_(first_chunk)
+    , end_chunk_(end_chunk)
+{
+}
+
+size_t
+chunked_file_reader_t::get_chunk_count(const std::string &path)
+{
+    std::ifstream *file = new std::ifstream(path, std::ifstream::binary);
+    if (!*file) {
+        delete file;
+        return 0;
+    }
+    chunked_reader_t reader(file);
+    if (!reader.read_index())
+        return 0;
+    return reader.chunk_count();
+}
+
+bool
+chunked_file_reader_t::open_input_files()
+{
+    if (!file_reader_t<chunked_reader_t>::open_input_files())
+        return false;
+    if (end_chunk_ == 0)
+        return true;
+    if (input_files_.size() != 1) {
+        ERRMSG("A chunk range requires a single input file\n");
+        return false;
+    }
+    if (!input_files_[0].set_chunk_range(first_chunk_, end_chunk_))
+        return false;
+    if (first_chunk_ > 0) {
+        // The header markers belong to the first range: keep just the tid and
+        // pid, which the reader needs to attribute our records.
+        std::queue<trace_entry_t> header;
+        header.swap(queues_[0]);
+        for (; !header.empty(); header.pop()) {
+            if (header.front().type == TRACE_TYPE_THREAD ||
+                header.front().type == TRACE_TYPE_PID)
+                queues_[0].push(header.front());
+        }
+    }
+    return true;
+}
@@ -0,0 +1,151 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* chunked_file_reader: reads final trace files in the seekable chunked format
+ * described in chunked_consts.h.  Unlike the other compressed readers, this one
+ * can jump forward to the chunk holding a target instruction without
+ * decompressing the chunks in between.
+ */
+
+#ifndef _CHUNKED_FILE_READER_H_
+#define _CHUNKED_FILE_READER_H_ 1
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+#include "chunked_consts.h"
+#include "file_reader.h"
+
+class chunked_reader_t : chunked_consts_t {
+public:
+    chunked_reader_t(std::ifstream *stream);
+
+    // Reads and validates the footer and chunk index.  Must be called before
+    // any other method.
+    bool
+    read_index();
+
+    // Read 'size' bytes into the 'to'.  Returns the number of bytes read, which
+    // is less than 'size' at the end of the file, or -1 on an error.
+    int
+    read(size_t size, OUT void *to);
+
+    bool
+    eof()
+    {
+        return at_eof_;
+    }
+
+    // Moves to the start of the last chunk whose first instruction ordinal
+    // (1-based) is at or before target_ordinal, if that chunk lies past the
+    // current read point.  On success returns true and sets *instrs_before to the
+    // count of instructions prior to that chunk.  The next record read is then
+    // the chunk's leading timestamp marker.
+    bool
+    seek_to_instruction(uint64_t target_ordinal, OUT uint64_t *instrs_before);
+
+    size_t
+    chunk_count() const
+    {
+        return index_.size();
+    }
+
+    // Limits reading to chunks [first_chunk, end_chunk): reaching end_chunk is
+    // treated as the end of the file.  If first_chunk is past the current chunk,
+    // moves to its start.
+    bool
+    set_chunk_range(size_t first_chunk, size_t end_chunk);
+
+private:
+    bool
+    seek_to_chunk(size_t chunk);
+
+    struct zstream_deleter_t {
+        void
+        operator()(z_stream *zstream)
+        {
+            inflateEnd(zstream);
+            delete zstream;
+        }
+    };
+
+    // The compressed file we're reading from.
+    std::unique_ptr<std::ifstream> fstream_;
+    std::unique_ptr<z_stream, zstream_deleter_t> zstream_;
+    // Buffer holding compressed data read from the file.
+    std::vector<char> compressed_buf_;
+    std::vector<chunk_index_entry_t> index_;
+    // File offset where the compressed data ends and the index begins.
+    uint64_t data_end_ = 0;
+    // File offset of the next compressed byte to read into compressed_buf_.
+    uint64_t file_pos_ = 0;
+    // Reading stops at the start of this chunk.
+    size_t end_chunk_ = 0;
+    // Count of instructions before the start of the chunk range.
+    uint64_t base_ordinal_ = 0;
+    // The chunk currently being decompressed.
+    size_t cur_chunk_ = 0;
+    bool at_eof_ = false;
+};
+
+class chunked_file_reader_t : public file_reader_t<chunked_reader_t> {
+public:
+    chunked_file_reader_t();
+    chunked_file_reader_t(const std::string &path, int verbosity = 0);
+    // Reads just chunks [first_chunk, end_chunk) of the single thread file at
+    // path, for analyzing one thread's trace in several independent pieces.
+    // The thread's header markers are only presented when first_chunk is 0, and
+    // its exit only when end_chunk is the last chunk, so that the pieces together
+    // contain exactly the records of the whole file.  Instruction ordinals are
+    // relative to the start of the range.
+    chunked_file_reader_t(const std::string &path, size_t first_chunk, size_t end_chunk,
+                          int verbosity = 0);
+
+    // Returns the number of chunks in the chunked trace file at path, or 0 on
+    // an error.
+    static size_t
+    get_chunk_count(const std::string &path);
+
+protected:
+    bool
+    open_input_files() override;
+
+private:
+    size_t first_chunk_ = 0;
+    // 0 means no range was requested.
+    size_t end_chunk_ = 0;
+};
+
+#endif /* _CHUNKED_FILE_READER_H_ */
@@ -114,6 +114,26 @@ config_reader_t::configure(std::istream *config_file, cache_simulator_knobs_t &k
                 ERRMSG("Error reading sim_refs from the configuration file\n");
                 return false;
             }
+        } else if (param == "sample_period") {
+            // Period of sampled simulation, or 0 for none.
+            if (!(*fin_ >> knobs.sample_period)) {
+                ERRMSG("Error reading sample_period from the configuration file\n");
+                return false;
+            }
+        } else if (param == "sample_warmup_refs") {
+            // Number of references to warm up the caches in each sampling unit.
+            if (!(*fin_ >> knobs.sample_warmup_refs)) {
+                ERRMSG("Error reading sample_warmup_refs from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "sample_measure_refs") {
+            // Number of references to measure in each sampling unit.
+            if (!(*fin_ >> knobs.sample_measure_refs)) {
+                ERRMSG("Error reading sample_measure_refs from "
+                       "the configuration file\n");
+                return false;
+            }
         } else if (param == "cpu_scheduling") {
             // Whether to simulate CPU scheduling or not.
             std::string bool_val;
@@ -133,6 +153,20 @@ config_reader_t::configure(std::istream *config_file, cache_simulator_knobs_t &k
                 ERRMSG("Error reading verbose from the configuration file\n");
                 return false;
             }
+        } else if (param == "pipeline_workers") {
+            // Number of threads simulating the L1 caches.
+            if (!(*fin_ >> knobs.pipeline_workers)) {
+                ERRMSG("Error reading pipeline_workers from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "snoop_filter_size") {
+            // Number of lines the snoop filter tracks, or 0 for unlimited.
+            if (!(*fin_ >> knobs.snoop_filter_size)) {
+                ERRMSG("Error reading snoop_filter_size from "
+                       "the configuration file\n");
+                return false;
+            }
         } else if (param == "coherence") {
             // Whether to simulate coherence
             std::string bool_val;
@@ -145,6 +179,48 @@ config_reader_t::configure(std::istream *config_file, cache_simulator_knobs_t &k
             } else {
                 knobs.model_coherence = false;
             }
+        } else if (param == "save_checkpoint") {
+            // File to write the simulation state to.
+            if (!(*fin_ >> knobs.save_checkpoint)) {
+                ERRMSG("Error reading save_checkpoint from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "restore_checkpoint") {
+            // File to resume the simulation from.
+            if (!(*fin_ >> knobs.restore_checkpoint)) {
+                ERRMSG("Error reading restore_checkpoint from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "model_timing") {
+            // Whether to estimate cycles with the timing model.
+            std::string bool_val;
+            if (!(*fin_ >> bool_val)) {
+                ERRMSG("Error reading model_timing from the configuration file\n");
+                return false;
+            }
+            knobs.model_timing = is_true(bool_val);
+        } else if (param == "memory_latency") {
+            // Cycles for main memory to serve a last-level miss.
+            if (!(*fin_ >> knobs.memory_latency)) {
+                ERRMSG("Error reading memory_latency from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "rob_size") {
+            // Reorder buffer entries for the timing model.
+            if (!(*fin_ >> knobs.rob_size)) {
+                ERRMSG("Error reading rob_size from the configuration file\n");
+                return false;
+            }
+        } else if (param == "dispatch_width") {
+            // Instructions dispatched per cycle for the timing model.
+            if (!(*fin_ >> knobs.dispatch_width)) {
+                ERRMSG("Error reading dispatch_width from "
+                       "the configuration file\n");
+                return false;
+            }
         } else {
             // A cache unit.
             cache_params_t cache;
@@ -268,7 +344,9 @@ config_reader_t::configure_cache(cache_params_t &cache)
             }
         } else if (param == "replace_policy") {
             // Cache replacement policy: REPLACE_POLICY_LRU (default),
-            // REPLACE_POLICY_LFU or REPLACE_POLICY_FIFO.
+            // REPLACE_POLICY_LFU, REPLACE_POLICY_FIFO, REPLACE_POLICY_PLRU,
+            // REPLACE_POLICY_SRRIP, REPLACE_POLICY_BRRIP, REPLACE_POLICY_DRRIP or
+            // REPLACE_POLICY_SHIP.
             if (!(*fin_ >> cache.replace_policy)) {
                 ERRMSG("Error reading cache replace_policy from "
                        "the configuration file\n");
@@ -277,12 +355,18 @@ config_reader_t::configure_cache(cache_params_t &cache)
             if (cache.replace_policy != REPLACE_POLICY_NON_SPECIFIED &&
                 cache.replace_policy != REPLACE_POLICY_LRU &&
                 cache.replace_policy != REPLACE_POLICY_LFU &&
-                cache.replace_policy != REPLACE_POLICY_FIFO) {
+                cache.replace_policy != REPLACE_POLICY_FIFO &&
+                cache.replace_policy != REPLACE_POLICY_PLRU &&
+                cache.replace_policy != REPLACE_POLICY_SRRIP &&
+                cache.replace_policy != REPLACE_POLICY_BRRIP &&
+                cache.replace_policy != REPLACE_POLICY_DRRIP &&
+                cache.replace_policy != REPLACE_POLICY_SHIP) {
                 ERRMSG("Unknown replacement policy: %s\n", cache.replace_policy.c_str());
                 return false;
             }
         } else if (param == "prefetcher") {
-            // Type of prefetcher: PREFETCH_POLICY_NEXTLINE
+            // Type of prefetcher: PREFETCH_POLICY_NEXTLINE,
+            // PREFETCH_POLICY_STRIDE, PREFETCH_POLICY_STREAM
             // or PREFETCH_POLICY_NONE.
             if (!(*fin_ >> cache.prefetcher)) {
                 ERRMSG("Error reading cache prefetcher from "
@@ -290,10 +374,33 @@ config_reader_t::configure_cache(cache_params_t &cache)
                 return false;
             }
             if (cache.prefetcher != PREFETCH_POLICY_NEXTLINE &&
+                cache.prefetcher != PREFETCH_POLICY_STRIDE &&
+                cache.prefetcher != PREFETCH_POLICY_STREAM &&
                 cache.prefetcher != PREFETCH_POLICY_NONE) {
                 ERRMSG("Unknown prefetcher type: %s\n", cache.prefetcher.c_str());
                 return false;
             }
+        } else if (param == "latency") {
+            // Cycles to look up the cache, for the timing model.
+            if (!(*fin_ >> cache.latency) || cache.latency < 0) {
+                ERRMSG("Error reading cache latency from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "mshrs") {
+            // Outstanding misses the cache supports, for the timing model.
+            if (!(*fin_ >> cache.mshrs) || cache.mshrs < 0) {
+                ERRMSG("Error reading cache mshrs from "
+                       "the configuration file\n");
+                return false;
+            }
+        } else if (param == "bandwidth") {
+            // Bytes per cycle the cache is filled at, for the timing model.
+            if (!(*fin_ >> cache.bandwidth) || cache.bandwidth < 0.0) {
+                ERRMSG("Error reading cache bandwidth from "
+                       "the configuration file\n");
+                return false;
+            }
         } else if (param == "miss_file") {
             // Name of the file to use to dump cache misses info.
             if (!(*fin_ >> cache.miss_file)) {
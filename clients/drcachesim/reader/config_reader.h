@@ -59,6 +59,9 @@ struct cache_params_t {
         , replace_policy(REPLACE_POLICY_LRU)
         , prefetcher(PREFETCH_POLICY_NONE)
         , miss_file("")
+        , latency(0)
+        , mshrs(0)
+        , bandwidth(0.0)
     {
     }
     // Cache's name. Each cache must have a unique name.
@@ -88,6 +91,12 @@ struct cache_params_t {
     std::string prefetcher;
     // Name of the file to use to dump cache misses info.
     std::string miss_file;
+    // Timing model parameters: the lookup latency in cycles, the number of
+    // outstanding misses, and the fill bandwidth in bytes per cycle.  A limit of
+    // 0 means unlimited.
+    int latency;
+    int mshrs;
+    double bandwidth;
 };
 
 class config_reader_t {
@@ -71,6 +71,15 @@ file_reader_t<std::ifstream *>::read_next_thread_entry(size_t thread_index,
     return true;
 }
 
+template <>
+bool
+file_reader_t<std::ifstream *>::seek_thread_to_instruction(size_t thread_index,
+                                                           uint64_t target_ordinal,
+                                                           OUT uint64_t *instrs_before)
+{
+    return false;
+}
+
 template <>
 bool
 file_reader_t<std::ifstream *>::is_complete()
@@ -40,7 +40,9 @@
 
 #include <string.h>
 #include <fstream>
+#include <functional>
 #include <queue>
+#include <utility>
 #include <vector>
 #include "reader.h"
 #include "memref.h"
@@ -99,6 +101,15 @@ public:
     virtual bool
     is_complete();
 
+    size_t
+    next_batch(OUT memref_t *memrefs, size_t max_count) override
+    {
+        // A qualified call to our read_next_entry() avoids the virtual
+        // operator*, operator++, and read_next_entry() per record.
+        return fill_batch(memrefs, max_count,
+                          [this]() { return file_reader_t<T>::read_next_entry(); });
+    }
+
 protected:
     bool
     read_next_thread_entry(size_t thread_index, OUT trace_entry_t *entry,
@@ -107,6 +118,28 @@ protected:
     virtual bool
     open_single_file(const std::string &path);
 
+    // Specialized per file type: formats without an index return false.
+    bool
+    seek_thread_to_instruction(size_t thread_index, uint64_t target_ordinal,
+                               OUT uint64_t *instrs_before);
+
+    bool
+    seek_to_instruction(uint64_t target_ordinal, OUT uint64_t *instrs_before) override
+    {
+        // Seeking one thread of several would break the timestamp interleaving.
+        if (input_files_.size() != 1)
+            return false;
+        if (!seek_thread_to_instruction(0, target_ordinal, instrs_before))
+            return false;
+        // The new position is a chunk's leading timestamp, which we obtain through
+        // the regular thread selection path.
+        queues_[0] = std::queue<trace_entry_t>();
+        next_times_ = decltype(next_times_)();
+        need_timestamp_.assign(1, 0);
+        index_ = input_files_.size();
+        return true;
+    }
+
     virtual bool
     open_input_files()
     {
@@ -155,7 +188,9 @@ protected:
         queues_.resize(input_files_.size());
         tids_.resize(input_files_.size());
         timestamps_.resize(input_files_.size());
-        times_.resize(input_files_.size(), 0);
+        need_timestamp_.resize(input_files_.size());
+        for (size_t i = 0; i < input_files_.size(); ++i)
+            need_timestamp_[i] = i;
         // We can't take the address of a vector<bool> element so we use a raw array.
         thread_eof_ = new bool[input_files_.size()];
         memset(thread_eof_, 0, input_files_.size() * sizeof(*thread_eof_));
@@ -212,41 +247,43 @@ protected:
     {
         // We read the thread files simultaneously in lockstep and merge them into
         // a single interleaved stream in timestamp order.
-        // When a thread file runs out we leave its times_[] entry as 0 and its file at
-        // eof.
+        // A thread whose next timestamp has been read sits in the next_times_
+        // heap; one whose next entry should be a timestamp not yet read is in
+        // need_timestamp_.  When a thread file runs out it is in neither and its
+        // file is at eof.
         while (thread_count_ > 0) {
             if (index_ >= input_files_.size()) {
-                // Pick the next thread by looking for the smallest timestamp.
-                uint64_t min_time = 0xffffffffffffffff;
-                size_t next_index = 0;
-                for (size_t i = 0; i < times_.size(); ++i) {
-                    if (times_[i] == 0 && !thread_eof_[i]) {
-                        if (!read_next_thread_entry(i, &timestamps_[i],
-                                                    &thread_eof_[i])) {
-                            ERRMSG("Failed to read from input file #%zu\n", i);
-                            return nullptr;
-                        }
-                        if (timestamps_[i].type != TRACE_TYPE_MARKER &&
-                            timestamps_[i].size != TRACE_MARKER_TYPE_TIMESTAMP) {
-                            ERRMSG("Missing timestamp entry in input file #%zu\n", i);
-                            return nullptr;
-                        }
-                        times_[i] = timestamps_[i].addr;
-                        VPRINT(this, 3,
-                               "Thread #%zu timestamp is @0x" ZHEX64_FORMAT_STRING "\n",
-                               i, times_[i]);
+                for (size_t i : need_timestamp_) {
+                    if (thread_eof_[i])
+                        continue;
+                    if (!read_next_thread_entry(i, &timestamps_[i], &thread_eof_[i])) {
+                        ERRMSG("Failed to read from input file #%zu\n", i);
+                        return nullptr;
                     }
-                    if (times_[i] != 0 && times_[i] < min_time) {
-                        min_time = times_[i];
-                        next_index = i;
+                    if (timestamps_[i].type != TRACE_TYPE_MARKER &&
+                        timestamps_[i].size != TRACE_MARKER_TYPE_TIMESTAMP) {
+                        ERRMSG("Missing timestamp entry in input file #%zu\n", i);
+                        return nullptr;
                     }
+                    VPRINT(this, 3,
+                           "Thread #%zu timestamp is @0x" ZHEX64_FORMAT_STRING "\n", i,
+                           (uint64_t)timestamps_[i].addr);
+                    next_times_.push(
+                        std::make_pair(static_cast<uint64_t>(timestamps_[i].addr), i));
+                }
+                need_timestamp_.clear();
+                if (next_times_.empty()) {
+                    ERRMSG("No thread has a next timestamp\n");
+                    return nullptr;
                 }
+                // Pick the next thread: the one with the smallest timestamp, with
+                // ties going to the lowest index.
+                index_ = next_times_.top().second;
                 VPRINT(this, 2,
                        "Next thread in timestamp order is #%zu @0x" ZHEX64_FORMAT_STRING
                        "\n",
-                       next_index, times_[next_index]);
-                index_ = next_index;
-                times_[index_] = 0; // Read from file for this thread's next timestamp.
+                       index_, next_times_.top().first);
+                next_times_.pop();
                 // If the queue is not empty, it should contain the initial tid;pid.
                 if ((queues_[index_].empty() ||
                      queues_[index_].front().type != TRACE_TYPE_THREAD) &&
@@ -271,8 +308,7 @@ protected:
                         at_eof_ = true;
                         break;
                     }
-                    times_[index_] = 0;
-                    index_ = input_files_.size(); // Request thread scan.
+                    index_ = input_files_.size(); // Request thread selection.
                     continue;
                 } else {
                     ERRMSG("Failed to read from input file #%zu\n", index_);
@@ -283,9 +319,10 @@ protected:
                 entry_copy_.size == TRACE_MARKER_TYPE_TIMESTAMP) {
                 VPRINT(this, 3, "Thread #%zu timestamp 0x" ZHEX64_FORMAT_STRING "\n",
                        index_, (uint64_t)entry_copy_.addr);
-                times_[index_] = entry_copy_.addr;
                 timestamps_[index_] = entry_copy_;
-                index_ = input_files_.size(); // Request thread scan.
+                next_times_.push(
+                    std::make_pair(static_cast<uint64_t>(entry_copy_.addr), index_));
+                index_ = input_files_.size(); // Request thread selection.
                 continue;
             }
             return &entry_copy_;
@@ -293,7 +330,6 @@ protected:
         return nullptr;
     }
 
-private:
     std::string input_path_;
     std::vector<std::string> input_path_list_;
     std::vector<T> input_files_;
@@ -305,7 +341,13 @@ private:
     std::vector<std::queue<trace_entry_t>> queues_;
     std::vector<trace_entry_t> tids_;
     std::vector<trace_entry_t> timestamps_;
-    std::vector<uint64_t> times_;
+    // A min-heap of (next timestamp, thread index), making each thread switch
+    // logarithmic rather than linear in the thread count.
+    std::priority_queue<std::pair<uint64_t, size_t>,
+                        std::vector<std::pair<uint64_t, size_t>>,
+                        std::greater<std::pair<uint64_t, size_t>>>
+        next_times_;
+    std::vector<size_t> need_timestamp_;
     bool *thread_eof_ = nullptr;
 };
 
@@ -41,17 +41,34 @@
 #endif
 
 ipc_reader_t::ipc_reader_t()
-    : creation_success_(false)
+    : use_ring_(false)
+    , creation_success_(false)
 {
     /* Empty. */
 }
 
-ipc_reader_t::ipc_reader_t(const char *ipc_name, int verbosity)
+ipc_reader_t::ipc_reader_t(const char *ipc_name, int verbosity, unsigned int shm_rings,
+                           size_t shm_ring_size)
     : reader_t(verbosity, "IPC")
     , pipe_(ipc_name)
+#ifdef UNIX
+    , ring_(ipc_name)
+#endif
+    , use_ring_(shm_rings > 0)
 {
     // We create the pipe here so the user can set up a pipe writer
     // *before* calling the blocking analyzer_t::run().
+#ifdef UNIX
+    if (use_ring_) {
+        creation_success_ = ring_.create(shm_rings, shm_ring_size);
+        return;
+    }
+#else
+    if (use_ring_) {
+        creation_success_ = false;
+        return;
+    }
+#endif
     creation_success_ = pipe_.create();
 }
 
@@ -67,6 +84,10 @@ ipc_reader_t::operator!()
 std::string
 ipc_reader_t::get_pipe_name() const
 {
+#ifdef UNIX
+    if (use_ring_)
+        return ring_.get_name();
+#endif
     return pipe_.get_name();
 }
 
@@ -74,9 +95,13 @@ bool
 ipc_reader_t::init()
 {
     at_eof_ = false;
-    if (!creation_success_ || !pipe_.open_for_read())
+    if (!creation_success_)
         return false;
-    pipe_.maximize_buffer();
+    if (!use_ring_) {
+        if (!pipe_.open_for_read())
+            return false;
+        pipe_.maximize_buffer();
+    }
     cur_buf_ = buf_;
     end_buf_ = buf_;
     ++*this;
@@ -85,6 +110,12 @@ ipc_reader_t::init()
 
 ipc_reader_t::~ipc_reader_t()
 {
+#ifdef UNIX
+    if (use_ring_) {
+        ring_.destroy();
+        return;
+    }
+#endif
     pipe_.close();
     pipe_.destroy();
 }
@@ -94,7 +125,13 @@ ipc_reader_t::read_next_entry()
 {
     ++cur_buf_;
     if (cur_buf_ >= end_buf_) {
-        ssize_t sz = pipe_.read(buf_, sizeof(buf_)); // blocking read
+        ssize_t sz;
+#ifdef UNIX
+        if (use_ring_)
+            sz = ring_.read(buf_, sizeof(buf_)); // blocking read
+        else
+#endif
+            sz = pipe_.read(buf_, sizeof(buf_)); // blocking read
         if (sz < 0 || sz % sizeof(*end_buf_) != 0) {
             // If called again at eof, do not return the footer: return an error.
             if (at_eof_)
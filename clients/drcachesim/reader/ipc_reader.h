@@ -41,12 +41,18 @@
 #include "reader.h"
 #include "../common/memref.h"
 #include "../common/named_pipe.h"
+#ifdef UNIX
+#    include "../common/shm_ring.h"
+#endif
 #include "../common/trace_entry.h"
 
 class ipc_reader_t : public reader_t {
 public:
     ipc_reader_t();
-    ipc_reader_t(const char *ipc_name, int verbosity);
+    // A non-zero shm_rings reads from that many shared-memory rings instead of
+    // from a named pipe.  This is only supported on UNIX.
+    ipc_reader_t(const char *ipc_name, int verbosity, unsigned int shm_rings = 0,
+                 size_t shm_ring_size = 0);
     virtual ~ipc_reader_t();
     bool operator!() override;
     // This potentially blocks.
@@ -68,12 +74,16 @@ protected:
 
 private:
     named_pipe_t pipe_;
+#ifdef UNIX
+    shm_ring_t ring_;
+#endif
+    bool use_ring_;
     bool creation_success_;
 
     // For efficiency we want to read large chunks at a time.
     // The atomic write size for a pipe on Linux is 4096 bytes but
     // we want to go ahead and read as much data as we can at one
-    // time.
+    // time.  This also holds the largest shm_ring_t record.
     static const int BUF_SIZE = 16 * 1024;
     trace_entry_t buf_[BUF_SIZE];
     trace_entry_t *cur_buf_;
@@ -0,0 +1,160 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mmap_file_reader.h"
+
+mapped_trace_file_t::mapped_trace_file_t(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return;
+    }
+    map_size_ = static_cast<size_t>(st.st_size);
+    if (map_size_ == 0) {
+        // mmap rejects a zero length: an empty file is simply at eof.
+        close(fd);
+        valid_ = true;
+        return;
+    }
+    base_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (base_ == MAP_FAILED) {
+        base_ = nullptr;
+        return;
+    }
+    // We walk each file once from start to end, so ask for aggressive read-ahead
+    // and early reclamation.  For files on tmpfs, huge pages cut the TLB misses
+    // of the walk; this is only a hint and fails harmlessly elsewhere.
+    madvise(base_, map_size_, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(base_, map_size_, MADV_HUGEPAGE);
+#endif
+    begin_ = static_cast<const trace_entry_t *>(base_);
+    end_ = begin_ + map_size_ / sizeof(trace_entry_t);
+    cur_ = begin_;
+    valid_ = true;
+}
+
+mapped_trace_file_t::~mapped_trace_file_t()
+{
+    if (base_ != nullptr)
+        munmap(base_, map_size_);
+}
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<mapped_trace_file_t *>::~file_reader_t<mapped_trace_file_t *>()
+{
+    for (auto file : input_files_)
+        delete file;
+    delete[] thread_eof_;
+}
+
+template <>
+bool
+file_reader_t<mapped_trace_file_t *>::open_single_file(const std::string &path)
+{
+    auto file = new mapped_trace_file_t(path);
+    if (!*file) {
+        delete file;
+        return false;
+    }
+    VPRINT(this, 1, "Opened input file %s\n", path.c_str());
+    input_files_.push_back(file);
+    return true;
+}
+
+template <>
+bool
+file_reader_t<mapped_trace_file_t *>::read_next_thread_entry(size_t thread_index,
+                                                             OUT trace_entry_t *entry,
+                                                             OUT bool *eof)
+{
+    const trace_entry_t *next = input_files_[thread_index]->next();
+    if (next == nullptr) {
+        *eof = true;
+        return false;
+    }
+    *entry = *next;
+    VPRINT(this, 4, "Read from thread #%zd file: type=%d, size=%d, addr=%zu\n",
+           thread_index, entry->type, entry->size, entry->addr);
+    return true;
+}
+
+template <>
+bool
+file_reader_t<mapped_trace_file_t *>::seek_thread_to_instruction(
+    size_t thread_index, uint64_t target_ordinal, OUT uint64_t *instrs_before)
+{
+    return false;
+}
+
+template <>
+bool
+file_reader_t<mapped_trace_file_t *>::is_complete()
+{
+    bool opened_temporarily = false;
+    if (input_files_.empty()) {
+        // Supporting analyzer_multi calling before init() for a single file.
+        opened_temporarily = true;
+        if (!input_path_list_.empty() || input_path_.empty() ||
+            directory_iterator_t::is_directory(input_path_))
+            return false; // Not supported.
+        if (!open_single_file(input_path_))
+            return false;
+    }
+    bool res = true;
+    for (auto file : input_files_) {
+        const trace_entry_t *last = file->last();
+        if (last == nullptr || last->type != TRACE_TYPE_FOOTER) {
+            res = false;
+            break;
+        }
+    }
+    if (opened_temporarily) {
+        // Put things back for init().
+        for (auto file : input_files_)
+            delete file;
+        input_files_.clear();
+    }
+    return res;
+}
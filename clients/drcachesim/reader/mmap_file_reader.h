@@ -0,0 +1,79 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* mmap_file_reader: reads uncompressed trace files by mapping them into memory. */
+
+#ifndef _MMAP_FILE_READER_H_
+#define _MMAP_FILE_READER_H_ 1
+
+#include <string>
+#include "file_reader.h"
+
+// A read-only mapping of one uncompressed thread file, walked one trace_entry_t
+// at a time with no intermediate buffering.
+class mapped_trace_file_t {
+public:
+    explicit mapped_trace_file_t(const std::string &path);
+    ~mapped_trace_file_t();
+    bool
+    operator!() const
+    {
+        return !valid_;
+    }
+    // Returns the next entry, or nullptr at the end of the file.  Any trailing
+    // partial entry is ignored.
+    const trace_entry_t *
+    next()
+    {
+        if (cur_ == end_)
+            return nullptr;
+        return cur_++;
+    }
+    // Returns the final complete entry, or nullptr if there is none.
+    const trace_entry_t *
+    last() const
+    {
+        return end_ == begin_ ? nullptr : end_ - 1;
+    }
+
+private:
+    void *base_ = nullptr;
+    size_t map_size_ = 0;
+    const trace_entry_t *begin_ = nullptr;
+    const trace_entry_t *end_ = nullptr;
+    const trace_entry_t *cur_ = nullptr;
+    bool valid_ = false;
+};
+
+typedef file_reader_t<mapped_trace_file_t *> mmap_file_reader_t;
+
+#endif /* _MMAP_FILE_READER_H_ */
@@ -0,0 +1,185 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <algorithm>
+#include "read_ahead_file_reader.h"
+
+gzip_read_ahead_t::gzip_read_ahead_t(gzFile file)
+    : file_(file)
+    , ring_(NUM_BUFFERS)
+{
+    for (auto &buffer : ring_)
+        buffer.data.resize(BUFFER_SIZE);
+    thread_ = std::thread(&gzip_read_ahead_t::decompress_loop, this);
+}
+
+gzip_read_ahead_t::~gzip_read_ahead_t()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+    }
+    emptied_.notify_one();
+    thread_.join();
+    gzclose(file_);
+}
+
+void
+gzip_read_ahead_t::decompress_loop()
+{
+    while (true) {
+        buffer_t *buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            emptied_.wait(lock, [this] { return stop_ || count_ < ring_.size(); });
+            if (stop_)
+                return;
+            buffer = &ring_[tail_];
+        }
+        // The consumer does not touch this buffer until we publish it below.
+        int len = gzread(file_, buffer->data.data(),
+                         static_cast<unsigned int>(buffer->data.size()));
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            buffer->size = len;
+            tail_ = (tail_ + 1) % ring_.size();
+            ++count_;
+        }
+        filled_.notify_one();
+        // A short read is followed by a final zero-length one.
+        if (len <= 0)
+            return;
+    }
+}
+
+bool
+gzip_read_ahead_t::next_buffer()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (cur_ != nullptr) {
+        cur_ = nullptr;
+        head_ = (head_ + 1) % ring_.size();
+        --count_;
+        emptied_.notify_one();
+    }
+    filled_.wait(lock, [this] { return count_ > 0; });
+    buffer_t *buffer = &ring_[head_];
+    if (buffer->size <= 0) {
+        // The background thread is done.  We leave the final buffer's size in
+        // place so further reads see it too, but free the memory now as a
+        // parallel analyzer keeps finished shards' readers around.
+        at_eof_ = (buffer->size == 0);
+        for (auto &entry : ring_)
+            std::vector<char>().swap(entry.data);
+        return false;
+    }
+    cur_ = buffer;
+    pos_ = 0;
+    return true;
+}
+
+int
+gzip_read_ahead_t::read(size_t size, OUT void *to)
+{
+    char *out = reinterpret_cast<char *>(to);
+    size_t remaining = size;
+    while (remaining > 0) {
+        if (cur_ == nullptr || pos_ >= static_cast<size_t>(cur_->size)) {
+            if (!next_buffer()) {
+                if (!at_eof_)
+                    return -1;
+                break;
+            }
+        }
+        size_t len = std::min(remaining, static_cast<size_t>(cur_->size) - pos_);
+        memcpy(out, cur_->data.data() + pos_, len);
+        pos_ += len;
+        out += len;
+        remaining -= len;
+    }
+    return static_cast<int>(size - remaining);
+}
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<gzip_read_ahead_t *>::~file_reader_t<gzip_read_ahead_t *>()
+{
+    for (auto file : input_files_)
+        delete file;
+    delete[] thread_eof_;
+}
+
+template <>
+bool
+file_reader_t<gzip_read_ahead_t *>::open_single_file(const std::string &path)
+{
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    VPRINT(this, 1, "Opened input file %s for read-ahead\n", path.c_str());
+    input_files_.push_back(new gzip_read_ahead_t(file));
+    return true;
+}
+
+template <>
+bool
+file_reader_t<gzip_read_ahead_t *>::read_next_thread_entry(size_t thread_index,
+                                                           OUT trace_entry_t *entry,
+                                                           OUT bool *eof)
+{
+    int len = input_files_[thread_index]->read(sizeof(*entry), entry);
+    // Returns less than asked-for for end of file, or –1 for error.
+    if (len < (int)sizeof(*entry)) {
+        *eof = (len >= 0) && input_files_[thread_index]->eof();
+        return false;
+    }
+    VPRINT(this, 4, "Read from thread #%zd file: type=%d, size=%d, addr=%zu\n",
+           thread_index, entry->type, entry->size, entry->addr);
+    return true;
+}
+
+template <>
+bool
+file_reader_t<gzip_read_ahead_t *>::seek_thread_to_instruction(
+    size_t thread_index, uint64_t target_ordinal, OUT uint64_t *instrs_before)
+{
+    return false;
+}
+
+template <>
+bool
+file_reader_t<gzip_read_ahead_t *>::is_complete()
+{
+    // Not supported, similar to gzip reader.
+    return false;
+}
@@ -0,0 +1,105 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* read_ahead_file_reader: reads gzip-compressed trace files like
+ * compressed_file_reader, but inflates them on a background thread into a ring
+ * of buffers so that decompression overlaps with the analysis consuming the
+ * records.
+ */
+
+#ifndef _READ_AHEAD_FILE_READER_H_
+#define _READ_AHEAD_FILE_READER_H_ 1
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+#include "file_reader.h"
+
+class gzip_read_ahead_t {
+public:
+    // Takes ownership of file and starts decompressing it.
+    gzip_read_ahead_t(gzFile file);
+    ~gzip_read_ahead_t();
+
+    // Read 'size' bytes into the 'to'.  Returns the number of bytes read, which
+    // is less than 'size' at the end of the file, or -1 on an error.
+    int
+    read(size_t size, OUT void *to);
+
+    bool
+    eof()
+    {
+        return at_eof_;
+    }
+
+private:
+    struct buffer_t {
+        std::vector<char> data;
+        // The count of valid bytes, 0 at the end of the file, or -1 on an error.
+        int size = 0;
+    };
+
+    // Hands the current buffer back to the background thread and waits for the
+    // next one.  Returns false at the end of the file or on an error.
+    bool
+    next_buffer();
+
+    void
+    decompress_loop();
+
+    static const size_t BUFFER_SIZE = 256 * 1024;
+    static const size_t NUM_BUFFERS = 4;
+
+    gzFile file_;
+    // The ring of buffers.  The background thread fills them at tail_ and we
+    // drain them from head_.  count_ is the number of filled buffers.
+    std::vector<buffer_t> ring_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    size_t count_ = 0;
+    bool stop_ = false;
+    std::mutex mutex_;
+    std::condition_variable filled_;
+    std::condition_variable emptied_;
+    // The buffer being drained, which we access without holding the lock.
+    buffer_t *cur_ = nullptr;
+    size_t pos_ = 0;
+    bool at_eof_ = false;
+    std::thread thread_;
+};
+
+typedef file_reader_t<gzip_read_ahead_t *> read_ahead_file_reader_t;
+
+#endif /* _READ_AHEAD_FILE_READER_H_ */
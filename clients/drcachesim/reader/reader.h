@@ -97,6 +97,32 @@ public:
     virtual reader_t &
     operator++();
 
+    // Copies up to max_count records, starting with the current one, into
+    // memrefs and advances past them.  Returns the number copied, which is 0 only
+    // at the end of the trace.  This lets a consumer handle records in batches
+    // rather than paying for a virtual call per record per tool.  The default
+    // goes through operator* and operator++; subclasses that can supply entries
+    // without a virtual call override it with fill_batch(), and then subclasses
+    // of those that override operator* or operator++ must override this as well.
+    virtual size_t
+    next_batch(OUT memref_t *memrefs, size_t max_count);
+
+    // Advances past the next instruction_count instructions, along with their
+    // associated data references and markers, leaving the iterator on the
+    // instruction that follows them.  Where the underlying trace format supports
+    // it, whole regions are skipped without decoding them; otherwise this walks
+    // the records one at a time.
+    virtual reader_t &
+    skip_instructions(uint64_t instruction_count);
+
+    // Returns the count of instructions presented so far, including the current
+    // record if it is an instruction.
+    virtual uint64_t
+    get_instruction_ordinal()
+    {
+        return cur_instr_count_;
+    }
+
     // Supplied for subclasses that may fail in their constructors.
     virtual bool operator!()
     {
@@ -120,6 +146,42 @@ protected:
     virtual bool
     read_next_thread_entry(size_t thread_index, OUT trace_entry_t *entry,
                            OUT bool *eof) = 0;
+    // Repositions the input so that subsequent reads resume at a point at or
+    // before the instruction with the 1-based ordinal target_ordinal, but past
+    // the current point.  Returns false if that is not supported or not possible,
+    // leaving the input untouched.  On success, sets *instrs_before to the count
+    // of instructions prior to the new point.
+    virtual bool
+    seek_to_instruction(uint64_t target_ordinal, OUT uint64_t *instrs_before)
+    {
+        return false;
+    }
+
+    // The body of operator++, obtaining each entry from read_entry() rather than
+    // from the virtual read_next_entry().
+    template <typename ReadEntry>
+    void
+    advance(ReadEntry read_entry)
+    {
+        do {
+            if (bundle_idx_ == 0 /*not in instr bundle*/)
+                input_entry_ = read_entry();
+        } while (!process_input_entry());
+    }
+
+    // A non-virtual next_batch() for subclasses whose read_entry() reads straight
+    // from their own buffers.
+    template <typename ReadEntry>
+    size_t
+    fill_batch(OUT memref_t *memrefs, size_t max_count, ReadEntry read_entry)
+    {
+        size_t count = 0;
+        while (count < max_count && !at_eof_) {
+            memrefs[count++] = cur_ref_;
+            advance(read_entry);
+        }
+        return count;
+    }
 
     // Following typical stream iterator convention, the default constructor
     // produces an EOF object.
@@ -132,6 +194,11 @@ protected:
     const char *output_prefix_ = "[reader]";
 
 private:
+    // Decodes input_entry_ into cur_ref_.  Returns false if the entry produced no
+    // record, in which case the caller should read another.
+    bool
+    process_input_entry();
+
     trace_entry_t *input_entry_ = nullptr;
     memref_t cur_ref_;
     memref_tid_t cur_tid_ = 0;
@@ -140,6 +207,7 @@ private:
     addr_t next_pc_;
     addr_t prev_instr_addr_ = 0;
     int bundle_idx_ = 0;
+    uint64_t cur_instr_count_ = 0;
     std::unordered_map<memref_tid_t, memref_pid_t> tid2pid_;
 };
 
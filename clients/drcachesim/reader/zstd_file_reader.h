@@ -0,0 +1,64 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* zstd_file_reader: reads zstd-compressed final trace files, optionally
+ * compressed with a dictionary.
+ */
+
+#ifndef _ZSTD_FILE_READER_H_
+#define _ZSTD_FILE_READER_H_ 1
+
+#include <string>
+#include "zstd_istream.h"
+#include "file_reader.h"
+
+class zstd_file_reader_t : public file_reader_t<zstd_istream_t *> {
+public:
+    zstd_file_reader_t();
+    // If dict_path is non-empty it names the dictionary the files were
+    // compressed with.
+    zstd_file_reader_t(const std::string &path, const std::string &dict_path,
+                       int verbosity = 0);
+
+protected:
+    bool
+    open_input_files() override;
+    bool
+    open_single_file(const std::string &path) override;
+
+private:
+    std::string dict_path_;
+    // The contents of the dictionary at dict_path_.
+    std::string dict_;
+};
+
+#endif /* _ZSTD_FILE_READER_H_ */
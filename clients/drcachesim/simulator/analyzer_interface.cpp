@@ -43,6 +43,7 @@
 #include "../tools/histogram_create.h"
 #include "../tools/reuse_distance_create.h"
 #include "../tools/reuse_time_create.h"
+#include "../tools/miss_ratio_curve_create.h"
 #include "../tools/basic_counts_create.h"
 #include "../tools/opcode_mix_create.h"
 #include "../tools/view_create.h"
@@ -118,12 +119,27 @@ get_cache_simulator_knobs()
     knobs->LL_assoc = op_LL_assoc.get_value();
     knobs->LL_miss_file = op_LL_miss_file.get_value();
     knobs->model_coherence = op_coherence.get_value();
+    knobs->snoop_filter_size = op_snoop_filter_size.get_value();
     knobs->replace_policy = op_replace_policy.get_value();
     knobs->data_prefetcher = op_data_prefetcher.get_value();
+    knobs->save_checkpoint = op_save_checkpoint.get_value();
+    knobs->restore_checkpoint = op_restore_checkpoint.get_value();
+    knobs->model_timing = op_model_timing.get_value();
+    knobs->L1_latency = op_L1_latency.get_value();
+    knobs->LL_latency = op_LL_latency.get_value();
+    knobs->memory_latency = op_memory_latency.get_value();
+    knobs->L1_mshrs = op_L1_mshrs.get_value();
+    knobs->LL_mshrs = op_LL_mshrs.get_value();
+    knobs->memory_bandwidth = op_memory_bandwidth.get_value();
+    knobs->rob_size = op_rob_size.get_value();
+    knobs->dispatch_width = op_dispatch_width.get_value();
     knobs->skip_refs = op_skip_refs.get_value();
     knobs->warmup_refs = op_warmup_refs.get_value();
     knobs->warmup_fraction = op_warmup_fraction.get_value();
     knobs->sim_refs = op_sim_refs.get_value();
+    knobs->sample_period = op_sample_period.get_value();
+    knobs->sample_warmup_refs = op_sample_warmup_refs.get_value();
+    knobs->sample_measure_refs = op_sample_measure_refs.get_value();
     knobs->verbose = op_verbose.get_value();
     knobs->cpu_scheduling = op_cpu_scheduling.get_value();
     knobs->use_physical = op_use_physical.get_value();
@@ -135,17 +151,33 @@ drmemtrace_analysis_tool_create()
 {
     if (op_simulator_type.get_value() == CPU_CACHE) {
         const std::string &config_file = op_config_file.get_value();
-        if (!config_file.empty()) {
+        const std::string &sweep_config = op_sweep_config.get_value();
+        if (!sweep_config.empty()) {
+            std::vector<std::string> config_files;
+            size_t start = 0;
+            while (start <= sweep_config.size()) {
+                size_t end = sweep_config.find(OP_SWEEP_CONFIG_SEP, start);
+                if (end == std::string::npos)
+                    end = sweep_config.size();
+                if (end > start)
+                    config_files.push_back(sweep_config.substr(start, end - start));
+                start = end + 1;
+            }
+            return cache_sweep_create(config_files, op_jobs.get_value());
+        } else if (!config_file.empty()) {
             return cache_simulator_create(config_file);
         } else {
             cache_simulator_knobs_t *knobs = get_cache_simulator_knobs();
+            knobs->pipeline_workers = op_pipeline_workers.get_value();
             return cache_simulator_create(*knobs);
         }
     } else if (op_simulator_type.get_value() == MISS_ANALYZER) {
         cache_simulator_knobs_t *knobs = get_cache_simulator_knobs();
         return cache_miss_analyzer_create(*knobs, op_miss_count_threshold.get_value(),
                                           op_miss_frac_threshold.get_value(),
-                                          op_confidence_threshold.get_value());
+                                          op_confidence_threshold.get_value(),
+                                          op_stride_sketch_size.get_value(),
+                                          op_miss_analyzer_shards.get_value());
     } else if (op_simulator_type.get_value() == TLB) {
         tlb_simulator_knobs_t knobs;
         knobs.num_cores = op_num_cores.get_value();
@@ -156,6 +188,18 @@ drmemtrace_analysis_tool_create()
         knobs.TLB_L1D_assoc = op_TLB_L1D_assoc.get_value();
         knobs.TLB_L2_entries = op_TLB_L2_entries.get_value();
         knobs.TLB_L2_assoc = op_TLB_L2_assoc.get_value();
+        knobs.TLB_L3_entries = op_TLB_L3_entries.get_value();
+        knobs.TLB_L3_assoc = op_TLB_L3_assoc.get_value();
+        knobs.TLB_PWC_entries = op_TLB_PWC_entries.get_value();
+        knobs.TLB_page_size_map = op_TLB_page_size_map.get_value();
+        knobs.use_trace_page_size = !op_page_size.specified();
+        knobs.TLB_walk_caches = op_TLB_walk_caches.get_value();
+        if (knobs.TLB_walk_caches) {
+            cache_simulator_knobs_t *walk_knobs = get_cache_simulator_knobs();
+            knobs.walk_cache_knobs = *walk_knobs;
+            knobs.walk_cache_knobs.LL_miss_file = "";
+            delete walk_knobs;
+        }
         knobs.TLB_replace_policy = op_TLB_replace_policy.get_value();
         knobs.skip_refs = op_skip_refs.get_value();
         knobs.warmup_refs = op_warmup_refs.get_value();
@@ -180,6 +224,9 @@ drmemtrace_analysis_tool_create()
         return reuse_distance_tool_create(knobs);
     } else if (op_simulator_type.get_value() == REUSE_TIME) {
         return reuse_time_tool_create(op_line_size.get_value(), op_verbose.get_value());
+    } else if (op_simulator_type.get_value() == MISS_RATIO_CURVE) {
+        return miss_ratio_curve_tool_create(op_line_size.get_value(),
+                                            op_verbose.get_value());
     } else if (op_simulator_type.get_value() == BASIC_COUNTS) {
         return basic_counts_tool_create(op_verbose.get_value());
     } else if (op_simulator_type.get_value() == OPCODE_MIX) {
@@ -189,7 +236,8 @@ drmemtrace_analysis_tool_create()
             return nullptr;
         }
         return opcode_mix_tool_create(module_file_path, op_verbose.get_value(),
-                                      op_alt_module_dir.get_value());
+                                      op_alt_module_dir.get_value(),
+                                      op_decode_cache_dir.get_value());
     } else if (op_simulator_type.get_value() == VIEW) {
         std::string module_file_path = get_module_file_path();
         // The module file is optional so we don't check for emptiness.
@@ -211,8 +259,8 @@ drmemtrace_analysis_tool_create()
     } else {
         ERRMSG("Usage error: unsupported analyzer type. "
                "Please choose " CPU_CACHE ", " MISS_ANALYZER ", " TLB ", " HISTOGRAM
-               ", " REUSE_DIST ", " BASIC_COUNTS ", " OPCODE_MIX ", " VIEW
-               " or " FUNC_VIEW ".\n");
+               ", " REUSE_DIST ", " MISS_RATIO_CURVE ", " BASIC_COUNTS ", " OPCODE_MIX
+               ", " VIEW " or " FUNC_VIEW ".\n");
         return nullptr;
     }
 }
@@ -73,7 +73,7 @@ cache_t::flush(const memref_t &memref)
         auto block_way = find_caching_device_block(tag);
         if (block_way.first == nullptr)
             continue;
-        invalidate_caching_device_block(block_way.first);
+        invalidate_caching_device_block(compute_block_idx(tag), block_way.second);
     }
     // We flush parent_'s code cache here.
     // XXX: should L1 data cache be flushed when L1 instr cache is flushed?
@@ -82,3 +82,42 @@ cache_t::flush(const memref_t &memref)
     if (stats_ != NULL)
         ((cache_stats_t *)stats_)->flush(memref);
 }
+
+void
+cache_t::save(checkpoint_writer_t &out) const
+{
+    caching_device_t::save(out);
+    // Only the few lines holding unused prefetches have state of their own.
+    std::vector<int> prefetched;
+    for (int i = 0; i < num_blocks_; i++) {
+        if (static_cast<cache_line_t *>(blocks_[i])->prefetched_)
+            prefetched.push_back(i);
+    }
+    out.write(prefetched.size());
+    for (int i : prefetched) {
+        out.write(i);
+        out.write(static_cast<cache_line_t *>(blocks_[i])->prefetch_time_);
+    }
+}
+
+bool
+cache_t::restore(checkpoint_reader_t &in)
+{
+    if (!caching_device_t::restore(in))
+        return false;
+    for (int i = 0; i < num_blocks_; i++)
+        static_cast<cache_line_t *>(blocks_[i])->prefetched_ = false;
+    size_t num_prefetched;
+    if (!in.read(&num_prefetched))
+        return false;
+    for (size_t j = 0; j < num_prefetched; j++) {
+        int i;
+        int_least64_t time;
+        if (!in.read(&i) || i < 0 || i >= num_blocks_ || !in.read(&time))
+            return false;
+        cache_line_t *line = static_cast<cache_line_t *>(blocks_[i]);
+        line->prefetched_ = true;
+        line->prefetch_time_ = time;
+    }
+    return true;
+}
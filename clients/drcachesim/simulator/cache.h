@@ -57,6 +57,11 @@ public:
     virtual void
     flush(const memref_t &memref);
 
+    void
+    save(checkpoint_writer_t &out) const override;
+    bool
+    restore(checkpoint_reader_t &in) override;
+
 protected:
     void
     init_blocks() override;
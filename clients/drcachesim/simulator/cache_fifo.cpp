@@ -57,7 +57,7 @@ cache_fifo_t::init(int associativity, int block_size, int total_size,
     // Create a replacement pointer for each set, and
     // initialize it to point to the first block.
     for (int i = 0; i < blocks_per_set_; i++) {
-        get_caching_device_block(i << assoc_bits_, 0).counter_ = 1;
+        counters_[i << assoc_bits_] = 1;
     }
     return true;
 }
@@ -81,10 +81,9 @@ cache_fifo_t::replace_which_way(int block_idx)
     if (victim_way == -1)
         return -1;
     // clear the counter of the victim block
-    get_caching_device_block(block_idx, victim_way).counter_ = 0;
+    counters_[block_idx + victim_way] = 0;
     // set the next block as victim
-    get_caching_device_block(block_idx, (victim_way + 1) & (associativity_ - 1))
-        .counter_ = 1;
+    counters_[block_idx + ((victim_way + 1) & (associativity_ - 1))] = 1;
     return victim_way;
 }
 
@@ -95,7 +94,7 @@ cache_fifo_t::get_next_way_to_replace(const int block_idx) const
 {
     for (int i = 0; i < associativity_; i++) {
         // We return the block whose counter is 1.
-        if (get_caching_device_block(block_idx, i).counter_ == 1) {
+        if (counters_[block_idx + i] == 1) {
             return i;
         }
     }
@@ -36,14 +36,16 @@
 #ifndef _CACHE_LINE_H_
 #define _CACHE_LINE_H_ 1
 
+#include <stdint.h>
 #include "caching_device_block.h"
 
 class cache_line_t : public caching_device_block_t {
-
-    // Currently, "cache_line_t" is identical to caching_device_block_t; however,
-    // cache_line_t is probably to be extended to have distinct member variables
-    // and functions, e.g., coherency-related ones. Therefore, it is
-    // reasonable to keep two identical classes now rather than use one instead.
+public:
+    // Whether the line was brought in by a hardware prefetch and has not yet
+    // been used by a demand access.  Maintained by cache_stats_t.
+    bool prefetched_ = false;
+    // When the prefetch was issued, counted in accesses to the cache.
+    int_least64_t prefetch_time_ = 0;
 };
 
 #endif /* _CACHE_LINE_H_ */
@@ -56,7 +56,7 @@ cache_lru_t::init(int associativity, int block_size, int total_size,
     // Initialize line counters with 0, 1, 2, ..., associativity - 1.
     for (int i = 0; i < blocks_per_set_; i++) {
         for (int way = 0; way < associativity_; ++way) {
-            get_caching_device_block(i << assoc_bits_, way).counter_ = way;
+            counters_[(i << assoc_bits_) + way] = way;
         }
     }
     return true;
@@ -65,17 +65,18 @@ cache_lru_t::init(int associativity, int block_size, int total_size,
 void
 cache_lru_t::access_update(int block_idx, int way)
 {
-    int cnt = get_caching_device_block(block_idx, way).counter_;
+    int *counters = &counters_[block_idx];
+    int cnt = counters[way];
     // Optimization: return early if it is a repeated access.
     if (cnt == 0)
         return;
     // We inc all the counters that are not larger than cnt for LRU.
-    for (int i = 0; i < associativity_; ++i) {
-        if (i != way && get_caching_device_block(block_idx, i).counter_ <= cnt)
-            get_caching_device_block(block_idx, i).counter_++;
-    }
+    // This includes counters[way] itself, which is cleared below: keeping the
+    // loop free of branches lets the compiler vectorize it over the packed set.
+    for (int i = 0; i < associativity_; ++i)
+        counters[i] += (counters[i] <= cnt);
     // Clear the counter for LRU.
-    get_caching_device_block(block_idx, way).counter_ = 0;
+    counters[way] = 0;
 }
 
 int
@@ -91,12 +92,12 @@ cache_lru_t::get_next_way_to_replace(int block_idx) const
     int max_counter = 0;
     int max_way = 0;
     for (int way = 0; way < associativity_; ++way) {
-        if (get_caching_device_block(block_idx, way).tag_ == TAG_INVALID) {
+        if (tags_[block_idx + way] == TAG_INVALID) {
             max_way = way;
             break;
         }
-        if (get_caching_device_block(block_idx, way).counter_ > max_counter) {
-            max_counter = get_caching_device_block(block_idx, way).counter_;
+        if (counters_[block_idx + way] > max_counter) {
+            max_counter = counters_[block_idx + way];
             max_way = way;
         }
     }
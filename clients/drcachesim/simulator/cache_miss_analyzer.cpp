@@ -32,6 +32,7 @@
 
 #include "cache_miss_analyzer.h"
 
+#include <algorithm>
 #include <iostream>
 #include <stdint.h>
 
@@ -41,21 +42,100 @@ const char *cache_miss_stats_t::kT0 = "t0";
 analysis_tool_t *
 cache_miss_analyzer_create(const cache_simulator_knobs_t &knobs,
                            unsigned int miss_count_threshold, double miss_frac_threshold,
-                           double confidence_threshold)
+                           double confidence_threshold, unsigned int sketch_size,
+                           bool parallel_shards)
 {
     return new cache_miss_analyzer_t(knobs, miss_count_threshold, miss_frac_threshold,
-                                     confidence_threshold);
+                                     confidence_threshold, sketch_size, parallel_shards);
+}
+
+stride_sketch_t::stride_sketch_t(unsigned int capacity)
+    : capacity_(capacity == 0 ? 1 : capacity)
+{
+}
+
+void
+stride_sketch_t::add(int stride)
+{
+    for (auto &counter : counters_) {
+        if (counter.first == stride) {
+            ++counter.second;
+            return;
+        }
+    }
+    if (counters_.size() < capacity_) {
+        counters_.emplace_back(stride, 1);
+        return;
+    }
+    // No free slot: the new stride and one occurrence of every tracked stride
+    // cancel out.
+    size_t kept = 0;
+    for (auto &counter : counters_) {
+        if (--counter.second > 0)
+            counters_[kept++] = counter;
+    }
+    counters_.resize(kept);
+}
+
+void
+stride_sketch_t::merge(const stride_sketch_t &other)
+{
+    for (const auto &other_counter : other.counters_) {
+        bool found = false;
+        for (auto &counter : counters_) {
+            if (counter.first == other_counter.first) {
+                counter.second += other_counter.second;
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            counters_.push_back(other_counter);
+    }
+    if (counters_.size() <= capacity_)
+        return;
+    // Keep the capacity_ largest counters, reduced by the next largest count,
+    // which bounds the error of the merged sketch just as for a single stream.
+    std::sort(counters_.begin(), counters_.end(),
+              [](const std::pair<int, uint64_t> &a, const std::pair<int, uint64_t> &b) {
+                  return a.second > b.second;
+              });
+    const uint64_t cutoff = counters_[capacity_].second;
+    counters_.resize(capacity_);
+    size_t kept = 0;
+    for (auto &counter : counters_) {
+        counter.second -= cutoff;
+        if (counter.second > 0)
+            counters_[kept++] = counter;
+    }
+    counters_.resize(kept);
+}
+
+int
+stride_sketch_t::top(uint64_t *count) const
+{
+    int max_count_stride = 0;
+    *count = 0;
+    for (const auto &counter : counters_) {
+        if (counter.second > *count) {
+            *count = counter.second;
+            max_count_stride = counter.first;
+        }
+    }
+    return max_count_stride;
 }
 
 cache_miss_stats_t::cache_miss_stats_t(bool warmup_enabled, unsigned int line_size,
                                        unsigned int miss_count_threshold,
                                        double miss_frac_threshold,
-                                       double confidence_threshold)
+                                       double confidence_threshold,
+                                       unsigned int sketch_size)
     : cache_stats_t(line_size, "", warmup_enabled, false)
     , kLineSize(line_size)
     , kMissCountThreshold(miss_count_threshold)
     , kMissFracThreshold(miss_frac_threshold)
     , kConfidenceThreshold(confidence_threshold)
+    , kSketchSize(sketch_size)
 {
     // Setting this variable to true ensures that the dump_miss() function below
     // gets called during cache simulation on a cache miss.
@@ -73,8 +153,8 @@ cache_miss_stats_t::reset()
 void
 cache_miss_stats_t::dump_miss(const memref_t &memref)
 {
-    // If the operation causing the LLC miss is a memory read (load), insert
-    // the miss into the pc_cache_misses_ hash map and update
+    // If the operation causing the LLC miss is a memory read (load), record
+    // the miss in the pc_cache_misses_ hash map and update
     // the total_misses_ counter.
     if (memref.data.type != TRACE_TYPE_READ) {
         return;
@@ -82,10 +162,36 @@ cache_miss_stats_t::dump_miss(const memref_t &memref)
 
     const addr_t pc = memref.data.pc;
     const addr_t addr = memref.data.addr / kLineSize;
-    pc_cache_misses_[pc].push_back(addr);
+    auto it = pc_cache_misses_.find(pc);
+    if (it == pc_cache_misses_.end())
+        it = pc_cache_misses_.emplace(pc, pc_misses_t(kSketchSize)).first;
+    pc_misses_t &misses = it->second;
+    if (misses.count > 0) {
+        int stride = static_cast<int>(addr - misses.last_line);
+        if (stride != 0) {
+            misses.strides.add(stride);
+        }
+    }
+    misses.last_line = addr;
+    misses.count++;
     total_misses_++;
 }
 
+void
+cache_miss_stats_t::merge(const cache_miss_stats_t &other)
+{
+    for (const auto &other_it : other.pc_cache_misses_) {
+        auto it = pc_cache_misses_.find(other_it.first);
+        if (it == pc_cache_misses_.end()) {
+            pc_cache_misses_.emplace(other_it.first, other_it.second);
+            continue;
+        }
+        it->second.count += other_it.second.count;
+        it->second.strides.merge(other_it.second.strides);
+    }
+    total_misses_ += other.total_misses_;
+}
+
 std::vector<prefetching_recommendation_t *>
 cache_miss_stats_t::generate_recommendations()
 {
@@ -98,9 +204,9 @@ cache_miss_stats_t::generate_recommendations()
     // Find loads that should be analyzed and analyze them.
     std::vector<prefetching_recommendation_t *> recommendations;
     for (auto &pc_cache_misses_it : pc_cache_misses_) {
-        std::vector<addr_t> &cache_misses = pc_cache_misses_it.second;
+        const pc_misses_t &cache_misses = pc_cache_misses_it.second;
 
-        if (cache_misses.size() >= miss_count_threshold) {
+        if (cache_misses.count >= miss_count_threshold) {
             const int stride = check_for_constant_stride(cache_misses);
             if (stride != 0) {
                 prefetching_recommendation_t *recommendation =
@@ -117,32 +223,15 @@ cache_miss_stats_t::generate_recommendations()
 }
 
 int
-cache_miss_stats_t::check_for_constant_stride(
-    const std::vector<addr_t> &cache_misses) const
+cache_miss_stats_t::check_for_constant_stride(const pc_misses_t &cache_misses) const
 {
-    std::unordered_map<int, int> stride_counts;
-
-    // Find and count all strides in the misses stream.
-    for (unsigned int i = 1; i < cache_misses.size(); ++i) {
-        int stride = static_cast<int>(cache_misses[i] - cache_misses[i - 1]);
-        if (stride != 0) {
-            stride_counts[stride]++;
-        }
-    }
-
     // Find the most occurring stride.
-    int max_count = 0;
-    int max_count_stride = 0;
-    for (auto &stride_count : stride_counts) {
-        if (stride_count.second > max_count) {
-            max_count = stride_count.second;
-            max_count_stride = stride_count.first;
-        }
-    }
+    uint64_t max_count;
+    const int max_count_stride = cache_misses.strides.top(&max_count);
 
     // Return the most occurring stride if it meets the confidence threshold.
-    stride_counts.clear();
-    if (max_count >= static_cast<int>(kConfidenceThreshold * cache_misses.size())) {
+    if (max_count_stride != 0 &&
+        max_count >= static_cast<uint64_t>(kConfidenceThreshold * cache_misses.count)) {
         return max_count_stride * kLineSize;
     } else {
         return 0;
@@ -152,8 +241,15 @@ cache_miss_stats_t::check_for_constant_stride(
 cache_miss_analyzer_t::cache_miss_analyzer_t(const cache_simulator_knobs_t &knobs,
                                              unsigned int miss_count_threshold,
                                              double miss_frac_threshold,
-                                             double confidence_threshold)
+                                             double confidence_threshold,
+                                             unsigned int sketch_size,
+                                             bool parallel_shards)
     : cache_simulator_t(knobs)
+    , miss_count_threshold_(miss_count_threshold)
+    , miss_frac_threshold_(miss_frac_threshold)
+    , confidence_threshold_(confidence_threshold)
+    , sketch_size_(sketch_size)
+    , parallel_shards_(parallel_shards)
 {
     if (!success_) {
         return;
@@ -163,7 +259,7 @@ cache_miss_analyzer_t::cache_miss_analyzer_t(const cache_simulator_knobs_t &knob
     delete llcaches_["LL"]->get_stats();
     ll_stats_ =
         new cache_miss_stats_t(warmup_enabled_, knobs.line_size, miss_count_threshold,
-                               miss_frac_threshold, confidence_threshold);
+                               miss_frac_threshold, confidence_threshold, sketch_size);
     llcaches_["LL"]->set_stats(ll_stats_);
 
     if (!knobs.LL_miss_file.empty()) {
@@ -171,12 +267,81 @@ cache_miss_analyzer_t::cache_miss_analyzer_t(const cache_simulator_knobs_t &knob
     }
 }
 
+cache_miss_analyzer_t::~cache_miss_analyzer_t()
+{
+    for (cache_miss_analyzer_t *shard : live_shards_)
+        delete shard;
+}
+
 std::vector<prefetching_recommendation_t *>
 cache_miss_analyzer_t::generate_recommendations()
 {
     return ll_stats_->generate_recommendations();
 }
 
+bool
+cache_miss_analyzer_t::parallel_shard_supported()
+{
+    return parallel_shards_;
+}
+
+void *
+cache_miss_analyzer_t::parallel_shard_init(int shard_index, void *worker_data)
+{
+    // Each shard runs through its own single-core hierarchy, so a shard's
+    // misses do not reflect other shards' contention for the LLC.
+    cache_simulator_knobs_t shard_knobs = knobs_;
+    shard_knobs.num_cores = 1;
+    shard_knobs.cpu_scheduling = false;
+    shard_knobs.LL_miss_file = "";
+    // Only the whole-trace simulation writes a checkpoint, and the shards are
+    // already run concurrently.
+    shard_knobs.save_checkpoint = "";
+    shard_knobs.restore_checkpoint = "";
+    shard_knobs.pipeline_workers = 0;
+    cache_miss_analyzer_t *shard = new cache_miss_analyzer_t(
+        shard_knobs, miss_count_threshold_, miss_frac_threshold_, confidence_threshold_,
+        sketch_size_, false);
+    std::lock_guard<std::mutex> guard(merge_mutex_);
+    live_shards_.insert(shard);
+    return shard;
+}
+
+bool
+cache_miss_analyzer_t::parallel_shard_exit(void *shard_data)
+{
+    cache_miss_analyzer_t *shard = reinterpret_cast<cache_miss_analyzer_t *>(shard_data);
+    // On an error the shard is left in live_shards_ for parallel_shard_error()
+    // and our destructor.
+    if (!*shard)
+        return false;
+    {
+        std::lock_guard<std::mutex> guard(merge_mutex_);
+        ll_stats_->merge(*shard->ll_stats_);
+        live_shards_.erase(shard);
+    }
+    // Free the shard's caches now rather than holding one hierarchy per shard
+    // until the end.
+    delete shard;
+    return true;
+}
+
+bool
+cache_miss_analyzer_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    cache_miss_analyzer_t *shard = reinterpret_cast<cache_miss_analyzer_t *>(shard_data);
+    if (!*shard)
+        return false;
+    return shard->process_memref(memref);
+}
+
+std::string
+cache_miss_analyzer_t::parallel_shard_error(void *shard_data)
+{
+    cache_miss_analyzer_t *shard = reinterpret_cast<cache_miss_analyzer_t *>(shard_data);
+    return shard->get_error_string();
+}
+
 bool
 cache_miss_analyzer_t::print_results()
 {
@@ -40,8 +40,10 @@
 #define _CACHE_MISS_ANALYZER_H_ 1
 
 #include <cstdint>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "cache_simulator.h"
@@ -55,6 +57,34 @@ struct prefetching_recommendation_t {
     std::string locality; // Prefetching locality: one of "nta" or "t0".
 };
 
+// A bounded-memory summary of the strides between a load's consecutive misses.
+// This is a Misra-Gries frequent-items sketch: it keeps at most capacity
+// candidate strides, and when a new stride finds no free slot every counter is
+// decremented instead.  A stride occurring in more than 1/(capacity+1) of the
+// stream is guaranteed to survive, and its count is exact whenever the stream
+// holds no more than capacity distinct strides.  Sketches of separate streams
+// can be merged without losing that guarantee.
+class stride_sketch_t {
+public:
+    explicit stride_sketch_t(unsigned int capacity = 16);
+
+    void
+    add(int stride);
+
+    // Adds the strides counted by other into this sketch.
+    void
+    merge(const stride_sketch_t &other);
+
+    // Returns the most frequent stride, or 0 if none has been counted, and its
+    // (possibly underestimated) count in *count.
+    int
+    top(uint64_t *count) const;
+
+private:
+    unsigned int capacity_;
+    std::vector<std::pair<int, uint64_t>> counters_;
+};
+
 class cache_miss_stats_t : public cache_stats_t {
 public:
     // Constructor - params description:
@@ -70,10 +100,12 @@ public:
     // Confidence in a discovered pattern for a load instruction is calculated
     // as the fraction of the load's misses with the discovered pattern over
     // all the load's misses.
+    // - sketch_size: The number of candidate strides tracked per load.
     cache_miss_stats_t(bool warmup_enabled = false, unsigned int line_size = 64,
                        unsigned int miss_count_threshold = 50000,
                        double miss_frac_threshold = 0.005,
-                       double confidence_threshold = 0.75);
+                       double confidence_threshold = 0.75,
+                       unsigned int sketch_size = 16);
 
     cache_miss_stats_t &
     operator=(const cache_miss_stats_t &)
@@ -87,6 +119,12 @@ public:
     std::vector<prefetching_recommendation_t *>
     generate_recommendations();
 
+    // Adds the misses recorded by other, which must use the same line size,
+    // into this object.  The stride between the last miss of one and the first
+    // miss of the other is not counted.
+    void
+    merge(const cache_miss_stats_t &other);
+
 protected:
     void
     dump_miss(const memref_t &memref) override;
@@ -110,20 +148,34 @@ private:
     // all the load's misses.
     const double kConfidenceThreshold;
 
+    // The number of candidate strides tracked per load.
+    const unsigned int kSketchSize;
+
+    // The LLC misses of one load instruction.  Only the last miss address is
+    // kept, so the memory used per load is bounded regardless of trace length.
+    struct pc_misses_t {
+        pc_misses_t(unsigned int sketch_size)
+            : strides(sketch_size)
+        {
+        }
+        uint64_t count = 0;
+        addr_t last_line = 0;
+        stride_sketch_t strides;
+    };
+
     // A function to analyze cache misses in search of a constant stride.
     // The function returns a nonzero stride value if it finds one that
     // satisfies the confidence threshold and returns 0 otherwise.
     int
-    check_for_constant_stride(const std::vector<addr_t> &cache_misses) const;
+    check_for_constant_stride(const pc_misses_t &cache_misses) const;
 
-    // A hash map storing the data cache line addresses accessed by load
+    // A hash map summarizing the data cache line addresses accessed by load
     // instructions that miss in the LLC.
     // Key is the PC of the load instruction.
-    // Value is a vector of data memory cache line addresses.
-    std::unordered_map<addr_t, std::vector<addr_t>> pc_cache_misses_;
+    std::unordered_map<addr_t, pc_misses_t> pc_cache_misses_;
 
     // Total number of LLC misses added to the hash map above.
-    int total_misses_ = 0;
+    uint64_t total_misses_ = 0;
 };
 
 class cache_miss_analyzer_t : public cache_simulator_t {
@@ -139,20 +191,49 @@ public:
     // Confidence in a discovered pattern for a load instruction is calculated
     // as the fraction of the load's misses with the discovered pattern over
     // all the load's misses.
+    // - sketch_size: The number of candidate strides tracked per load.
+    // - parallel_shards: Whether to simulate each trace shard separately and
+    //                    concurrently, each with a private single-core cache
+    //                    hierarchy, merging the shards' misses for the analysis.
     cache_miss_analyzer_t(const cache_simulator_knobs_t &knobs,
                           unsigned int miss_count_threshold = 50000,
                           double miss_frac_threshold = 0.005,
-                          double confidence_threshold = 0.75);
+                          double confidence_threshold = 0.75,
+                          unsigned int sketch_size = 16, bool parallel_shards = false);
+    ~cache_miss_analyzer_t() override;
 
     std::vector<prefetching_recommendation_t *>
     generate_recommendations();
 
     bool
     print_results() override;
+    bool
+    parallel_shard_supported() override;
+    void *
+    parallel_shard_init(int shard_index, void *worker_data) override;
+    bool
+    parallel_shard_exit(void *shard_data) override;
+    bool
+    parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    std::string
+    parallel_shard_error(void *shard_data) override;
 
 private:
     cache_miss_stats_t *ll_stats_;
 
+    // The arguments used to create a simulator for each shard.
+    const unsigned int miss_count_threshold_;
+    const double miss_frac_threshold_;
+    const double confidence_threshold_;
+    const unsigned int sketch_size_;
+    const bool parallel_shards_;
+
+    // Each shard's misses are merged into ll_stats_ at parallel_shard_exit,
+    // which worker threads invoke concurrently.  This also guards live_shards_.
+    std::mutex merge_mutex_;
+    // Shards not yet merged, which an error can leave behind.
+    std::unordered_set<cache_miss_analyzer_t *> live_shards_;
+
     // Recommendations are written to this file for use by the LLVM compiler.
     std::string recommendation_file_ = "";
 };
@@ -0,0 +1,338 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+#include "cache_pipeline.h"
+#include "caching_device_stats.h"
+
+// The number of requests across all cores handed to the L1 threads at once.
+// This amortizes the synchronization, which happens once per step for every
+// thread, while keeping a step's requests and misses small enough to stay in the
+// cache.
+static const size_t PIPELINE_BATCH_SIZE = 16384;
+
+// The stand-in parent records the misses and flushes its L1 cache sends up the
+// hierarchy, tagged with the trace position of the request that caused them.
+// The L1 cache's hit bookkeeping for its parents lands in our own stats, whose
+// child hits are later credited to the real parent and its ancestors.
+class cache_pipeline_t::l1_parent_t : public cache_t {
+public:
+    l1_parent_t(cache_t *l1, cache_t *real_parent)
+        : l1_(l1)
+        , real_parent_(real_parent)
+    {
+    }
+    ~l1_parent_t() override
+    {
+        delete get_stats();
+    }
+    bool
+    init()
+    {
+        // We never hold anything, so the smallest valid geometry suffices.
+        const int block_size = 4;
+        return cache_t::init(1, block_size, block_size, nullptr,
+                             new caching_device_stats_t("", block_size));
+    }
+    void
+    set_output(uint64_t seq, std::vector<miss_t> *output)
+    {
+        seq_ = seq;
+        output_ = output;
+    }
+    void
+    request(const memref_t &memref) override
+    {
+        output_->push_back({ seq_, memref, real_parent_, false });
+    }
+    void
+    flush(const memref_t &memref) override
+    {
+        output_->push_back({ seq_, memref, real_parent_, true });
+    }
+
+    cache_t *l1_;
+    cache_t *real_parent_;
+
+private:
+    uint64_t seq_ = 0;
+    std::vector<miss_t> *output_ = nullptr;
+};
+
+cache_pipeline_t::cache_pipeline_t()
+{
+}
+
+cache_pipeline_t::~cache_pipeline_t()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exiting_ = true;
+    }
+    start_cond_.notify_all();
+    for (std::thread &thread : threads_) {
+        if (thread.joinable())
+            thread.join();
+    }
+    for (l1_parent_t *parent : parents_) {
+        parent->l1_->set_parent(parent->real_parent_);
+        delete parent;
+    }
+}
+
+bool
+cache_pipeline_t::init(cache_t **l1_icaches, cache_t **l1_dcaches,
+                       unsigned int num_cores, int worker_count)
+{
+    num_cores_ = num_cores;
+    icaches_.assign(l1_icaches, l1_icaches + num_cores_);
+    dcaches_.assign(l1_dcaches, l1_dcaches + num_cores_);
+    icache_parents_.resize(num_cores_, nullptr);
+    dcache_parents_.resize(num_cores_, nullptr);
+    for (unsigned int core = 0; core < num_cores_; ++core) {
+        for (int instr = 0; instr < 2; ++instr) {
+            cache_t *l1 = instr != 0 ? l1_icaches[core] : l1_dcaches[core];
+            std::vector<l1_parent_t *> &core_parents =
+                instr != 0 ? icache_parents_ : dcache_parents_;
+            // A unified cache shares its stand-in.
+            if (instr == 0 && l1 == l1_icaches[core]) {
+                core_parents[core] = icache_parents_[core];
+                continue;
+            }
+            if (l1->get_parent() == nullptr)
+                continue;
+            l1_parent_t *parent =
+                new l1_parent_t(l1, static_cast<cache_t *>(l1->get_parent()));
+            parents_.push_back(parent);
+            if (!parent->init())
+                return false;
+            l1->set_parent(parent);
+            core_parents[core] = parent;
+        }
+    }
+    for (int buffer = 0; buffer < 2; ++buffer) {
+        ops_[buffer].resize(num_cores_);
+        misses_[buffer].resize(num_cores_);
+    }
+    if (worker_count < 0)
+        worker_count = std::thread::hardware_concurrency();
+    size_t num_workers =
+        std::min(static_cast<size_t>(std::max(worker_count, 1)), (size_t)num_cores_);
+    worker_cores_.resize(num_workers);
+    for (unsigned int core = 0; core < num_cores_; ++core)
+        worker_cores_[core % num_workers].push_back(core);
+    for (size_t i = 0; i < num_workers; ++i)
+        threads_.emplace_back(&cache_pipeline_t::l1_worker_loop, this, i);
+    threads_.emplace_back(&cache_pipeline_t::upper_worker_loop, this);
+    return true;
+}
+
+caching_device_t *
+cache_pipeline_t::get_parent(const caching_device_t *l1) const
+{
+    for (l1_parent_t *parent : parents_) {
+        if (parent->l1_ == l1)
+            return parent->real_parent_;
+    }
+    return l1->get_parent();
+}
+
+void
+cache_pipeline_t::enqueue(int core, bool instr, const memref_t &memref, bool flush)
+{
+    if (instr) {
+        ops_[pending_][core].push_back(
+            { next_seq_++, memref, icaches_[core], icache_parents_[core], flush });
+    } else {
+        ops_[pending_][core].push_back(
+            { next_seq_++, memref, dcaches_[core], dcache_parents_[core], flush });
+    }
+    dirty_ = true;
+    if (++pending_count_ == PIPELINE_BATCH_SIZE)
+        advance();
+}
+
+void
+cache_pipeline_t::request(int core, bool instr, const memref_t &memref)
+{
+    enqueue(core, instr, memref, false);
+}
+
+void
+cache_pipeline_t::flush(int core, bool instr, const memref_t &memref)
+{
+    enqueue(core, instr, memref, true);
+}
+
+void
+cache_pipeline_t::wait_for_step()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cond_.wait(lock, [this] { return busy_threads_ == 0; });
+}
+
+void
+cache_pipeline_t::fold_child_hits()
+{
+    for (l1_parent_t *parent : parents_) {
+        int_least64_t hits = parent->get_stats()->get_metric(metric_name_t::CHILD_HITS);
+        if (hits == 0)
+            continue;
+        for (caching_device_t *up = parent->real_parent_; up != nullptr;
+             up = up->get_parent())
+            up->get_stats()->add_child_hits(hits);
+        parent->get_stats()->reset();
+    }
+}
+
+void
+cache_pipeline_t::advance()
+{
+    wait_for_step();
+    fold_child_hits();
+    // The upper-level thread replayed these in the step that just finished.
+    for (std::vector<miss_t> &misses : misses_[pending_])
+        misses.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dispatched_ = pending_;
+        busy_threads_ = threads_.size();
+        ++generation_;
+    }
+    start_cond_.notify_all();
+    // The L1 threads simulated these in the step that just finished.
+    pending_ = 1 - pending_;
+    for (std::vector<l1_op_t> &ops : ops_[pending_])
+        ops.clear();
+    pending_count_ = 0;
+}
+
+void
+cache_pipeline_t::drain()
+{
+    if (!dirty_)
+        return;
+    // The first step simulates the last requests in the L1 caches and the
+    // second replays their misses.
+    advance();
+    advance();
+    wait_for_step();
+    fold_child_hits();
+    dirty_ = false;
+}
+
+void
+cache_pipeline_t::l1_worker_loop(size_t index)
+{
+    uint64_t seen = 0;
+    while (true) {
+        int buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cond_.wait(lock, [&] { return exiting_ || generation_ != seen; });
+            if (generation_ == seen)
+                return;
+            seen = generation_;
+            buffer = dispatched_;
+        }
+        for (int core : worker_cores_[index]) {
+            std::vector<miss_t> *misses = &misses_[buffer][core];
+            for (const l1_op_t &op : ops_[buffer][core]) {
+                if (op.parent != nullptr)
+                    op.parent->set_output(op.seq, misses);
+                if (op.flush)
+                    op.cache->flush(op.memref);
+                else
+                    op.cache->request(op.memref);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_threads_ == 0)
+                done_cond_.notify_one();
+        }
+    }
+}
+
+void
+cache_pipeline_t::upper_worker_loop()
+{
+    uint64_t seen = 0;
+    while (true) {
+        int buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cond_.wait(lock, [&] { return exiting_ || generation_ != seen; });
+            if (generation_ == seen)
+                return;
+            seen = generation_;
+            buffer = 1 - dispatched_;
+        }
+        simulate_upper(buffer);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_threads_ == 0)
+                done_cond_.notify_one();
+        }
+    }
+}
+
+void
+cache_pipeline_t::simulate_upper(int buffer)
+{
+    // Each core's misses are already in trace order, so a k-way merge on the
+    // trace position reproduces the order a serial simulation would see.
+    const std::vector<std::vector<miss_t>> &misses = misses_[buffer];
+    std::vector<size_t> next(num_cores_, 0);
+    std::priority_queue<std::pair<uint64_t, unsigned int>,
+                        std::vector<std::pair<uint64_t, unsigned int>>,
+                        std::greater<std::pair<uint64_t, unsigned int>>>
+        heads;
+    for (unsigned int core = 0; core < num_cores_; ++core) {
+        if (!misses[core].empty())
+            heads.push(std::make_pair(misses[core][0].seq, core));
+    }
+    while (!heads.empty()) {
+        unsigned int core = heads.top().second;
+        heads.pop();
+        const miss_t &miss = misses[core][next[core]];
+        if (miss.flush)
+            miss.parent->flush(miss.memref);
+        else
+            miss.parent->request(miss.memref);
+        if (++next[core] < misses[core].size())
+            heads.push(std::make_pair(misses[core][next[core]].seq, core));
+    }
+}
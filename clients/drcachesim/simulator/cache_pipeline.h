@@ -0,0 +1,159 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* cache_pipeline: simulates the private L1 caches of different cores on separate
+ * threads, feeding their misses in trace order to a single thread that simulates
+ * the rest of the hierarchy.
+ */
+
+#ifndef _CACHE_PIPELINE_H_
+#define _CACHE_PIPELINE_H_ 1
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "cache.h"
+#include "memref.h"
+
+// This produces the same results as simulating serially only when nothing above
+// the L1 caches ever reaches back down into them: i.e., with no coherence and no
+// inclusive caches.  The caller is responsible for checking that.
+//
+// Each core's L1 parent is replaced with a stand-in that records the requests it
+// receives instead of simulating them.  Requests are handed over in batches.
+// While the L1 threads simulate one batch, the upper-level thread replays the
+// misses the L1 threads recorded for the prior batch, merged across cores by
+// their position in the trace, and the caller fills the next batch.
+class cache_pipeline_t {
+public:
+    cache_pipeline_t();
+    ~cache_pipeline_t();
+
+    // Takes over the parents of each core's L1 caches, which may be a single
+    // unified cache, and starts the threads.  The L1 cores are divided among
+    // worker_count threads, or one per hardware thread if worker_count is
+    // negative.
+    bool
+    init(cache_t **l1_icaches, cache_t **l1_dcaches, unsigned int num_cores,
+         int worker_count);
+
+    // Queues a request or flush for core's L1 instruction or data cache.
+    void
+    request(int core, bool instr, const memref_t &memref);
+    void
+    flush(int core, bool instr, const memref_t &memref);
+
+    // Waits until every queued request has been simulated at every level.
+    void
+    drain();
+
+    // Returns the real parent of an L1 cache, as its get_parent() now returns
+    // the stand-in.
+    caching_device_t *
+    get_parent(const caching_device_t *l1) const;
+
+protected:
+    // The stand-in parent for one L1 cache.
+    class l1_parent_t;
+
+    struct l1_op_t {
+        // The trace position, used to order the L1 misses of different cores.
+        uint64_t seq;
+        memref_t memref;
+        cache_t *cache;
+        l1_parent_t *parent;
+        bool flush;
+    };
+
+    struct miss_t {
+        uint64_t seq;
+        memref_t memref;
+        cache_t *parent;
+        bool flush;
+    };
+
+    void
+    enqueue(int core, bool instr, const memref_t &memref, bool flush);
+    // Starts the next step: the L1 threads take the batch being filled and the
+    // upper-level thread takes the misses from the prior step.
+    void
+    advance();
+    void
+    wait_for_step();
+    // Moves the child hits counted by the stand-ins to the real parents.
+    void
+    fold_child_hits();
+    void
+    l1_worker_loop(size_t index);
+    void
+    upper_worker_loop();
+    void
+    simulate_upper(int buffer);
+
+    unsigned int num_cores_ = 0;
+    // Per core, its L1 instruction and data caches and their stand-in parents
+    // (nullptr if the cache has no parent).
+    std::vector<cache_t *> icaches_;
+    std::vector<cache_t *> dcaches_;
+    std::vector<l1_parent_t *> icache_parents_;
+    std::vector<l1_parent_t *> dcache_parents_;
+    // All of the stand-ins.
+    std::vector<l1_parent_t *> parents_;
+    // Per L1 worker, the cores it simulates.
+    std::vector<std::vector<int>> worker_cores_;
+    std::vector<std::thread> threads_;
+
+    // Per buffer, per core.
+    std::vector<std::vector<l1_op_t>> ops_[2];
+    std::vector<std::vector<miss_t>> misses_[2];
+    // The buffer being filled and how many requests it holds.
+    int pending_ = 0;
+    size_t pending_count_ = 0;
+    uint64_t next_seq_ = 0;
+    // Whether anything was queued since the last drain().
+    bool dirty_ = false;
+
+    std::mutex mutex_;
+    std::condition_variable start_cond_;
+    std::condition_variable done_cond_;
+    // Incremented for each step.
+    uint64_t generation_ = 0;
+    // The ops_ buffer the L1 threads are simulating in the current step.  The
+    // upper-level thread is replaying the other misses_ buffer.
+    int dispatched_ = 0;
+    // How many threads have yet to finish the current step.
+    size_t busy_threads_ = 0;
+    bool exiting_ = false;
+};
+
+#endif /* _CACHE_PIPELINE_H_ */
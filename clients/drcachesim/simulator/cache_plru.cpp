@@ -0,0 +1,99 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "cache_plru.h"
+
+bool
+cache_plru_t::init(int associativity, int block_size, int total_size,
+                   caching_device_t *parent, caching_device_stats_t *stats,
+                   prefetcher_t *prefetcher, bool inclusive, bool coherent_cache, int id,
+                   snoop_filter_t *snoop_filter,
+                   const std::vector<caching_device_t *> &children)
+{
+    // The tree has associativity - 1 nodes, numbered from 1.
+    if (associativity > 64)
+        return false;
+    if (!cache_t::init(associativity, block_size, total_size, parent, stats, prefetcher,
+                       inclusive, coherent_cache, id, snoop_filter, children))
+        return false;
+    tree_bits_.assign(blocks_per_set_, 0);
+    return true;
+}
+
+void
+cache_plru_t::access_update(int block_idx, int way)
+{
+    uint64_t &bits = tree_bits_[block_idx >> assoc_bits_];
+    int node = 1;
+    for (int level = assoc_bits_ - 1; level >= 0; --level) {
+        int dir = (way >> level) & 1;
+        // Point the node away from the half holding this way.
+        if (dir == 0)
+            bits |= 1ULL << node;
+        else
+            bits &= ~(1ULL << node);
+        node = 2 * node + dir;
+    }
+}
+
+int
+cache_plru_t::replace_which_way(int block_idx)
+{
+    return get_next_way_to_replace(block_idx);
+}
+
+int
+cache_plru_t::get_next_way_to_replace(const int block_idx) const
+{
+    for (int way = 0; way < associativity_; ++way) {
+        if (tags_[block_idx + way] == TAG_INVALID)
+            return way;
+    }
+    uint64_t bits = tree_bits_[block_idx >> assoc_bits_];
+    int node = 1;
+    for (int level = 0; level < assoc_bits_; ++level)
+        node = 2 * node + static_cast<int>((bits >> node) & 1);
+    return node - associativity_;
+}
+
+void
+cache_plru_t::save(checkpoint_writer_t &out) const
+{
+    cache_t::save(out);
+    out.write_vector(tree_bits_);
+}
+
+bool
+cache_plru_t::restore(checkpoint_reader_t &in)
+{
+    return cache_t::restore(in) && in.read_vector(&tree_bits_, tree_bits_.size());
+}
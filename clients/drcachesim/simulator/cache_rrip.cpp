@@ -0,0 +1,157 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <algorithm>
+#include "cache_rrip.h"
+
+// How many of each kind of DRRIP leader set to aim for.
+static const int DRRIP_LEADER_SETS = 32;
+// The DRRIP policy selector is a 10-bit saturating counter.
+static const int DRRIP_PSEL_MAX = (1 << 10) - 1;
+// One in this many BRRIP insertions uses a long rather than distant interval.
+static const unsigned int BRRIP_LONG_INTERVAL = 32;
+
+cache_rrip_t::cache_rrip_t(rrip_insertion_t insertion)
+    : insertion_(insertion)
+{
+}
+
+bool
+cache_rrip_t::init(int associativity, int block_size, int total_size,
+                   caching_device_t *parent, caching_device_stats_t *stats,
+                   prefetcher_t *prefetcher, bool inclusive, bool coherent_cache, int id,
+                   snoop_filter_t *snoop_filter,
+                   const std::vector<caching_device_t *> &children)
+{
+    if (!cache_t::init(associativity, block_size, total_size, parent, stats, prefetcher,
+                       inclusive, coherent_cache, id, snoop_filter, children))
+        return false;
+    dueling_stride_ = std::max(2, blocks_per_set_ / DRRIP_LEADER_SETS);
+    psel_ = (DRRIP_PSEL_MAX + 1) / 2;
+    return true;
+}
+
+bool
+cache_rrip_t::set_uses_bimodal(int block_idx) const
+{
+    if (insertion_ != RRIP_INSERT_DYNAMIC)
+        return insertion_ == RRIP_INSERT_BIMODAL;
+    int leader = (block_idx >> assoc_bits_) % dueling_stride_;
+    if (leader == 0)
+        return false;
+    if (leader == 1)
+        return true;
+    return psel_ > DRRIP_PSEL_MAX / 2;
+}
+
+int
+cache_rrip_t::insertion_rrpv(int block_idx, int way)
+{
+    if (!set_uses_bimodal(block_idx))
+        return RRIP_MAX_RRPV - 1;
+    bimodal_random_ ^= bimodal_random_ << 13;
+    bimodal_random_ ^= bimodal_random_ >> 17;
+    bimodal_random_ ^= bimodal_random_ << 5;
+    return bimodal_random_ % BRRIP_LONG_INTERVAL == 0 ? RRIP_MAX_RRPV - 1
+                                                      : RRIP_MAX_RRPV;
+}
+
+void
+cache_rrip_t::access_update(int block_idx, int way)
+{
+    if (filling_) {
+        filling_ = false;
+        counters_[block_idx + way] = insertion_rrpv(block_idx, way);
+    } else
+        counters_[block_idx + way] = 0;
+}
+
+int
+cache_rrip_t::replace_which_way(int block_idx)
+{
+    filling_ = true;
+    if (insertion_ == RRIP_INSERT_DYNAMIC) {
+        // Only misses in the leader sets train the selector.
+        int leader = (block_idx >> assoc_bits_) % dueling_stride_;
+        if (leader == 0)
+            psel_ = std::min(psel_ + 1, DRRIP_PSEL_MAX);
+        else if (leader == 1)
+            psel_ = std::max(psel_ - 1, 0);
+    }
+    int victim = get_next_way_to_replace(block_idx);
+    if (tags_[block_idx + victim] == TAG_INVALID)
+        return victim;
+    // Age the set by as much as it takes for the victim to reach the maximum.
+    int age = RRIP_MAX_RRPV - counters_[block_idx + victim];
+    if (age > 0) {
+        for (int way = 0; way < associativity_; ++way)
+            counters_[block_idx + way] += age;
+    }
+    return victim;
+}
+
+int
+cache_rrip_t::get_next_way_to_replace(const int block_idx) const
+{
+    // This is the way that aging would first bring to the maximum RRPV.
+    int max_rrpv = -1;
+    int max_way = 0;
+    for (int way = 0; way < associativity_; ++way) {
+        if (tags_[block_idx + way] == TAG_INVALID)
+            return way;
+        if (counters_[block_idx + way] > max_rrpv) {
+            max_rrpv = counters_[block_idx + way];
+            max_way = way;
+            if (max_rrpv == RRIP_MAX_RRPV)
+                break;
+        }
+    }
+    return max_way;
+}
+
+void
+cache_rrip_t::save(checkpoint_writer_t &out) const
+{
+    cache_t::save(out);
+    out.write(static_cast<int>(insertion_));
+    out.write(bimodal_random_);
+    out.write(psel_);
+}
+
+bool
+cache_rrip_t::restore(checkpoint_reader_t &in)
+{
+    int insertion;
+    return cache_t::restore(in) && in.read(&insertion) &&
+        insertion == static_cast<int>(insertion_) && in.read(&bimodal_random_) &&
+        in.read(&psel_);
+}
@@ -0,0 +1,102 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+/* cache_rrip: represents a single hardware cache with re-reference interval
+ * prediction (RRIP) replacement.
+ */
+
+#ifndef _CACHE_RRIP_H_
+#define _CACHE_RRIP_H_ 1
+
+#include <stdint.h>
+#include "cache.h"
+
+// Where newly filled blocks are placed in the predicted re-reference order.
+enum rrip_insertion_t {
+    // SRRIP: always insert with a long re-reference interval.
+    RRIP_INSERT_STATIC,
+    // BRRIP: mostly insert with a distant interval, so that a working set
+    // larger than the cache keeps some of its blocks.
+    RRIP_INSERT_BIMODAL,
+    // DRRIP: pick between the two by set dueling.
+    RRIP_INSERT_DYNAMIC,
+};
+
+// Each block's counter holds its 2-bit re-reference prediction value (RRPV):
+// 0 predicts a near-immediate re-reference and RRIP_MAX_RRPV a distant one.
+// A hit sets the RRPV to 0.  The victim is the first way whose RRPV is
+// RRIP_MAX_RRPV, after aging the whole set until there is one.
+class cache_rrip_t : public cache_t {
+public:
+    explicit cache_rrip_t(rrip_insertion_t insertion = RRIP_INSERT_STATIC);
+    bool
+    init(int associativity, int line_size, int total_size, caching_device_t *parent,
+         caching_device_stats_t *stats, prefetcher_t *prefetcher, bool inclusive = false,
+         bool coherent_cache = false, int id_ = -1,
+         snoop_filter_t *snoop_filter_ = nullptr,
+         const std::vector<caching_device_t *> &children = {}) override;
+    void
+    save(checkpoint_writer_t &out) const override;
+    bool
+    restore(checkpoint_reader_t &in) override;
+
+protected:
+    static const int RRIP_MAX_RRPV = 3;
+
+    void
+    access_update(int block_idx, int way) override;
+    int
+    replace_which_way(int block_idx) override;
+    int
+    get_next_way_to_replace(const int block_idx) const override;
+
+    // Returns the RRPV for a block being filled into the set at block_idx.
+    virtual int
+    insertion_rrpv(int block_idx, int way);
+    // Returns true if the set at block_idx should insert bimodally.
+    bool
+    set_uses_bimodal(int block_idx) const;
+
+    rrip_insertion_t insertion_;
+    // Set between replace_which_way() and the access_update() for the fill.
+    bool filling_ = false;
+    // A fixed-seed xorshift generator for choosing which bimodal insertions are
+    // long rather than distant, so that runs are reproducible.  A plain counter
+    // would alias with regular access patterns and always pick the same sets.
+    uint32_t bimodal_random_ = 2463534242U;
+    // For DRRIP: every dueling_stride_'th set is a leader that always uses static
+    // insertion, the set after each of those always uses bimodal insertion, and
+    // the policy selector psel_ moves toward whichever leader group misses less.
+    int dueling_stride_ = 0;
+    int psel_ = 0;
+};
+
+#endif /* _CACHE_RRIP_H_ */
@@ -0,0 +1,121 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "cache_ship.h"
+
+// The signature history counter table has 16K 3-bit counters.
+static const int SHIP_SIGNATURE_BITS = 14;
+static const uint8_t SHIP_COUNTER_MAX = 7;
+
+cache_ship_t::cache_ship_t()
+    : cache_rrip_t(RRIP_INSERT_STATIC)
+{
+}
+
+bool
+cache_ship_t::init(int associativity, int block_size, int total_size,
+                   caching_device_t *parent, caching_device_stats_t *stats,
+                   prefetcher_t *prefetcher, bool inclusive, bool coherent_cache, int id,
+                   snoop_filter_t *snoop_filter,
+                   const std::vector<caching_device_t *> &children)
+{
+    if (!cache_rrip_t::init(associativity, block_size, total_size, parent, stats,
+                            prefetcher, inclusive, coherent_cache, id, snoop_filter,
+                            children))
+        return false;
+    block_signatures_.assign(num_blocks_, 0);
+    block_reused_.assign(num_blocks_, false);
+    // Start out weakly predicting reuse, so the first fills behave like SRRIP.
+    shct_.assign(1 << SHIP_SIGNATURE_BITS, 1);
+    return true;
+}
+
+void
+cache_ship_t::request(const memref_t &memref)
+{
+    addr_t pc = type_is_instr(memref.instr.type) ? memref.instr.addr : memref.data.pc;
+    signature_ = static_cast<uint16_t>((pc ^ (pc >> SHIP_SIGNATURE_BITS)) &
+                                       ((1 << SHIP_SIGNATURE_BITS) - 1));
+    cache_rrip_t::request(memref);
+}
+
+int
+cache_ship_t::insertion_rrpv(int block_idx, int way)
+{
+    block_signatures_[block_idx + way] = signature_;
+    block_reused_[block_idx + way] = false;
+    return shct_[signature_] == 0 ? RRIP_MAX_RRPV : RRIP_MAX_RRPV - 1;
+}
+
+void
+cache_ship_t::access_update(int block_idx, int way)
+{
+    // We train on the first re-reference only, so a burst of hits to one block
+    // does not saturate its signature's counter.
+    if (!filling_ && !block_reused_[block_idx + way]) {
+        uint8_t &counter = shct_[block_signatures_[block_idx + way]];
+        if (counter < SHIP_COUNTER_MAX)
+            ++counter;
+        block_reused_[block_idx + way] = true;
+    }
+    cache_rrip_t::access_update(block_idx, way);
+}
+
+int
+cache_ship_t::replace_which_way(int block_idx)
+{
+    int victim = cache_rrip_t::replace_which_way(block_idx);
+    if (tags_[block_idx + victim] != TAG_INVALID && !block_reused_[block_idx + victim]) {
+        uint8_t &counter = shct_[block_signatures_[block_idx + victim]];
+        if (counter > 0)
+            --counter;
+    }
+    return victim;
+}
+
+void
+cache_ship_t::save(checkpoint_writer_t &out) const
+{
+    cache_rrip_t::save(out);
+    out.write_vector(block_signatures_);
+    out.write_vector(block_reused_);
+    out.write_vector(shct_);
+}
+
+bool
+cache_ship_t::restore(checkpoint_reader_t &in)
+{
+    return cache_rrip_t::restore(in) &&
+        in.read_vector(&block_signatures_, block_signatures_.size()) &&
+        in.read_vector(&block_reused_, block_reused_.size()) &&
+        in.read_vector(&shct_, shct_.size());
+}
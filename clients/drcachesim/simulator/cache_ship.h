@@ -0,0 +1,82 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+/* cache_ship: represents a single hardware cache with signature-based hit
+ * prediction (SHiP) on top of RRIP replacement.
+ */
+
+#ifndef _CACHE_SHIP_H_
+#define _CACHE_SHIP_H_ 1
+
+#include <stdint.h>
+#include <vector>
+#include "cache_rrip.h"
+
+// SHiP-PC: each block remembers a signature of the PC that filled it and
+// whether it has been re-referenced since.  A table of saturating counters
+// indexed by signature is incremented on a block's first hit and decremented when
+// a block is evicted without having been re-referenced.  A fill whose signature's
+// counter is zero is predicted to be dead and inserted with a distant RRPV;
+// otherwise it gets SRRIP's long RRPV.
+class cache_ship_t : public cache_rrip_t {
+public:
+    cache_ship_t();
+    bool
+    init(int associativity, int line_size, int total_size, caching_device_t *parent,
+         caching_device_stats_t *stats, prefetcher_t *prefetcher, bool inclusive = false,
+         bool coherent_cache = false, int id_ = -1,
+         snoop_filter_t *snoop_filter_ = nullptr,
+         const std::vector<caching_device_t *> &children = {}) override;
+    void
+    save(checkpoint_writer_t &out) const override;
+    bool
+    restore(checkpoint_reader_t &in) override;
+    void
+    request(const memref_t &memref) override;
+
+protected:
+    void
+    access_update(int block_idx, int way) override;
+    int
+    replace_which_way(int block_idx) override;
+    int
+    insertion_rrpv(int block_idx, int way) override;
+
+    // The signature of the request being simulated.
+    uint16_t signature_ = 0;
+    // Per block, the signature it was filled with and whether it was re-referenced.
+    std::vector<uint16_t> block_signatures_;
+    std::vector<bool> block_reused_;
+    // The signature history counter table.
+    std::vector<uint8_t> shct_;
+};
+
+#endif /* _CACHE_SHIP_H_ */
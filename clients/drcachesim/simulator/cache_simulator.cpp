@@ -33,6 +33,7 @@
 #include <iostream>
 #include <iterator>
 #include <string>
+#include <unordered_set>
 #include <assert.h>
 #include <limits.h>
 #include <stdint.h> /* for supporting 64-bit integers*/
@@ -46,7 +47,13 @@
 #include "cache.h"
 #include "cache_lru.h"
 #include "cache_fifo.h"
+#include "cache_plru.h"
+#include "cache_rrip.h"
+#include "cache_ship.h"
+#include "prefetcher_stride.h"
+#include "prefetcher_stream.h"
 #include "cache_simulator.h"
+#include "checkpoint.h"
 #include "droption.h"
 
 #include "snoop_filter.h"
@@ -95,6 +102,8 @@ cache_simulator_t::cache_simulator_t(const cache_simulator_knobs_t &knobs)
     llcaches_[cache_name] = llc;
 
     if (knobs_.data_prefetcher != PREFETCH_POLICY_NEXTLINE &&
+        knobs_.data_prefetcher != PREFETCH_POLICY_STRIDE &&
+        knobs_.data_prefetcher != PREFETCH_POLICY_STREAM &&
         knobs_.data_prefetcher != PREFETCH_POLICY_NONE) {
         // Unknown value.
         error_string_ = " unknown data_prefetcher: '" + knobs_.data_prefetcher + "'";
@@ -114,6 +123,7 @@ cache_simulator_t::cache_simulator_t(const cache_simulator_knobs_t &knobs)
         success_ = false;
         return;
     }
+    llc->set_timing(knobs_.LL_latency, knobs_.LL_mshrs, knobs_.memory_bandwidth);
 
     l1_icaches_ = new cache_t *[knobs_.num_cores];
     l1_dcaches_ = new cache_t *[knobs_.num_cores];
@@ -149,9 +159,7 @@ cache_simulator_t::cache_simulator_t(const cache_simulator_knobs_t &knobs)
                 knobs_.L1D_assoc, (int)knobs_.line_size, (int)knobs_.L1D_size, llc,
                 new cache_stats_t((int)knobs_.line_size, "", warmup_enabled_,
                                   knobs_.model_coherence),
-                knobs_.data_prefetcher == PREFETCH_POLICY_NEXTLINE
-                    ? new prefetcher_t((int)knobs_.line_size)
-                    : nullptr,
+                create_prefetcher(knobs_.data_prefetcher),
                 false /*inclusive*/, knobs_.model_coherence, (2 * i) + 1,
                 snoop_filter_)) {
             error_string_ = "Usage error: failed to initialize L1 caches.  Ensure sizes "
@@ -161,6 +169,9 @@ cache_simulator_t::cache_simulator_t(const cache_simulator_knobs_t &knobs)
             return;
         }
 
+        l1_icaches_[i]->set_timing(knobs_.L1_latency, knobs_.L1_mshrs, 0.0);
+        l1_dcaches_[i]->set_timing(knobs_.L1_latency, knobs_.L1_mshrs, 0.0);
+
         cache_name = "L1_I_Cache_" + std::to_string(i);
         all_caches_[cache_name] = l1_icaches_[i];
         cache_name = "L1_D_Cache_" + std::to_string(i);
@@ -168,11 +179,28 @@ cache_simulator_t::cache_simulator_t(const cache_simulator_knobs_t &knobs)
     }
 
     if (knobs_.model_coherence &&
-        !snoop_filter_->init(snooped_caches_, total_snooped_caches)) {
+        !snoop_filter_->init(snooped_caches_, total_snooped_caches,
+                             knobs_.snoop_filter_size)) {
         ERRMSG("Usage error: failed to initialize snoop filter.\n");
         success_ = false;
         return;
     }
+    if (!knobs_.restore_checkpoint.empty() && !restore_checkpoint()) {
+        success_ = false;
+        return;
+    }
+    if (knobs_.pipeline_workers > 0 && !init_pipeline()) {
+        success_ = false;
+        return;
+    }
+    if (knobs_.sample_period > 0 && !init_sampling()) {
+        success_ = false;
+        return;
+    }
+    if (knobs_.model_timing && !init_timing()) {
+        success_ = false;
+        return;
+    }
 }
 
 cache_simulator_t::cache_simulator_t(std::istream *config_file)
@@ -196,6 +224,8 @@ cache_simulator_t::cache_simulator_t(std::istream *config_file)
                knobs_.use_physical, knobs_.verbose);
 
     if (knobs_.data_prefetcher != PREFETCH_POLICY_NEXTLINE &&
+        knobs_.data_prefetcher != PREFETCH_POLICY_STRIDE &&
+        knobs_.data_prefetcher != PREFETCH_POLICY_STREAM &&
         knobs_.data_prefetcher != PREFETCH_POLICY_NONE) {
         // Unknown prefetcher type.
         success_ = false;
@@ -319,15 +349,15 @@ cache_simulator_t::cache_simulator_t(std::istream *config_file)
                          (int)cache_config.size, parent_,
                          new cache_stats_t((int)knobs_.line_size, cache_config.miss_file,
                                            warmup_enabled_, is_coherent_),
-                         cache_config.prefetcher == PREFETCH_POLICY_NEXTLINE
-                             ? new prefetcher_t((int)knobs_.line_size)
-                             : nullptr,
+                         create_prefetcher(cache_config.prefetcher),
                          cache_config.inclusive, is_coherent_, is_snooped ? snoop_id : -1,
                          is_snooped ? snoop_filter_ : nullptr, children)) {
             error_string_ = "Usage error: failed to initialize the cache " + cache_name;
             success_ = false;
             return;
         }
+        cache->set_timing(cache_config.latency, cache_config.mshrs,
+                          cache_config.bandwidth);
 
         // Next snooped cache should have a different ID.
         if (is_snooped) {
@@ -361,7 +391,8 @@ cache_simulator_t::cache_simulator_t(std::istream *config_file)
             other_caches_[cache_name] = cache;
         }
     }
-    if (knobs_.model_coherence && !snoop_filter_->init(snooped_caches_, snoop_id)) {
+    if (knobs_.model_coherence &&
+        !snoop_filter_->init(snooped_caches_, snoop_id, knobs_.snoop_filter_size)) {
         ERRMSG("Usage error: failed to initialize snoop filter.\n");
         success_ = false;
         return;
@@ -375,10 +406,98 @@ cache_simulator_t::cache_simulator_t(std::istream *config_file)
             cache.second->set_hashtable_use(true);
         }
     }
+    if (!knobs_.restore_checkpoint.empty() && !restore_checkpoint()) {
+        success_ = false;
+        return;
+    }
+    if (knobs_.pipeline_workers > 0 && !init_pipeline()) {
+        success_ = false;
+        return;
+    }
+    if (knobs_.sample_period > 0 && !init_sampling()) {
+        success_ = false;
+        return;
+    }
+    if (knobs_.model_timing && !init_timing()) {
+        success_ = false;
+        return;
+    }
+}
+
+bool
+cache_simulator_t::init_pipeline()
+{
+    // The L1 caches can only run ahead of the rest of the hierarchy if nothing
+    // above them ever reaches back down into them, and if nothing we decide on
+    // the fly depends on the state of the upper levels.
+    if (knobs_.model_coherence) {
+        error_string_ = "Usage error: pipeline_workers does not support coherence";
+        return false;
+    }
+    if (knobs_.warmup_fraction > 0.0) {
+        error_string_ = "Usage error: pipeline_workers does not support warmup_fraction";
+        return false;
+    }
+    std::unordered_set<caching_device_t *> l1_caches;
+    for (unsigned int i = 0; i < knobs_.num_cores; i++) {
+        l1_caches.insert(l1_icaches_[i]);
+        l1_caches.insert(l1_dcaches_[i]);
+    }
+    for (caching_device_t *cache : l1_caches) {
+        if (l1_caches.find(cache->get_parent()) != l1_caches.end()) {
+            error_string_ =
+                "Usage error: pipeline_workers requires the L1 caches' parents "
+                "to not be L1 caches";
+            return false;
+        }
+    }
+    // An inclusive L1 has no children to invalidate.
+    for (auto &cache_it : all_caches_) {
+        if (cache_it.second->is_inclusive() &&
+            l1_caches.find(cache_it.second) == l1_caches.end()) {
+            error_string_ =
+                "Usage error: pipeline_workers does not support inclusive caches "
+                "above the L1 caches";
+            return false;
+        }
+    }
+    pipeline_ = new cache_pipeline_t;
+    if (!pipeline_->init(l1_icaches_, l1_dcaches_, knobs_.num_cores,
+                         knobs_.pipeline_workers)) {
+        error_string_ = "Failed to initialize the cache pipeline";
+        return false;
+    }
+    return true;
+}
+
+bool
+cache_simulator_t::init_timing()
+{
+    // The model follows each request up the hierarchy as soon as it is made,
+    // and keeps one count of cycles for the whole simulation.
+    if (pipeline_ != nullptr) {
+        error_string_ = "Usage error: model_timing does not support pipeline_workers";
+        return false;
+    }
+    if (knobs_.sample_period > 0) {
+        error_string_ = "Usage error: model_timing does not support sampling";
+        return false;
+    }
+    timing_ = new timing_model_t(knobs_.rob_size, knobs_.dispatch_width,
+                                 knobs_.memory_latency);
+    if (!timing_->init(l1_icaches_, l1_dcaches_, knobs_.num_cores)) {
+        error_string_ = "Usage error: failed to initialize the timing model.  Ensure "
+                        "rob_size and dispatch_width are non-zero.";
+        return false;
+    }
+    return true;
 }
 
 cache_simulator_t::~cache_simulator_t()
 {
+    delete timing_;
+    // This hands the L1 caches back their real parents.
+    delete pipeline_;
     for (auto &caches_it : all_caches_) {
         cache_t *cache = caches_it.second;
         delete cache->get_stats();
@@ -400,6 +519,175 @@ cache_simulator_t::~cache_simulator_t()
     }
 }
 
+bool
+cache_simulator_t::init_sampling()
+{
+    if (knobs_.sample_measure_refs == 0 ||
+        knobs_.sample_warmup_refs + knobs_.sample_measure_refs > knobs_.sample_period) {
+        error_string_ = "Usage error: sampling requires a non-zero sample_measure_refs "
+                        "and sample_warmup_refs plus sample_measure_refs to be at most "
+                        "sample_period";
+        return false;
+    }
+    if (knobs_.warmup_refs > 0 || knobs_.warmup_fraction > 0.0) {
+        error_string_ = "Usage error: sampling does not support warmup_refs or "
+                        "warmup_fraction; use sample_warmup_refs instead";
+        return false;
+    }
+    if (!knobs_.save_checkpoint.empty() || !knobs_.restore_checkpoint.empty()) {
+        error_string_ = "Usage error: sampling does not support checkpoints";
+        return false;
+    }
+    return true;
+}
+
+bool
+cache_simulator_t::advance_sampling(const memref_t &memref)
+{
+    if (sampling_finished_)
+        return false;
+    uint64_t pos = sample_pos_;
+    if (++sample_pos_ == knobs_.sample_period)
+        sample_pos_ = 0;
+    uint64_t measure_start = knobs_.sample_period - knobs_.sample_measure_refs;
+    uint64_t warmup_start = measure_start - knobs_.sample_warmup_refs;
+    if (pos == 0 && sample_unit_open_)
+        end_sample_unit();
+    if (pos < warmup_start) {
+        // Drop accesses, but keep following markers and thread exits so that
+        // threads are scheduled onto the same cores as in a full simulation.
+        return memref.marker.type == TRACE_TYPE_MARKER ||
+            memref.exit.type == TRACE_TYPE_THREAD_EXIT;
+    }
+    if (pos == measure_start) {
+        if (pipeline_ != nullptr)
+            pipeline_->drain();
+        for (auto &cache_it : all_caches_)
+            cache_it.second->get_stats()->reset();
+        sample_unit_open_ = true;
+    }
+    return true;
+}
+
+void
+cache_simulator_t::end_sample_unit()
+{
+    if (pipeline_ != nullptr)
+        pipeline_->drain();
+    for (auto &cache_it : all_caches_)
+        cache_it.second->get_stats()->end_sample();
+    sample_unit_open_ = false;
+    num_sample_units_++;
+}
+
+bool
+cache_simulator_t::keep_open_sample_unit() const
+{
+    // A unit cut short by the end of the trace is dropped unless it is the only
+    // one, as its references are not a systematic sample.
+    return sample_unit_open_ && (sample_pos_ == 0 || num_sample_units_ == 0);
+}
+
+void
+cache_simulator_t::finish_sampling()
+{
+    if (knobs_.sample_period == 0 || sampling_finished_)
+        return;
+    if (keep_open_sample_unit())
+        end_sample_unit();
+    if (pipeline_ != nullptr)
+        pipeline_->drain();
+    for (auto &cache_it : all_caches_)
+        cache_it.second->get_stats()->finish_sampling();
+    sampling_finished_ = true;
+}
+
+static const char CHECKPOINT_MAGIC[] = "drcachesim checkpoint";
+static const int CHECKPOINT_VERSION = 1;
+
+bool
+cache_simulator_t::save_checkpoint()
+{
+    std::ofstream file(knobs_.save_checkpoint, std::ios::binary);
+    checkpoint_writer_t out(&file);
+    out.write_string(CHECKPOINT_MAGIC);
+    out.write(CHECKPOINT_VERSION);
+    out.write(knobs_.num_cores);
+    out.write(knobs_.line_size);
+    out.write(refs_seen_);
+    out.write(is_warmed_up_);
+    out.write(knobs_.warmup_refs);
+    save_scheduling(out);
+    out.write(snoop_filter_ != nullptr);
+    if (snoop_filter_ != nullptr)
+        snoop_filter_->save(out);
+    out.write(all_caches_.size());
+    for (const auto &cache_it : all_caches_) {
+        out.write_string(cache_it.first);
+        cache_it.second->save(out);
+        cache_it.second->get_stats()->save(out);
+    }
+    file.flush();
+    if (!out.ok()) {
+        error_string_ = "Failed to write checkpoint " + knobs_.save_checkpoint;
+        return false;
+    }
+    checkpoint_saved_ = true;
+    if (knobs_.verbose >= 1)
+        std::cerr << "Wrote checkpoint after " << refs_seen_ << " references\n";
+    return true;
+}
+
+bool
+cache_simulator_t::restore_checkpoint()
+{
+    std::ifstream file(knobs_.restore_checkpoint, std::ios::binary);
+    if (!file.good()) {
+        error_string_ = "Failed to open checkpoint " + knobs_.restore_checkpoint;
+        return false;
+    }
+    checkpoint_reader_t in(&file);
+    std::string magic;
+    int version;
+    unsigned int num_cores, line_size;
+    uint64_t refs_seen, warmup_refs;
+    bool warmed_up, has_snoop_filter;
+    size_t num_caches;
+    error_string_ = "Checkpoint " + knobs_.restore_checkpoint +
+        " is corrupt or does not match this cache hierarchy";
+    if (!in.read_string(&magic) || magic != CHECKPOINT_MAGIC || !in.read(&version) ||
+        version != CHECKPOINT_VERSION || !in.read(&num_cores) ||
+        num_cores != knobs_.num_cores || !in.read(&line_size) ||
+        line_size != knobs_.line_size || !in.read(&refs_seen) || !in.read(&warmed_up) ||
+        !in.read(&warmup_refs) || !restore_scheduling(in) ||
+        !in.read(&has_snoop_filter) || has_snoop_filter != (snoop_filter_ != nullptr) ||
+        (has_snoop_filter && !snoop_filter_->restore(in)) || !in.read(&num_caches) ||
+        num_caches != all_caches_.size())
+        return false;
+    for (size_t i = 0; i < num_caches; ++i) {
+        std::string name;
+        if (!in.read_string(&name))
+            return false;
+        auto cache_it = all_caches_.find(name);
+        if (cache_it == all_caches_.end()) {
+            error_string_ = "Checkpoint " + knobs_.restore_checkpoint +
+                " has no cache named " + name;
+            return false;
+        }
+        if (!cache_it->second->restore(in) || !cache_it->second->get_stats()->restore(in))
+            return false;
+    }
+    error_string_.clear();
+    // Fast-forward to where the checkpoint was taken, and carry on with its
+    // warmup, if it had not finished.
+    knobs_.skip_refs = refs_seen;
+    is_warmed_up_ = warmed_up;
+    knobs_.warmup_refs = warmup_refs;
+    if (warmed_up)
+        knobs_.warmup_fraction = 0.0;
+    return true;
+}
+
 uint64_t
 cache_simulator_t::remaining_sim_refs() const
 {
@@ -411,9 +699,13 @@ cache_simulator_t::process_memref(const memref_t &memref)
 {
     if (knobs_.skip_refs > 0) {
         knobs_.skip_refs--;
+        refs_seen_++;
         return true;
     }
 
+    if (knobs_.sample_period > 0 && !advance_sampling(memref))
+        return true;
+
     // If no warmup is specified and we have simulated sim_refs then
     // we are done.
     if ((knobs_.warmup_refs == 0 && knobs_.warmup_fraction == 0.0) &&
@@ -425,6 +717,7 @@ cache_simulator_t::process_memref(const memref_t &memref)
         return true;
 
     // Both warmup and simulated references are simulated.
+    refs_seen_++;
 
     if (!simulator_t::process_memref(memref))
         return false;
@@ -466,7 +759,12 @@ cache_simulator_t::process_memref(const memref_t &memref)
                       << " @" << (void *)simref->instr.addr << " instr x"
                       << simref->instr.size << "\n";
         }
-        l1_icaches_[core]->request(*simref);
+        if (pipeline_ != nullptr)
+            pipeline_->request(core, true /*instr*/, *simref);
+        else
+            l1_icaches_[core]->request(*simref);
+        if (timing_ != nullptr)
+            timing_->access(core, *simref, true /*instr*/);
     } else if (simref->data.type == TRACE_TYPE_READ ||
                simref->data.type == TRACE_TYPE_WRITE ||
                // We may potentially handle prefetches differently.
@@ -478,21 +776,32 @@ cache_simulator_t::process_memref(const memref_t &memref)
                       << trace_type_names[simref->data.type] << " "
                       << (void *)simref->data.addr << " x" << simref->data.size << "\n";
         }
-        l1_dcaches_[core]->request(*simref);
+        if (pipeline_ != nullptr)
+            pipeline_->request(core, false /*instr*/, *simref);
+        else
+            l1_dcaches_[core]->request(*simref);
+        if (timing_ != nullptr)
+            timing_->access(core, *simref, false /*instr*/);
     } else if (simref->flush.type == TRACE_TYPE_INSTR_FLUSH) {
         if (knobs_.verbose >= 3) {
             std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
                       << " @" << (void *)simref->data.pc << " iflush "
                       << (void *)simref->data.addr << " x" << simref->data.size << "\n";
         }
-        l1_icaches_[core]->flush(*simref);
+        if (pipeline_ != nullptr)
+            pipeline_->flush(core, true /*instr*/, *simref);
+        else
+            l1_icaches_[core]->flush(*simref);
     } else if (simref->flush.type == TRACE_TYPE_DATA_FLUSH) {
         if (knobs_.verbose >= 3) {
             std::cerr << "::" << simref->data.pid << "." << simref->data.tid << ":: "
                       << " @" << (void *)simref->data.pc << " dflush "
                       << (void *)simref->data.addr << " x" << simref->data.size << "\n";
         }
-        l1_dcaches_[core]->flush(*simref);
+        if (pipeline_ != nullptr)
+            pipeline_->flush(core, false /*instr*/, *simref);
+        else
+            l1_dcaches_[core]->flush(*simref);
     } else if (simref->exit.type == TRACE_TYPE_THREAD_EXIT) {
         handle_thread_exit(simref->exit.tid);
         last_thread_ = 0;
@@ -513,13 +822,19 @@ cache_simulator_t::process_memref(const memref_t &memref)
 
     // reset cache stats when warming up is completed
     if (!is_warmed_up_ && check_warmed_up()) {
+        if (pipeline_ != nullptr)
+            pipeline_->drain();
         for (auto &cache_it : all_caches_) {
             cache_t *cache = cache_it.second;
             cache->get_stats()->reset();
         }
+        if (timing_ != nullptr)
+            timing_->reset();
         if (knobs_.verbose >= 1) {
             std::cerr << "Cache simulation warmed up\n";
         }
+        if (!knobs_.save_checkpoint.empty() && !save_checkpoint())
+            return false;
     } else {
         knobs_.sim_refs--;
     }
@@ -571,6 +886,12 @@ cache_simulator_t::check_warmed_up()
 bool
 cache_simulator_t::print_results()
 {
+    if (pipeline_ != nullptr)
+        pipeline_->drain();
+    finish_sampling();
+    // Without a warmup to checkpoint after, we checkpoint the end of the run.
+    if (!knobs_.save_checkpoint.empty() && !checkpoint_saved_ && !save_checkpoint())
+        return false;
     std::cerr << "Cache simulation results:\n";
     // Print core and associated L1 cache stats first.
     for (unsigned int i = 0; i < knobs_.num_cores; i++) {
@@ -585,6 +906,10 @@ cache_simulator_t::print_results()
                 std::cerr << "  unified L1 stats:" << std::endl;
                 l1_icaches_[i]->get_stats()->print_stats("    ");
             }
+            if (timing_ != nullptr) {
+                std::cerr << "  Timing stats:" << std::endl;
+                timing_->print_stats(i, "    ");
+            }
         }
     }
 
@@ -625,8 +950,12 @@ cache_simulator_t::get_cache_metric(metric_name_t metric, unsigned level, unsign
         curr_cache = l1_icaches_[core];
     }
 
+    if (pipeline_ != nullptr)
+        pipeline_->drain();
     for (size_t i = 1; i < level; i++) {
         caching_device_t *parent = curr_cache->get_parent();
+        if (i == 1 && pipeline_ != nullptr)
+            parent = pipeline_->get_parent(curr_cache);
 
         if (parent == NULL) {
             return STATS_ERROR_WRONG_CACHE_LEVEL;
@@ -639,6 +968,10 @@ cache_simulator_t::get_cache_metric(metric_name_t metric, unsigned level, unsign
         return STATS_ERROR_NO_CACHE_STATS;
     }
 
+    // Sampling may continue after this query, so we sum the units without
+    // finishing it.
+    if (knobs_.sample_period > 0 && !sampling_finished_)
+        return stats->get_sampled_metric(metric, keep_open_sample_unit());
     return stats->get_metric(metric);
 }
 
@@ -658,9 +991,34 @@ cache_simulator_t::create_cache(const std::string &policy)
         return new cache_t;
     if (policy == REPLACE_POLICY_FIFO) // set to FIFO
         return new cache_fifo_t;
+    if (policy == REPLACE_POLICY_PLRU)
+        return new cache_plru_t;
+    if (policy == REPLACE_POLICY_SRRIP)
+        return new cache_rrip_t(RRIP_INSERT_STATIC);
+    if (policy == REPLACE_POLICY_BRRIP)
+        return new cache_rrip_t(RRIP_INSERT_BIMODAL);
+    if (policy == REPLACE_POLICY_DRRIP)
+        return new cache_rrip_t(RRIP_INSERT_DYNAMIC);
+    if (policy == REPLACE_POLICY_SHIP)
+        return new cache_ship_t;
 
     // undefined replacement policy
     ERRMSG("Usage error: undefined replacement policy. "
-           "Please choose " REPLACE_POLICY_LRU " or " REPLACE_POLICY_LFU ".\n");
+           "Please choose " REPLACE_POLICY_LRU ", " REPLACE_POLICY_LFU
+           ", " REPLACE_POLICY_FIFO ", " REPLACE_POLICY_PLRU ", " REPLACE_POLICY_SRRIP
+           ", " REPLACE_POLICY_BRRIP ", " REPLACE_POLICY_DRRIP
+           " or " REPLACE_POLICY_SHIP ".\n");
     return NULL;
 }
+
+prefetcher_t *
+cache_simulator_t::create_prefetcher(const std::string &policy)
+{
+    if (policy == PREFETCH_POLICY_NEXTLINE)
+        return new prefetcher_t((int)knobs_.line_size);
+    if (policy == PREFETCH_POLICY_STRIDE)
+        return new prefetcher_stride_t((int)knobs_.line_size);
+    if (policy == PREFETCH_POLICY_STREAM)
+        return new prefetcher_stream_t((int)knobs_.line_size);
+    return nullptr;
+}
@@ -41,7 +41,10 @@
 #include "cache_simulator_create.h"
 #include "cache_stats.h"
 #include "cache.h"
+#include "cache_pipeline.h"
+#include "prefetcher.h"
 #include "snoop_filter.h"
+#include "timing_model.h"
 #include <limits.h>
 
 enum class cache_split_t { DATA, INSTRUCTION };
@@ -74,6 +77,7 @@ public:
     bool
     print_results() override;
 
+    // With sampling, this returns the sum over the sampling units so far.
     int_least64_t
     get_cache_metric(metric_name_t metric, unsigned level, unsigned core = 0,
                      cache_split_t split = cache_split_t::DATA) const;
@@ -87,11 +91,23 @@ public:
     const cache_simulator_knobs_t &
     get_knobs() const;
 
+    // Returns nullptr unless knobs.model_timing is set.
+    const timing_model_t *
+    get_timing_model() const
+    {
+        return timing_;
+    }
+
 protected:
     // Create a cache_t object with a specific replacement policy.
     virtual cache_t *
     create_cache(const std::string &policy);
 
+    // Create a prefetcher_t object for a specific prefetcher policy.  Returns
+    // nullptr for PREFETCH_POLICY_NONE or an unknown policy.
+    virtual prefetcher_t *
+    create_prefetcher(const std::string &policy);
+
     cache_simulator_knobs_t knobs_;
 
     // Implement a set of ICaches and DCaches with pointer arrays.
@@ -112,8 +128,64 @@ protected:
     // Snoop filter tracks ownership of cache lines across private caches.
     snoop_filter_t *snoop_filter_ = nullptr;
 
+    // If knobs_.pipeline_workers is set, the L1 caches are simulated on their own
+    // threads and all requests go through here.
+    cache_pipeline_t *pipeline_ = nullptr;
+
+    // If knobs_.model_timing is set, this estimates the cycles each core takes.
+    timing_model_t *timing_ = nullptr;
+
 private:
+    // Starts the pipeline, returning false if the hierarchy does not support it.
+    bool
+    init_pipeline();
+
+    // Starts the timing model, returning false if the configuration does not
+    // support it.
+    bool
+    init_timing();
+
+    // Writes the state of the caches, their stats, the snoop filter and the
+    // thread scheduling to knobs_.save_checkpoint.
+    bool
+    save_checkpoint();
+    // Restores the state from knobs_.restore_checkpoint and arranges to skip the
+    // references the checkpointed simulation had consumed.
+    bool
+    restore_checkpoint();
+
+    // Checks the sampling knobs, returning false if they are inconsistent.
+    bool
+    init_sampling();
+    // Moves through the sampling period, starting and ending sampling units.
+    // Returns false if memref falls in the fast-forwarded part of the period and
+    // should be dropped.
+    bool
+    advance_sampling(const memref_t &memref);
+    void
+    end_sample_unit();
+    // Returns whether finish_sampling() would keep the open sampling unit.
+    bool
+    keep_open_sample_unit() const;
+    // Replaces the stats of each cache with their sums over the sampling units.
+    void
+    finish_sampling();
+
     bool is_warmed_up_;
+
+    // The references consumed so far, skipped or simulated, which is where a
+    // checkpoint resumes.
+    uint64_t refs_seen_ = 0;
+    bool checkpoint_saved_ = false;
+
+    // For sampled simulation, where each period of knobs_.sample_period
+    // references ends with a sampling unit of knobs_.sample_warmup_refs
+    // simulated but not measured references followed by knobs_.sample_measure_refs
+    // measured ones.  The rest of the period is dropped.
+    uint64_t sample_pos_ = 0;
+    bool sample_unit_open_ = false;
+    bool sampling_finished_ = false;
+    int_least64_t num_sample_units_ = 0;
 };
 
 #endif /* _CACHE_SIMULATOR_H_ */
@@ -36,6 +36,7 @@
 #define _CACHE_SIMULATOR_CREATE_H_ 1
 
 #include <string>
+#include <vector>
 #include "analysis_tool.h"
 
 /**
@@ -60,14 +61,30 @@ struct cache_simulator_knobs_t {
         , LL_assoc(16)
         , LL_miss_file("")
         , model_coherence(false)
+        , snoop_filter_size(0)
         , replace_policy("LRU")
         , data_prefetcher("nextline")
         , skip_refs(0)
         , warmup_refs(0)
         , warmup_fraction(0.0)
         , sim_refs(1ULL << 63)
+        , sample_period(0)
+        , sample_warmup_refs(0)
+        , sample_measure_refs(0)
         , cpu_scheduling(false)
         , use_physical(false)
+        , pipeline_workers(0)
+        , save_checkpoint("")
+        , restore_checkpoint("")
+        , model_timing(false)
+        , L1_latency(4)
+        , LL_latency(40)
+        , memory_latency(200)
+        , L1_mshrs(10)
+        , LL_mshrs(32)
+        , memory_bandwidth(16.0)
+        , rob_size(128)
+        , dispatch_width(4)
         , verbose(0)
     {
     }
@@ -81,14 +98,30 @@ struct cache_simulator_knobs_t {
     unsigned int LL_assoc;
     std::string LL_miss_file;
     bool model_coherence;
+    unsigned int snoop_filter_size;
     std::string replace_policy;
     std::string data_prefetcher;
     uint64_t skip_refs;
     uint64_t warmup_refs;
     double warmup_fraction;
     uint64_t sim_refs;
+    uint64_t sample_period;
+    uint64_t sample_warmup_refs;
+    uint64_t sample_measure_refs;
     bool cpu_scheduling;
     bool use_physical;
+    unsigned int pipeline_workers;
+    std::string save_checkpoint;
+    std::string restore_checkpoint;
+    bool model_timing;
+    unsigned int L1_latency;
+    unsigned int LL_latency;
+    unsigned int memory_latency;
+    unsigned int L1_mshrs;
+    unsigned int LL_mshrs;
+    double memory_bandwidth;
+    unsigned int rob_size;
+    unsigned int dispatch_width;
     unsigned int verbose;
 };
 
@@ -103,10 +136,26 @@ cache_simulator_create(const cache_simulator_knobs_t &knobs);
 analysis_tool_t *
 cache_simulator_create(const std::string &config_file);
 
-/** Creates an instance of a cache miss analyzer. */
+/**
+ * Creates a tool that simulates the cache hierarchies defined in each of the
+ * configuration files over the same single pass through the trace.  The
+ * simulators are divided among worker_count threads, or one per hardware thread
+ * if worker_count is negative.  With a worker_count of 0 or 1 they all run on the
+ * analyzer's thread.
+ */
+analysis_tool_t *
+cache_sweep_create(const std::vector<std::string> &config_files, int worker_count);
+
+/**
+ * Creates an instance of a cache miss analyzer.  Each load's miss strides are
+ * summarized in sketch_size counters.  If parallel_shards is set, each trace shard
+ * is simulated concurrently in a private single-core hierarchy and the shards'
+ * misses are merged.
+ */
 analysis_tool_t *
 cache_miss_analyzer_create(const cache_simulator_knobs_t &knobs,
                            unsigned int miss_count_threshold, double miss_frac_threshold,
-                           double confidence_threshold);
+                           double confidence_threshold, unsigned int sketch_size = 16,
+                           bool parallel_shards = false);
 
 #endif /* _CACHE_SIMULATOR_CREATE_H_ */
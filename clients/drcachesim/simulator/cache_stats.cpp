@@ -33,6 +33,7 @@
 #include <iostream>
 #include <iomanip>
 #include "cache_stats.h"
+#include "cache_line.h"
 
 cache_stats_t::cache_stats_t(int block_size, const std::string &miss_file,
                              bool warmup_enabled, bool is_coherent)
@@ -40,16 +41,35 @@ cache_stats_t::cache_stats_t(int block_size, const std::string &miss_file,
     , num_flushes_(0)
     , num_prefetch_hits_(0)
     , num_prefetch_misses_(0)
+    , num_prefetch_useful_(0)
+    , num_prefetch_unused_(0)
+    , prefetch_lead_total_(0)
+    , access_clock_(0)
 {
     stats_map_.emplace(metric_name_t::FLUSHES, num_flushes_);
     stats_map_.emplace(metric_name_t::PREFETCH_HITS, num_prefetch_hits_);
     stats_map_.emplace(metric_name_t::PREFETCH_MISSES, num_prefetch_misses_);
+    stats_map_.emplace(metric_name_t::PREFETCH_USEFUL, num_prefetch_useful_);
+    stats_map_.emplace(metric_name_t::PREFETCH_UNUSED, num_prefetch_unused_);
 }
 
 void
 cache_stats_t::access(const memref_t &memref, bool hit,
                       caching_device_block_t *cache_block)
 {
+    ++access_clock_;
+    // On a miss cache_block is the victim about to be replaced.
+    cache_line_t *line = static_cast<cache_line_t *>(cache_block);
+    if (!hit) {
+        if (line->prefetched_ && line->tag_ != TAG_INVALID)
+            num_prefetch_unused_++;
+        line->prefetched_ = memref.data.type == TRACE_TYPE_HARDWARE_PREFETCH;
+        line->prefetch_time_ = access_clock_;
+    } else if (line->prefetched_ && !type_is_prefetch(memref.data.type)) {
+        num_prefetch_useful_++;
+        prefetch_lead_total_ += access_clock_ - line->prefetch_time_;
+        line->prefetched_ = false;
+    }
     // handle prefetching requests
     if (type_is_prefetch(memref.data.type)) {
         if (hit)
@@ -88,6 +108,37 @@ cache_stats_t::print_counts(std::string prefix)
                   << "Prefetch misses:" << std::setw(20) << std::right
                   << num_prefetch_misses_ << std::endl;
     }
+    // Only hardware prefetches that missed bring in lines to evaluate.
+    int_least64_t fills = num_prefetch_useful_ + num_prefetch_unused_;
+    // Coverage is the fraction of would-be demand misses that prefetching removed.
+    // Prefetch requests are counted in num_prefetch_misses_ and never reach
+    // caching_device_stats_t::access(), so num_misses_ holds demand misses only.
+    int_least64_t demand_misses = num_misses_;
+    if (fills != 0) {
+        std::cerr << prefix << std::setw(18) << std::left
+                  << "Prefetch useful:" << std::setw(20) << std::right
+                  << num_prefetch_useful_ << std::endl;
+        std::cerr << prefix << std::setw(18) << std::left
+                  << "Prefetch unused:" << std::setw(20) << std::right
+                  << num_prefetch_unused_ << std::endl;
+        std::cerr << prefix << std::setw(18) << std::left
+                  << "Prefetch accuracy:" << std::setw(20) << std::fixed
+                  << std::setprecision(2) << std::right
+                  << ((float)num_prefetch_useful_ * 100 / fills) << "%" << std::endl;
+        std::cerr << prefix << std::setw(18) << std::left
+                  << "Prefetch coverage:" << std::setw(20) << std::fixed
+                  << std::setprecision(2) << std::right
+                  << ((float)num_prefetch_useful_ * 100 /
+                      (num_prefetch_useful_ + demand_misses))
+                  << "%" << std::endl;
+        if (num_prefetch_useful_ != 0) {
+            std::cerr << prefix << std::setw(18) << std::left
+                      << "Prefetch lead:" << std::setw(20) << std::fixed
+                      << std::setprecision(2) << std::right
+                      << ((double)prefetch_lead_total_ / num_prefetch_useful_)
+                      << " accesses" << std::endl;
+        }
+    }
 }
 
 void
@@ -97,4 +148,36 @@ cache_stats_t::reset()
     num_flushes_ = 0;
     num_prefetch_hits_ = 0;
     num_prefetch_misses_ = 0;
+    num_prefetch_useful_ = 0;
+    num_prefetch_unused_ = 0;
+    prefetch_lead_total_ = 0;
+}
+
+void
+cache_stats_t::end_sample()
+{
+    caching_device_stats_t::end_sample();
+    sampled_prefetch_lead_total_ += prefetch_lead_total_;
+}
+
+void
+cache_stats_t::finish_sampling()
+{
+    caching_device_stats_t::finish_sampling();
+    prefetch_lead_total_ = sampled_prefetch_lead_total_;
+}
+
+void
+cache_stats_t::save(checkpoint_writer_t &out) const
+{
+    caching_device_stats_t::save(out);
+    out.write(prefetch_lead_total_);
+    out.write(access_clock_);
+}
+
+bool
+cache_stats_t::restore(checkpoint_reader_t &in)
+{
+    return caching_device_stats_t::restore(in) && in.read(&prefetch_lead_total_) &&
+        in.read(&access_clock_);
 }
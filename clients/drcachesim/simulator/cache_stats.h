@@ -57,6 +57,17 @@ public:
     void
     reset() override;
 
+    void
+    end_sample() override;
+
+    void
+    save(checkpoint_writer_t &out) const override;
+    bool
+    restore(checkpoint_reader_t &in) override;
+
+    void
+    finish_sampling() override;
+
 protected:
     // In addition to caching_device_stats_t::print_counts,
     // cache_stats_t::print_counts prints stats for flushes and
@@ -69,6 +80,17 @@ protected:
     int_least64_t num_flushes_;
     int_least64_t num_prefetch_hits_;
     int_least64_t num_prefetch_misses_;
+
+    // Hardware prefetch effectiveness.  A hardware-prefetched line is useful
+    // if a demand access hits it before it is evicted and unused otherwise.
+    // Lead time, our timeliness measure, is the number of accesses to this
+    // cache between the prefetch and the first demand hit.
+    int_least64_t num_prefetch_useful_;
+    int_least64_t num_prefetch_unused_;
+    int_least64_t prefetch_lead_total_;
+    int_least64_t sampled_prefetch_lead_total_ = 0;
+    // Counts every access, for lead times.  Not reset.
+    int_least64_t access_clock_;
 };
 
 #endif /* _CACHE_STATS_H_ */
@@ -0,0 +1,249 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include "cache_sweep.h"
+#include "cache_simulator_create.h"
+#include "../common/utils.h"
+
+// The number of records handed to the workers at once.  This amortizes the
+// synchronization while keeping each batch small enough to stay in the cache
+// as every simulator walks it.
+static const size_t SWEEP_BATCH_SIZE = 4096;
+
+analysis_tool_t *
+cache_sweep_create(const std::vector<std::string> &config_files, int worker_count)
+{
+    return new cache_sweep_t(config_files, worker_count);
+}
+
+cache_sweep_t::cache_sweep_t(const std::vector<std::string> &config_files,
+                             int worker_count)
+    : config_files_(config_files)
+    , failed_(false)
+{
+    if (config_files_.empty()) {
+        error_string_ = "Usage error: no configuration files to sweep";
+        success_ = false;
+        return;
+    }
+    for (const std::string &file : config_files_) {
+        std::ifstream fin(file);
+        if (!fin.is_open()) {
+            error_string_ = "Failed to open the config file '" + file + "'";
+            success_ = false;
+            return;
+        }
+        cache_simulator_t *sim = new cache_simulator_t(&fin);
+        simulators_.push_back(sim);
+        if (!*sim) {
+            error_string_ = file + ": " + sim->get_error_string();
+            success_ = false;
+            return;
+        }
+    }
+    if (worker_count < 0)
+        worker_count = std::thread::hardware_concurrency();
+    size_t num_workers =
+        std::min(static_cast<size_t>(std::max(worker_count, 1)), simulators_.size());
+    workers_ = std::vector<worker_t>(num_workers);
+    for (size_t i = 0; i < simulators_.size(); ++i)
+        workers_[i % num_workers].configs.push_back(i);
+    buffers_[0].resize(SWEEP_BATCH_SIZE);
+    buffers_[1].resize(SWEEP_BATCH_SIZE);
+    if (workers_.size() > 1) {
+        for (worker_t &worker : workers_)
+            worker.thread = std::thread(&cache_sweep_t::worker_loop, this, &worker);
+    }
+}
+
+cache_sweep_t::~cache_sweep_t()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        exiting_ = true;
+    }
+    start_cond_.notify_all();
+    for (worker_t &worker : workers_) {
+        if (worker.thread.joinable())
+            worker.thread.join();
+    }
+    for (cache_simulator_t *sim : simulators_)
+        delete sim;
+}
+
+std::string
+cache_sweep_t::simulate(const std::vector<size_t> &configs, const memref_t *memrefs,
+                        size_t count)
+{
+    // We run each simulator over the whole batch in turn so its state stays hot.
+    for (size_t config : configs) {
+        // Once another worker has failed the results are discarded anyway.
+        if (failed_.load(std::memory_order_relaxed))
+            break;
+        cache_simulator_t *sim = simulators_[config];
+        for (size_t i = 0; i < count; ++i) {
+            if (!sim->process_memref(memrefs[i]))
+                return config_files_[config] + ": " + sim->get_error_string();
+        }
+    }
+    return "";
+}
+
+void
+cache_sweep_t::worker_loop(worker_t *worker)
+{
+    uint64_t seen = 0;
+    while (true) {
+        const memref_t *memrefs;
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cond_.wait(lock, [&] { return exiting_ || generation_ != seen; });
+            if (generation_ == seen)
+                return;
+            seen = generation_;
+            memrefs = buffers_[dispatched_].data();
+            count = dispatched_count_;
+        }
+        std::string error = simulate(worker->configs, memrefs, count);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!error.empty()) {
+                worker->error = error;
+                failed_.store(true, std::memory_order_relaxed);
+            }
+            if (--busy_workers_ == 0)
+                done_cond_.notify_one();
+        }
+    }
+}
+
+bool
+cache_sweep_t::wait_for_workers()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cond_.wait(lock, [this] { return busy_workers_ == 0; });
+    for (const worker_t &worker : workers_) {
+        if (!worker.error.empty()) {
+            error_string_ = worker.error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+cache_sweep_t::dispatch()
+{
+    if (pending_count_ == 0)
+        return true;
+    if (workers_.size() == 1) {
+        std::string error =
+            simulate(workers_[0].configs, buffers_[pending_].data(), pending_count_);
+        pending_count_ = 0;
+        if (!error.empty()) {
+            error_string_ = error;
+            return false;
+        }
+        return true;
+    }
+    if (failed_.load(std::memory_order_relaxed)) {
+        // Stop right away rather than handing off another batch.  We only wait
+        // for the other workers to abandon theirs so we can collect the error.
+        wait_for_workers();
+        return false;
+    }
+    if (!wait_for_workers())
+        return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        dispatched_ = pending_;
+        dispatched_count_ = pending_count_;
+        busy_workers_ = workers_.size();
+        ++generation_;
+    }
+    start_cond_.notify_all();
+    pending_ = 1 - pending_;
+    pending_count_ = 0;
+    return true;
+}
+
+bool
+cache_sweep_t::process_memref(const memref_t &memref)
+{
+    buffers_[pending_][pending_count_++] = memref;
+    if (pending_count_ == SWEEP_BATCH_SIZE)
+        return dispatch();
+    return true;
+}
+
+bool
+cache_sweep_t::process_memref_batch(const memref_t *memrefs, size_t count)
+{
+    if (workers_.size() == 1 && pending_count_ == 0) {
+        // There is no other thread to hand off to, so skip the copy.
+        std::string error = simulate(workers_[0].configs, memrefs, count);
+        if (!error.empty()) {
+            error_string_ = error;
+            return false;
+        }
+        return true;
+    }
+    while (count > 0) {
+        size_t num = std::min(count, SWEEP_BATCH_SIZE - pending_count_);
+        std::copy(memrefs, memrefs + num, buffers_[pending_].begin() + pending_count_);
+        pending_count_ += num;
+        memrefs += num;
+        count -= num;
+        if (pending_count_ == SWEEP_BATCH_SIZE && !dispatch())
+            return false;
+    }
+    return true;
+}
+
+bool
+cache_sweep_t::print_results()
+{
+    if (!dispatch() || !wait_for_workers()) {
+        std::cerr << "Cache sweep failed: " << error_string_ << "\n";
+        return false;
+    }
+    for (size_t i = 0; i < simulators_.size(); ++i) {
+        std::cerr << "Configuration #" << i << " (" << config_files_[i] << "):\n";
+        if (!simulators_[i]->print_results())
+            return false;
+    }
+    return true;
+}
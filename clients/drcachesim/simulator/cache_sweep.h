@@ -0,0 +1,117 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* cache_sweep: simulates several independent cache hierarchies over a single
+ * pass through the trace, so the cost of reading and decompressing the trace is
+ * paid only once for a whole design-space sweep.
+ */
+
+#ifndef _CACHE_SWEEP_H_
+#define _CACHE_SWEEP_H_ 1
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "analysis_tool.h"
+#include "cache_simulator.h"
+#include "memref.h"
+
+// The trace is read by the analyzer's single serial thread, which hands each
+// batch of records to a set of worker threads; each worker feeds the batch to
+// its share of the simulators.  Two batch buffers let the reading thread fill
+// one while the workers process the other.
+class cache_sweep_t : public analysis_tool_t {
+public:
+    // A negative worker count uses one worker per hardware thread.  With a
+    // single worker (or a count of 0) the simulators run on the calling thread.
+    cache_sweep_t(const std::vector<std::string> &config_files, int worker_count);
+    virtual ~cache_sweep_t();
+    bool
+    process_memref(const memref_t &memref) override;
+    bool
+    process_memref_batch(const memref_t *memrefs, size_t count) override;
+    bool
+    print_results() override;
+
+protected:
+    struct worker_t {
+        std::thread thread;
+        // The index into simulators_ of each configuration this worker simulates.
+        std::vector<size_t> configs;
+        std::string error;
+    };
+
+    // Hands the pending batch to the workers once they finish the prior one.
+    // Returns false without handing it off if a worker has failed.
+    bool
+    dispatch();
+    // Waits until the workers finish the dispatched batch.  Returns false if any
+    // simulator failed.
+    bool
+    wait_for_workers();
+    void
+    worker_loop(worker_t *worker);
+    // Feeds records to the simulators in configs, returning an error message on
+    // failure.
+    std::string
+    simulate(const std::vector<size_t> &configs, const memref_t *memrefs,
+             size_t count);
+
+    std::vector<std::string> config_files_;
+    std::vector<cache_simulator_t *> simulators_;
+    std::vector<worker_t> workers_;
+
+    std::vector<memref_t> buffers_[2];
+    // The buffer being filled, and the number of records in it.
+    int pending_ = 0;
+    size_t pending_count_ = 0;
+    // The buffer last handed to the workers, and its record count.
+    int dispatched_ = 0;
+    size_t dispatched_count_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable start_cond_;
+    std::condition_variable done_cond_;
+    // Incremented for each dispatched batch.
+    uint64_t generation_ = 0;
+    // How many workers have yet to finish the current batch.
+    size_t busy_workers_ = 0;
+    bool exiting_ = false;
+    // Set once any worker's simulator fails, so that the other workers abandon
+    // the current batch and no further batches are handed off.
+    std::atomic<bool> failed_;
+};
+
+#endif /* _CACHE_SWEEP_H_ */
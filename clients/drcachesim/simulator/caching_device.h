@@ -42,13 +42,19 @@
 
 #include "caching_device_block.h"
 #include "caching_device_stats.h"
+#include "checkpoint.h"
 #include "memref.h"
 #include "prefetcher.h"
 
 // Statistics collection is abstracted out into the caching_device_stats_t class.
 
 // Different replacement policies are expected to be implemented by
-// subclassing caching_device_t.
+// subclassing caching_device_t, or cache_t for caches, and overriding
+// access_update(), replace_which_way() and get_next_way_to_replace(), with any
+// per-set state kept in the subclass (see cache_plru_t and cache_rrip_t).  There
+// is no separate policy interface, so a policy is tied to the class it extends
+// (tlb_t cannot use the cache_t policies), and counters_ is allocated even for
+// policies such as tree-PLRU that do not use it.
 
 // We assume we're only invoked from a single thread of control and do
 // not need to synchronize data access.
@@ -69,6 +75,15 @@ public:
     request(const memref_t &memref);
     virtual void
     invalidate(addr_t tag, invalidation_type_t invalidation_type_);
+
+    // Writes the contents and replacement state of the device to a checkpoint.
+    // Subclasses with more state extend both of these.
+    virtual void
+    save(checkpoint_writer_t &out) const;
+    // Restores what save() wrote, returning false if the checkpoint is from a
+    // device of another kind or geometry.
+    virtual bool
+    restore(checkpoint_reader_t &in);
     bool
     contains_tag(addr_t tag);
     void
@@ -96,6 +111,55 @@ public:
     {
         return parent_;
     }
+    void
+    set_parent(caching_device_t *parent)
+    {
+        parent_ = parent;
+    }
+    bool
+    is_inclusive() const
+    {
+        return inclusive_;
+    }
+    int
+    get_block_size() const
+    {
+        return block_size_;
+    }
+    // Timing parameters, used only by timing_model_t: the cycles to look up
+    // this device, the number of misses it can have outstanding, and the bytes
+    // per cycle it can be filled at from its parent or memory.  A limit of 0
+    // means unlimited.
+    void
+    set_timing(int latency, int mshrs, double fill_bandwidth)
+    {
+        latency_ = latency;
+        mshrs_ = mshrs;
+        fill_bandwidth_ = fill_bandwidth;
+    }
+    int
+    get_latency() const
+    {
+        return latency_;
+    }
+    int
+    get_mshrs() const
+    {
+        return mshrs_;
+    }
+    double
+    get_fill_bandwidth() const
+    {
+        return fill_bandwidth_;
+    }
+    // The number of misses by demand (non-prefetch) requests so far.  Unlike the
+    // stats, this is never reset, so that the timing model can tell from its
+    // changes how far up the hierarchy each request went.
+    int_least64_t
+    get_num_demand_misses() const
+    {
+        return num_demand_misses_;
+    }
     inline double
     get_loaded_fraction() const
     {
@@ -151,26 +215,33 @@ protected:
     }
 
     inline void
-    invalidate_caching_device_block(caching_device_block_t *block)
+    invalidate_caching_device_block(int block_idx, int way)
     {
         if (use_tag2block_table_)
-            tag2block.erase(block->tag_);
-        block->tag_ = TAG_INVALID;
-        // Xref cache_block_t constructor about why we set counter to 0.
-        block->counter_ = 0;
+            tag2block.erase(tags_[block_idx + way]);
+        tags_[block_idx + way] = TAG_INVALID;
+        blocks_[block_idx + way]->tag_ = TAG_INVALID;
+        // Xref caching_device_t::init() about why we set counter to 0.
+        counters_[block_idx + way] = 0;
     }
 
     inline void
-    update_tag(caching_device_block_t *block, int way, addr_t new_tag)
+    update_tag(int block_idx, int way, addr_t new_tag)
     {
         if (use_tag2block_table_) {
-            if (block->tag_ != TAG_INVALID)
-                tag2block.erase(block->tag_);
-            tag2block[new_tag] = std::make_pair(block, way);
+            if (tags_[block_idx + way] != TAG_INVALID)
+                tag2block.erase(tags_[block_idx + way]);
+            tag2block[new_tag] = std::make_pair(blocks_[block_idx + way], way);
         }
-        block->tag_ = new_tag;
+        tags_[block_idx + way] = new_tag;
+        blocks_[block_idx + way]->tag_ = new_tag;
     }
 
+    // Returns the way in the set starting at block_idx whose tag equals `tag`,
+    // or -1 if there is no such way.
+    int
+    find_way(int block_idx, addr_t tag) const;
+
     // Returns the block (and its way) whose tag equals `tag`.
     // Returns <nullptr,0> if there is no such block.
     std::pair<caching_device_block_t *, int>
@@ -203,6 +274,14 @@ protected:
     // an extended block class which has its own member variables cannot be indexed
     // correctly by base class pointers.
     caching_device_block_t **blocks_;
+    // The per-block tags and replacement counters are kept in flat arrays indexed
+    // like blocks_ (block_idx + way) rather than inside the block objects.  The
+    // ways of a set are then contiguous, so find_way() can compare a whole set
+    // with a few vector instructions and the replacement policies scan counters
+    // without chasing a pointer per way.  Each block's tag_ mirrors tags_ for
+    // subclasses and stats that look at the block object.
+    std::vector<addr_t> tags_;
+    std::vector<int> counters_;
     int blocks_per_set_;
     // Optimization fields for fast bit operations
     int blocks_per_set_mask_;
@@ -226,6 +305,11 @@ protected:
                        std::function<unsigned long(addr_t)>>
         tag2block;
     bool use_tag2block_table_ = false;
+
+    int latency_ = 0;
+    int mshrs_ = 0;
+    double fill_bandwidth_ = 0.0;
+    int_least64_t num_demand_misses_ = 0;
 };
 
 #endif /* _CACHING_DEVICE_H_ */
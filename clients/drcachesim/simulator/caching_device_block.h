@@ -47,13 +47,8 @@ static const addr_t TAG_INVALID = (addr_t)-1; // block is invalid
 
 class caching_device_block_t {
 public:
-    // Initializing counter to 0 is just to be safe and to make it easier to write new
-    // replacement algorithms without errors (and we expect negligible perf cost), as
-    // we expect any use of counter to only occur *after* a valid tag is put in place,
-    // where for the current replacement code we also set the counter at that time.
     caching_device_block_t()
         : tag_(TAG_INVALID)
-        , counter_(0)
     {
     }
     // Destructor must be virtual and default is not.
@@ -61,12 +56,10 @@ public:
     {
     }
 
+    // A copy of caching_device_t::tags_ for this block, maintained by
+    // caching_device_t::update_tag() and invalidate_caching_device_block().
+    // The replacement counter lives only in caching_device_t::counters_.
     addr_t tag_;
-
-    // XXX: using int_least64_t here results in a ~4% slowdown for 32-bit apps.
-    // A 32-bit counter should be sufficient but we may want to revisit.
-    // We already have stdint.h so we can reinstate int_least64_t easily.
-    int counter_; // for use by replacement policies
 };
 
 #endif /* _CACHING_DEVICE_BLOCK_H_ */
@@ -33,6 +33,8 @@
 #include <assert.h>
 #include <iostream>
 #include <iomanip>
+#include <math.h>
+#include <sstream>
 #include "../common/options.h"
 #include "caching_device_stats.h"
 
@@ -223,6 +225,8 @@ caching_device_stats_t::print_stats(std::string prefix)
     print_counts(prefix);
     print_rates(prefix);
     print_child_stats(prefix);
+    if (num_sample_units_ > 0)
+        print_sampling(prefix);
     std::cerr.imbue(std::locale("C")); // Reset to avoid affecting later prints.
 }
 
@@ -240,6 +244,149 @@ caching_device_stats_t::reset()
     num_coherence_invalidates_ = 0;
 }
 
+void
+caching_device_stats_t::save(checkpoint_writer_t &out) const
+{
+    out.write(stats_map_.size());
+    for (const auto &stat : stats_map_)
+        out.write(stat.second);
+    access_count_.save(out);
+}
+
+bool
+caching_device_stats_t::restore(checkpoint_reader_t &in)
+{
+    size_t size;
+    if (!in.read(&size) || size != stats_map_.size())
+        return false;
+    for (auto &stat : stats_map_) {
+        if (!in.read(&stat.second))
+            return false;
+    }
+    return access_count_.restore(in);
+}
+
+static bool
+is_reset_metric(metric_name_t metric)
+{
+    return metric == metric_name_t::HITS_AT_RESET ||
+        metric == metric_name_t::MISSES_AT_RESET ||
+        metric == metric_name_t::CHILD_HITS_AT_RESET;
+}
+
+void
+caching_device_stats_t::end_sample()
+{
+    for (const auto &stat : stats_map_) {
+        if (!is_reset_metric(stat.first))
+            sample_values_[stat.first].push_back(stat.second);
+    }
+    num_sample_units_++;
+}
+
+void
+caching_device_stats_t::finish_sampling()
+{
+    for (auto &stat : stats_map_) {
+        if (is_reset_metric(stat.first))
+            continue;
+        int_least64_t total = 0;
+        for (int_least64_t value : sample_values_[stat.first])
+            total += value;
+        stat.second = total;
+    }
+}
+
+int_least64_t
+caching_device_stats_t::get_sampled_metric(metric_name_t metric,
+                                           bool include_current) const
+{
+    int_least64_t current = get_metric(metric);
+    if (is_reset_metric(metric))
+        return current;
+    int_least64_t total = include_current ? current : 0;
+    auto it = sample_values_.find(metric);
+    if (it != sample_values_.end()) {
+        for (int_least64_t value : it->second)
+            total += value;
+    }
+    return total;
+}
+
+// Returns the mean of values and, through half_width, the half-width of its 95%
+// confidence interval, using the normal approximation as SMARTS does.
+static double
+mean_and_interval(const std::vector<double> &values, double *half_width)
+{
+    double sum = 0;
+    for (double value : values)
+        sum += value;
+    double mean = sum / values.size();
+    *half_width = 0;
+    if (values.size() > 1) {
+        double squares = 0;
+        for (double value : values)
+            squares += (value - mean) * (value - mean);
+        double stddev = sqrt(squares / (values.size() - 1));
+        *half_width = 1.96 * stddev / sqrt((double)values.size());
+    }
+    return mean;
+}
+
+static std::string
+format_interval(double mean, double half_width, const char *suffix)
+{
+    std::ostringstream str;
+    str << std::fixed << std::setprecision(2) << mean << suffix << " +- " << half_width
+        << suffix;
+    return str.str();
+}
+
+void
+caching_device_stats_t::print_sampling(std::string prefix)
+{
+    static const std::map<metric_name_t, const char *> labels = {
+        { metric_name_t::HITS, "Hits/unit:" },
+        { metric_name_t::MISSES, "Misses/unit:" },
+        { metric_name_t::COMPULSORY_MISSES, "Compulsory/unit:" },
+        { metric_name_t::CHILD_HITS, "Child hits/unit:" },
+        { metric_name_t::INCLUSIVE_INVALIDATES, "Incl inval/unit:" },
+        { metric_name_t::COHERENCE_INVALIDATES, "Coh inval/unit:" },
+        { metric_name_t::PREFETCH_HITS, "Pf hits/unit:" },
+        { metric_name_t::PREFETCH_MISSES, "Pf misses/unit:" },
+        { metric_name_t::PREFETCH_USEFUL, "Pf useful/unit:" },
+        { metric_name_t::PREFETCH_UNUSED, "Pf unused/unit:" },
+        { metric_name_t::FLUSHES, "Flushes/unit:" },
+    };
+    std::cerr << prefix << std::setw(18) << std::left << "Sampling units:"
+              << std::setw(20) << std::right << num_sample_units_ << std::endl;
+    double half_width;
+    // The miss rate of each unit with any accesses.
+    std::vector<double> miss_rates;
+    const std::vector<int_least64_t> &hits = sample_values_[metric_name_t::HITS];
+    const std::vector<int_least64_t> &misses = sample_values_[metric_name_t::MISSES];
+    for (size_t i = 0; i < hits.size(); i++) {
+        if (hits[i] + misses[i] > 0)
+            miss_rates.push_back((double)misses[i] * 100 / (hits[i] + misses[i]));
+    }
+    if (!miss_rates.empty()) {
+        double mean = mean_and_interval(miss_rates, &half_width);
+        std::cerr << prefix << std::setw(18) << std::left << "Miss rate/unit:"
+                  << std::setw(20) << std::right << format_interval(mean, half_width, "%")
+                  << std::endl;
+    }
+    for (const auto &label : labels) {
+        auto it = sample_values_.find(label.first);
+        if (it == sample_values_.end() || stats_map_.at(label.first) == 0)
+            continue;
+        std::vector<double> values(it->second.begin(), it->second.end());
+        double mean = mean_and_interval(values, &half_width);
+        std::cerr << prefix << std::setw(18) << std::left << label.second
+                  << std::setw(20) << std::right << format_interval(mean, half_width, "")
+                  << std::endl;
+    }
+}
+
 void
 caching_device_stats_t::invalidate(invalidation_type_t invalidation_type)
 {
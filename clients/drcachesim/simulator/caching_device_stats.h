@@ -41,9 +41,11 @@
 #include <map>
 #include <stdint.h>
 #include <limits>
+#include <vector>
 #ifdef HAS_ZLIB
 #    include <zlib.h>
 #endif
+#include "checkpoint.h"
 #include "memref.h"
 
 enum invalidation_type_t {
@@ -63,6 +65,8 @@ enum class metric_name_t {
     COHERENCE_INVALIDATES,
     PREFETCH_HITS,
     PREFETCH_MISSES,
+    PREFETCH_USEFUL,
+    PREFETCH_UNUSED,
     FLUSHES
 };
 
@@ -141,6 +145,32 @@ public:
         }
     }
 
+    void
+    save(checkpoint_writer_t &out) const
+    {
+        out.write(bounds.size());
+        for (const auto &bound : bounds) {
+            out.write(bound.first);
+            out.write(bound.second);
+        }
+    }
+
+    bool
+    restore(checkpoint_reader_t &in)
+    {
+        bounds.clear();
+        size_t size;
+        if (!in.read(&size))
+            return false;
+        for (size_t i = 0; i < size; ++i) {
+            addr_t beg, end;
+            if (!in.read(&beg) || !in.read(&end))
+                return false;
+            bounds.emplace_hint(bounds.end(), beg, end);
+        }
+        return true;
+    }
+
 private:
     // Bounds are members of the std::map. The beginning of the bound is stored
     // as a key and the end as a value.
@@ -181,6 +211,38 @@ public:
     virtual void
     invalidate(invalidation_type_t invalidation_type);
 
+    // Writes the counts and the record of accessed lines to a checkpoint, and
+    // restores them.  Subclasses with more counts extend both of these.
+    virtual void
+    save(checkpoint_writer_t &out) const;
+    virtual bool
+    restore(checkpoint_reader_t &in);
+
+    // Credits this device with hits in a child that were counted elsewhere, such
+    // as by a stand-in parent on another thread.
+    void
+    add_child_hits(int_least64_t count)
+    {
+        num_child_hits_ += count;
+    }
+
+    // For sampled simulation: records the counts since the last reset() as one
+    // sampling unit.
+    virtual void
+    end_sample();
+
+    // Replaces the counts with their sums over all sampling units, so that they
+    // are printed and queried as though only the units had been simulated.
+    // print_stats() then adds confidence intervals for the per-unit values.
+    virtual void
+    finish_sampling();
+
+    // Returns what get_metric() would return after finish_sampling(), without
+    // changing any counts.  The counts since the last reset() are included as
+    // a unit if include_current is true.
+    int_least64_t
+    get_sampled_metric(metric_name_t metric, bool include_current) const;
+
     int_least64_t
     get_metric(metric_name_t metric) const
     {
@@ -204,6 +266,8 @@ protected:
     print_rates(std::string prefix); // hit/miss rates
     virtual void
     print_child_stats(std::string prefix); // child/total info
+    virtual void
+    print_sampling(std::string prefix); // per-unit confidence intervals
 
     virtual void
     dump_miss(const memref_t &memref);
@@ -234,6 +298,10 @@ protected:
     // statistic name as the key. Sample map element: {HITS, num_hits_}
     std::map<metric_name_t, int_least64_t &> stats_map_;
 
+    // The value of each metric in each sampling unit.
+    std::map<metric_name_t, std::vector<int_least64_t>> sample_values_;
+    int_least64_t num_sample_units_ = 0;
+
     // We provide a feature of dumping misses to a file.
     bool dump_misses_;
 
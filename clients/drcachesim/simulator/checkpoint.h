@@ -0,0 +1,159 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+/* checkpoint: reads and writes simulator state in a compact binary form.
+ */
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_ 1
+
+#include <stdint.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Integers are written as LEB128 varints, with signed values zigzag-encoded
+// first, so that the mostly small counts and counters of a simulator take a
+// byte or two each.
+class checkpoint_writer_t {
+public:
+    explicit checkpoint_writer_t(std::ostream *out)
+        : out_(out)
+    {
+    }
+
+    template <typename T>
+    void
+    write(T value)
+    {
+        static_assert(std::is_integral<T>::value, "only integers are supported");
+        uint64_t bits = static_cast<uint64_t>(value);
+        if (std::is_signed<T>::value) {
+            int64_t signed_value = static_cast<int64_t>(value);
+            bits = (static_cast<uint64_t>(signed_value) << 1) ^
+                static_cast<uint64_t>(signed_value >> 63);
+        }
+        while (bits >= 0x80) {
+            out_->put(static_cast<char>(bits | 0x80));
+            bits >>= 7;
+        }
+        out_->put(static_cast<char>(bits));
+    }
+
+    void
+    write_string(const std::string &value)
+    {
+        write(value.size());
+        out_->write(value.data(), value.size());
+    }
+
+    template <typename T>
+    void
+    write_vector(const std::vector<T> &values)
+    {
+        write(values.size());
+        for (const T &value : values)
+            write(value);
+    }
+
+    bool
+    ok() const
+    {
+        return out_->good();
+    }
+
+private:
+    std::ostream *out_;
+};
+
+// Every read returns false once the input runs out or is malformed.
+class checkpoint_reader_t {
+public:
+    explicit checkpoint_reader_t(std::istream *in)
+        : in_(in)
+    {
+    }
+
+    template <typename T>
+    bool
+    read(T *value)
+    {
+        static_assert(std::is_integral<T>::value, "only integers are supported");
+        uint64_t bits = 0;
+        for (int shift = 0;; shift += 7) {
+            int byte = in_->get();
+            if (byte == std::char_traits<char>::eof() || shift > 63)
+                return false;
+            bits |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                break;
+        }
+        if (std::is_signed<T>::value)
+            bits = (bits >> 1) ^ (~(bits & 1) + 1);
+        *value = static_cast<T>(bits);
+        return true;
+    }
+
+    bool
+    read_string(std::string *value)
+    {
+        size_t size;
+        if (!read(&size))
+            return false;
+        value->resize(size);
+        return size == 0 || in_->read(&(*value)[0], size).good();
+    }
+
+    // Fails unless the vector holds exactly expected_size values.
+    template <typename T>
+    bool
+    read_vector(std::vector<T> *values, size_t expected_size)
+    {
+        size_t size;
+        if (!read(&size) || size != expected_size)
+            return false;
+        values->resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            T value;
+            if (!read(&value))
+                return false;
+            (*values)[i] = value;
+        }
+        return true;
+    }
+
+private:
+    std::istream *in_;
+};
+
+#endif /* _CHECKPOINT_H_ */
@@ -0,0 +1,110 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <fstream>
+#include <sstream>
+#include "page_size_map.h"
+#include "../common/utils.h"
+
+page_size_map_t::page_size_map_t(addr_t base_page_size)
+{
+    set_base_page_size(base_page_size);
+}
+
+void
+page_size_map_t::set_base_page_size(addr_t base_page_size)
+{
+    base_bits_ = compute_log2(static_cast<int>(base_page_size));
+    last_size_ = 0;
+}
+
+bool
+page_size_map_t::add_range(addr_t start, addr_t end, addr_t page_size)
+{
+    if (!IS_POWER_OF_2(page_size) || start >= end || (start & (page_size - 1)) != 0 ||
+        (end & (page_size - 1)) != 0)
+        return false;
+    int bits = 0;
+    while ((addr_t)1 << bits < page_size)
+        ++bits;
+    ranges_[start] = { end, bits };
+    last_size_ = 0;
+    return true;
+}
+
+bool
+page_size_map_t::read(const std::string &path, std::string *error)
+{
+    std::ifstream file(path);
+    if (!file.good()) {
+        *error = "Failed to open page size map " + path;
+        return false;
+    }
+    std::string line;
+    int line_num = 0;
+    while (std::getline(file, line)) {
+        ++line_num;
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        fields.unsetf(std::ios::basefield); // Accept hex with 0x as well as decimal.
+        addr_t start, end, page_size;
+        if (!(fields >> start >> end >> page_size) ||
+            !add_range(start, end, page_size)) {
+            *error = "Invalid page size map entry at " + path + ":" +
+                std::to_string(line_num) +
+                ": expecting page-aligned \"<start> <end> <page size>\"";
+            return false;
+        }
+    }
+    return true;
+}
+
+int
+page_size_map_t::lookup(addr_t addr) const
+{
+    auto it = ranges_.upper_bound(addr);
+    if (it != ranges_.begin()) {
+        --it;
+        if (addr < it->second.end) {
+            last_start_ = it->first;
+            last_size_ = it->second.end - it->first;
+            last_bits_ = it->second.page_size_bits;
+            return last_bits_;
+        }
+    }
+    // Remember just this base page, as a range may start right after it.
+    last_start_ = addr & ~(((addr_t)1 << base_bits_) - 1);
+    last_size_ = (addr_t)1 << base_bits_;
+    last_bits_ = base_bits_;
+    return base_bits_;
+}
@@ -0,0 +1,92 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+/* page_size_map: maps virtual addresses to the size of the page holding them.
+ */
+
+#ifndef _PAGE_SIZE_MAP_H_
+#define _PAGE_SIZE_MAP_H_ 1
+
+#include <map>
+#include <string>
+#include "memref.h"
+
+// Addresses are in base-sized pages unless they fall in one of a set of ranges
+// backed by larger pages, such as transparent huge pages.  The ranges are
+// shared by all processes.
+class page_size_map_t {
+public:
+    page_size_map_t(addr_t base_page_size);
+
+    // Reads the huge page ranges from a file with one range per line, as
+    // "<start> <end> <page size>" with each in hex (with a 0x prefix) or decimal.
+    // Lines starting with '#' are ignored.  Each range must be aligned to its
+    // page size.  Returns false and sets error on failure.
+    bool
+    read(const std::string &path, std::string *error);
+
+    // Adds a range of pages of page_size bytes.  Returns false if the range is
+    // not aligned to page_size or page_size is not a power of 2.
+    bool
+    add_range(addr_t start, addr_t end, addr_t page_size);
+
+    void
+    set_base_page_size(addr_t base_page_size);
+
+    // Returns log2 of the size of the page holding addr.
+    int
+    get_page_size_bits(addr_t addr) const
+    {
+        if (ranges_.empty())
+            return base_bits_;
+        if (addr - last_start_ < last_size_)
+            return last_bits_;
+        return lookup(addr);
+    }
+
+protected:
+    int
+    lookup(addr_t addr) const;
+
+    struct range_t {
+        addr_t end;
+        int page_size_bits;
+    };
+    // Keyed by range start.
+    std::map<addr_t, range_t> ranges_;
+    int base_bits_;
+    // The last range looked up, or the base page holding the last address.
+    mutable addr_t last_start_ = 0;
+    mutable addr_t last_size_ = 0;
+    mutable int last_bits_ = 0;
+};
+
+#endif /* _PAGE_SIZE_MAP_H_ */
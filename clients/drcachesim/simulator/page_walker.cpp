@@ -0,0 +1,182 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include "page_walker.h"
+#include "cache_simulator.h"
+#include "../common/trace_entry.h"
+
+// Each table is one 4K page of 512 8-byte entries.
+static const int TABLE_INDEX_BITS = 9;
+static const int TABLE_ENTRY_SIZE = 8;
+static const int TABLE_PAGE_BITS = 12;
+// Page-table pages are placed well above typical user and synthetic physical
+// addresses, with a separate region for each core.
+static const addr_t TABLE_REGION_BASE = 0x7ff000000000ULL;
+static const int TABLE_REGION_BITS = 36;
+
+// Returns log2 of the bytes mapped by an entry at level, where level 1 holds
+// the 4K page table entries.
+static int
+level_shift(int level)
+{
+    return TABLE_PAGE_BITS + TABLE_INDEX_BITS * (level - 1);
+}
+
+page_walker_t::page_walker_t(int pwc_entries, cache_simulator_t *walk_caches,
+                             unsigned int core)
+    : walk_caches_(walk_caches)
+    , next_table_page_(TABLE_REGION_BASE +
+                       (static_cast<addr_t>(core) << TABLE_REGION_BITS))
+{
+    for (pwc_t &pwc : pwc_) {
+        pwc.tags.assign(pwc_entries, TAG_INVALID);
+        pwc.pids.assign(pwc_entries, 0);
+        pwc.last_use.assign(pwc_entries, 0);
+    }
+}
+
+bool
+page_walker_t::pwc_lookup(int level, memref_pid_t pid, addr_t vaddr)
+{
+    pwc_t &pwc = pwc_[level - 2];
+    addr_t tag = vaddr >> level_shift(level);
+    for (size_t i = 0; i < pwc.tags.size(); ++i) {
+        if (pwc.tags[i] == tag && pwc.pids[i] == pid) {
+            pwc.last_use[i] = ++pwc_clock_;
+            ++pwc.hits;
+            return true;
+        }
+    }
+    ++pwc.misses;
+    return false;
+}
+
+void
+page_walker_t::pwc_insert(int level, memref_pid_t pid, addr_t vaddr)
+{
+    pwc_t &pwc = pwc_[level - 2];
+    if (pwc.tags.empty())
+        return;
+    size_t victim = 0;
+    for (size_t i = 1; i < pwc.tags.size(); ++i) {
+        if (pwc.last_use[i] < pwc.last_use[victim])
+            victim = i;
+    }
+    pwc.tags[victim] = vaddr >> level_shift(level);
+    pwc.pids[victim] = pid;
+    pwc.last_use[victim] = ++pwc_clock_;
+}
+
+addr_t
+page_walker_t::entry_address(int level, memref_pid_t pid, addr_t vaddr)
+{
+    // The table at level maps the bits below level_shift(level + 1), so the
+    // bits above pick the table.
+    addr_t &table = tables_[level - 1][pid][vaddr >> level_shift(level + 1)];
+    if (table == 0) {
+        table = next_table_page_;
+        next_table_page_ += 1 << TABLE_PAGE_BITS;
+    }
+    addr_t index = (vaddr >> level_shift(level)) & ((1 << TABLE_INDEX_BITS) - 1);
+    return table + index * TABLE_ENTRY_SIZE;
+}
+
+void
+page_walker_t::walk(const memref_t &memref, int page_size_bits)
+{
+    addr_t vaddr = memref.data.addr;
+    memref_pid_t pid = memref.data.pid;
+    // The level holding the leaf entry for this page size.
+    int leaf = 1;
+    while (leaf < NUM_LEVELS - 1 && page_size_bits >= level_shift(leaf + 1))
+        ++leaf;
+    ++num_walks_;
+    // Start below the deepest non-leaf entry in the walk caches, if any.
+    int start = NUM_LEVELS;
+    if (!pwc_[0].tags.empty()) {
+        for (int level = leaf + 1; level <= NUM_LEVELS; ++level) {
+            if (pwc_lookup(level, pid, vaddr)) {
+                start = level - 1;
+                break;
+            }
+        }
+    }
+    memref_t walk_ref = memref;
+    walk_ref.data.type = TRACE_TYPE_READ;
+    walk_ref.data.size = TABLE_ENTRY_SIZE;
+    for (int level = start; level >= leaf; --level) {
+        ++num_walk_refs_;
+        if (walk_caches_ != nullptr) {
+            walk_ref.data.addr = entry_address(level, pid, vaddr);
+            walk_caches_->process_memref(walk_ref);
+        }
+        if (level > leaf)
+            pwc_insert(level, pid, vaddr);
+    }
+}
+
+void
+page_walker_t::reset()
+{
+    num_walks_ = 0;
+    num_walk_refs_ = 0;
+    for (pwc_t &pwc : pwc_) {
+        pwc.hits = 0;
+        pwc.misses = 0;
+    }
+}
+
+void
+page_walker_t::print_stats(std::string prefix)
+{
+    static const char *const pwc_names[] = { "PDE cache hits:", "PDPTE cache hits:",
+                                             "PML4E cache hits:" };
+    std::cerr.imbue(std::locale("")); // Add commas, at least for my locale
+    std::cerr << prefix << std::setw(18) << std::left << "Page walks:" << std::setw(20)
+              << std::right << num_walks_ << std::endl;
+    std::cerr << prefix << std::setw(18) << std::left << "Walk refs:" << std::setw(20)
+              << std::right << num_walk_refs_ << std::endl;
+    if (num_walks_ > 0) {
+        std::cerr << prefix << std::setw(18) << std::left << "Refs per walk:"
+                  << std::setw(20) << std::fixed << std::setprecision(2) << std::right
+                  << ((double)num_walk_refs_ / num_walks_) << std::endl;
+    }
+    for (int i = 0; i < NUM_LEVELS - 1; ++i) {
+        if (pwc_[i].hits + pwc_[i].misses == 0)
+            continue;
+        std::cerr << prefix << std::setw(18) << std::left << pwc_names[i]
+                  << std::setw(20) << std::right << pwc_[i].hits << std::endl;
+    }
+    std::cerr.imbue(std::locale("C")); // Reset to avoid affecting later prints.
+}
@@ -0,0 +1,121 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+/* page_walker: models the page table walks on last-level TLB misses.
+ */
+
+#ifndef _PAGE_WALKER_H_
+#define _PAGE_WALKER_H_ 1
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "memref.h"
+
+class cache_simulator_t;
+
+// Walks a synthetic x86-64 style 4-level radix page table on each last-level
+// TLB miss.  A 4K page needs an entry from each of the 4 levels, a 2M page
+// stops at the page directory, and a 1G page at the page directory pointer
+// table.  A page walk cache holds recently used non-leaf entries per level so
+// that a walk can start below the root.  The entries read, which live in
+// page-table pages allocated on first use, can be charged to a cache simulator.
+class page_walker_t {
+public:
+    // pwc_entries is the size of each of the fully associative page walk
+    // caches for the three non-leaf levels, or 0 for none.  walk_caches may be
+    // nullptr; it is shared among cores and not owned by the walker.  core picks
+    // the region holding this walker's page-table pages, so that the walkers of
+    // different cores sharing walk_caches do not alias each other.
+    page_walker_t(int pwc_entries, cache_simulator_t *walk_caches,
+                  unsigned int core = 0);
+
+    // Walks the page table for the page of 1 << page_size_bits bytes holding
+    // memref's address.
+    void
+    walk(const memref_t &memref, int page_size_bits);
+
+    void
+    reset();
+
+    void
+    print_stats(std::string prefix);
+
+    int_least64_t
+    get_walks() const
+    {
+        return num_walks_;
+    }
+    int_least64_t
+    get_walk_refs() const
+    {
+        return num_walk_refs_;
+    }
+
+protected:
+    static const int NUM_LEVELS = 4;
+
+    struct pwc_t {
+        std::vector<addr_t> tags;
+        std::vector<memref_pid_t> pids;
+        std::vector<uint64_t> last_use;
+        int_least64_t hits = 0;
+        int_least64_t misses = 0;
+    };
+
+    // Returns whether the walk cache for level holds the entry for vaddr, and
+    // makes it most recently used.
+    bool
+    pwc_lookup(int level, memref_pid_t pid, addr_t vaddr);
+    void
+    pwc_insert(int level, memref_pid_t pid, addr_t vaddr);
+    // Returns the address of the entry of the table at level that maps vaddr.
+    addr_t
+    entry_address(int level, memref_pid_t pid, addr_t vaddr);
+
+    // Walk caches for the levels above the leaves, indexed by level - 2.
+    pwc_t pwc_[NUM_LEVELS - 1];
+    uint64_t pwc_clock_ = 0;
+    cache_simulator_t *walk_caches_;
+
+    // The page-table page for each table, indexed by level - 1, then by process,
+    // then by the address bits above those the table maps.
+    std::unordered_map<memref_pid_t, std::unordered_map<addr_t, addr_t>>
+        tables_[NUM_LEVELS];
+    // Where the next page-table page is allocated.
+    addr_t next_table_page_;
+
+    int_least64_t num_walks_ = 0;
+    int_least64_t num_walk_refs_ = 0;
+};
+
+#endif /* _PAGE_WALKER_H_ */
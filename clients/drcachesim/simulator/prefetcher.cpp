@@ -51,3 +51,13 @@ prefetcher_t::prefetch(caching_device_t *cache, const memref_t &memref_in)
     memref.data.type = TRACE_TYPE_HARDWARE_PREFETCH;
     cache->request(memref);
 }
+
+void
+prefetcher_t::issue(caching_device_t *cache, const memref_t &memref_in, addr_t addr)
+{
+    memref_t memref = memref_in;
+    memref.data.type = TRACE_TYPE_HARDWARE_PREFETCH;
+    memref.data.addr = addr;
+    memref.data.size = 1;
+    cache->request(memref);
+}
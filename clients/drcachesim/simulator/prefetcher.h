@@ -36,21 +36,32 @@
 #ifndef _PREFETCHER_H_
 #define _PREFETCHER_H_ 1
 
-#include "caching_device.h"
 #include "memref.h"
 
 class caching_device_t;
 
+// The base class implements a next-line prefetcher.
 class prefetcher_t {
 public:
     prefetcher_t(int block_size);
     virtual ~prefetcher_t()
     {
     }
+    // Called on each demand miss in cache.
     virtual void
     prefetch(caching_device_t *cache, const memref_t &memref);
+    // Called on each demand hit in cache, for prefetchers that train on the
+    // whole access stream rather than just on misses.
+    virtual void
+    demand_hit(caching_device_t *cache, const memref_t &memref)
+    {
+    }
+
+protected:
+    // Requests the block holding addr as a hardware prefetch.
+    void
+    issue(caching_device_t *cache, const memref_t &memref, addr_t addr);
 
-private:
     int block_size_;
 };
 
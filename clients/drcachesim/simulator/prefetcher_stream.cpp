@@ -0,0 +1,119 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "prefetcher_stream.h"
+#include "../common/utils.h"
+
+static const int STREAM_COUNT = 16;
+// Streams are confined to 4K regions, as the next physical page is unknown.
+static const int STREAM_REGION_BITS = 12;
+// A block at most this many blocks past the last one continues the stream.
+static const int STREAM_WINDOW = 4;
+// Prefetching starts once the direction has been seen this many times in a row.
+static const int STREAM_MIN_CONFIDENCE = 2;
+// How many blocks ahead to prefetch.
+static const int STREAM_DEGREE = 4;
+
+prefetcher_stream_t::prefetcher_stream_t(int block_size)
+    : prefetcher_t(block_size)
+    , block_size_bits_(compute_log2(block_size))
+    , streams_(STREAM_COUNT)
+{
+}
+
+prefetcher_stream_t::stream_t *
+prefetcher_stream_t::find_stream(addr_t addr, bool allocate)
+{
+    addr_t region = addr >> STREAM_REGION_BITS;
+    stream_t *lru = &streams_[0];
+    for (stream_t &stream : streams_) {
+        if (stream.valid && stream.region == region)
+            return &stream;
+        if (!stream.valid || (lru->valid && stream.last_use < lru->last_use))
+            lru = &stream;
+    }
+    if (!allocate)
+        return nullptr;
+    *lru = stream_t();
+    lru->valid = true;
+    lru->region = region;
+    lru->last_block = addr >> block_size_bits_;
+    return lru;
+}
+
+void
+prefetcher_stream_t::prefetch(caching_device_t *cache, const memref_t &memref)
+{
+    train(cache, memref, true);
+}
+
+void
+prefetcher_stream_t::demand_hit(caching_device_t *cache, const memref_t &memref)
+{
+    train(cache, memref, false);
+}
+
+void
+prefetcher_stream_t::train(caching_device_t *cache, const memref_t &memref, bool miss)
+{
+    // Only misses start new streams; hits just keep existing ones going.
+    stream_t *stream = find_stream(memref.data.addr, miss);
+    if (stream == nullptr)
+        return;
+    stream->last_use = ++use_count_;
+    addr_t block = memref.data.addr >> block_size_bits_;
+    if (block == stream->last_block)
+        return;
+    int direction = block > stream->last_block ? 1 : -1;
+    addr_t distance =
+        direction > 0 ? block - stream->last_block : stream->last_block - block;
+    stream->last_block = block;
+    if (distance > STREAM_WINDOW) {
+        stream->confidence = 0;
+        return;
+    }
+    if (direction == stream->direction) {
+        if (stream->confidence < STREAM_MIN_CONFIDENCE)
+            ++stream->confidence;
+    } else {
+        stream->direction = direction;
+        stream->confidence = 1;
+    }
+    if (stream->confidence < STREAM_MIN_CONFIDENCE)
+        return;
+    for (int i = 1; i <= STREAM_DEGREE; ++i) {
+        addr_t target = (block + direction * i) << block_size_bits_;
+        if (target >> STREAM_REGION_BITS != stream->region)
+            break;
+        issue(cache, memref, target);
+    }
+}
@@ -0,0 +1,79 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+/* prefetcher_stream: represents a region-based stream prefetcher.
+ */
+
+#ifndef _PREFETCHER_STREAM_H_
+#define _PREFETCHER_STREAM_H_ 1
+
+#include <stdint.h>
+#include <vector>
+#include "prefetcher.h"
+
+// Tracks a small number of streams, each confined to an aligned region of
+// memory.  Misses to nearby blocks in the same direction within a region
+// confirm its stream, after which each access to the stream prefetches the next
+// few blocks in that direction, without leaving the region.  Unlike the stride
+// prefetcher this needs no PC, so it also suits instruction and unified caches.
+class prefetcher_stream_t : public prefetcher_t {
+public:
+    prefetcher_stream_t(int block_size);
+    void
+    prefetch(caching_device_t *cache, const memref_t &memref) override;
+    void
+    demand_hit(caching_device_t *cache, const memref_t &memref) override;
+
+protected:
+    struct stream_t {
+        addr_t region = 0;
+        // The last block accessed, as a block number.
+        addr_t last_block = 0;
+        int direction = 0;
+        int confidence = 0;
+        // For choosing a stream to replace.
+        uint64_t last_use = 0;
+        bool valid = false;
+    };
+
+    // Returns the stream for the block at addr.  If allocate, a stream is
+    // replaced if none matches; otherwise nullptr is returned.
+    stream_t *
+    find_stream(addr_t addr, bool allocate);
+    void
+    train(caching_device_t *cache, const memref_t &memref, bool miss);
+
+    int block_size_bits_;
+    std::vector<stream_t> streams_;
+    uint64_t use_count_ = 0;
+};
+
+#endif /* _PREFETCHER_STREAM_H_ */
@@ -0,0 +1,104 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "prefetcher_stride.h"
+
+// The table is direct-mapped on the PC.
+static const int STRIDE_TABLE_BITS = 8;
+// The confidence counter saturates here, and we prefetch once it reaches
+// STRIDE_MIN_CONFIDENCE.
+static const int STRIDE_MAX_CONFIDENCE = 3;
+static const int STRIDE_MIN_CONFIDENCE = 2;
+// How many strides ahead to prefetch.
+static const int STRIDE_DEGREE = 4;
+
+prefetcher_stride_t::prefetcher_stride_t(int block_size)
+    : prefetcher_t(block_size)
+    , table_(1 << STRIDE_TABLE_BITS)
+{
+}
+
+void
+prefetcher_stride_t::prefetch(caching_device_t *cache, const memref_t &memref)
+{
+    train(cache, memref);
+}
+
+void
+prefetcher_stride_t::demand_hit(caching_device_t *cache, const memref_t &memref)
+{
+    train(cache, memref);
+}
+
+void
+prefetcher_stride_t::train(caching_device_t *cache, const memref_t &memref)
+{
+    // Instruction fetches have no separate PC to key on.
+    if (type_is_instr(memref.instr.type))
+        return;
+    addr_t pc = memref.data.pc;
+    entry_t &entry = table_[(pc ^ (pc >> STRIDE_TABLE_BITS)) &
+                            ((1 << STRIDE_TABLE_BITS) - 1)];
+    if (entry.pc != pc) {
+        entry.pc = pc;
+        entry.last_addr = memref.data.addr;
+        entry.stride = 0;
+        entry.confidence = 0;
+        return;
+    }
+    int64_t stride =
+        static_cast<int64_t>(memref.data.addr) - static_cast<int64_t>(entry.last_addr);
+    if (stride == 0)
+        return;
+    entry.last_addr = memref.data.addr;
+    if (stride == entry.stride) {
+        if (entry.confidence < STRIDE_MAX_CONFIDENCE)
+            ++entry.confidence;
+    } else {
+        entry.stride = stride;
+        entry.confidence = 0;
+        return;
+    }
+    if (entry.confidence < STRIDE_MIN_CONFIDENCE)
+        return;
+    // Strides smaller than a block would mostly hit the same blocks, so we skip
+    // targets in a block we just requested.
+    addr_t block_mask = ~static_cast<addr_t>(block_size_ - 1);
+    addr_t last_block = memref.data.addr & block_mask;
+    for (int i = 1; i <= STRIDE_DEGREE; ++i) {
+        addr_t target = memref.data.addr + i * entry.stride;
+        if ((target & block_mask) == last_block)
+            continue;
+        last_block = target & block_mask;
+        issue(cache, memref, target);
+    }
+}
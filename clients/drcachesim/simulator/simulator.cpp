@@ -268,3 +268,71 @@ simulator_t::print_core(int core) const
         std::cerr << ")" << std::endl;
     }
 }
+
+void
+simulator_t::save_scheduling(checkpoint_writer_t &out) const
+{
+    out.write(cpu2core_.size());
+    for (const auto &entry : cpu2core_) {
+        out.write(entry.first);
+        out.write(entry.second);
+    }
+    out.write(thread2core_.size());
+    for (const auto &entry : thread2core_) {
+        out.write(entry.first);
+        out.write(entry.second);
+    }
+    out.write_vector(cpu_counts_);
+    out.write_vector(thread_counts_);
+    out.write_vector(thread_ever_counts_);
+    out.write(page_size_);
+    out.write(virt2phys_.size());
+    for (const auto &entry : virt2phys_) {
+        out.write(entry.first);
+        out.write(entry.second);
+    }
+    out.write(prior_phys_addr_);
+}
+
+bool
+simulator_t::restore_scheduling(checkpoint_reader_t &in)
+{
+    size_t size;
+    cpu2core_.clear();
+    if (!in.read(&size))
+        return false;
+    for (size_t i = 0; i < size; ++i) {
+        int cpu, core;
+        if (!in.read(&cpu) || !in.read(&core) || core < 0 ||
+            core >= static_cast<int>(knob_num_cores_))
+            return false;
+        cpu2core_[cpu] = core;
+    }
+    thread2core_.clear();
+    if (!in.read(&size))
+        return false;
+    for (size_t i = 0; i < size; ++i) {
+        memref_tid_t tid;
+        int core;
+        if (!in.read(&tid) || !in.read(&core) || core < 0 ||
+            core >= static_cast<int>(knob_num_cores_))
+            return false;
+        thread2core_[tid] = core;
+    }
+    if (!in.read_vector(&cpu_counts_, knob_num_cores_) ||
+        !in.read_vector(&thread_counts_, knob_num_cores_) ||
+        !in.read_vector(&thread_ever_counts_, knob_num_cores_) || !in.read(&page_size_))
+        return false;
+    virt2phys_.clear();
+    if (!in.read(&size))
+        return false;
+    for (size_t i = 0; i < size; ++i) {
+        addr_t virt, phys;
+        if (!in.read(&virt) || !in.read(&phys))
+            return false;
+        virt2phys_[virt] = phys;
+    }
+    // Re-resolve the next thread's core from the restored mapping.
+    last_thread_ = 0;
+    return in.read(&prior_phys_addr_);
+}
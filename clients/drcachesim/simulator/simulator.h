@@ -72,6 +72,13 @@ protected:
     virtual void
     handle_thread_exit(memref_tid_t tid);
 
+    // Writes the mapping of threads to cores and of virtual to physical pages
+    // to a checkpoint, and restores it.
+    void
+    save_scheduling(checkpoint_writer_t &out) const;
+    bool
+    restore_scheduling(checkpoint_reader_t &in);
+
     addr_t
     virt2phys(addr_t virt) const;
     memref_t
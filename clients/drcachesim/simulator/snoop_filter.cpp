@@ -35,90 +35,233 @@
 #include <iomanip>
 #include <assert.h>
 #include <algorithm>
+#include <bitset>
+#include "../common/utils.h"
+#ifdef _MSC_VER
+#    include <intrin.h>
+#endif
+
+// The associativity of the filter.
+static const int SNOOP_FILTER_ASSOC = 16;
+// The initial number of sets of a perfect snoop filter.
+static const int SNOOP_FILTER_INITIAL_SETS = 1024;
+
+static inline int
+lowest_set_bit(uint64_t bits)
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
 
 snoop_filter_t::snoop_filter_t(void)
 {
 }
 
 bool
-snoop_filter_t::init(cache_t **caches, int num_snooped_caches)
+snoop_filter_t::init(cache_t **caches, int num_snooped_caches, int capacity)
 {
+    if (num_snooped_caches <= 0 || num_snooped_caches > SNOOP_FILTER_MAX_CACHES) {
+        ERRMSG("Snoop filter supports at most %d caches\n", SNOOP_FILTER_MAX_CACHES);
+        return false;
+    }
+    if (capacity < 0 ||
+        (capacity > 0 &&
+         (capacity % SNOOP_FILTER_ASSOC != 0 ||
+          !IS_POWER_OF_2(capacity / SNOOP_FILTER_ASSOC)))) {
+        ERRMSG("Snoop filter size must be 0 or a power of 2 multiple of %d\n",
+               SNOOP_FILTER_ASSOC);
+        return false;
+    }
     caches_ = caches;
     num_snooped_caches_ = num_snooped_caches;
     num_writes_ = 0;
     num_writebacks_ = 0;
     num_invalidates_ = 0;
+    num_evictions_ = 0;
+    num_back_invalidates_ = 0;
 
+    assoc_ = SNOOP_FILTER_ASSOC;
+    bounded_ = capacity > 0;
+    num_sets_ = bounded_ ? capacity / assoc_ : SNOOP_FILTER_INITIAL_SETS;
+    sharer_words_ = (num_snooped_caches + 63) / 64;
+    use_clock_ = 0;
+    tags_.assign(num_sets_ * assoc_, TAG_INVALID);
+    sharers_.assign(tags_.size() * sharer_words_, 0);
+    dirty_.assign(tags_.size(), false);
+    last_use_.assign(tags_.size(), 0);
     return true;
 }
 
+int
+snoop_filter_t::find_entry(addr_t tag) const
+{
+    int set_idx = compute_set_idx(tag);
+    for (int way = 0; way < assoc_; ++way) {
+        if (tags_[set_idx + way] == tag)
+            return set_idx + way;
+    }
+    return -1;
+}
+
+int
+snoop_filter_t::allocate_entry(addr_t tag)
+{
+    int set_idx = compute_set_idx(tag);
+    int victim = -1;
+    for (int way = 0; way < assoc_; ++way) {
+        int idx = set_idx + way;
+        if (tags_[idx] == TAG_INVALID) {
+            victim = idx;
+            break;
+        }
+        if (victim == -1 || last_use_[idx] < last_use_[victim])
+            victim = idx;
+    }
+    if (tags_[victim] != TAG_INVALID) {
+        if (!bounded_) {
+            grow();
+            return allocate_entry(tag);
+        }
+        evict_entry(victim);
+    }
+    tags_[victim] = tag;
+    return victim;
+}
+
+void
+snoop_filter_t::evict_entry(int idx)
+{
+    addr_t tag = tags_[idx];
+    uint64_t *sharers = get_sharers(idx);
+    num_evictions_++;
+    for (int word = 0; word < sharer_words_; ++word) {
+        for (uint64_t bits = sharers[word]; bits != 0; bits &= bits - 1) {
+            int id = word * 64 + lowest_set_bit(bits);
+            caches_[id]->invalidate(tag, INVALIDATION_COHERENCE);
+            num_back_invalidates_++;
+        }
+        sharers[word] = 0;
+    }
+    if (dirty_[idx]) {
+        num_writebacks_++;
+        dirty_[idx] = false;
+    }
+    tags_[idx] = TAG_INVALID;
+}
+
+void
+snoop_filter_t::grow()
+{
+    std::vector<addr_t> old_tags;
+    std::vector<uint64_t> old_sharers;
+    std::vector<uint8_t> old_dirty;
+    std::vector<uint64_t> old_last_use;
+    old_tags.swap(tags_);
+    old_sharers.swap(sharers_);
+    old_dirty.swap(dirty_);
+    old_last_use.swap(last_use_);
+    num_sets_ *= 2;
+    tags_.assign(num_sets_ * assoc_, TAG_INVALID);
+    sharers_.assign(tags_.size() * sharer_words_, 0);
+    dirty_.assign(tags_.size(), false);
+    last_use_.assign(tags_.size(), 0);
+    for (size_t old_idx = 0; old_idx < old_tags.size(); ++old_idx) {
+        if (old_tags[old_idx] == TAG_INVALID)
+            continue;
+        // Each set splits in two, so there is always room.
+        int idx = allocate_entry(old_tags[old_idx]);
+        std::copy(&old_sharers[old_idx * sharer_words_],
+                  &old_sharers[(old_idx + 1) * sharer_words_], get_sharers(idx));
+        dirty_[idx] = old_dirty[old_idx];
+        last_use_[idx] = old_last_use[old_idx];
+    }
+}
+
 /*  This function should be called for all misses in snooped caches_ as well as
  *  all writes to coherent caches_.
  */
 void
 snoop_filter_t::snoop(addr_t tag, int id, bool is_write)
 {
-    coherence_table_entry_t *coherence_entry = &coherence_table_[tag];
-    // Initialize new snoop filter entry.
-    if (coherence_entry->sharers.empty()) {
-        coherence_entry->sharers.resize(num_snooped_caches_, false);
-        coherence_entry->dirty = false;
-    }
-
-    auto num_sharers = std::count(coherence_entry->sharers.begin(),
-                                  coherence_entry->sharers.end(), true);
-
     // Check that cache id is valid.
     assert(id >= 0 && id < num_snooped_caches_);
     // Check that tag is valid.
     assert(tag != TAG_INVALID);
+
+    int idx = find_entry(tag);
+    if (idx < 0)
+        idx = allocate_entry(tag);
+    last_use_[idx] = ++use_clock_;
+    uint64_t *sharers = get_sharers(idx);
+    uint64_t id_bit = 1ULL << (id % 64);
+    uint64_t &id_word = sharers[id / 64];
+
+#ifndef NDEBUG
     // Check that any dirty line is only held in one snooped cache.
-    assert(!coherence_entry->dirty || num_sharers == 1);
+    size_t num_sharers = 0;
+    for (int word = 0; word < sharer_words_; ++word)
+        num_sharers += std::bitset<64>(sharers[word]).count();
+    assert(!dirty_[idx] || num_sharers == 1);
+#endif
 
     // Check if this request causes a writeback.
-    if (!coherence_entry->sharers[id] && coherence_entry->dirty) {
+    if ((id_word & id_bit) == 0 && dirty_[idx]) {
         num_writebacks_++;
-        coherence_entry->dirty = false;
+        dirty_[idx] = false;
     }
 
     if (is_write) {
         num_writes_++;
-        coherence_entry->dirty = true;
-        if (num_sharers > 0) {
-            // Writes will invalidate other caches_.
-            for (int i = 0; i < num_snooped_caches_; i++) {
-                if (coherence_entry->sharers[i] && id != i) {
-                    caches_[i]->invalidate(tag, INVALIDATION_COHERENCE);
-                    num_invalidates_++;
-                    coherence_entry->sharers[i] = false;
-                }
+        dirty_[idx] = true;
+        // Writes will invalidate other caches_.
+        for (int word = 0; word < sharer_words_; ++word) {
+            uint64_t others = sharers[word];
+            if (word == id / 64)
+                others &= ~id_bit;
+            for (uint64_t bits = others; bits != 0; bits &= bits - 1) {
+                caches_[word * 64 + lowest_set_bit(bits)]->invalidate(
+                    tag, INVALIDATION_COHERENCE);
+                num_invalidates_++;
             }
+            sharers[word] &= ~others;
         }
     }
-    coherence_entry->sharers[id] = true;
+    id_word |= id_bit;
 }
 
 /* This function is called whenever a coherent cache evicts a line. */
 void
 snoop_filter_t::snoop_eviction(addr_t tag, int id)
 {
-    coherence_table_entry_t *coherence_entry = &coherence_table_[tag];
-
-    // Check if sharer list is initialized.
-    assert(coherence_entry->sharers.size() == (uint64_t)num_snooped_caches_);
     // Check that cache id is valid.
     assert(id >= 0 && id < num_snooped_caches_);
     // Check that tag is valid.
     assert(tag != TAG_INVALID);
+
+    int idx = find_entry(tag);
+    // Check that we currently track this line.
+    assert(idx >= 0);
+    if (idx < 0)
+        return;
+    uint64_t &id_word = get_sharers(idx)[id / 64];
+    uint64_t id_bit = 1ULL << (id % 64);
     // Check that we currently have this cache marked as a sharer.
-    assert(coherence_entry->sharers[id]);
+    assert((id_word & id_bit) != 0);
 
-    if (coherence_entry->dirty) {
+    if (dirty_[idx]) {
         num_writebacks_++;
-        coherence_entry->dirty = false;
+        dirty_[idx] = false;
     }
 
-    coherence_entry->sharers[id] = false;
+    id_word &= ~id_bit;
+    // Free the entry once no cache holds the line.
+    if (!has_sharers(idx))
+        tags_[idx] = TAG_INVALID;
 }
 
 void
@@ -133,5 +276,60 @@ snoop_filter_t::print_stats(void)
               << std::right << num_invalidates_ << std::endl;
     std::cerr << prefix << std::setw(18) << std::left << "Writebacks:" << std::setw(20)
               << std::right << num_writebacks_ << std::endl;
+    if (bounded_) {
+        std::cerr << prefix << std::setw(18) << std::left
+                  << "Filter evictions:" << std::setw(20) << std::right
+                  << num_evictions_ << std::endl;
+        std::cerr << prefix << std::setw(18) << std::left
+                  << "Back invalidates:" << std::setw(20) << std::right
+                  << num_back_invalidates_ << std::endl;
+    }
     std::cerr.imbue(std::locale("C")); // Reset to avoid affecting later prints.
 }
+
+void
+snoop_filter_t::save(checkpoint_writer_t &out) const
+{
+    out.write(bounded_);
+    out.write(num_snooped_caches_);
+    out.write(num_sets_);
+    out.write(use_clock_);
+    // Offsetting the tags turns TAG_INVALID into a single byte.
+    out.write(tags_.size());
+    for (addr_t tag : tags_)
+        out.write(tag + 1);
+    out.write_vector(sharers_);
+    out.write_vector(dirty_);
+    out.write_vector(last_use_);
+    out.write(num_writes_);
+    out.write(num_writebacks_);
+    out.write(num_invalidates_);
+    out.write(num_evictions_);
+    out.write(num_back_invalidates_);
+}
+
+bool
+snoop_filter_t::restore(checkpoint_reader_t &in)
+{
+    bool bounded;
+    int num_snooped_caches, num_sets;
+    size_t num_entries;
+    // A perfect filter may have grown to any number of sets.
+    if (!in.read(&bounded) || bounded != bounded_ || !in.read(&num_snooped_caches) ||
+        num_snooped_caches != num_snooped_caches_ || !in.read(&num_sets) ||
+        num_sets <= 0 || (bounded_ && num_sets != num_sets_) || !in.read(&use_clock_) ||
+        !in.read(&num_entries) || num_entries != static_cast<size_t>(num_sets) * assoc_)
+        return false;
+    num_sets_ = num_sets;
+    tags_.resize(num_entries);
+    for (addr_t &tag : tags_) {
+        if (!in.read(&tag))
+            return false;
+        tag -= 1;
+    }
+    return in.read_vector(&sharers_, num_entries * sharer_words_) &&
+        in.read_vector(&dirty_, num_entries) && in.read_vector(&last_use_, num_entries) &&
+        in.read(&num_writes_) && in.read(&num_writebacks_) &&
+        in.read(&num_invalidates_) && in.read(&num_evictions_) &&
+        in.read(&num_back_invalidates_);
+}
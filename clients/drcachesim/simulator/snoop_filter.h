@@ -34,22 +34,28 @@
 #define _SNOOP_FILTER_H_ 1
 
 #include "cache.h"
-#include <unordered_map>
+#include <stdint.h>
 #include <vector>
 
-struct coherence_table_entry_t {
-    std::vector<bool> sharers;
-    bool dirty;
-};
+// The most caches a snoop filter can track.
+#define SNOOP_FILTER_MAX_CACHES 256
 
+// The snoop filter is organized like a set-associative cache of lines, each entry
+// holding a fixed-width bitmask of the snooped caches sharing the line.  With a
+// non-zero capacity, allocating an entry in a full set evicts the least recently
+// used entry in that set, invalidating the line in all of its sharers as a real
+// directory would.  With a capacity of 0 the filter is perfect: a full set doubles
+// the number of sets instead.
 class snoop_filter_t {
 public:
     snoop_filter_t(void);
     virtual ~snoop_filter_t()
     {
     }
+    // The capacity is in entries and must be 0 or a power of 2 multiple of
+    // the associativity.
     virtual bool
-    init(cache_t **caches, int num_snooped_caches);
+    init(cache_t **caches, int num_snooped_caches, int capacity = 0);
     virtual void
     snoop(addr_t tag, int id, bool is_write);
     virtual void
@@ -57,14 +63,66 @@ public:
     void
     print_stats(void);
 
+    // Writes the entries and counts to a checkpoint, and restores them into a
+    // filter with the same capacity and number of caches.
+    void
+    save(checkpoint_writer_t &out) const;
+    bool
+    restore(checkpoint_reader_t &in);
+
 protected:
-    // XXX: This initial coherence implementation uses a perfect snoop filter.
-    std::unordered_map<addr_t, coherence_table_entry_t> coherence_table_;
+    // Returns the index of the entry for tag, or -1 if there is none.
+    int
+    find_entry(addr_t tag) const;
+    // Returns the index of a new, empty entry for tag.
+    int
+    allocate_entry(addr_t tag);
+    // Removes the entry at idx, invalidating the line in all of its sharers.
+    void
+    evict_entry(int idx);
+    // Doubles the number of sets of a perfect snoop filter.
+    void
+    grow();
+    int
+    compute_set_idx(addr_t tag) const
+    {
+        return static_cast<int>(tag & (num_sets_ - 1)) * assoc_;
+    }
+    uint64_t *
+    get_sharers(int idx)
+    {
+        return &sharers_[idx * sharer_words_];
+    }
+    bool
+    has_sharers(int idx)
+    {
+        uint64_t *sharers = get_sharers(idx);
+        for (int i = 0; i < sharer_words_; ++i) {
+            if (sharers[i] != 0)
+                return true;
+        }
+        return false;
+    }
+
+    // Entries are kept in flat arrays indexed by set index plus way, with
+    // sharer_words_ words of sharer bits per entry.
+    std::vector<addr_t> tags_;
+    std::vector<uint64_t> sharers_;
+    std::vector<uint8_t> dirty_;
+    std::vector<uint64_t> last_use_;
+    int assoc_;
+    int num_sets_;
+    int sharer_words_;
+    bool bounded_;
+    uint64_t use_clock_;
+
     cache_t **caches_;
     int num_snooped_caches_;
     int_least64_t num_writes_;
     int_least64_t num_writebacks_;
     int_least64_t num_invalidates_;
+    int_least64_t num_evictions_;
+    int_least64_t num_back_invalidates_;
 };
 
 #endif /* _SNOOP_FILTER_H_ */
@@ -0,0 +1,250 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <unordered_set>
+#include "timing_model.h"
+
+timing_model_t::timing_model_t(int rob_size, int dispatch_width, int memory_latency)
+    : rob_size_(rob_size)
+    , cycles_per_instr_(1.0 / dispatch_width)
+    , memory_latency_(memory_latency)
+{
+}
+
+bool
+timing_model_t::init(cache_t **l1_icaches, cache_t **l1_dcaches, unsigned int num_cores)
+{
+    if (rob_size_ <= 0 || cycles_per_instr_ <= 0.0 || memory_latency_ < 0)
+        return false;
+    // Count the cores sharing each device to divide up its resources.
+    std::unordered_map<caching_device_t *, unsigned int> sharers;
+    for (unsigned int i = 0; i < num_cores; i++) {
+        std::unordered_set<caching_device_t *> path;
+        for (caching_device_t *device = l1_icaches[i]; device != nullptr;
+             device = device->get_parent())
+            path.insert(device);
+        for (caching_device_t *device = l1_dcaches[i]; device != nullptr;
+             device = device->get_parent())
+            path.insert(device);
+        for (caching_device_t *device : path) {
+            if (device->get_latency() < 0 || device->get_mshrs() < 0 ||
+                device->get_fill_bandwidth() < 0.0)
+                return false;
+            sharers[device]++;
+            last_misses_[device] = device->get_num_demand_misses();
+        }
+    }
+    cores_.resize(num_cores);
+    for (unsigned int i = 0; i < num_cores; i++) {
+        core_t &core = cores_[i];
+        for (int instr = 0; instr < 2; instr++) {
+            std::vector<resource_t *> &chain = instr ? core.ichain : core.dchain;
+            for (caching_device_t *device = instr ? l1_icaches[i] : l1_dcaches[i];
+                 device != nullptr; device = device->get_parent()) {
+                // A unified L1, or an upper level shared by the L1I and L1D,
+                // has a single set of resources for both chains.
+                auto inserted = core.resources.emplace(device, resource_t());
+                resource_t &res = inserted.first->second;
+                if (inserted.second) {
+                    unsigned int share = sharers[device];
+                    res.device = device;
+                    res.last_misses = &last_misses_[device];
+                    unsigned int mshrs = static_cast<unsigned int>(device->get_mshrs());
+                    if (mshrs > 0)
+                        res.mshr_free.resize(std::max(1u, mshrs / share), 0.0);
+                    if (device->get_fill_bandwidth() > 0.0) {
+                        res.fill_cycles = device->get_block_size() * share /
+                            device->get_fill_bandwidth();
+                    }
+                }
+                chain.push_back(&res);
+            }
+            if (chain.size() > MAX_LEVELS)
+                return false;
+        }
+    }
+    return true;
+}
+
+double
+timing_model_t::complete_miss(core_t &core, const std::vector<resource_t *> &chain,
+                              int depth, double now)
+{
+    double time = now;
+    // The MSHR held at each level, indexed by depth.
+    std::vector<double>::iterator mshrs[MAX_LEVELS];
+    for (int i = 0; i < depth; i++) {
+        resource_t &res = *chain[i];
+        time += res.device->get_latency();
+        if (!res.mshr_free.empty()) {
+            mshrs[i] = std::min_element(res.mshr_free.begin(), res.mshr_free.end());
+            if (*mshrs[i] > time) {
+                core.mshr_wait_cycles += *mshrs[i] - time;
+                time = *mshrs[i];
+            }
+        }
+    }
+    if (depth < static_cast<int>(chain.size()))
+        time += chain[depth]->device->get_latency();
+    else
+        time += memory_latency_;
+    // The block is then filled back down the path, one device at a time.
+    for (int i = depth - 1; i >= 0; i--) {
+        resource_t &res = *chain[i];
+        if (res.fill_cycles > 0.0) {
+            time = std::max(time, res.fill_free) + res.fill_cycles;
+            res.fill_free = time;
+        }
+        if (!res.mshr_free.empty())
+            *mshrs[i] = time;
+    }
+    return time;
+}
+
+void
+timing_model_t::close_window(core_t &core)
+{
+    if (core.window_end > core.cycle) {
+        core.load_stall_cycles += core.window_end - core.cycle;
+        core.cycle = core.window_end;
+    }
+    core.window_open = false;
+}
+
+void
+timing_model_t::access(int core_idx, const memref_t &memref, bool instr)
+{
+    core_t &core = cores_[core_idx];
+    const std::vector<resource_t *> &chain = instr ? core.ichain : core.dchain;
+    // A demand miss at one level is a demand request to the next, so the levels
+    // that missed are a prefix of the path.
+    int depth = 0;
+    for (resource_t *res : chain) {
+        int_least64_t misses = res->device->get_num_demand_misses();
+        if (misses == *res->last_misses)
+            break;
+        *res->last_misses = misses;
+        depth++;
+    }
+    if (instr) {
+        if (core.window_open && core.instructions - core.window_start >= rob_size_)
+            close_window(core);
+        core.instructions++;
+        core.cycle += cycles_per_instr_;
+    }
+    if (depth == 0)
+        return;
+    double done = complete_miss(core, chain, depth, core.cycle);
+    if (instr) {
+        core.fetch_stall_cycles += done - core.cycle;
+        core.cycle = done;
+    } else if (memref.data.type == TRACE_TYPE_READ) {
+        core.load_misses++;
+        if (core.window_open)
+            core.window_end = std::max(core.window_end, done);
+        else {
+            core.window_open = true;
+            core.window_start = core.instructions;
+            core.window_end = done;
+            core.windows++;
+        }
+    }
+}
+
+double
+timing_model_t::get_cycles(int core_idx) const
+{
+    const core_t &core = cores_[core_idx];
+    double cycle = core.cycle;
+    if (core.window_open)
+        cycle = std::max(cycle, core.window_end);
+    return cycle - core.start_cycle;
+}
+
+double
+timing_model_t::get_load_stall_cycles(int core_idx) const
+{
+    const core_t &core = cores_[core_idx];
+    double stall = core.load_stall_cycles;
+    if (core.window_open && core.window_end > core.cycle)
+        stall += core.window_end - core.cycle;
+    return stall;
+}
+
+void
+timing_model_t::reset()
+{
+    for (core_t &core : cores_) {
+        core.start_instructions = core.instructions;
+        core.start_cycle = core.cycle;
+        core.fetch_stall_cycles = 0.0;
+        core.load_stall_cycles = 0.0;
+        core.mshr_wait_cycles = 0.0;
+        core.load_misses = 0;
+        core.windows = 0;
+    }
+}
+
+void
+timing_model_t::print_stats(int core_idx, std::string prefix) const
+{
+    const core_t &core = cores_[core_idx];
+    int_least64_t instructions = get_instructions(core_idx);
+    double cycles = get_cycles(core_idx);
+    std::cerr << prefix << std::setw(18) << std::left << "Instructions:" << std::setw(20)
+              << std::right << instructions << std::endl;
+    std::cerr << prefix << std::setw(18) << std::left << "Cycles:" << std::setw(20)
+              << std::right << static_cast<int_least64_t>(cycles) << std::endl;
+    if (instructions > 0) {
+        std::cerr << prefix << std::setw(18) << std::left << "CPI:" << std::setw(20)
+                  << std::fixed << std::setprecision(2) << std::right
+                  << cycles / instructions << std::endl;
+    }
+    std::cerr << prefix << std::setw(20) << std::left
+              << "Fetch stall cycles:" << std::setw(18) << std::right
+              << static_cast<int_least64_t>(core.fetch_stall_cycles) << std::endl;
+    std::cerr << prefix << std::setw(20) << std::left
+              << "Load stall cycles:" << std::setw(18) << std::right
+              << static_cast<int_least64_t>(get_load_stall_cycles(core_idx))
+              << std::endl;
+    std::cerr << prefix << std::setw(20) << std::left
+              << "MSHR wait cycles:" << std::setw(18) << std::right
+              << static_cast<int_least64_t>(core.mshr_wait_cycles) << std::endl;
+    if (core.windows > 0) {
+        // The load misses overlapping in each interval.
+        std::cerr << prefix << std::setw(18) << std::left << "Load MLP:" << std::setw(20)
+                  << std::fixed << std::setprecision(2) << std::right
+                  << static_cast<double>(core.load_misses) / core.windows << std::endl;
+    }
+}
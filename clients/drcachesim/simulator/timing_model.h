@@ -0,0 +1,150 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+/* timing_model: estimates cycles per instruction from the cache simulation.
+ */
+
+#ifndef _TIMING_MODEL_H_
+#define _TIMING_MODEL_H_ 1
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cache.h"
+#include "memref.h"
+
+// An interval timing model layered over the cache hierarchy.  Rather than
+// simulating an out-of-order core, it charges each instruction
+// 1/dispatch_width cycles and adds the stalls the core cannot hide.  An
+// instruction fetch miss stalls the front end for its whole latency.  Load
+// misses issued within a reorder buffer's worth of instructions of the first
+// miss of an interval overlap with it, and once the reorder buffer fills the
+// core stalls until the last of them completes.  Stores retire through a store
+// buffer and only take up miss resources.
+//
+// A miss's latency is the sum of the lookup latencies of the devices it visits
+// plus the memory latency if it leaves the hierarchy.  It waits for a free MSHR
+// at each device it misses in and for each device's fill bandwidth on the way
+// back.  Trace-driven cores do not share a clock, so a device shared by several
+// cores gives each of them an even share of its MSHRs and bandwidth.
+class timing_model_t {
+public:
+    timing_model_t(int rob_size, int dispatch_width, int memory_latency);
+
+    // Builds the resources of each core's hierarchy from the timing parameters
+    // of its devices.  This must be called before the caches see any requests.
+    bool
+    init(cache_t **l1_icaches, cache_t **l1_dcaches, unsigned int num_cores);
+
+    // Accounts for a reference the caches of core have just simulated.
+    void
+    access(int core, const memref_t &memref, bool instr);
+
+    // Clears the statistics, but not the state of the cores and resources.
+    void
+    reset();
+
+    void
+    print_stats(int core, std::string prefix) const;
+
+    int_least64_t
+    get_instructions(int core) const
+    {
+        return cores_[core].instructions - cores_[core].start_instructions;
+    }
+    // Includes the stall for any misses still outstanding.
+    double
+    get_cycles(int core) const;
+    double
+    get_fetch_stall_cycles(int core) const
+    {
+        return cores_[core].fetch_stall_cycles;
+    }
+    double
+    get_load_stall_cycles(int core) const;
+
+protected:
+    // The longest path from an L1 to memory.
+    static const int MAX_LEVELS = 16;
+
+    // A core's share of one device's MSHRs and fill bandwidth.
+    struct resource_t {
+        caching_device_t *device;
+        // The device's entry in last_misses_.
+        int_least64_t *last_misses;
+        // When each MSHR becomes free, or empty if unlimited.
+        std::vector<double> mshr_free;
+        // The cycles to fill one block, or 0 if unlimited.
+        double fill_cycles = 0.0;
+        double fill_free = 0.0;
+    };
+    struct core_t {
+        // Each L1's path to memory.
+        std::vector<resource_t *> ichain;
+        std::vector<resource_t *> dchain;
+        std::unordered_map<caching_device_t *, resource_t> resources;
+
+        double cycle = 0.0;
+        // An interval of overlapping load misses.
+        bool window_open = false;
+        int_least64_t window_start = 0;
+        double window_end = 0.0;
+
+        int_least64_t instructions = 0;
+        // The statistics count from here.
+        int_least64_t start_instructions = 0;
+        double start_cycle = 0.0;
+        double fetch_stall_cycles = 0.0;
+        double load_stall_cycles = 0.0;
+        double mshr_wait_cycles = 0.0;
+        int_least64_t load_misses = 0;
+        int_least64_t windows = 0;
+    };
+
+    // Returns the cycle at which a miss issued at cycle now and served by
+    // chain[depth], or memory if depth is the length of chain, completes.
+    double
+    complete_miss(core_t &core, const std::vector<resource_t *> &chain, int depth,
+                  double now);
+    void
+    close_window(core_t &core);
+
+    int rob_size_;
+    double cycles_per_instr_;
+    int memory_latency_;
+    std::vector<core_t> cores_;
+    // The demand misses of each device as of the last access.  These are shared
+    // by all cores, as an access can only change the counts along its own path.
+    std::unordered_map<caching_device_t *, int_least64_t> last_misses_;
+};
+
+#endif /* _TIMING_MODEL_H_ */
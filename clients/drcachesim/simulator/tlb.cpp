@@ -57,19 +57,25 @@ tlb_t::request(const memref_t &memref_in)
     // the right data struct to the parent and stats collectors.
     memref_t memref;
     // We support larger sizes to improve the IPC perf.
-    // This means that one memref could touch multiple blocks.
-    // We treat each block separately for statistics purposes.
-    addr_t final_addr = memref_in.data.addr + memref_in.data.size - 1 /*avoid overflow*/;
-    addr_t final_tag = compute_tag(final_addr);
-    addr_t tag = compute_tag(memref_in.data.addr);
+    // This means that one memref could touch multiple pages.
+    // We treat each page separately for statistics purposes.
+    addr_t addr = memref_in.data.addr;
+    addr_t final_addr = addr + memref_in.data.size - 1 /*avoid overflow*/;
+    int page_size_bits = get_page_size_bits(addr);
+    addr_t tag = compute_page_tag(addr, page_size_bits);
     memref_pid_t pid = memref_in.data.pid;
 
-    // Optimization: check last tag and pid if single-block
-    if (tag == final_tag && tag == last_tag_ && pid == last_pid_) {
+    // A zero-sized reference at the start of a page touches no page.
+    if (final_addr < addr && (addr & (((addr_t)1 << page_size_bits) - 1)) == 0)
+        return;
+
+    // Optimization: check last tag and pid if single-page
+    if (tag == last_tag_ && pid == last_pid_ &&
+        (addr >> page_size_bits) == (final_addr >> page_size_bits)) {
         // Make sure last_tag_ and pid are properly in sync.
         caching_device_block_t *tlb_entry =
             &get_caching_device_block(last_block_idx_, last_way_);
-        assert(tag != TAG_INVALID && tag == tlb_entry->tag_ &&
+        assert(tag != TAG_INVALID && tag == tags_[last_block_idx_ + last_way_] &&
                pid == ((tlb_entry_t *)tlb_entry)->pid_);
         record_access_stats(memref_in, true /*hit*/, tlb_entry);
         access_update(last_block_idx_, last_way_);
@@ -77,16 +83,19 @@ tlb_t::request(const memref_t &memref_in)
     }
 
     memref = memref_in;
-    for (; tag <= final_tag; ++tag) {
+    while (true) {
         int way;
         int block_idx = compute_block_idx(tag);
-
-        if (tag + 1 <= final_tag)
-            memref.data.size = ((tag + 1) << block_size_bits_) - memref.data.addr;
+        // The start of the next page, or 0 on wraparound.
+        addr_t next_addr = ((addr >> page_size_bits) + 1) << page_size_bits;
+        bool last_page = next_addr == 0 || final_addr < next_addr;
+        memref.data.addr = addr;
+        memref.data.size = last_page ? final_addr - addr + 1 : next_addr - addr;
 
         for (way = 0; way < associativity_; ++way) {
             caching_device_block_t *tlb_entry = &get_caching_device_block(block_idx, way);
-            if (tlb_entry->tag_ == tag && ((tlb_entry_t *)tlb_entry)->pid_ == pid) {
+            if (tags_[block_idx + way] == tag &&
+                ((tlb_entry_t *)tlb_entry)->pid_ == pid) {
                 record_access_stats(memref, true /*hit*/, tlb_entry);
                 break;
             }
@@ -97,27 +106,30 @@ tlb_t::request(const memref_t &memref_in)
             caching_device_block_t *tlb_entry = &get_caching_device_block(block_idx, way);
 
             record_access_stats(memref, false /*miss*/, tlb_entry);
-            // If no parent we assume we get the data from main memory
+            // If no parent we walk the page table, if modeled.
             if (parent_ != NULL)
                 parent_->request(memref);
+            else if (page_walker_ != nullptr)
+                page_walker_->walk(memref, page_size_bits);
 
             // XXX: do we need to handle TLB coherency?
 
-            tlb_entry->tag_ = tag;
+            update_tag(block_idx, way, tag);
             ((tlb_entry_t *)tlb_entry)->pid_ = pid;
         }
 
         access_update(block_idx, way);
 
-        if (tag + 1 <= final_tag) {
-            addr_t next_addr = (tag + 1) << block_size_bits_;
-            memref.data.addr = next_addr;
-            memref.data.size = final_addr - next_addr + 1 /*undo the -1*/;
-        }
         // Optimization: remember last tag and pid
         last_tag_ = tag;
         last_way_ = way;
         last_block_idx_ = block_idx;
         last_pid_ = pid;
+
+        if (last_page)
+            break;
+        addr = next_addr;
+        page_size_bits = get_page_size_bits(addr);
+        tag = compute_page_tag(addr, page_size_bits);
     }
 }
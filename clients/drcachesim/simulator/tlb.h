@@ -37,6 +37,8 @@
 #define _TLB_H_ 1
 
 #include "caching_device.h"
+#include "page_size_map.h"
+#include "page_walker.h"
 #include "tlb_entry.h"
 #include "tlb_stats.h"
 
@@ -45,6 +47,23 @@ public:
     void
     request(const memref_t &memref) override;
 
+    // With a page size map, each address is looked up in a page of the size the
+    // map gives, so that one TLB holds a mix of page sizes.  Otherwise every page
+    // is the block size passed to init().  The map is not owned by the TLB.
+    void
+    set_page_size_map(const page_size_map_t *page_size_map)
+    {
+        page_size_map_ = page_size_map;
+    }
+
+    // Misses in a TLB with no parent are handed to the walker, if any.  The
+    // walker is not owned by the TLB.
+    void
+    set_page_walker(page_walker_t *page_walker)
+    {
+        page_walker_ = page_walker;
+    }
+
     // TODO i#4816: The addition of the pid as a lookup parameter beyond just the tag
     // needs to be imposed on the parent methods invalidate(), contains_tag(), and
     // propagate_eviction() by overriding them.
@@ -53,8 +72,24 @@ protected:
     void
     init_blocks() override;
 
+    int
+    get_page_size_bits(addr_t addr) const
+    {
+        return page_size_map_ == nullptr ? block_size_bits_
+                                         : page_size_map_->get_page_size_bits(addr);
+    }
+    // The tag of a page is its page number combined with its size, so that
+    // pages of different sizes never match.
+    static addr_t
+    compute_page_tag(addr_t addr, int page_size_bits)
+    {
+        return (addr >> page_size_bits) | ((addr_t)page_size_bits << 56);
+    }
+
     // Optimization: remember last pid in addition to last tag
     memref_pid_t last_pid_;
+    const page_size_map_t *page_size_map_ = nullptr;
+    page_walker_t *page_walker_ = nullptr;
 };
 
 #endif /* _TLB_H_ */
@@ -55,14 +55,43 @@ tlb_simulator_t::tlb_simulator_t(const tlb_simulator_knobs_t &knobs)
                   knobs.warmup_fraction, knobs.sim_refs, knobs.cpu_scheduling,
                   knobs.use_physical, knobs.verbose)
     , knobs_(knobs)
+    , page_size_map_(knobs.page_size)
 {
     itlbs_ = new tlb_t *[knobs_.num_cores];
     dtlbs_ = new tlb_t *[knobs_.num_cores];
     lltlbs_ = new tlb_t *[knobs_.num_cores];
+    l3tlbs_ = new tlb_t *[knobs_.num_cores];
     for (unsigned int i = 0; i < knobs_.num_cores; i++) {
         itlbs_[i] = NULL;
         dtlbs_[i] = NULL;
         lltlbs_[i] = NULL;
+        l3tlbs_[i] = NULL;
+    }
+    if (!knobs_.TLB_page_size_map.empty() &&
+        !page_size_map_.read(knobs_.TLB_page_size_map, &error_string_)) {
+        success_ = false;
+        return;
+    }
+    if (knobs_.TLB_walk_caches) {
+        // The walk caches see walk references interleaved with the application's,
+        // so their reference counts do not line up with ours: we leave the
+        // skip/warmup/limit accounting to this simulator and feed them everything
+        // we simulate, warmup included.
+        cache_simulator_knobs_t walk_knobs = knobs_.walk_cache_knobs;
+        walk_knobs.num_cores = knobs_.num_cores;
+        walk_knobs.skip_refs = 0;
+        walk_knobs.warmup_refs = 0;
+        walk_knobs.warmup_fraction = 0.0;
+        walk_knobs.sim_refs = cache_simulator_knobs_t().sim_refs;
+        walk_knobs.cpu_scheduling = knobs_.cpu_scheduling;
+        walk_knobs.use_physical = knobs_.use_physical;
+        walk_caches_ = new cache_simulator_t(walk_knobs);
+        if (!*walk_caches_) {
+            error_string_ = "Failed to create walk caches: " +
+                walk_caches_->get_error_string();
+            success_ = false;
+            return;
+        }
     }
     for (unsigned int i = 0; i < knobs_.num_cores; i++) {
         itlbs_[i] = create_tlb(knobs_.TLB_replace_policy);
@@ -83,6 +112,14 @@ tlb_simulator_t::tlb_simulator_t(const tlb_simulator_knobs_t &knobs)
             success_ = false;
             return;
         }
+        if (knobs_.TLB_L3_entries > 0) {
+            l3tlbs_[i] = create_tlb(knobs_.TLB_replace_policy);
+            if (l3tlbs_[i] == NULL) {
+                error_string_ = "Failed to create l3tlbs_";
+                success_ = false;
+                return;
+            }
+        }
 
         if (!itlbs_[i]->init(knobs_.TLB_L1I_assoc, (int)knobs_.page_size,
                              knobs_.TLB_L1I_entries, lltlbs_[i],
@@ -91,19 +128,36 @@ tlb_simulator_t::tlb_simulator_t(const tlb_simulator_knobs_t &knobs)
                              knobs_.TLB_L1D_entries, lltlbs_[i],
                              new tlb_stats_t((int)knobs_.page_size)) ||
             !lltlbs_[i]->init(knobs_.TLB_L2_assoc, (int)knobs_.page_size,
-                              knobs_.TLB_L2_entries, NULL,
-                              new tlb_stats_t((int)knobs_.page_size))) {
+                              knobs_.TLB_L2_entries, l3tlbs_[i],
+                              new tlb_stats_t((int)knobs_.page_size)) ||
+            (l3tlbs_[i] != NULL &&
+             !l3tlbs_[i]->init(knobs_.TLB_L3_assoc, (int)knobs_.page_size,
+                               knobs_.TLB_L3_entries, NULL,
+                               new tlb_stats_t((int)knobs_.page_size)))) {
             error_string_ =
                 "Usage error: failed to initialize TLbs_. Ensure entry number, "
                 "page size and associativity are powers of 2.";
             success_ = false;
             return;
         }
+        itlbs_[i]->set_page_size_map(&page_size_map_);
+        dtlbs_[i]->set_page_size_map(&page_size_map_);
+        lltlbs_[i]->set_page_size_map(&page_size_map_);
+        walkers_.push_back(
+            new page_walker_t(knobs_.TLB_PWC_entries, walk_caches_, i));
+        if (l3tlbs_[i] != NULL) {
+            l3tlbs_[i]->set_page_size_map(&page_size_map_);
+            l3tlbs_[i]->set_page_walker(walkers_.back());
+        } else
+            lltlbs_[i]->set_page_walker(walkers_.back());
     }
 }
 
 tlb_simulator_t::~tlb_simulator_t()
 {
+    for (page_walker_t *walker : walkers_)
+        delete walker;
+    delete walk_caches_;
     for (unsigned int i = 0; i < knobs_.num_cores; i++) {
         // Try to handle failure during construction.
         if (itlbs_[i] == NULL)
@@ -118,10 +172,15 @@ tlb_simulator_t::~tlb_simulator_t()
             return;
         delete lltlbs_[i]->get_stats();
         delete lltlbs_[i];
+        if (l3tlbs_[i] != NULL) {
+            delete l3tlbs_[i]->get_stats();
+            delete l3tlbs_[i];
+        }
     }
     delete[] itlbs_;
     delete[] dtlbs_;
     delete[] lltlbs_;
+    delete[] l3tlbs_;
 }
 
 bool
@@ -141,7 +200,17 @@ tlb_simulator_t::process_memref(const memref_t &memref)
     if (!simulator_t::process_memref(memref))
         return false;
 
+    // The walk caches see every reference so that walks contend with the
+    // application for cache space.
+    if (walk_caches_ != nullptr && !walk_caches_->process_memref(memref)) {
+        error_string_ = walk_caches_->get_error_string();
+        return false;
+    }
+
     if (memref.marker.type == TRACE_TYPE_MARKER) {
+        if (knobs_.use_trace_page_size &&
+            memref.marker.marker_type == TRACE_MARKER_TYPE_PAGE_SIZE)
+            page_size_map_.set_base_page_size(memref.marker.marker_value);
         // We ignore markers before we ask core_for_thread, to avoid asking
         // too early on a timestamp marker.
         return true;
@@ -204,6 +273,9 @@ tlb_simulator_t::process_memref(const memref_t &memref)
                 itlbs_[i]->get_stats()->reset();
                 dtlbs_[i]->get_stats()->reset();
                 lltlbs_[i]->get_stats()->reset();
+                if (l3tlbs_[i] != NULL)
+                    l3tlbs_[i]->get_stats()->reset();
+                walkers_[i]->reset();
             }
         }
     } else {
@@ -223,10 +295,23 @@ tlb_simulator_t::print_results()
             itlbs_[i]->get_stats()->print_stats("    ");
             std::cerr << "  L1D stats:" << std::endl;
             dtlbs_[i]->get_stats()->print_stats("    ");
-            std::cerr << "  LL stats:" << std::endl;
-            lltlbs_[i]->get_stats()->print_stats("    ");
+            if (l3tlbs_[i] != NULL) {
+                std::cerr << "  L2 stats:" << std::endl;
+                lltlbs_[i]->get_stats()->print_stats("    ");
+                std::cerr << "  LL stats:" << std::endl;
+                l3tlbs_[i]->get_stats()->print_stats("    ");
+            } else {
+                std::cerr << "  LL stats:" << std::endl;
+                lltlbs_[i]->get_stats()->print_stats("    ");
+            }
+            std::cerr << "  Page walk stats:" << std::endl;
+            walkers_[i]->print_stats("    ");
         }
     }
+    if (walk_caches_ != nullptr) {
+        std::cerr << "Page walk cache hierarchy:\n";
+        walk_caches_->print_results();
+    }
     return true;
 }
 
@@ -37,6 +37,10 @@
 #define _TLB_SIMULATOR_H_ 1
 
 #include <unordered_map>
+#include <vector>
+#include "cache_simulator.h"
+#include "page_size_map.h"
+#include "page_walker.h"
 #include "simulator.h"
 #include "tlb_simulator_create.h"
 #include "tlb_stats.h"
@@ -58,11 +62,19 @@ protected:
 
     tlb_simulator_knobs_t knobs_;
 
-    // Each CPU core contains a L1 ITLB, L1 DTLB and L2 TLB.
+    // Each CPU core contains a L1 ITLB, L1 DTLB, L2 TLB and optional L3 TLB.
     // All of them are private to the core.
     tlb_t **itlbs_;
     tlb_t **dtlbs_;
     tlb_t **lltlbs_;
+    // NULL entries unless an L3 TLB is configured.
+    tlb_t **l3tlbs_;
+
+    page_size_map_t page_size_map_;
+    // One walker per core handles the misses of the core's last-level TLB.
+    std::vector<page_walker_t *> walkers_;
+    // The cache hierarchy page walks are charged to, if any.
+    cache_simulator_t *walk_caches_ = nullptr;
 };
 
 #endif /* _TLB_SIMULATOR_H_ */
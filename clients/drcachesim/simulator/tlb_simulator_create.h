@@ -37,6 +37,7 @@
 
 #include <string>
 #include "analysis_tool.h"
+#include "cache_simulator_create.h"
 
 /**
  * @file drmemtrace/tlb_simulator_create.h
@@ -58,6 +59,12 @@ struct tlb_simulator_knobs_t {
         , TLB_L1D_assoc(32)
         , TLB_L2_entries(1024)
         , TLB_L2_assoc(4)
+        , TLB_L3_entries(0)
+        , TLB_L3_assoc(4)
+        , TLB_PWC_entries(32)
+        , TLB_page_size_map("")
+        , use_trace_page_size(false)
+        , TLB_walk_caches(false)
         , TLB_replace_policy("LFU")
         , skip_refs(0)
         , warmup_refs(0)
@@ -76,6 +83,19 @@ struct tlb_simulator_knobs_t {
     unsigned int TLB_L1D_assoc;
     unsigned int TLB_L2_entries;
     unsigned int TLB_L2_assoc;
+    // A private L3 TLB below the L2 TLB, if non-zero.
+    unsigned int TLB_L3_entries;
+    unsigned int TLB_L3_assoc;
+    // The size of each per-level page walk cache, or 0 for none.
+    unsigned int TLB_PWC_entries;
+    // A file listing address ranges backed by pages other than page_size.
+    std::string TLB_page_size_map;
+    // Whether a page size marker in the trace replaces page_size.
+    bool use_trace_page_size;
+    // Whether page walks are charged to a cache hierarchy built from
+    // walk_cache_knobs, which also sees the application's own references.
+    bool TLB_walk_caches;
+    cache_simulator_knobs_t walk_cache_knobs;
     std::string TLB_replace_policy;
     uint64_t skip_refs;
     uint64_t warmup_refs;
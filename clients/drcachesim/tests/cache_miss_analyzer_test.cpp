@@ -206,10 +206,116 @@ two_dominant_strides()
     }
 }
 
+// A test with a dominant stride hidden among many more distinct strides than the
+// analyzer tracks per load.
+bool
+dominant_stride_with_noise()
+{
+    const int kStride = 5;
+    const unsigned int kLineSize = 64;
+
+    cache_simulator_knobs_t knobs;
+    knobs.line_size = kLineSize;
+    knobs.LL_size = 1024 * 1024;
+    knobs.data_prefetcher = "none";
+
+    // Track only 4 candidate strides per load, with a 0.5 confidence threshold.
+    cache_miss_analyzer_t analyzer(knobs, 1000, 0.01, 0.5, 4);
+
+    // Every fifth stride is a different large one; the rest are kStride lines.
+    addr_t addr = 0x1000;
+    for (int i = 0; i < 50000; ++i) {
+        analyzer.process_memref(generate_mem_ref(addr, 0xAAAA));
+        if (i % 5 == 4)
+            addr += kLineSize * (1000 + i);
+        else
+            addr += kLineSize * kStride;
+    }
+
+    std::vector<prefetching_recommendation_t *> recommendations =
+        analyzer.generate_recommendations();
+    if (recommendations.size() == 1 && recommendations[0]->pc == 0xAAAA &&
+        recommendations[0]->stride == (kStride * kLineSize)) {
+        std::cout << "dominant_stride_with_noise test passed." << std::endl;
+        return true;
+    }
+    std::cerr << "dominant_stride_with_noise test failed: " << recommendations.size()
+              << " recommendations." << std::endl;
+    return false;
+}
+
+// A test analyzing two shards in parallel mode, with the strides of one load split
+// between them.
+bool
+parallel_shards()
+{
+    const int kStride = 9;
+    const unsigned int kLineSize = 64;
+
+    cache_simulator_knobs_t knobs;
+    knobs.line_size = kLineSize;
+    knobs.LL_size = 1024 * 1024;
+    knobs.data_prefetcher = "none";
+    knobs.save_checkpoint = "cache_miss_analyzer_test.checkpoint";
+    knobs.pipeline_workers = 2;
+
+    cache_miss_analyzer_t analyzer(knobs, 1000, 0.01, 0.75, 16, true);
+    if (!analyzer) {
+        std::cerr << "parallel_shards test failed: " << analyzer.get_error_string()
+                  << std::endl;
+        return false;
+    }
+    if (!analyzer.parallel_shard_supported()) {
+        std::cerr << "parallel_shards test failed: shards unsupported." << std::endl;
+        return false;
+    }
+    void *shard1 = analyzer.parallel_shard_init(0, nullptr);
+    void *shard2 = analyzer.parallel_shard_init(1, nullptr);
+    // Checkpointing and pipelining are left to the whole-trace simulation.
+    for (void *shard : { shard1, shard2 }) {
+        const cache_simulator_knobs_t &shard_knobs =
+            reinterpret_cast<cache_miss_analyzer_t *>(shard)->get_knobs();
+        if (!shard_knobs.save_checkpoint.empty() || shard_knobs.pipeline_workers != 0) {
+            std::cerr << "parallel_shards test failed: shard knobs not cleared."
+                      << std::endl;
+            return false;
+        }
+    }
+    // Load 0xAAAA has the same stride in both shards, while 0xBBBB alternates
+    // between two strides.
+    addr_t addr1 = 0x1000;
+    addr_t addr2 = 0x40000000;
+    addr_t addr3 = 0x80000000;
+    for (int i = 0; i < 10000; ++i) {
+        analyzer.parallel_shard_memref(shard1, generate_mem_ref(addr1, 0xAAAA));
+        addr1 += kLineSize * kStride;
+        analyzer.parallel_shard_memref(shard2, generate_mem_ref(addr2, 0xAAAA));
+        addr2 += kLineSize * kStride;
+        analyzer.parallel_shard_memref(shard2, generate_mem_ref(addr3, 0xBBBB));
+        addr3 += kLineSize * (i % 2 == 0 ? 1 : 3);
+    }
+    if (!analyzer.parallel_shard_exit(shard1) || !analyzer.parallel_shard_exit(shard2)) {
+        std::cerr << "parallel_shards test failed: shard exit failed." << std::endl;
+        return false;
+    }
+
+    std::vector<prefetching_recommendation_t *> recommendations =
+        analyzer.generate_recommendations();
+    if (recommendations.size() == 1 && recommendations[0]->pc == 0xAAAA &&
+        recommendations[0]->stride == (kStride * kLineSize)) {
+        std::cout << "parallel_shards test passed." << std::endl;
+        return true;
+    }
+    std::cerr << "parallel_shards test failed: " << recommendations.size()
+              << " recommendations." << std::endl;
+    return false;
+}
+
 int
 main(int argc, const char *argv[])
 {
-    if (no_dominant_stride() && one_dominant_stride() && two_dominant_strides()) {
+    if (no_dominant_stride() && one_dominant_stride() && two_dominant_strides() &&
+        dominant_stride_with_noise() && parallel_shards()) {
         return 0;
     } else {
         std::cerr << "cache_miss_analyzer_test failed" << std::endl;
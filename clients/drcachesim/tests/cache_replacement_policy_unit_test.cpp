@@ -37,6 +37,9 @@
 #include "cache_replacement_policy_unit_test.h"
 #include "simulator/cache_fifo.h"
 #include "simulator/cache_lru.h"
+#include "simulator/cache_plru.h"
+#include "simulator/cache_rrip.h"
+#include "simulator/cache_ship.h"
 
 // Indices for test address vector.
 enum {
@@ -66,7 +69,10 @@ template <class T> class cache_policy_test_t : public T {
     int total_size_;
 
 public:
-    cache_policy_test_t(int associativity, int line_size, int total_size)
+    template <typename... Args>
+    cache_policy_test_t(int associativity, int line_size, int total_size,
+                        Args... policy_args)
+        : T(policy_args...)
     {
         associativity_ = associativity;
         line_size_ = line_size;
@@ -96,6 +102,21 @@ public:
                expected_replacement_way_after_access);
     }
 
+    int_least64_t
+    access_and_count_hits(const std::vector<addr_t> &addresses, int repeats)
+    {
+        memref_t ref;
+        ref.data.type = TRACE_TYPE_READ;
+        ref.data.size = 1;
+        for (int i = 0; i < repeats; ++i) {
+            for (addr_t addr : addresses) {
+                ref.data.addr = addr;
+                this->request(ref);
+            }
+        }
+        return this->get_stats()->get_metric(metric_name_t::HITS);
+    }
+
     bool
     tags_are_different(const std::vector<addr_t> &addresses)
     {
@@ -240,6 +261,103 @@ unit_test_cache_fifo_eight_way()
     cache_fifo_test.access_and_check_cache(addr_vec[ADDR_L], 4); // I  J  K  L  e  F  G  H
 }
 
+void
+unit_test_cache_plru_four_way()
+{
+    cache_policy_test_t<cache_plru_t> cache_plru_test(/*associativity=*/4,
+                                                      /*line_size=*/32,
+                                                      /*total_size=*/256);
+    cache_plru_test.initialize_cache();
+
+    assert(cache_plru_test.block_indices_are_identical(addr_vec));
+    assert(cache_plru_test.tags_are_different(addr_vec));
+
+    // Lower-case letter shows the way that is to be replaced after the access.
+    // Unlike true LRU, after "A" the tree points at the pair holding C and D and
+    // then at C, even though D was touched more recently.
+    cache_plru_test.access_and_check_cache(addr_vec[ADDR_A], 1); // A x X X
+    cache_plru_test.access_and_check_cache(addr_vec[ADDR_B], 2); // A B x X
+    cache_plru_test.access_and_check_cache(addr_vec[ADDR_C], 3); // A B C x
+    cache_plru_test.access_and_check_cache(addr_vec[ADDR_D], 0); // a B C D
+    cache_plru_test.access_and_check_cache(addr_vec[ADDR_A], 2); // A B c D
+    cache_plru_test.access_and_check_cache(addr_vec[ADDR_E], 1); // A b E D
+    cache_plru_test.access_and_check_cache(addr_vec[ADDR_B], 3); // A B E d
+}
+
+void
+unit_test_cache_srrip_four_way()
+{
+    cache_policy_test_t<cache_rrip_t> cache_rrip_test(/*associativity=*/4,
+                                                      /*line_size=*/32,
+                                                      /*total_size=*/256);
+    cache_rrip_test.initialize_cache();
+
+    assert(cache_rrip_test.block_indices_are_identical(addr_vec));
+    assert(cache_rrip_test.tags_are_different(addr_vec));
+
+    // Lower-case letter shows the way that is to be replaced after the access,
+    // and the digits are the re-reference prediction values.
+    cache_rrip_test.access_and_check_cache(addr_vec[ADDR_A], 1); // A x X X  2---
+    cache_rrip_test.access_and_check_cache(addr_vec[ADDR_B], 2); // A B x X  22--
+    cache_rrip_test.access_and_check_cache(addr_vec[ADDR_C], 3); // A B C x  222-
+    cache_rrip_test.access_and_check_cache(addr_vec[ADDR_D], 0); // a B C D  2222
+    cache_rrip_test.access_and_check_cache(addr_vec[ADDR_A], 1); // A b C D  0222
+    cache_rrip_test.access_and_check_cache(addr_vec[ADDR_E], 2); // A E c D  1233
+    cache_rrip_test.access_and_check_cache(addr_vec[ADDR_A], 2); // A E c D  0233
+    cache_rrip_test.access_and_check_cache(addr_vec[ADDR_C], 3); // A E C d  0203
+    cache_rrip_test.access_and_check_cache(addr_vec[ADDR_F], 1); // A e C F  0202
+}
+
+void
+unit_test_cache_rrip_thrashing()
+{
+    // A cyclic working set one block larger than a set never hits under LRU or
+    // SRRIP, while bimodal insertion keeps part of it resident.
+    const std::vector<addr_t> cycle(addr_vec.begin(), addr_vec.begin() + 5);
+    cache_policy_test_t<cache_lru_t> cache_lru_test(/*associativity=*/4,
+                                                    /*line_size=*/32,
+                                                    /*total_size=*/256);
+    cache_lru_test.initialize_cache();
+    assert(cache_lru_test.access_and_count_hits(cycle, 100) == 0);
+
+    cache_policy_test_t<cache_rrip_t> cache_brrip_test(/*associativity=*/4,
+                                                       /*line_size=*/32,
+                                                       /*total_size=*/256,
+                                                       RRIP_INSERT_BIMODAL);
+    cache_brrip_test.initialize_cache();
+    assert(cache_brrip_test.access_and_count_hits(cycle, 100) > 100);
+
+    // DRRIP needs more sets than its leaders for set dueling to matter: with 128
+    // sets, a quarter are static leaders that keep missing, which steers the
+    // half that follow toward bimodal insertion.
+    std::vector<addr_t> all_sets_cycle;
+    for (addr_t line = 0; line < 5 * 128; ++line)
+        all_sets_cycle.push_back(line * 32);
+    cache_policy_test_t<cache_rrip_t> cache_wide_brrip_test(/*associativity=*/4,
+                                                            /*line_size=*/32,
+                                                            /*total_size=*/16384,
+                                                            RRIP_INSERT_BIMODAL);
+    cache_wide_brrip_test.initialize_cache();
+    int_least64_t brrip_hits =
+        cache_wide_brrip_test.access_and_count_hits(all_sets_cycle, 100);
+    cache_policy_test_t<cache_rrip_t> cache_drrip_test(/*associativity=*/4,
+                                                       /*line_size=*/32,
+                                                       /*total_size=*/16384,
+                                                       RRIP_INSERT_DYNAMIC);
+    cache_drrip_test.initialize_cache();
+    int_least64_t drrip_hits =
+        cache_drrip_test.access_and_count_hits(all_sets_cycle, 100);
+    assert(drrip_hits > brrip_hits / 2 && drrip_hits < brrip_hits);
+
+    // The cycle's single PC is learned to be dead on fill, so SHiP inserts it
+    // distant and keeps the rest of the set.
+    cache_policy_test_t<cache_ship_t> cache_ship_test(/*associativity=*/4,
+                                                      /*line_size=*/32,
+                                                      /*total_size=*/256);
+    cache_ship_test.initialize_cache();
+    assert(cache_ship_test.access_and_count_hits(cycle, 100) > 100);
+}
+
 void
 unit_test_cache_replacement_policy()
 {
@@ -247,5 +365,8 @@ unit_test_cache_replacement_policy()
     unit_test_cache_lru_eight_way();
     unit_test_cache_fifo_four_way();
     unit_test_cache_fifo_eight_way();
+    unit_test_cache_plru_four_way();
+    unit_test_cache_srrip_four_way();
+    unit_test_cache_rrip_thrashing();
     // XXX i#4842: Add more test sequences.
 }
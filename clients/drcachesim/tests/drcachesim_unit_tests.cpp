@@ -33,11 +33,40 @@
 // Unit tests for drcachesim
 #include <iostream>
 #include <cstdlib>
+#include <fstream>
+#include <memory>
 #undef NDEBUG
 #include <assert.h>
 #include "cache_replacement_policy_unit_test.h"
 #include "simulator/cache_simulator.h"
+#include "simulator/cache_sweep.h"
+#include "simulator/page_size_map.h"
+#include "simulator/page_walker.h"
+#include "simulator/tlb.h"
 #include "../common/memref.h"
+#ifdef HAS_ZLIB
+#    include <mutex>
+#    include "analyzer.h"
+#    include "../common/chunked_ostream.h"
+#    include "../common/directory_iterator.h"
+#    include "../common/gzip_ostream.h"
+#    include "reader/compressed_file_reader.h"
+#    include "reader/read_ahead_file_reader.h"
+#    include "reader/chunked_file_reader.h"
+#    include "reader/file_reader.h"
+#    include "tools/basic_counts.h"
+#    ifdef UNIX
+#        include "reader/mmap_file_reader.h"
+#    endif
+#    ifdef HAS_ZSTD
+#        include "../common/zstd_ostream.h"
+#        include "reader/zstd_file_reader.h"
+#    endif
+#    ifdef HAS_LZ4
+#        include "../common/lz4_ostream.h"
+#        include "reader/lz4_file_reader.h"
+#    endif
+#endif
 
 static cache_simulator_knobs_t
 make_test_knobs()
@@ -306,6 +335,1131 @@ LLC {
            num_accesses - 1);
 }
 
+static int_least64_t
+run_strided_loads(const std::string &prefetcher, int_least64_t *useful,
+                  int_least64_t *unused, int_least64_t *prefetch_misses = nullptr)
+{
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.data_prefetcher = prefetcher;
+    cache_simulator_t cache_sim(knobs);
+    memref_t ref;
+    ref.data.type = TRACE_TYPE_READ;
+    ref.data.pid = 0;
+    ref.data.tid = 0;
+    ref.data.size = 8;
+    ref.data.pc = 0x1000;
+    // One load walking a 4-line stride, far more lines than the caches hold.
+    for (int i = 0; i < 4000; i++) {
+        ref.data.addr = 0x100000 + i * 4 * 64;
+        if (!cache_sim.process_memref(ref)) {
+            std::cerr << "drcachesim unit_test_prefetchers failed: "
+                      << cache_sim.get_error_string() << "\n";
+            exit(1);
+        }
+    }
+    *useful = cache_sim.get_cache_metric(metric_name_t::PREFETCH_USEFUL, 1, 0,
+                                         cache_split_t::DATA);
+    *unused = cache_sim.get_cache_metric(metric_name_t::PREFETCH_UNUSED, 1, 0,
+                                         cache_split_t::DATA);
+    if (prefetch_misses != nullptr) {
+        *prefetch_misses = cache_sim.get_cache_metric(metric_name_t::PREFETCH_MISSES,
+                                                      1, 0, cache_split_t::DATA);
+    }
+    return cache_sim.get_cache_metric(metric_name_t::MISSES, 1, 0, cache_split_t::DATA);
+}
+
+void
+unit_test_prefetchers()
+{
+    int_least64_t useful, unused;
+    int_least64_t none_misses = run_strided_loads("none", &useful, &unused);
+    assert(none_misses == 4000 && useful == 0 && unused == 0);
+    // The next line is never touched.  Its prefetches miss too, but only the
+    // demand misses, which prefetch coverage is computed from, count as misses.
+    int_least64_t prefetch_misses;
+    int_least64_t nextline_misses =
+        run_strided_loads("nextline", &useful, &unused, &prefetch_misses);
+    assert(nextline_misses == 4000 && useful == 0 && unused > 0);
+    assert(prefetch_misses == 4000);
+    // Once trained, the stride prefetcher covers every load.
+    int_least64_t stride_misses =
+        run_strided_loads("stride", &useful, &unused);
+    assert(stride_misses < 10 && useful > 3990);
+    int_least64_t stream_misses =
+        run_strided_loads("stream", &useful, &unused);
+    // Streams stop at each 4K region, where they must be trained again.
+    assert(stream_misses == 4000 / 16 * 3 && useful == 4000 - stream_misses);
+}
+
+static int_least64_t
+run_snoop_filter_conflicts(unsigned int snoop_filter_size, int_least64_t *invalidates)
+{
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.num_cores = 2;
+    knobs.model_coherence = true;
+    knobs.snoop_filter_size = snoop_filter_size;
+    cache_simulator_t cache_sim(knobs);
+    memref_t ref;
+    ref.data.type = TRACE_TYPE_READ;
+    ref.data.pid = 0;
+    ref.data.tid = 0;
+    ref.data.size = 8;
+    ref.data.pc = 0x1000;
+    // Touch one more line than a snoop filter set holds, then the first line
+    // again.
+    for (int i = 0; i <= 17; i++) {
+        ref.data.addr = 0x100000 + (i % 17) * 64;
+        if (!cache_sim.process_memref(ref)) {
+            std::cerr << "drcachesim unit_test_snoop_filter failed: "
+                      << cache_sim.get_error_string() << "\n";
+            exit(1);
+        }
+    }
+    *invalidates = cache_sim.get_cache_metric(metric_name_t::COHERENCE_INVALIDATES, 1,
+                                              0, cache_split_t::DATA);
+    return cache_sim.get_cache_metric(metric_name_t::MISSES, 1, 0, cache_split_t::DATA);
+}
+
+// Returns the L1D misses when the snoop filter evicts a line other than the L1D's
+// replacement victim.
+static int_least64_t
+run_snoop_filter_victim(int_least64_t *invalidates)
+{
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.num_cores = 2;
+    knobs.model_coherence = true;
+    knobs.snoop_filter_size = 16;
+    knobs.L1D_size = 16 * 64;
+    knobs.L1D_assoc = 16;
+    cache_simulator_t cache_sim(knobs);
+    memref_t ref;
+    ref.data.type = TRACE_TYPE_READ;
+    ref.data.pid = 0;
+    ref.data.tid = 0;
+    ref.data.size = 8;
+    ref.data.pc = 0x1000;
+    // Fill the L1D and the filter, then hit the first line so that it is the
+    // filter's least recently used entry but not the L1D's.  Tracking a new line
+    // then invalidates the first line, whose way should take the new line, leaving
+    // the second line in place.
+    const int lines[] = { 0,  1,  2,  3,  4,  5,  6,  7,  8, 9,
+                          10, 11, 12, 13, 14, 15, 0, 16, 1 };
+    for (int line : lines) {
+        ref.data.addr = 0x100000 + line * 64;
+        if (!cache_sim.process_memref(ref)) {
+            std::cerr << "drcachesim unit_test_snoop_filter failed: "
+                      << cache_sim.get_error_string() << "\n";
+            exit(1);
+        }
+    }
+    *invalidates = cache_sim.get_cache_metric(metric_name_t::COHERENCE_INVALIDATES, 1,
+                                              0, cache_split_t::DATA);
+    return cache_sim.get_cache_metric(metric_name_t::MISSES, 1, 0, cache_split_t::DATA);
+}
+
+void
+unit_test_snoop_filter()
+{
+    int_least64_t invalidates;
+    // A perfect snoop filter leaves the L1D, which holds all 17 lines, alone.
+    assert(run_snoop_filter_conflicts(0, &invalidates) == 17 && invalidates == 0);
+    // The lines spread over the sets of a larger filter.
+    assert(run_snoop_filter_conflicts(16 * 1024, &invalidates) == 17 &&
+           invalidates == 0);
+    // A 16-entry filter evicts the first line from the L1D to track the last, and
+    // the second to track the first again.
+    assert(run_snoop_filter_conflicts(16, &invalidates) == 18 && invalidates == 2);
+    assert(run_snoop_filter_victim(&invalidates) == 17 && invalidates == 1);
+}
+
+// If mid_misses is non-null, the misses are also queried halfway through.
+static void
+run_sampled_loads(int num_refs, int num_lines, int_least64_t *hits, int_least64_t *misses,
+                  int_least64_t *mid_misses = nullptr)
+{
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.sample_period = 100;
+    knobs.sample_warmup_refs = 10;
+    knobs.sample_measure_refs = 10;
+    cache_simulator_t cache_sim(knobs);
+    memref_t ref;
+    ref.data.type = TRACE_TYPE_READ;
+    ref.data.pid = 0;
+    ref.data.tid = 0;
+    ref.data.size = 8;
+    ref.data.pc = 0x1000;
+    for (int i = 0; i < num_refs; i++) {
+        if (mid_misses != nullptr && i == num_refs / 2) {
+            *mid_misses = cache_sim.get_cache_metric(metric_name_t::MISSES, 1, 0,
+                                                     cache_split_t::DATA);
+        }
+        ref.data.addr = 0x100000 + (i % num_lines) * 64;
+        if (!cache_sim.process_memref(ref)) {
+            std::cerr << "drcachesim unit_test_sampling failed: "
+                      << cache_sim.get_error_string() << "\n";
+            exit(1);
+        }
+    }
+    *hits = cache_sim.get_cache_metric(metric_name_t::HITS, 1, 0, cache_split_t::DATA);
+    *misses =
+        cache_sim.get_cache_metric(metric_name_t::MISSES, 1, 0, cache_split_t::DATA);
+}
+
+void
+unit_test_sampling()
+{
+    int_least64_t hits, misses;
+    // Only the last 10 references of each period of 100 are measured.
+    run_sampled_loads(1000, 1000, &hits, &misses);
+    assert(hits == 0 && misses == 10 * 10);
+    // The warmup references bring the 8 lines back into the cache before each
+    // measurement.
+    run_sampled_loads(1000, 8, &hits, &misses);
+    assert(hits == 10 * 10 && misses == 0);
+    // A unit cut short by the end of the trace is dropped.
+    run_sampled_loads(1095, 1095, &hits, &misses);
+    assert(hits == 0 && misses == 10 * 10);
+    // Querying part way through does not end the sampling.
+    int_least64_t mid_misses;
+    run_sampled_loads(1000, 1000, &hits, &misses, &mid_misses);
+    assert(mid_misses == 5 * 10 && hits == 0 && misses == 10 * 10);
+}
+
+static double
+run_timed_loads(int num_lines, unsigned int l1_mshrs, double memory_bandwidth)
+{
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.model_timing = true;
+    knobs.L1_mshrs = l1_mshrs;
+    knobs.memory_bandwidth = memory_bandwidth;
+    cache_simulator_t cache_sim(knobs);
+    memref_t instr, load;
+    instr.instr.type = TRACE_TYPE_INSTR;
+    instr.instr.pid = 0;
+    instr.instr.tid = 0;
+    instr.instr.size = 4;
+    load.data.type = TRACE_TYPE_READ;
+    load.data.pid = 0;
+    load.data.tid = 0;
+    load.data.size = 8;
+    const int num_loads = 40000;
+    for (int i = 0; i < num_loads; i++) {
+        instr.instr.addr = 0x1000 + (i % 8) * 4;
+        load.data.pc = instr.instr.addr;
+        load.data.addr = 0x100000 + (i % num_lines) * 64;
+        if (!cache_sim.process_memref(instr) || !cache_sim.process_memref(load)) {
+            std::cerr << "drcachesim unit_test_timing_model failed: "
+                      << cache_sim.get_error_string() << "\n";
+            exit(1);
+        }
+    }
+    const timing_model_t *timing = cache_sim.get_timing_model();
+    assert(timing != nullptr && timing->get_instructions(0) == num_loads);
+    return timing->get_cycles(0) / num_loads;
+}
+
+void
+unit_test_timing_model()
+{
+    // Loads that hit leave the core running at its dispatch width of 4.
+    assert(run_timed_loads(8, 10, 16.0) < 0.3);
+    // Each load goes to memory in 4 + 40 + 200 cycles.  The reorder buffer
+    // holds far more of them than the 10 L1 MSHRs can track at once.
+    double cpi = run_timed_loads(4096, 10, 0.0);
+    assert(cpi > 244.0 / 10 - 1 && cpi < 244.0 / 10 + 1);
+    // With a single MSHR the misses no longer overlap.
+    assert(run_timed_loads(4096, 1, 0.0) > 240.0);
+    // At a byte per cycle, each 64-byte line takes 64 cycles to arrive.
+    cpi = run_timed_loads(4096, 10, 1.0);
+    assert(cpi > 64.0 && cpi < 64.0 + 4);
+}
+
+static void
+run_checkpointed_loads(cache_simulator_t &cache_sim, int_least64_t *hits,
+                       int_least64_t *misses)
+{
+    memref_t ref;
+    ref.data.type = TRACE_TYPE_READ;
+    ref.data.pid = 0;
+    ref.data.tid = 0;
+    ref.data.size = 8;
+    ref.data.pc = 0x1000;
+    for (int i = 0; i < 2000; i++) {
+        // Cycle through twice as many lines as the caches hold, out of order.
+        ref.data.addr = 0x100000 + ((i * 7) % 64) * 64;
+        if (!cache_sim.process_memref(ref)) {
+            std::cerr << "drcachesim unit_test_checkpoint failed: "
+                      << cache_sim.get_error_string() << "\n";
+            exit(1);
+        }
+    }
+    for (int level = 1; level <= 2; level++) {
+        hits[level - 1] = cache_sim.get_cache_metric(metric_name_t::HITS, level);
+        misses[level - 1] = cache_sim.get_cache_metric(metric_name_t::MISSES, level);
+    }
+}
+
+void
+unit_test_checkpoint()
+{
+    const char *path = "drcachesim_unit_tests.checkpoint";
+    int_least64_t hits[2], misses[2], restored_hits[2], restored_misses[2];
+    cache_simulator_knobs_t knobs = make_test_knobs();
+    knobs.replace_policy = "PLRU";
+    knobs.warmup_refs = 500;
+    knobs.save_checkpoint = path;
+    {
+        cache_simulator_t cache_sim(knobs);
+        run_checkpointed_loads(cache_sim, hits, misses);
+    }
+    // Resuming from the end of the warmup gives the same results, without
+    // simulating the warmup again.
+    knobs.warmup_refs = 0;
+    knobs.save_checkpoint = "";
+    knobs.restore_checkpoint = path;
+    {
+        cache_simulator_t cache_sim(knobs);
+        assert(!!cache_sim);
+        run_checkpointed_loads(cache_sim, restored_hits, restored_misses);
+    }
+    for (int i = 0; i < 2; i++)
+        assert(hits[i] == restored_hits[i] && misses[i] == restored_misses[i]);
+    // A checkpoint only fits the hierarchy it was taken from.
+    knobs.LL_size *= 2;
+    {
+        cache_simulator_t cache_sim(knobs);
+        assert(!cache_sim);
+    }
+    std::remove(path);
+}
+
+static void
+run_page_walks(bool huge_pages, int_least64_t *misses, int_least64_t *walk_refs)
+{
+    page_size_map_t page_size_map(4096);
+    if (huge_pages)
+        assert(page_size_map.add_range(0x40000000, 0x40400000, 0x200000));
+    page_walker_t walker(32, nullptr);
+    tlb_t tlb;
+    tlb_stats_t *stats = new tlb_stats_t(4096);
+    assert(tlb.init(4, 4096, 64, nullptr, stats));
+    tlb.set_page_size_map(&page_size_map);
+    tlb.set_page_walker(&walker);
+    memref_t ref;
+    ref.data.type = TRACE_TYPE_READ;
+    ref.data.pid = 0;
+    ref.data.tid = 0;
+    ref.data.size = 8;
+    ref.data.pc = 0x1000;
+    // Touch each 4K page of two 2M regions.
+    for (int i = 0; i < 1024; i++) {
+        ref.data.addr = 0x40000000 + i * 4096;
+        tlb.request(ref);
+    }
+    *misses = stats->get_metric(metric_name_t::MISSES);
+    *walk_refs = walker.get_walk_refs();
+    assert(walker.get_walks() == *misses);
+    delete stats;
+}
+
+void
+unit_test_page_walker()
+{
+    int_least64_t misses, walk_refs;
+    // Every 4K page misses.  The first walk reads all 4 levels, the first in
+    // the second 2M region finds its PDPTE in the walk cache, and the rest find
+    // their PDE.
+    run_page_walks(false, &misses, &walk_refs);
+    assert(misses == 1024 && walk_refs == 4 + 511 + 2 + 511);
+    // With 2M pages each region takes one TLB entry, and walks stop at the PDE.
+    run_page_walks(true, &misses, &walk_refs);
+    assert(misses == 2 && walk_refs == 3 + 1);
+}
+
+void
+unit_test_cache_pipeline()
+{
+    // Ensure simulating the L1 caches on their own threads gives the same results
+    // as a serial simulation, at every level.
+    std::string config = R"MYCONFIG(// 2-core 3-level non-inclusive config.
+num_cores       2
+line_size       64
+L1I_0 {
+  type            instruction
+  core            0
+  size            1K
+  assoc           4
+  prefetcher      none
+  parent          L2
+}
+L1D_0 {
+  type            data
+  core            0
+  size            1K
+  assoc           4
+  prefetcher      nextline
+  parent          L2
+}
+L1I_1 {
+  type            instruction
+  core            1
+  size            1K
+  assoc           4
+  prefetcher      none
+  parent          L2
+}
+L1D_1 {
+  type            data
+  core            1
+  size            1K
+  assoc           4
+  prefetcher      nextline
+  parent          L2
+}
+L2 {
+  size            8K
+  assoc           8
+  prefetcher      none
+  parent          LLC
+}
+LLC {
+  size            64K
+  assoc           8
+  prefetcher      none
+  parent          memory
+}
+)MYCONFIG";
+    std::istringstream serial_in(config);
+    cache_simulator_t serial_sim(&serial_in);
+    std::istringstream pipeline_in(config + "pipeline_workers 2\n");
+    cache_simulator_t pipeline_sim(&pipeline_in);
+    if (!serial_sim || !pipeline_sim) {
+        std::cerr << "drcachesim unit_test_cache_pipeline failed: "
+                  << pipeline_sim.get_error_string() << "\n";
+        exit(1);
+    }
+
+    // Enough references for several batches, mixing threads, types, and sizes
+    // that span lines, with a flush now and then.
+    uint64_t state = 1;
+    for (int i = 0; i < 100000; i++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        memref_t ref = {};
+        ref.data.tid = 1 + (state >> 60) % 3;
+        ref.data.pid = 1;
+        ref.data.addr = (state >> 20) % (256 * 1024);
+        ref.data.size = 1 + (state >> 10) % 96;
+        switch ((state >> 40) % 8) {
+        case 0:
+        case 1:
+        case 2: ref.data.type = TRACE_TYPE_INSTR; break;
+        case 3:
+        case 4:
+        case 5: ref.data.type = TRACE_TYPE_READ; break;
+        case 6: ref.data.type = TRACE_TYPE_WRITE; break;
+        default:
+            ref.flush.type = i % 2 == 0 ? TRACE_TYPE_INSTR_FLUSH : TRACE_TYPE_DATA_FLUSH;
+            ref.flush.size = 256;
+            break;
+        }
+        if (!serial_sim.process_memref(ref) || !pipeline_sim.process_memref(ref)) {
+            std::cerr << "drcachesim unit_test_cache_pipeline failed\n";
+            exit(1);
+        }
+    }
+    for (unsigned core = 0; core < 2; core++) {
+        for (unsigned level = 1; level <= 3; level++) {
+            for (metric_name_t metric :
+                 { metric_name_t::HITS, metric_name_t::MISSES,
+                   metric_name_t::COMPULSORY_MISSES, metric_name_t::CHILD_HITS,
+                   metric_name_t::PREFETCH_HITS, metric_name_t::FLUSHES }) {
+                for (cache_split_t split :
+                     { cache_split_t::DATA, cache_split_t::INSTRUCTION }) {
+                    assert(
+                        serial_sim.get_cache_metric(metric, level, core, split) ==
+                        pipeline_sim.get_cache_metric(metric, level, core, split));
+                }
+            }
+        }
+    }
+    assert(pipeline_sim.get_cache_metric(metric_name_t::CHILD_HITS, 3, 0) > 0);
+}
+
+// Exposes the simulators of a sweep.
+class cache_sweep_test_t : public cache_sweep_t {
+public:
+    cache_sweep_test_t(const std::vector<std::string> &config_files, int worker_count)
+        : cache_sweep_t(config_files, worker_count)
+    {
+    }
+    // Simulates the records still buffered, without printing the results.
+    bool
+    finish()
+    {
+        return dispatch() && wait_for_workers();
+    }
+    cache_simulator_t *
+    get_simulator(size_t index)
+    {
+        return simulators_[index];
+    }
+};
+
+void
+unit_test_cache_sweep()
+{
+    // Ensure each configuration of a sweep gives the same results as a standalone
+    // simulation of that configuration.
+    const int num_configs = 3;
+    const char *const l1d_geometries[num_configs] = { "size 1K\n  assoc 1",
+                                                      "size 1K\n  assoc 4",
+                                                      "size 4K\n  assoc 8" };
+    std::vector<std::string> configs, config_files;
+    for (int i = 0; i < num_configs; i++) {
+        configs.push_back(std::string(R"MYCONFIG(// 1-core 2-level config.
+num_cores       1
+line_size       64
+L1I {
+  type            instruction
+  core            0
+  size            1K
+  assoc           4
+  parent          LLC
+}
+L1D {
+  type            data
+  core            0
+  )MYCONFIG") + l1d_geometries[i] + R"MYCONFIG(
+  parent          LLC
+}
+LLC {
+  size            16K
+  assoc           8
+  parent          memory
+}
+)MYCONFIG");
+        config_files.push_back("drcachesim_unit_tests.sweep" + std::to_string(i) +
+                               ".conf");
+        std::ofstream out(config_files.back());
+        out << configs.back();
+    }
+    std::vector<std::unique_ptr<cache_simulator_t>> standalone;
+    for (const std::string &config : configs) {
+        std::istringstream in(config);
+        standalone.emplace_back(new cache_simulator_t(&in));
+        assert(!!*standalone.back());
+    }
+    // Test both the serial and the threaded sweep.
+    for (int workers : { 1, 2 }) {
+        cache_sweep_test_t sweep(config_files, workers);
+        if (!sweep) {
+            std::cerr << "drcachesim unit_test_cache_sweep failed: "
+                      << sweep.get_error_string() << "\n";
+            exit(1);
+        }
+        // Enough references for several batches, handed over both singly and in
+        // batches of varying sizes.
+        uint64_t state = 1;
+        std::vector<memref_t> batch;
+        size_t batch_size = 1;
+        for (int i = 0; i < 20000; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            memref_t ref = {};
+            ref.data.tid = 1;
+            ref.data.pid = 1;
+            ref.data.addr = (state >> 20) % (64 * 1024);
+            ref.data.size = 1 + (state >> 10) % 8;
+            ref.data.type = (state >> 40) % 3 == 0 ? TRACE_TYPE_INSTR : TRACE_TYPE_READ;
+            if (workers == 1) {
+                for (auto &sim : standalone) {
+                    bool ok = sim->process_memref(ref);
+                    assert(ok);
+                }
+            }
+            batch.push_back(ref);
+            if (batch.size() == batch_size) {
+                bool ok = batch_size == 1
+                    ? sweep.process_memref(batch[0])
+                    : sweep.process_memref_batch(batch.data(), batch.size());
+                assert(ok);
+                batch.clear();
+                batch_size = 1 + (state >> 50) % 1000;
+            }
+        }
+        bool ok = sweep.process_memref_batch(batch.data(), batch.size()) &&
+            sweep.finish();
+        assert(ok);
+        for (int i = 0; i < num_configs; i++) {
+            for (unsigned level = 1; level <= 2; level++) {
+                for (metric_name_t metric :
+                     { metric_name_t::HITS, metric_name_t::MISSES,
+                       metric_name_t::COMPULSORY_MISSES }) {
+                    for (cache_split_t split :
+                         { cache_split_t::DATA, cache_split_t::INSTRUCTION }) {
+                        assert(sweep.get_simulator(i)->get_cache_metric(
+                                   metric, level, 0, split) ==
+                               standalone[i]->get_cache_metric(metric, level, 0, split));
+                    }
+                }
+            }
+        }
+    }
+    // The geometries should differ in their results.
+    assert(standalone[0]->get_cache_metric(metric_name_t::MISSES, 1) >
+           standalone[2]->get_cache_metric(metric_name_t::MISSES, 1));
+    for (const std::string &file : config_files)
+        std::remove(file.c_str());
+}
+
+#ifdef HAS_ZLIB
+static trace_entry_t
+make_entry(unsigned short type, unsigned short size, addr_t addr)
+{
+    trace_entry_t entry;
+    entry.type = type;
+    entry.size = size;
+    entry.addr = addr;
+    return entry;
+}
+
+// Writes a single-thread trace where instruction #N (1-based) is at pc 0x1000+N*4
+// and is followed by a load from address N*64.  If buffers_per_window is non-zero
+// the trace is split into windows of that many buffers.
+static void
+write_test_trace(std::ostream &out, int num_buffers, int instrs_per_buffer,
+                 int buffers_per_window = 0)
+{
+    std::vector<trace_entry_t> entries;
+    entries.push_back(make_entry(TRACE_TYPE_HEADER, 0, TRACE_ENTRY_VERSION));
+    entries.push_back(
+        make_entry(TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_VERSION, TRACE_ENTRY_VERSION));
+    entries.push_back(make_entry(TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_FILETYPE,
+                                 OFFLINE_FILE_TYPE_DEFAULT));
+    entries.push_back(make_entry(TRACE_TYPE_THREAD, 4, 42));
+    entries.push_back(make_entry(TRACE_TYPE_PID, 4, 41));
+    addr_t ordinal = 0;
+    for (int i = 0; i < num_buffers; ++i) {
+        entries.push_back(
+            make_entry(TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_TIMESTAMP, 100 + i));
+        if (buffers_per_window > 0) {
+            entries.push_back(make_entry(TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_WINDOW_ID,
+                                         i / buffers_per_window));
+        }
+        entries.push_back(make_entry(TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_CPU_ID, 0));
+        for (int j = 0; j < instrs_per_buffer; ++j) {
+            ++ordinal;
+            entries.push_back(make_entry(TRACE_TYPE_INSTR, 4, 0x1000 + ordinal * 4));
+            entries.push_back(make_entry(TRACE_TYPE_READ, 8, ordinal * 64));
+        }
+    }
+    entries.push_back(make_entry(TRACE_TYPE_THREAD_EXIT, 4, 42));
+    entries.push_back(make_entry(TRACE_TYPE_FOOTER, 0, 0));
+    // Use odd-sized writes to exercise records split across writes.
+    const char *data = reinterpret_cast<const char *>(entries.data());
+    size_t size = entries.size() * sizeof(entries[0]);
+    for (size_t pos = 0; pos < size; pos += 1000)
+        out.write(data + pos, std::min<size_t>(1000, size - pos));
+}
+
+static void
+check_skip(reader_t &reader, uint64_t skip, uint64_t expect_ordinal)
+{
+    reader.skip_instructions(skip);
+    assert(reader.get_instruction_ordinal() == expect_ordinal);
+    const memref_t &memref = *reader;
+    assert(memref.instr.type == TRACE_TYPE_INSTR);
+    assert(memref.instr.addr == 0x1000 + expect_ordinal * 4);
+    assert(memref.instr.tid == 42 && memref.instr.pid == 41);
+    ++reader;
+    assert((*reader).data.type == TRACE_TYPE_READ);
+    assert((*reader).data.addr == expect_ordinal * 64);
+}
+
+static void
+unit_test_chunked_file_skip()
+{
+    const int num_buffers = 50;
+    const int instrs_per_buffer = 100;
+    const char *chunked_path = "drcachesim_unit_tests.trace.chunked";
+    const char *plain_path = "drcachesim_unit_tests.trace";
+    {
+        chunked_ostream_t out(chunked_path, 1000);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    {
+        std::ofstream out(plain_path, std::ofstream::binary);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    // The chunked reader seeks while the plain reader walks: both should land in
+    // the same place.
+    chunked_file_reader_t chunked(chunked_path);
+    file_reader_t<std::ifstream *> plain(plain_path);
+    for (reader_t *reader : std::vector<reader_t *> { &chunked, &plain }) {
+        bool ok = reader->init();
+        assert(ok);
+        // Skipping from before the first instruction walks into the first chunk.
+        check_skip(*reader, 9, 10);
+        check_skip(*reader, 0, 11);
+        // Cross several chunk boundaries.
+        check_skip(*reader, 3488, 3500);
+        // Land exactly on the first instruction after a chunk boundary.
+        check_skip(*reader, 500, 4001);
+        // Skip past the end.
+        reader->skip_instructions(num_buffers * instrs_per_buffer);
+        assert(*reader == file_reader_t<std::ifstream *>());
+    }
+    std::remove(chunked_path);
+    std::remove(plain_path);
+}
+
+// Counts the entries it reads, to check that next_batch() consumes the input
+// exactly as operator++ does.
+class counting_reader_t : public file_reader_t<std::ifstream *> {
+public:
+    counting_reader_t(const std::string &path)
+        : file_reader_t<std::ifstream *>(path)
+    {
+    }
+    uint64_t count = 0;
+
+protected:
+    bool
+    read_next_thread_entry(size_t thread_index, OUT trace_entry_t *entry,
+                           OUT bool *eof) override
+    {
+        ++count;
+        return file_reader_t<std::ifstream *>::read_next_thread_entry(thread_index,
+                                                                      entry, eof);
+    }
+};
+
+static void
+unit_test_next_batch()
+{
+    const int num_buffers = 10;
+    const int instrs_per_buffer = 100;
+    const char *path = "drcachesim_unit_tests.batch.trace";
+    {
+        std::ofstream out(path, std::ofstream::binary);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    counting_reader_t batched(path);
+    counting_reader_t single(path);
+    bool ok = batched.init() && single.init();
+    assert(ok);
+    // An odd batch size leaves a partial final batch.
+    std::vector<memref_t> batch(7);
+    uint64_t total = 0;
+    size_t count;
+    while ((count = batched.next_batch(batch.data(), batch.size())) > 0) {
+        for (size_t i = 0; i < count; ++i, ++single, ++total) {
+            assert(single != file_reader_t<std::ifstream *>());
+            const memref_t &expect = *single;
+            const memref_t &actual = batch[i];
+            assert(expect.data.type == actual.data.type &&
+                   expect.data.tid == actual.data.tid);
+            if (expect.marker.type == TRACE_TYPE_MARKER) {
+                assert(expect.marker.marker_type == actual.marker.marker_type &&
+                       expect.marker.marker_value == actual.marker.marker_value);
+            } else
+                assert(expect.data.addr == actual.data.addr);
+        }
+    }
+    assert(single == file_reader_t<std::ifstream *>());
+    assert(batched == file_reader_t<std::ifstream *>());
+    assert(batched.count == single.count);
+    assert(total > 0);
+    assert(batched.get_instruction_ordinal() == num_buffers * instrs_per_buffer);
+    std::remove(path);
+}
+
+// Checks that the pieces of a split shard cover the whole file exactly once and
+// are merged in trace order.
+class subshard_test_tool_t : public analysis_tool_t {
+public:
+    struct shard_t {
+        uint64_t instrs = 0;
+        addr_t first_pc = 0;
+        addr_t last_pc = 0;
+        int filetypes = 0;
+        int exits = 0;
+        bool merged = false;
+    };
+    bool
+    process_memref(const memref_t &memref) override
+    {
+        return false;
+    }
+    bool
+    print_results() override
+    {
+        return true;
+    }
+    bool
+    parallel_shard_supported() override
+    {
+        return true;
+    }
+    bool
+    parallel_subshard_supported() override
+    {
+        return true;
+    }
+    void *
+    parallel_shard_init(int shard_index, void *worker_data) override
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        shards_.emplace_back(new shard_t);
+        return shards_.back().get();
+    }
+    bool
+    parallel_shard_memref(void *shard_data, const memref_t &memref) override
+    {
+        shard_t *shard = reinterpret_cast<shard_t *>(shard_data);
+        if (memref.instr.type == TRACE_TYPE_INSTR) {
+            assert(shard->last_pc == 0 || memref.instr.addr == shard->last_pc + 4);
+            if (shard->first_pc == 0)
+                shard->first_pc = memref.instr.addr;
+            shard->last_pc = memref.instr.addr;
+            ++shard->instrs;
+        } else if (memref.marker.type == TRACE_TYPE_MARKER &&
+                   memref.marker.marker_type == TRACE_MARKER_TYPE_FILETYPE)
+            ++shard->filetypes;
+        else if (memref.exit.type == TRACE_TYPE_THREAD_EXIT)
+            ++shard->exits;
+        return true;
+    }
+    bool
+    parallel_shard_merge(void *dst_shard_data, void *src_shard_data) override
+    {
+        shard_t *dst = reinterpret_cast<shard_t *>(dst_shard_data);
+        shard_t *src = reinterpret_cast<shard_t *>(src_shard_data);
+        assert(src->first_pc == dst->last_pc + 4);
+        dst->instrs += src->instrs;
+        dst->last_pc = src->last_pc;
+        dst->filetypes += src->filetypes;
+        dst->exits += src->exits;
+        src->merged = true;
+        return true;
+    }
+    std::vector<std::unique_ptr<shard_t>> shards_;
+
+private:
+    std::mutex mutex_;
+};
+
+static void
+unit_test_chunked_subshards()
+{
+    const int num_buffers = 50;
+    const int instrs_per_buffer = 100;
+    const std::string dir = "drcachesim_unit_tests.subshard.dir";
+    const std::string path = dir + DIRSEP + "drmemtrace.test.trace.chunked";
+    bool ok = directory_iterator_t::is_directory(dir) ||
+        directory_iterator_t::create_directory(dir);
+    assert(ok);
+    {
+        chunked_ostream_t out(path, 1000);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    // Five chunks over four workers gives four pieces.
+    subshard_test_tool_t tool;
+    analysis_tool_t *tools[] = { &tool };
+    analyzer_t analyzer(dir, tools, 1, 4);
+    assert(!!analyzer);
+    ok = analyzer.run();
+    assert(ok);
+    assert(tool.shards_.size() == 4);
+    const subshard_test_tool_t::shard_t *whole = nullptr;
+    for (const auto &shard : tool.shards_) {
+        if (!shard->merged) {
+            assert(whole == nullptr);
+            whole = shard.get();
+        }
+    }
+    assert(whole != nullptr);
+    assert(whole->instrs == num_buffers * instrs_per_buffer);
+    assert(whole->first_pc == 0x1000 + 4);
+    assert(whole->last_pc == 0x1000 + whole->instrs * 4);
+    assert(whole->filetypes == 1 && whole->exits == 1);
+    std::remove(path.c_str());
+    std::remove(dir.c_str());
+}
+
+static void
+unit_test_chunked_windowed_shards()
+{
+    const int num_buffers = 50;
+    const int instrs_per_buffer = 100;
+    const std::string dir = "drcachesim_unit_tests.windowed.dir";
+    const std::string path = dir + DIRSEP + "drmemtrace.test.trace.chunked";
+    bool ok = directory_iterator_t::is_directory(dir) ||
+        directory_iterator_t::create_directory(dir);
+    assert(ok);
+    {
+        chunked_ostream_t out(path, 1000);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer, 10);
+    }
+    // Pieces of a windowed file cannot be merged, so the file should be analyzed
+    // whole even with workers to spare.
+    subshard_test_tool_t tool;
+    basic_counts_t counts(0);
+    analysis_tool_t *tools[] = { &tool, &counts };
+    analyzer_t analyzer(dir, tools, 2, 4);
+    assert(!!analyzer);
+    ok = analyzer.run();
+    assert(ok);
+    assert(tool.shards_.size() == 1);
+    assert(tool.shards_[0]->instrs == num_buffers * instrs_per_buffer);
+    std::remove(path.c_str());
+    std::remove(dir.c_str());
+}
+
+// Counts instructions in serial mode.
+class instr_count_tool_t : public analysis_tool_t {
+public:
+    bool
+    process_memref(const memref_t &memref) override
+    {
+        if (type_is_instr(memref.instr.type))
+            ++instrs;
+        return true;
+    }
+    bool
+    print_results() override
+    {
+        return true;
+    }
+    uint64_t instrs = 0;
+};
+
+static void
+unit_test_mixed_directory()
+{
+    const int num_buffers = 10;
+    const int instrs_per_buffer = 100;
+    const std::string dir = "drcachesim_unit_tests.mixed.dir";
+    const std::string plain_path = dir + DIRSEP + "drmemtrace.plain.trace";
+    const std::string gzip_path = dir + DIRSEP + "drmemtrace.gzip.trace.gz";
+    const std::string chunked_path = dir + DIRSEP + "drmemtrace.chunked.trace.chunked";
+    bool ok = directory_iterator_t::is_directory(dir) ||
+        directory_iterator_t::create_directory(dir);
+    assert(ok);
+    {
+        std::ofstream out(plain_path, std::ofstream::binary);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    {
+        gzip_ostream_t out(gzip_path);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    // The default reader handles both uncompressed and gzipped files.
+    {
+        instr_count_tool_t tool;
+        analysis_tool_t *tools[] = { &tool };
+        analyzer_t analyzer(dir, tools, 1);
+        assert(!!analyzer);
+        ok = analyzer.run();
+        assert(ok);
+        assert(tool.instrs == 2 * num_buffers * instrs_per_buffer);
+    }
+    // No one reader handles both chunked and uncompressed files.
+    {
+        chunked_ostream_t out(chunked_path, 1000);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    {
+        instr_count_tool_t tool;
+        analysis_tool_t *tools[] = { &tool };
+        analyzer_t analyzer(dir, tools, 1);
+        assert(!analyzer);
+    }
+    std::remove(plain_path.c_str());
+    std::remove(gzip_path.c_str());
+    std::remove(chunked_path.c_str());
+    std::remove(dir.c_str());
+}
+
+static void
+unit_test_read_ahead()
+{
+    // Enough records to cycle through the read-ahead ring several times.
+    const int num_buffers = 500;
+    const int instrs_per_buffer = 100;
+    const char *path = "drcachesim_unit_tests.read_ahead.trace.gz";
+    {
+        gzip_ostream_t out(path);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    read_ahead_file_reader_t read_ahead(path);
+    compressed_file_reader_t plain(path);
+    bool ok = read_ahead.init() && plain.init();
+    assert(ok);
+    uint64_t count = 0;
+    for (; plain != compressed_file_reader_t(); ++plain, ++read_ahead, ++count) {
+        assert(read_ahead != compressed_file_reader_t());
+        const memref_t &expect = *plain;
+        const memref_t &actual = *read_ahead;
+        assert(expect.data.type == actual.data.type &&
+               expect.data.tid == actual.data.tid);
+        if (expect.marker.type == TRACE_TYPE_MARKER) {
+            assert(expect.marker.marker_type == actual.marker.marker_type &&
+                   expect.marker.marker_value == actual.marker.marker_value);
+        } else {
+            assert(expect.data.addr == actual.data.addr);
+        }
+    }
+    assert(read_ahead == compressed_file_reader_t());
+    assert(read_ahead.get_instruction_ordinal() == num_buffers * instrs_per_buffer);
+    assert(count > 2 * num_buffers * instrs_per_buffer);
+    std::remove(path);
+}
+
+#    ifdef UNIX
+void
+unit_test_mmap_reader()
+{
+    const int num_buffers = 50;
+    const int instrs_per_buffer = 100;
+    const char *path = "drcachesim_unit_tests.mmap.trace";
+    {
+        std::ofstream out(path, std::ofstream::binary);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    mmap_file_reader_t mapped(path);
+    assert(mapped.is_complete());
+    // zlib reads uncompressed files as well.
+    compressed_file_reader_t plain(path);
+    bool ok = mapped.init() && plain.init();
+    assert(ok);
+    for (; plain != compressed_file_reader_t(); ++plain, ++mapped) {
+        assert(mapped != compressed_file_reader_t());
+        const memref_t &expect = *plain;
+        const memref_t &actual = *mapped;
+        assert(expect.data.type == actual.data.type &&
+               expect.data.tid == actual.data.tid);
+        if (expect.marker.type == TRACE_TYPE_MARKER) {
+            assert(expect.marker.marker_type == actual.marker.marker_type &&
+                   expect.marker.marker_value == actual.marker.marker_value);
+        } else
+            assert(expect.data.addr == actual.data.addr);
+    }
+    assert(mapped == compressed_file_reader_t());
+    assert(mapped.get_instruction_ordinal() == num_buffers * instrs_per_buffer);
+    std::remove(path);
+}
+#    endif
+
+#    if defined(HAS_ZSTD) || defined(HAS_LZ4)
+// Checks that reader yields the same records as the uncompressed trace file at
+// plain_path.
+static void
+check_same_records(reader_t &reader, const char *plain_path)
+{
+    file_reader_t<std::ifstream *> plain(plain_path);
+    bool ok = plain.init() && reader.init();
+    assert(ok);
+    for (; plain != file_reader_t<std::ifstream *>(); ++plain, ++reader) {
+        assert(reader != file_reader_t<std::ifstream *>());
+        const memref_t &expect = *plain;
+        const memref_t &actual = *reader;
+        assert(expect.data.type == actual.data.type &&
+               expect.data.tid == actual.data.tid);
+        if (expect.marker.type == TRACE_TYPE_MARKER) {
+            assert(expect.marker.marker_type == actual.marker.marker_type &&
+                   expect.marker.marker_value == actual.marker.marker_value);
+        } else
+            assert(expect.data.addr == actual.data.addr);
+    }
+    assert(reader == file_reader_t<std::ifstream *>());
+    assert(reader.get_instruction_ordinal() == plain.get_instruction_ordinal());
+}
+#    endif
+
+#    ifdef HAS_ZSTD
+static void
+unit_test_zstd_round_trip()
+{
+    const int num_buffers = 50;
+    const int instrs_per_buffer = 100;
+    const char *plain_path = "drcachesim_unit_tests.zstd.trace";
+    const char *path = "drcachesim_unit_tests.trace.zst";
+    const char *dict_path = "drcachesim_unit_tests.zstd.dict";
+    const char *dict_trace_path = "drcachesim_unit_tests.dict.trace.zst";
+    {
+        std::ofstream out(plain_path, std::ofstream::binary);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    {
+        zstd_ostream_t out(path);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    {
+        zstd_file_reader_t reader(path, "");
+        check_same_records(reader, plain_path);
+    }
+    // A shorter trace of the same shape serves as a raw content dictionary.
+    std::ostringstream dict;
+    write_test_trace(dict, 1, instrs_per_buffer);
+    {
+        std::ofstream out(dict_path, std::ofstream::binary);
+        assert(out);
+        out << dict.str();
+    }
+    {
+        zstd_ostream_t out(dict_trace_path, dict.str());
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    {
+        zstd_file_reader_t reader(dict_trace_path, dict_path);
+        check_same_records(reader, plain_path);
+    }
+    std::remove(plain_path);
+    std::remove(path);
+    std::remove(dict_path);
+    std::remove(dict_trace_path);
+}
+#    endif
+
+#    ifdef HAS_LZ4
+static void
+unit_test_lz4_round_trip()
+{
+    const int num_buffers = 50;
+    const int instrs_per_buffer = 100;
+    const char *plain_path = "drcachesim_unit_tests.lz4.trace";
+    const char *path = "drcachesim_unit_tests.trace.lz4";
+    {
+        std::ofstream out(plain_path, std::ofstream::binary);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    {
+        lz4_ostream_t out(path);
+        assert(out);
+        write_test_trace(out, num_buffers, instrs_per_buffer);
+    }
+    lz4_file_reader_t reader(path);
+    check_same_records(reader, plain_path);
+    std::remove(plain_path);
+    std::remove(path);
+}
+#    endif
+#endif
+
 int
 main(int argc, const char *argv[])
 {
@@ -315,6 +1469,31 @@ main(int argc, const char *argv[])
     unit_test_warmup_refs();
     unit_test_sim_refs();
     unit_test_child_hits();
+    unit_test_prefetchers();
+    unit_test_snoop_filter();
+    unit_test_sampling();
+    unit_test_page_walker();
+    unit_test_timing_model();
+    unit_test_checkpoint();
+    unit_test_cache_pipeline();
+    unit_test_cache_sweep();
     unit_test_cache_replacement_policy();
+#ifdef HAS_ZLIB
+    unit_test_chunked_file_skip();
+    unit_test_next_batch();
+    unit_test_chunked_subshards();
+    unit_test_chunked_windowed_shards();
+    unit_test_mixed_directory();
+    unit_test_read_ahead();
+#    ifdef UNIX
+    unit_test_mmap_reader();
+#    endif
+#    ifdef HAS_ZSTD
+    unit_test_zstd_round_trip();
+#    endif
+#    ifdef HAS_LZ4
+    unit_test_lz4_round_trip();
+#    endif
+#endif
     return 0;
 }
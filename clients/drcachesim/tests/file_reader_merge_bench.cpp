@@ -0,0 +1,200 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Microbenchmark for file_reader_t's merging of many thread files into a
+ * single stream in timestamp order.  Each synthetic thread switches at every
+ * timestamp, and the total number of records is held roughly constant across
+ * thread counts, so the time per switch exposes the cost of picking the next
+ * thread.  The merged output is also checked for timestamp order.
+ *
+ * Usage: tool.drcachesim.file_reader_merge_bench [total_timestamps]
+ */
+
+#include <assert.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../common/memref.h"
+#include "../common/trace_entry.h"
+#include "../reader/file_reader.h"
+
+namespace {
+
+// An in-memory thread file whose records are generated on the fly.
+struct synthetic_thread_t {
+    size_t index;
+    uint64_t pos;
+};
+
+// Shared by all synthetic threads.
+size_t num_threads;
+uint64_t timestamps_per_thread;
+const uint64_t RECORDS_PER_TIMESTAMP = 4;
+const uint64_t HEADER_RECORDS = 3;
+
+} // namespace
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<synthetic_thread_t *>::~file_reader_t()
+{
+    for (auto thread : input_files_)
+        delete thread;
+    delete[] thread_eof_;
+}
+
+template <>
+bool
+file_reader_t<synthetic_thread_t *>::open_single_file(const std::string &path)
+{
+    // The path is just the thread's index.
+    input_files_.push_back(new synthetic_thread_t{ std::stoul(path), 0 });
+    return true;
+}
+
+template <>
+bool
+file_reader_t<synthetic_thread_t *>::read_next_thread_entry(size_t thread_index,
+                                                            OUT trace_entry_t *entry,
+                                                            OUT bool *eof)
+{
+    synthetic_thread_t *thread = input_files_[thread_index];
+    uint64_t pos = thread->pos++;
+    if (pos == 0) {
+        *entry = { TRACE_TYPE_HEADER, 0, { TRACE_ENTRY_VERSION } };
+    } else if (pos == 1) {
+        *entry = { TRACE_TYPE_THREAD,
+                   sizeof(int),
+                   { static_cast<addr_t>(1 + thread->index) } };
+    } else if (pos == 2) {
+        *entry = { TRACE_TYPE_PID, sizeof(int), { 1 } };
+    } else {
+        pos -= HEADER_RECORDS;
+        uint64_t round = pos / (RECORDS_PER_TIMESTAMP + 1);
+        if (round >= timestamps_per_thread) {
+            *eof = true;
+            return false;
+        }
+        uint64_t offs = pos % (RECORDS_PER_TIMESTAMP + 1);
+        if (offs == 0) {
+            // Interleave the threads round-robin, in reverse index order so
+            // a scan that favors low indices gains nothing.
+            uint64_t time = 1 + round * num_threads + (num_threads - 1 - thread->index);
+            *entry = { TRACE_TYPE_MARKER,
+                       TRACE_MARKER_TYPE_TIMESTAMP,
+                       { static_cast<addr_t>(time) } };
+        } else {
+            *entry = { TRACE_TYPE_INSTR, 4,
+                       { static_cast<addr_t>(0x1000 + 4 * (pos % 64)) } };
+        }
+    }
+    return true;
+}
+
+template <>
+bool
+file_reader_t<synthetic_thread_t *>::seek_thread_to_instruction(
+    size_t thread_index, uint64_t target_ordinal, OUT uint64_t *instrs_before)
+{
+    return false;
+}
+
+template <>
+bool
+file_reader_t<synthetic_thread_t *>::is_complete()
+{
+    return false;
+}
+
+namespace {
+
+bool
+run_benchmark(size_t threads, uint64_t total_timestamps)
+{
+    num_threads = threads;
+    timestamps_per_thread = total_timestamps / threads;
+    if (timestamps_per_thread == 0)
+        timestamps_per_thread = 1;
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < threads; ++i)
+        paths.push_back(std::to_string(i));
+    file_reader_t<synthetic_thread_t *> reader(paths);
+    file_reader_t<synthetic_thread_t *> end;
+    auto start = std::chrono::steady_clock::now();
+    if (!reader.init()) {
+        std::cerr << "Failed to initialize the reader\n";
+        return false;
+    }
+    uint64_t records = 0, last_time = 0, switches = 0;
+    for (; reader != end; ++reader, ++records) {
+        const memref_t &memref = *reader;
+        if (memref.marker.type == TRACE_TYPE_MARKER &&
+            memref.marker.marker_type == TRACE_MARKER_TYPE_TIMESTAMP) {
+            if (memref.marker.marker_value < last_time) {
+                std::cerr << "Timestamp " << memref.marker.marker_value
+                          << " is out of order\n";
+                return false;
+            }
+            last_time = memref.marker.marker_value;
+            ++switches;
+        }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+    if (switches != threads * timestamps_per_thread) {
+        std::cerr << "Expected " << threads * timestamps_per_thread
+                  << " timestamps but saw " << switches << "\n";
+        return false;
+    }
+    std::cout << threads << " threads: " << records << " records, " << switches
+              << " switches in " << elapsed << "us ("
+              << (switches == 0 ? 0 : elapsed * 1000 / switches) << "ns/switch)\n";
+    return true;
+}
+
+} // namespace
+
+int
+main(int argc, const char *argv[])
+{
+    uint64_t total_timestamps = 200000;
+    if (argc > 1)
+        total_timestamps = std::stoull(argv[1]);
+    for (size_t threads : { 10, 100, 1000, 10000 }) {
+        if (!run_benchmark(threads, total_timestamps))
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Tests the stack distances computed for the miss ratio curve tool against a
+ * brute-force LRU stack.
+ */
+
+#include <iostream>
+#include <list>
+#include <vector>
+
+#include "../tools/miss_ratio_curve.h"
+#include "../common/memref.h"
+#include "memref_gen.h"
+
+namespace {
+
+bool
+check_stack_distance()
+{
+    // Enough lines and accesses to go through several tree compactions.
+    static constexpr int NUM_LINES = 3000;
+    static constexpr int NUM_ACCESSES = 100000;
+    stack_distance_tree_t tree;
+    std::list<addr_t> lru;
+    uint32_t seed = 1;
+    for (int i = 0; i < NUM_ACCESSES; ++i) {
+        seed = seed * 1103515245 + 12345;
+        // Favor a hot subset so there is a spread of short and long distances.
+        addr_t tag = (seed >> 16) % (i % 4 == 0 ? NUM_LINES : NUM_LINES / 20);
+        int_least64_t expect = -1;
+        int_least64_t depth = 0;
+        for (auto it = lru.begin(); it != lru.end(); ++it, ++depth) {
+            if (*it == tag) {
+                expect = depth;
+                lru.erase(it);
+                break;
+            }
+        }
+        lru.push_front(tag);
+        int_least64_t dist = tree.access(tag);
+        if (dist != expect) {
+            std::cerr << "access #" << i << " to " << tag << ": got distance " << dist
+                      << ", expected " << expect << "\n";
+            return false;
+        }
+    }
+    if (tree.unique_lines() != lru.size()) {
+        std::cerr << "got " << tree.unique_lines() << " unique lines, expected "
+                  << lru.size() << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool
+check_tool()
+{
+    static constexpr unsigned int LINE_SIZE = 64;
+    miss_ratio_curve_t tool(LINE_SIZE, 0);
+    // Two threads cycling through 4 and 8 lines respectively.
+    for (int i = 0; i < 64; ++i) {
+        if (!tool.process_memref(gen_data(1, /*load=*/true, (i % 4) * LINE_SIZE, 8)) ||
+            !tool.process_memref(gen_instr(2, 0x1000 + (i % 8) * LINE_SIZE)))
+            return false;
+    }
+    return tool.print_results();
+}
+
+} // namespace
+
+int
+main(int argc, const char *argv[])
+{
+    if (check_stack_distance() && check_tool()) {
+        std::cerr << "miss_ratio_curve_test passed\n";
+        return 0;
+    }
+    std::cerr << "miss_ratio_curve_test FAILED\n";
+    exit(1);
+}
@@ -33,10 +33,18 @@
 /* Unit tests for raw2trace. */
 
 #include "dr_api.h"
+#include "tracer/persistent_decode_cache.h"
 #include "tracer/raw2trace.h"
 #include "tracer/raw2trace_directory.h"
+#include "common/directory_iterator.h"
+#include "common/follow_istream.h"
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #undef ASSERT
 #define ASSERT(cond, msg, ...)        \
@@ -71,17 +79,22 @@ class raw2trace_test_t : public raw2trace_t {
 public:
     raw2trace_test_t(const std::vector<std::istream *> &input,
                      const std::vector<std::ostream *> &output, instrlist_t &instrs,
-                     void *drcontext)
+                     void *drcontext, const std::string &decode_cache_dir = "",
+                     int worker_count = -1)
         : raw2trace_t(nullptr, input, output, drcontext,
                       // The sequences are small so we print everything for easier
                       // debugging and viewing of what's going on.
-                      4)
+                      4, worker_count, "", decode_cache_dir)
     {
+        // The decode cache identifies our module by its contents.
+        memset(decode_buf_, 0, sizeof(decode_buf_));
         byte *pc = instrlist_encode(drcontext, &instrs, decode_buf_, true);
         ASSERT(pc - decode_buf_ < MAX_DECODE_SIZE, "decode buffer overflow");
         set_modvec_(&modules_);
     }
 
+    static const int MAX_DECODE_SIZE = 1024;
+
 protected:
     std::string
     read_and_map_modules() override
@@ -92,7 +105,6 @@ protected:
     }
 
 private:
-    static const int MAX_DECODE_SIZE = 1024;
     byte decode_buf_[MAX_DECODE_SIZE];
     std::vector<module_t> modules_;
 };
@@ -159,6 +171,15 @@ make_block(uint64_t offs, uint64_t instr_count)
     return entry;
 }
 
+offline_entry_t
+make_memref(uint64_t addr)
+{
+    offline_entry_t entry;
+    entry.addr.type = OFFLINE_TYPE_MEMREF;
+    entry.addr.addr = addr;
+    return entry;
+}
+
 offline_entry_t
 make_timestamp()
 {
@@ -280,6 +301,286 @@ test_branch_delays(void *drcontext)
     return true;
 }
 
+std::string
+convert(void *drcontext, instrlist_t *ilist, const std::vector<offline_entry_t> &raw,
+        const std::string &decode_cache_dir, OUT std::string *result)
+{
+    std::ostringstream raw_out;
+    for (const auto &entry : raw) {
+        raw_out << std::string(reinterpret_cast<const char *>(&entry),
+                               reinterpret_cast<const char *>(&entry + 1));
+    }
+    std::istringstream raw_in(raw_out.str());
+    std::vector<std::istream *> input(1, &raw_in);
+    std::ostringstream result_stream;
+    std::vector<std::ostream *> output(1, &result_stream);
+    raw2trace_test_t raw2trace(input, output, *ilist, drcontext, decode_cache_dir);
+    std::string error = raw2trace.do_conversion();
+    *result = result_stream.str();
+    return error;
+}
+
+bool
+test_persistent_decode_cache(void *drcontext)
+{
+    instrlist_t *ilist = instrlist_create(drcontext);
+    // raw2trace doesn't like offsets of 0 so we shift with a nop.
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *load = XINST_CREATE_load(drcontext, opnd_create_reg(REG1),
+                                      OPND_CREATE_MEMPTR(REG2, 8));
+    instrlist_append(ilist, nop);
+    instrlist_append(ilist, load);
+    size_t offs_load = instr_length(drcontext, nop);
+    int load_length = instr_length(drcontext, load);
+    int load_opcode = instr_get_opcode(load);
+
+    std::vector<offline_entry_t> raw;
+    raw.push_back(make_header());
+    raw.push_back(make_tid());
+    raw.push_back(make_pid());
+    raw.push_back(make_line_size());
+    raw.push_back(make_block(offs_load, 1));
+    raw.push_back(make_memref(0x1008));
+    raw.push_back(make_exit());
+
+    const std::string dir =
+        "raw2trace_decode_cache." + std::to_string(dr_get_process_id());
+    std::string expected, result;
+    std::string error = convert(drcontext, ilist, raw, "", &expected);
+    CHECK(error.empty(), error);
+    // The first run with the cache fills it in and the second reads from it.
+    for (int i = 0; i < 2; ++i) {
+        error = convert(drcontext, ilist, raw, dir, &result);
+        CHECK(error.empty(), error);
+        CHECK(result == expected, "output differs with the decode cache");
+    }
+
+    // Check the saved decodings directly.
+    byte buf[raw2trace_test_t::MAX_DECODE_SIZE];
+    memset(buf, 0, sizeof(buf));
+    instrlist_encode(drcontext, ilist, buf, true);
+    instrlist_clear_and_destroy(drcontext, ilist);
+    std::vector<module_t> modules;
+    modules.push_back(module_t("fake_exe", 0, buf, 0, sizeof(buf), sizeof(buf), true));
+    {
+        persistent_decode_cache_t cache(dir, 1);
+        error = cache.load(modules);
+        CHECK(error.empty(), error);
+        instr_summary_t desc;
+        CHECK(cache.lookup(buf + offs_load, buf + offs_load, &desc),
+              "load is missing from the decode cache");
+        CHECK(desc.next_pc() == buf + offs_load + load_length, "wrong cached length");
+        int opcode;
+        CHECK(cache.lookup_opcode(buf + offs_load, &opcode) && opcode == load_opcode,
+              "wrong cached opcode");
+        CHECK(!cache.lookup(buf, buf, &desc), "unexecuted nop is in the decode cache");
+    }
+
+    int files = 0;
+    for (directory_iterator_t iter(dir), end; iter != end; ++iter) {
+        if (*iter == "." || *iter == "..")
+            continue;
+        ++files;
+        dr_delete_file((dir + DIRSEP + *iter).c_str());
+    }
+    dr_delete_dir(dir.c_str());
+    CHECK(files == 1, "expected one decode cache file");
+    return true;
+}
+
+struct follow_test_data_t {
+    std::istream *thread_file;
+    std::ostream *out_file;
+};
+
+static bool
+follow_test_next_thread(void *user_data, OUT std::istream **thread_file,
+                        OUT std::ostream **out_file)
+{
+    follow_test_data_t *data = reinterpret_cast<follow_test_data_t *>(user_data);
+    if (data->thread_file == nullptr)
+        return false;
+    *thread_file = data->thread_file;
+    *out_file = data->out_file;
+    data->thread_file = nullptr;
+    return true;
+}
+
+static const char *
+follow_test_module_map(void *user_data)
+{
+    return nullptr;
+}
+
+static void
+append_entries(const std::string &path, const std::vector<offline_entry_t> &raw,
+               size_t start, size_t end)
+{
+    std::ofstream file(path, std::ofstream::binary | std::ofstream::app);
+    file.write(reinterpret_cast<const char *>(raw.data() + start),
+               (end - start) * sizeof(raw[0]));
+}
+
+bool
+test_follow(void *drcontext)
+{
+    instrlist_t *ilist = instrlist_create(drcontext);
+    // raw2trace doesn't like offsets of 0 so we shift with a nop.
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *load = XINST_CREATE_load(drcontext, opnd_create_reg(REG1),
+                                      OPND_CREATE_MEMPTR(REG2, 8));
+    instrlist_append(ilist, nop);
+    instrlist_append(ilist, load);
+    size_t offs_load = instr_length(drcontext, nop);
+
+    std::vector<offline_entry_t> raw;
+    raw.push_back(make_header());
+    raw.push_back(make_tid());
+    raw.push_back(make_pid());
+    raw.push_back(make_line_size());
+    raw.push_back(make_block(offs_load, 1));
+    raw.push_back(make_memref(0x1008));
+    raw.push_back(make_block(offs_load, 1));
+    raw.push_back(make_memref(0x1010));
+    raw.push_back(make_exit());
+    std::string expected;
+    std::string error = convert(drcontext, ilist, raw, "", &expected);
+    CHECK(error.empty(), error);
+
+    // The first thread file is passed up front and the second through the
+    // callback, with each written in pieces while they are being converted.
+    const std::string base = "raw2trace_follow." + std::to_string(dr_get_process_id());
+    const std::string path1 = base + ".1.raw", path2 = base + ".2.raw";
+    const std::string done_path = base + ".done";
+    append_entries(path1, raw, 0, 5);
+    append_entries(path2, raw, 0, 1);
+    std::thread writer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        append_entries(path1, raw, 5, raw.size());
+        append_entries(path2, raw, 1, 6);
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        append_entries(path2, raw, 6, raw.size());
+        std::ofstream done(done_path);
+    });
+    follow_istream_t in1(path1, done_path, 10), in2(path2, done_path, 10);
+    std::vector<std::istream *> input(1, &in1);
+    std::ostringstream out1, out2;
+    std::vector<std::ostream *> output(1, &out1);
+    follow_test_data_t data = { &in2, &out2 };
+    {
+        raw2trace_test_t raw2trace(input, output, *ilist, drcontext);
+        raw2trace.set_follow_callbacks(follow_test_next_thread, follow_test_module_map,
+                                       &data);
+        error = raw2trace.do_conversion();
+    }
+    writer.join();
+    instrlist_clear_and_destroy(drcontext, ilist);
+    dr_delete_file(path1.c_str());
+    dr_delete_file(path2.c_str());
+    dr_delete_file(done_path.c_str());
+    CHECK(error.empty(), error);
+    CHECK(out1.str() == expected, "followed output differs for the first thread");
+    CHECK(out2.str() == expected, "followed output differs for the second thread");
+    return true;
+}
+
+// Records the order in which a set of these buffers is first written to.
+class order_recording_buf_t : public std::stringbuf {
+public:
+    order_recording_buf_t(int id, std::vector<int> *order)
+        : id_(id)
+        , order_(order)
+    {
+    }
+
+protected:
+    std::streamsize
+    xsputn(const char *s, std::streamsize count) override
+    {
+        note_write();
+        return std::stringbuf::xsputn(s, count);
+    }
+    int_type
+    overflow(int_type ch) override
+    {
+        note_write();
+        return std::stringbuf::overflow(ch);
+    }
+
+private:
+    void
+    note_write()
+    {
+        if (!written_)
+            order_->push_back(id_);
+        written_ = true;
+    }
+    int id_;
+    std::vector<int> *order_;
+    bool written_ = false;
+};
+
+bool
+test_thread_file_sizes(void *drcontext)
+{
+    instrlist_t *ilist = instrlist_create(drcontext);
+    // raw2trace doesn't like offsets of 0 so we shift with a nop.
+    instr_t *nop = XINST_CREATE_nop(drcontext);
+    instr_t *load = XINST_CREATE_load(drcontext, opnd_create_reg(REG1),
+                                      OPND_CREATE_MEMPTR(REG2, 8));
+    instrlist_append(ilist, nop);
+    instrlist_append(ilist, load);
+    size_t offs_load = instr_length(drcontext, nop);
+
+    // Thread files of different lengths, with the largest in the middle, should
+    // be handed out largest first and each still produce its own output.
+    const int kNumFiles = 3;
+    const int block_counts[kNumFiles] = { 1, 5, 2 };
+    std::vector<std::string> raw_data(kNumFiles), expected(kNumFiles);
+    std::vector<uint64_t> sizes;
+    for (int i = 0; i < kNumFiles; ++i) {
+        std::vector<offline_entry_t> raw;
+        raw.push_back(make_header());
+        raw.push_back(make_tid());
+        raw.push_back(make_pid());
+        raw.push_back(make_line_size());
+        for (int j = 0; j < block_counts[i]; ++j) {
+            raw.push_back(make_block(offs_load, 1));
+            raw.push_back(make_memref(0x1000 + 8 * j));
+        }
+        raw.push_back(make_exit());
+        std::string error = convert(drcontext, ilist, raw, "", &expected[i]);
+        CHECK(error.empty(), error);
+        raw_data[i].assign(reinterpret_cast<const char *>(raw.data()),
+                           raw.size() * sizeof(raw[0]));
+        sizes.push_back(raw_data[i].size());
+    }
+    std::vector<std::istringstream> raw_in;
+    std::vector<int> order;
+    std::vector<std::unique_ptr<order_recording_buf_t>> result;
+    std::vector<std::unique_ptr<std::ostream>> out;
+    std::vector<std::istream *> input;
+    std::vector<std::ostream *> output;
+    raw_in.reserve(kNumFiles);
+    for (int i = 0; i < kNumFiles; ++i) {
+        raw_in.emplace_back(raw_data[i]);
+        input.push_back(&raw_in[i]);
+        result.emplace_back(new order_recording_buf_t(i, &order));
+        out.emplace_back(new std::ostream(result[i].get()));
+        output.push_back(out[i].get());
+    }
+    // A single worker converts the files one at a time in the order handed out.
+    raw2trace_test_t raw2trace(input, output, *ilist, drcontext, "", 1);
+    raw2trace.set_thread_file_sizes(sizes);
+    std::string error = raw2trace.do_conversion();
+    instrlist_clear_and_destroy(drcontext, ilist);
+    CHECK(error.empty(), error);
+    for (int i = 0; i < kNumFiles; ++i)
+        CHECK(result[i]->str() == expected[i], "output differs for file " << i);
+    CHECK(order == std::vector<int>({ 1, 2, 0 }), "files not handed out largest first");
+    return true;
+}
+
 int
 main(int argc, const char *argv[])
 {
@@ -287,5 +588,11 @@ main(int argc, const char *argv[])
     void *drcontext = dr_standalone_init();
     if (!test_branch_delays(drcontext))
         return 1;
+    if (!test_persistent_decode_cache(drcontext))
+        return 1;
+    if (!test_follow(drcontext))
+        return 1;
+    if (!test_thread_file_sizes(drcontext))
+        return 1;
     return 0;
 }
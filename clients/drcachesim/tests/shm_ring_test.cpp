@@ -0,0 +1,179 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Unit tests for shm_ring_t, with writer processes sharing rings that fill up. */
+
+#include <fcntl.h>
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "../common/shm_ring.h"
+
+namespace {
+
+const int NUM_WRITERS = 3;
+const int NUM_RINGS = 2;
+// Each writer sends more than a ring holds, so the writers sharing a ring wait
+// for space while contending for its lock.
+const int RECORDS_PER_WRITER = 2000;
+const size_t RECORD_SIZE = 1024;
+
+struct record_t {
+    uint32_t writer;
+    uint32_t seq;
+    unsigned char fill[RECORD_SIZE - 2 * sizeof(uint32_t)];
+};
+
+void
+fill_record(record_t *record, uint32_t writer, uint32_t seq)
+{
+    record->writer = writer;
+    record->seq = seq;
+    memset(record->fill, static_cast<unsigned char>(writer + seq), sizeof(record->fill));
+}
+
+// Runs in a child process.  The last writer exits without detaching, as a
+// crashed writer would.
+void
+run_writer(const std::string &name, uint32_t writer)
+{
+    int fd = open(name.c_str(), O_RDWR);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+        _exit(1);
+    void *map = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    shm_ring_t ring;
+    if (map == MAP_FAILED || !ring.attach(map, st.st_size))
+        _exit(1);
+    record_t record;
+    for (uint32_t seq = 0; seq < RECORDS_PER_WRITER; ++seq) {
+        fill_record(&record, writer, seq);
+        // Writers 0 and 2 share a ring.
+        if (ring.write(writer, &record, sizeof(record)) != sizeof(record))
+            _exit(1);
+    }
+    if (writer == NUM_WRITERS - 1)
+        _exit(0);
+    ring.detach();
+    munmap(map, st.st_size);
+    _exit(0);
+}
+
+bool
+check_records(const unsigned char *buf, size_t size, std::vector<uint32_t> *next_seq)
+{
+    if (size % RECORD_SIZE != 0) {
+        std::cerr << "read " << size << " bytes: not whole records\n";
+        return false;
+    }
+    for (size_t offs = 0; offs < size; offs += RECORD_SIZE) {
+        record_t record;
+        memcpy(&record, buf + offs, sizeof(record));
+        if (record.writer >= NUM_WRITERS ||
+            record.seq != (*next_seq)[record.writer]++) {
+            std::cerr << "record " << record.seq << " from writer " << record.writer
+                      << " is out of order\n";
+            return false;
+        }
+        record_t expect;
+        fill_record(&expect, record.writer, record.seq);
+        if (memcmp(&record, &expect, sizeof(record)) != 0) {
+            std::cerr << "record " << record.seq << " from writer " << record.writer
+                      << " is corrupted\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+test_multi_process()
+{
+    const std::string name = "shm_ring_test." + std::to_string(getpid());
+    shm_ring_t ring(name.c_str());
+    // The smallest ring size.
+    if (!ring.create(NUM_RINGS, 0)) {
+        std::cerr << "failed to create " << ring.get_name() << "\n";
+        return false;
+    }
+    std::vector<pid_t> children;
+    for (uint32_t writer = 0; writer < NUM_WRITERS; ++writer) {
+        pid_t child = fork();
+        if (child == 0)
+            run_writer(ring.get_name(), writer);
+        children.push_back(child);
+    }
+    bool res = true;
+    std::vector<uint32_t> next_seq(NUM_WRITERS, 0);
+    std::vector<unsigned char> buf(ring.get_atomic_write_size());
+    ssize_t len;
+    while (res && (len = ring.read(buf.data(), buf.size())) >= 0)
+        res = check_records(buf.data(), len, &next_seq);
+    for (pid_t child : children) {
+        int status;
+        if (waitpid(child, &status, 0) != child || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+            std::cerr << "writer " << child << " failed\n";
+            res = false;
+        }
+    }
+    for (uint32_t writer = 0; res && writer < NUM_WRITERS; ++writer) {
+        if (next_seq[writer] != RECORDS_PER_WRITER) {
+            std::cerr << "got " << next_seq[writer] << " records from writer " << writer
+                      << "\n";
+            res = false;
+        }
+    }
+    ring.destroy();
+    return res;
+}
+
+} // namespace
+
+int
+main(int argc, const char *argv[])
+{
+    if (test_multi_process()) {
+        std::cerr << "shm_ring_test passed\n";
+        return 0;
+    }
+    std::cerr << "shm_ring_test FAILED\n";
+    exit(1);
+}
@@ -88,6 +88,53 @@ basic_counts_t::parallel_shard_error(void *shard_data)
     return per_shard->error;
 }
 
+bool
+basic_counts_t::parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                            size_t count)
+{
+    // Qualified calls let the compiler inline the per-record work.
+    for (size_t i = 0; i < count; ++i) {
+        if (!basic_counts_t::parallel_shard_memref(shard_data, memrefs[i]))
+            return false;
+    }
+    return true;
+}
+
+bool
+basic_counts_t::parallel_subshard_supported()
+{
+    return true;
+}
+
+bool
+basic_counts_t::parallel_shard_merge(void *dst_shard_data, void *src_shard_data)
+{
+    per_shard_t *dst = reinterpret_cast<per_shard_t *>(dst_shard_data);
+    per_shard_t *src = reinterpret_cast<per_shard_t *>(src_shard_data);
+    // A piece after the first cannot tell where the file's windows start, so we
+    // only support a piece lying within the last window of those before it.
+    if (src->counters.size() != 1 ||
+        (src->last_window != -1 && dst->last_window != -1 &&
+         src->last_window != dst->last_window)) {
+        dst->error = "Cannot merge sub-shards spanning multiple windows";
+        return false;
+    }
+    dst->counters.back() += src->counters[0];
+    if (dst->last_window == -1)
+        dst->last_window = src->last_window;
+    // Only the last piece sees the thread exit.
+    if (src->tid != 0)
+        dst->tid = src->tid;
+    for (auto it = shard_map_.begin(); it != shard_map_.end(); ++it) {
+        if (it->second == src) {
+            shard_map_.erase(it);
+            break;
+        }
+    }
+    delete src;
+    return true;
+}
+
 bool
 basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
 {
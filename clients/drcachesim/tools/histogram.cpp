@@ -138,6 +138,43 @@ histogram_t::parallel_shard_error(void *shard_data)
     return shard->error;
 }
 
+bool
+histogram_t::parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                         size_t count)
+{
+    // Qualified calls let the compiler inline the per-record work.
+    for (size_t i = 0; i < count; ++i) {
+        if (!histogram_t::parallel_shard_memref(shard_data, memrefs[i]))
+            return false;
+    }
+    return true;
+}
+
+bool
+histogram_t::parallel_subshard_supported()
+{
+    return true;
+}
+
+bool
+histogram_t::parallel_shard_merge(void *dst_shard_data, void *src_shard_data)
+{
+    shard_data_t *dst = reinterpret_cast<shard_data_t *>(dst_shard_data);
+    shard_data_t *src = reinterpret_cast<shard_data_t *>(src_shard_data);
+    for (const auto &keyvals : src->icache_map)
+        dst->icache_map[keyvals.first] += keyvals.second;
+    for (const auto &keyvals : src->dcache_map)
+        dst->dcache_map[keyvals.first] += keyvals.second;
+    for (auto it = shard_map_.begin(); it != shard_map_.end(); ++it) {
+        if (it->second == src) {
+            shard_map_.erase(it);
+            break;
+        }
+    }
+    delete src;
+    return true;
+}
+
 bool
 histogram_t::process_memref(const memref_t &memref)
 {
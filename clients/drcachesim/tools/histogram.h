@@ -63,8 +63,15 @@ public:
     parallel_shard_exit(void *shard_data) override;
     bool
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                size_t count) override;
     std::string
     parallel_shard_error(void *shard_data) override;
+    bool
+    parallel_subshard_supported() override;
+    bool
+    parallel_shard_merge(void *dst_shard_data, void *src_shard_data) override;
 
     // This is public, with output parameters, for test use.
     virtual bool
@@ -0,0 +1,279 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+#include <vector>
+#include "miss_ratio_curve.h"
+#include "miss_ratio_curve_create.h"
+#include "../common/utils.h"
+
+const std::string miss_ratio_curve_t::TOOL_NAME = "Miss ratio curve tool";
+
+// The smallest tree we bother compacting into.
+static const uint64_t MIN_TREE_SIZE = 1024;
+
+analysis_tool_t *
+miss_ratio_curve_tool_create(unsigned int line_size, unsigned int verbose)
+{
+    return new miss_ratio_curve_t(line_size, verbose);
+}
+
+stack_distance_tree_t::stack_distance_tree_t()
+    : tree_(MIN_TREE_SIZE + 1, 0)
+{
+}
+
+void
+stack_distance_tree_t::add(uint64_t time, int delta)
+{
+    for (; time < tree_.size(); time += time & (~time + 1))
+        tree_[time] += delta;
+}
+
+uint64_t
+stack_distance_tree_t::prefix_count(uint64_t time) const
+{
+    uint64_t count = 0;
+    for (; time > 0; time -= time & (~time + 1))
+        count += tree_[time];
+    return count;
+}
+
+void
+stack_distance_tree_t::compact()
+{
+    std::vector<std::pair<uint64_t, uint64_t *>> by_time;
+    by_time.reserve(last_access_.size());
+    for (auto &entry : last_access_)
+        by_time.emplace_back(entry.second, &entry.second);
+    std::sort(by_time.begin(), by_time.end());
+    // Leave as much room again for new times, so the O(n log n) renumbering is
+    // amortized over at least n accesses.
+    uint64_t size = std::max(2 * by_time.size(), MIN_TREE_SIZE);
+    tree_.assign(size + 1, 0);
+    for (uint64_t i = 0; i < by_time.size(); ++i)
+        *by_time[i].second = i + 1;
+    // Build the tree in linear time: each node passes its count up to its parent.
+    for (uint64_t i = 1; i <= by_time.size(); ++i)
+        tree_[i] = 1;
+    for (uint64_t i = 1; i <= size; ++i) {
+        uint64_t parent = i + (i & (~i + 1));
+        if (parent <= size)
+            tree_[parent] += tree_[i];
+    }
+    next_time_ = by_time.size() + 1;
+}
+
+int_least64_t
+stack_distance_tree_t::access(addr_t tag)
+{
+    if (next_time_ >= tree_.size())
+        compact();
+    auto res = last_access_.emplace(tag, next_time_);
+    int_least64_t dist = -1;
+    if (!res.second) {
+        uint64_t &last = res.first->second;
+        // Every other line's last access is counted once: those after ours are
+        // the lines touched since.
+        dist = static_cast<int_least64_t>(last_access_.size() - prefix_count(last));
+        add(last, -1);
+        last = next_time_;
+    }
+    add(next_time_, 1);
+    ++next_time_;
+    return dist;
+}
+
+miss_ratio_curve_t::miss_ratio_curve_t(unsigned int line_size, unsigned int verbose)
+    : knob_line_size_(line_size)
+    , knob_verbose_(verbose)
+{
+    line_size_bits_ = compute_log2((int)knob_line_size_);
+}
+
+miss_ratio_curve_t::~miss_ratio_curve_t()
+{
+    for (auto &shard : shard_map_)
+        delete shard.second;
+}
+
+bool
+miss_ratio_curve_t::parallel_shard_supported()
+{
+    return true;
+}
+
+void *
+miss_ratio_curve_t::parallel_shard_init(int shard_index, void *worker_data)
+{
+    auto shard = new shard_data_t;
+    std::lock_guard<std::mutex> guard(shard_map_mutex_);
+    shard_map_[shard_index] = shard;
+    return reinterpret_cast<void *>(shard);
+}
+
+bool
+miss_ratio_curve_t::parallel_shard_exit(void *shard_data)
+{
+    // Nothing (we read the shard data in print_results).
+    return true;
+}
+
+std::string
+miss_ratio_curve_t::parallel_shard_error(void *shard_data)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    return shard->error;
+}
+
+bool
+miss_ratio_curve_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
+    if (memref.data.type == TRACE_TYPE_THREAD_EXIT) {
+        shard->tid = memref.exit.tid;
+        return true;
+    }
+    // We consider the same accesses as reuse_distance_t, in a unified cache.
+    if (!type_is_instr(memref.instr.type) && memref.data.type != TRACE_TYPE_READ &&
+        memref.data.type != TRACE_TYPE_WRITE && !type_is_prefetch(memref.data.type))
+        return true;
+    ++shard->total_refs;
+    int_least64_t dist = shard->tree.access(memref.data.addr >> line_size_bits_);
+    if (dist < 0) {
+        ++shard->cold_misses;
+        return true;
+    }
+    int bucket = 0;
+    for (uint64_t rest = static_cast<uint64_t>(dist); rest > 0; rest >>= 1)
+        ++bucket;
+    ++shard->dist_buckets[bucket];
+    return true;
+}
+
+bool
+miss_ratio_curve_t::parallel_shard_memref_batch(void *shard_data,
+                                                const memref_t *memrefs, size_t count)
+{
+    // Qualified calls let the compiler inline the per-record work.
+    for (size_t i = 0; i < count; ++i) {
+        if (!miss_ratio_curve_t::parallel_shard_memref(shard_data, memrefs[i]))
+            return false;
+    }
+    return true;
+}
+
+bool
+miss_ratio_curve_t::process_memref(const memref_t &memref)
+{
+    // For serial operation we index using the tid.
+    shard_data_t *shard;
+    const auto &lookup = shard_map_.find(memref.data.tid);
+    if (lookup == shard_map_.end()) {
+        shard = new shard_data_t;
+        shard_map_[memref.data.tid] = shard;
+    } else
+        shard = lookup->second;
+    if (!parallel_shard_memref(reinterpret_cast<void *>(shard), memref)) {
+        error_string_ = shard->error;
+        return false;
+    }
+    return true;
+}
+
+void
+miss_ratio_curve_t::print_shard_results(const shard_data_t *shard)
+{
+    std::cerr << "Total accesses: " << shard->total_refs << "\n";
+    std::cerr << "Unique cache lines accessed: " << shard->unique_lines << "\n";
+    std::cerr << "Cold misses: " << shard->cold_misses << "\n";
+    std::cerr << std::setw(12) << "Lines" << std::setw(14) << "Bytes" << std::setw(14)
+              << "Misses"
+              << "  Miss ratio\n";
+    std::cerr.precision(4);
+    std::cerr.setf(std::ios::fixed);
+    // Each size's misses are the cold misses plus the accesses at or beyond it.
+    uint64_t misses = shard->total_refs - shard->dist_buckets[0];
+    for (int k = 0; k + 1 < NUM_BUCKETS; ++k) {
+        uint64_t lines = 1ULL << k;
+        std::cerr << std::setw(12) << lines << std::setw(14) << lines * knob_line_size_
+                  << std::setw(14) << misses << std::setw(12)
+                  << (shard->total_refs == 0
+                          ? 0.
+                          : misses / static_cast<double>(shard->total_refs))
+                  << "\n";
+        // Larger caches only remove capacity misses, so we stop once every line
+        // fits.
+        if (misses == shard->cold_misses)
+            break;
+        misses -= shard->dist_buckets[k + 1];
+    }
+}
+
+bool
+miss_ratio_curve_t::print_results()
+{
+    // The aggregate is the sum of the per-shard private caches.
+    shard_data_t aggregate;
+    for (auto &shard : shard_map_) {
+        shard.second->unique_lines = shard.second->tree.unique_lines();
+        aggregate.total_refs += shard.second->total_refs;
+        aggregate.cold_misses += shard.second->cold_misses;
+        aggregate.unique_lines += shard.second->unique_lines;
+        for (int i = 0; i < NUM_BUCKETS; ++i)
+            aggregate.dist_buckets[i] += shard.second->dist_buckets[i];
+    }
+    std::cerr << TOOL_NAME << " aggregated results:\n";
+    print_shard_results(&aggregate);
+
+    if (shard_map_.size() > 1) {
+        using keyval_t = std::pair<memref_tid_t, shard_data_t *>;
+        std::vector<keyval_t> sorted(shard_map_.begin(), shard_map_.end());
+        std::sort(sorted.begin(), sorted.end(), [](const keyval_t &l, const keyval_t &r) {
+            return l.second->total_refs > r.second->total_refs;
+        });
+        for (const auto &shard : sorted) {
+            std::cerr << "\n==================================================\n"
+                      << TOOL_NAME << " results for shard " << shard.first << " (thread "
+                      << shard.second->tid << "):\n";
+            print_shard_results(shard.second);
+        }
+    }
+
+    // Reset the i/o format for subsequent tool invocations.
+    std::cerr.unsetf(std::ios::fixed);
+    std::cerr << std::dec;
+    return true;
+}
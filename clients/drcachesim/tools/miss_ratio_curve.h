@@ -0,0 +1,137 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* miss_ratio_curve: computes the miss ratio curve of a fully-associative LRU
+ * cache from the stack distance of every access.
+ */
+
+#ifndef _MISS_RATIO_CURVE_H_
+#define _MISS_RATIO_CURVE_H_ 1
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "analysis_tool.h"
+#include "memref.h"
+
+// An access hits in an LRU cache of N lines exactly when fewer than N other
+// lines were accessed since the previous access to its line: its stack distance.
+// Rather than walking a recency list as reuse_distance_t does, we find the stack
+// distance with an order-statistic structure indexed by time: a Fenwick tree
+// holding a 1 at the most recent access time of each line.  The distance is then
+// the count of 1's after the line's own time, in O(log n) for n lines.
+class stack_distance_tree_t {
+public:
+    stack_distance_tree_t();
+    // Records an access to the line with tag.  Returns its stack distance, or -1
+    // for the line's first access.
+    int_least64_t
+    access(addr_t tag);
+    uint64_t
+    unique_lines() const
+    {
+        return last_access_.size();
+    }
+
+private:
+    void
+    add(uint64_t time, int delta);
+    // Returns the number of lines whose last access was at or before time.
+    uint64_t
+    prefix_count(uint64_t time) const;
+    // Renumbers the last-access times densely once the tree fills up, so its size
+    // stays proportional to the number of lines.
+    void
+    compact();
+
+    std::unordered_map<addr_t, uint64_t> last_access_;
+    // A 1-based Fenwick tree over access times.
+    std::vector<uint32_t> tree_;
+    uint64_t next_time_ = 1;
+};
+
+class miss_ratio_curve_t : public analysis_tool_t {
+public:
+    miss_ratio_curve_t(unsigned int line_size, unsigned int verbose);
+    ~miss_ratio_curve_t() override;
+    bool
+    process_memref(const memref_t &memref) override;
+    bool
+    print_results() override;
+    bool
+    parallel_shard_supported() override;
+    void *
+    parallel_shard_init(int shard_index, void *worker_data) override;
+    bool
+    parallel_shard_exit(void *shard_data) override;
+    bool
+    parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                size_t count) override;
+    std::string
+    parallel_shard_error(void *shard_data) override;
+
+    // The number of buckets: bucket 0 holds distance 0 and bucket i holds distances
+    // in [2^(i-1), 2^i), so a cache of 2^k lines hits on buckets 0 through k.
+    static const int NUM_BUCKETS = 65;
+
+protected:
+    // As with reuse_distance_t, each shard (by default a thread) is measured as
+    // its own private cache.
+    struct shard_data_t {
+        stack_distance_tree_t tree;
+        uint64_t dist_buckets[NUM_BUCKETS] = {};
+        uint64_t total_refs = 0;
+        uint64_t cold_misses = 0;
+        uint64_t unique_lines = 0;
+        memref_tid_t tid = 0;
+        std::string error;
+    };
+
+    void
+    print_shard_results(const shard_data_t *shard);
+
+    unsigned int knob_line_size_;
+    unsigned int knob_verbose_;
+    size_t line_size_bits_;
+    static const std::string TOOL_NAME;
+    // In parallel operation the keys are "shard indices": just ints.
+    std::unordered_map<memref_tid_t, shard_data_t *> shard_map_;
+    // This mutex is only needed in parallel_shard_init.  In all other accesses to
+    // shard_map (process_memref, print_results) we are single-threaded.
+    std::mutex shard_map_mutex_;
+};
+
+#endif /* _MISS_RATIO_CURVE_H_ */
@@ -38,6 +38,7 @@
 
 #include "dr_api.h"
 #include "opcode_mix.h"
+#include "persistent_decode_cache.h"
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
@@ -48,16 +49,19 @@ const std::string opcode_mix_t::TOOL_NAME = "Opcode mix tool";
 
 analysis_tool_t *
 opcode_mix_tool_create(const std::string &module_file_path, unsigned int verbose,
-                       const std::string &alt_module_dir)
+                       const std::string &alt_module_dir,
+                       const std::string &decode_cache_dir)
 {
-    return new opcode_mix_t(module_file_path, verbose, alt_module_dir);
+    return new opcode_mix_t(module_file_path, verbose, alt_module_dir, decode_cache_dir);
 }
 
 opcode_mix_t::opcode_mix_t(const std::string &module_file_path, unsigned int verbose,
-                           const std::string &alt_module_dir)
+                           const std::string &alt_module_dir,
+                           const std::string &decode_cache_dir)
     : module_file_path_(module_file_path)
     , knob_verbose_(verbose)
     , knob_alt_module_dir_(alt_module_dir)
+    , knob_decode_cache_dir_(decode_cache_dir)
 {
 }
 
@@ -78,6 +82,14 @@ opcode_mix_t::initialize()
     error = module_mapper_->get_last_error();
     if (!error.empty())
         return "Failed to load binaries: " + error;
+    if (!knob_decode_cache_dir_.empty()) {
+        // We only read the cache, which raw2trace fills in.
+        decode_cache_.reset(
+            new persistent_decode_cache_t(knob_decode_cache_dir_, 1, knob_verbose_));
+        error = decode_cache_->load(module_mapper_->get_loaded_modules());
+        if (!error.empty())
+            return error;
+    }
     return "";
 }
 
@@ -173,6 +185,8 @@ opcode_mix_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
     auto cached_opcode = shard->worker->opcode_cache.find(mapped_pc);
     if (cached_opcode != shard->worker->opcode_cache.end()) {
         opcode = cached_opcode->second;
+    } else if (decode_cache_ && decode_cache_->lookup_opcode(mapped_pc, &opcode)) {
+        shard->worker->opcode_cache[mapped_pc] = opcode;
     } else {
         instr_t instr;
         instr_init(dcontext_.dcontext, &instr);
@@ -198,6 +212,30 @@ opcode_mix_t::parallel_shard_error(void *shard_data)
     return shard->error;
 }
 
+bool
+opcode_mix_t::parallel_subshard_supported()
+{
+    return true;
+}
+
+bool
+opcode_mix_t::parallel_shard_merge(void *dst_shard_data, void *src_shard_data)
+{
+    shard_data_t *dst = reinterpret_cast<shard_data_t *>(dst_shard_data);
+    shard_data_t *src = reinterpret_cast<shard_data_t *>(src_shard_data);
+    dst->instr_count += src->instr_count;
+    for (const auto &keyvals : src->opcode_counts)
+        dst->opcode_counts[keyvals.first] += keyvals.second;
+    for (auto it = shard_map_.begin(); it != shard_map_.end(); ++it) {
+        if (it->second == src) {
+            shard_map_.erase(it);
+            break;
+        }
+    }
+    delete src;
+    return true;
+}
+
 bool
 opcode_mix_t::process_memref(const memref_t &memref)
 {
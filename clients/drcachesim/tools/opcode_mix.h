@@ -44,7 +44,8 @@
 class opcode_mix_t : public analysis_tool_t {
 public:
     opcode_mix_t(const std::string &module_file_path, unsigned int verbose,
-                 const std::string &alt_module_dir = "");
+                 const std::string &alt_module_dir = "",
+                 const std::string &decode_cache_dir = "");
     virtual ~opcode_mix_t();
     std::string
     initialize() override;
@@ -66,6 +67,10 @@ public:
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
     std::string
     parallel_shard_error(void *shard_data) override;
+    bool
+    parallel_subshard_supported() override;
+    bool
+    parallel_shard_merge(void *dst_shard_data, void *src_shard_data) override;
 
 protected:
     struct worker_data_t {
@@ -112,6 +117,8 @@ protected:
     std::string module_file_path_;
     std::unique_ptr<module_mapper_t> module_mapper_;
     std::mutex mapper_mutex_;
+    // Read-only once initialized, so it needs no lock.
+    std::unique_ptr<persistent_decode_cache_t> decode_cache_;
 
     // We reference directory.modfile_bytes throughout operation, so its lifetime
     // must match ours.
@@ -122,6 +129,7 @@ protected:
     std::mutex shard_map_mutex_;
     unsigned int knob_verbose_;
     std::string knob_alt_module_dir_;
+    std::string knob_decode_cache_dir_;
     static const std::string TOOL_NAME;
     // For serial operation.
     worker_data_t serial_worker_;
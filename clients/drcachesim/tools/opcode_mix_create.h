@@ -47,10 +47,12 @@
  * in the trace.  This tool needs access to the modules.log and original libraries
  * and binaries from the traced execution.  It does not support online analysis.
  * An alternate search path for the libraries in the modules.log can be specified
- * in "alt_module_path".
+ * in "alt_module_path".  A non-empty "decode_cache_dir" names a directory of
+ * decodings saved by raw2trace, which are used to avoid decoding instructions.
  */
 analysis_tool_t *
 opcode_mix_tool_create(const std::string &module_file_path, unsigned int verbose = 0,
-                       const std::string &alt_module_dir = "");
+                       const std::string &alt_module_dir = "",
+                       const std::string &decode_cache_dir = "");
 
 #endif /* _OPCODE_MIX_CREATE_H_ */
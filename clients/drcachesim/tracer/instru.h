@@ -424,6 +424,11 @@ public:
     bb_analysis(void *drcontext, void *tag, void **bb_field, instrlist_t *ilist,
                 bool repstr_expanded) override;
 
+    // Writes out the current module list to "file", as is done for the module file
+    // passed to the constructor at exit.  Returns whether successful.
+    bool
+    write_module_list(file_t file);
+
     static bool
     custom_module_data(void *(*load_cb)(module_data_t *module, int seg_idx),
                        int (*print_cb)(void *data, char *dst, size_t max_len),
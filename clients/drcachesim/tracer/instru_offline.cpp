@@ -97,23 +97,32 @@ offline_instru_t::~offline_instru_t()
 {
     if (standalone_)
         return;
+    bool ok = write_module_list(modfile_);
+    DR_ASSERT(ok);
+    drcovlib_status_t res = drmodtrack_exit();
+    DR_ASSERT(res == DRCOVLIB_SUCCESS);
+    drmgr_exit();
+}
+
+bool
+offline_instru_t::write_module_list(file_t file)
+{
     drcovlib_status_t res;
     size_t size = 8192;
     char *buf;
     size_t wrote;
+    bool ok = false;
     do {
         buf = (char *)dr_global_alloc(size);
         res = drmodtrack_dump_buf(buf, size, &wrote);
         if (res == DRCOVLIB_SUCCESS) {
-            ssize_t written = write_file_func_(modfile_, buf, wrote - 1 /*no null*/);
-            DR_ASSERT(written == (ssize_t)wrote - 1);
+            ssize_t written = write_file_func_(file, buf, wrote - 1 /*no null*/);
+            ok = written == (ssize_t)wrote - 1;
         }
         dr_global_free(buf, size);
         size *= 2;
     } while (res == DRCOVLIB_ERROR_BUF_TOO_SMALL);
-    res = drmodtrack_exit();
-    DR_ASSERT(res == DRCOVLIB_SUCCESS);
-    drmgr_exit();
+    return ok;
 }
 
 void *
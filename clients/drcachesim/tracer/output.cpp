@@ -272,10 +272,263 @@ open_new_window_dir(ptr_int_t window_num)
     NOTIFY(2, "Created new window dir %s\n", windir);
 }
 
+// Compresses and writes [start, end) to the thread's file.  For
+// -offline_writer_threads this runs on a writer thread while the traced thread
+// continues, so it must not touch the thread's TLS.
+static void
+write_offline_data(per_thread_t *data, thread_id_t tid, ptr_int_t window, byte *start,
+                   byte *end)
+{
+    ssize_t size = end - start;
+    ssize_t wrote;
+#ifdef HAS_SNAPPY
+    if (op_offline.get_value() && snappy_enabled())
+        wrote = data->snappy_writer->compress_and_write(start, size);
+    else
+#endif
+#ifdef HAS_ZLIB
+        if (op_offline.get_value() &&
+            (op_raw_compress.get_value() == "zlib" ||
+             op_raw_compress.get_value() == "gzip")) {
+        data->zstream.next_in = (Bytef *)start;
+        data->zstream.avail_in = size;
+        int res;
+        do {
+            data->zstream.next_out = (Bytef *)data->buf_compressed;
+            data->zstream.avail_out = max_buf_size;
+            res = deflate(&data->zstream, Z_NO_FLUSH);
+            NOTIFY(3, "deflate => %d in=%d out=%d => in=%d, out=%d, write=%d\n",
+                   res, size, size, data->zstream.avail_in, data->zstream.avail_out,
+                   max_buf_size - data->zstream.avail_out);
+            DR_ASSERT(res != Z_STREAM_ERROR);
+            wrote = file_ops_func.write_file(data->file, data->buf_compressed,
+                                             max_buf_size - data->zstream.avail_out);
+        } while (data->zstream.avail_out == 0);
+        DR_ASSERT(data->zstream.avail_in == 0);
+        wrote = size;
+    } else
+#endif
+#ifdef HAS_LZ4
+        if (op_offline.get_value() && op_raw_compress.get_value() == "lz4") {
+        size_t res = LZ4F_compressUpdate(data->lzcxt, data->buf_lz4,
+                                         data->buf_lz4_size, start, size, nullptr);
+        DR_ASSERT(!LZ4F_isError(res));
+        wrote = file_ops_func.write_file(data->file, data->buf_lz4, res);
+        DR_ASSERT(static_cast<size_t>(wrote) == res);
+        wrote = size;
+    } else
+#endif
+        wrote = file_ops_func.write_file(data->file, start, size);
+    if (wrote < size) {
+        FATAL("Fatal error: failed to write trace for T%d window %zd: wrote %zd "
+              "of %zd\n",
+              tid, window, wrote, size);
+    }
+}
+
+// A -offline_writer_threads writer thread and the queue of full buffers handed to
+// it by the application threads assigned to it.
+struct async_writer_t {
+    void *lock;
+    void *work_ready; // Signaled when a buffer is queued.
+    write_job_t *head;
+    write_job_t *tail;
+    // The job the writer thread is writing, which the owner may retire once done.
+    write_job_t *current;
+};
+
+static async_writer_t *writers;
+static uint num_writers;
+static std::atomic<uint> next_writer;
+
+static void
+write_job(write_job_t *job)
+{
+    write_offline_data(reinterpret_cast<per_thread_t *>(job->owner), job->tid,
+                       job->window, job->start, job->end);
+    // Prepare the buffer for reuse, as process_and_output_buffer() does for an
+    // inline write, to keep the clearing off the application thread too.
+    memset(job->buf, 0, trace_buf_size);
+    memset(job->buf + trace_buf_size, -1, redzone_size);
+    dr_atomic_store32(&job->done, 1);
+}
+
+// Returns a written buffer to its owner.  The caller must hold the writer's lock.
+static void
+retire_job(write_job_t *job)
+{
+    per_thread_t *data = reinterpret_cast<per_thread_t *>(job->owner);
+    DR_ASSERT(dr_atomic_load32(&job->done) != 0);
+    data->free_bufs[data->num_free_bufs++] = job->buf;
+    --data->writes_pending;
+    job->in_use = false;
+}
+
+static void
+writer_thread_main(void *arg)
+{
+    async_writer_t *writer = reinterpret_cast<async_writer_t *>(arg);
+    // We run until DR terminates us at process exit.  DR only suspends us while
+    // we wait on our locks or event, never partway through a buffer.
+    dr_mutex_lock(writer->lock);
+    while (true) {
+        if (writer->current != nullptr) {
+            retire_job(writer->current);
+            writer->current = nullptr;
+        }
+        while (writer->head == nullptr) {
+            dr_event_reset(writer->work_ready);
+            dr_mutex_unlock(writer->lock);
+            dr_event_wait(writer->work_ready);
+            dr_mutex_lock(writer->lock);
+        }
+        write_job_t *job = writer->head;
+        writer->head = job->next;
+        if (writer->head == nullptr)
+            writer->tail = nullptr;
+        writer->current = job;
+        dr_mutex_unlock(writer->lock);
+        write_job(job);
+        dr_mutex_lock(writer->lock);
+    }
+}
+
+static void
+init_writers()
+{
+    num_writers = op_offline_writer_threads.get_value();
+    writers = static_cast<async_writer_t *>(
+        dr_global_alloc(num_writers * sizeof(async_writer_t)));
+    for (uint i = 0; i < num_writers; ++i) {
+        async_writer_t *writer = &writers[i];
+        *writer = {};
+        writer->lock = dr_mutex_create();
+        writer->work_ready = dr_event_create();
+        if (!dr_create_client_thread(writer_thread_main, writer))
+            FATAL("Fatal error: failed to create offline writer thread\n");
+    }
+}
+
+// Waits until all of the thread's queued buffers are written out, or if
+// for_free_buffer is set, until one of its buffers is free.  Rather than wait
+// behind other threads' buffers, this writes out those the writer thread has
+// not started on itself.  That also keeps us from waiting on a writer thread
+// that DR has suspended, as it does while running thread exit events at process
+// exit.
+static void
+wait_for_writes(per_thread_t *data, bool for_free_buffer)
+{
+    async_writer_t *writer = reinterpret_cast<async_writer_t *>(data->writer);
+    dr_mutex_lock(writer->lock);
+    while (for_free_buffer ? data->num_free_bufs == 0 : data->writes_pending > 0) {
+        write_job_t *job = writer->current;
+        if (job != nullptr && job->owner == data) {
+            // The writer thread is partway through our oldest buffer, and so
+            // through our compression state: we must let it finish.
+            dr_mutex_unlock(writer->lock);
+            while (dr_atomic_load32(&job->done) == 0)
+                dr_thread_yield();
+            dr_mutex_lock(writer->lock);
+            if (writer->current == job) {
+                retire_job(job);
+                writer->current = nullptr;
+            }
+            continue;
+        }
+        // Take back all of our queued buffers, preserving their order.
+        write_job_t *mine = nullptr;
+        write_job_t **mine_tail = &mine;
+        write_job_t **link = &writer->head;
+        writer->tail = nullptr;
+        while (*link != nullptr) {
+            write_job_t *queued = *link;
+            if (queued->owner == data) {
+                *link = queued->next;
+                queued->next = nullptr;
+                *mine_tail = queued;
+                mine_tail = &queued->next;
+            } else {
+                writer->tail = queued;
+                link = &queued->next;
+            }
+        }
+        DR_ASSERT(mine != nullptr);
+        dr_mutex_unlock(writer->lock);
+        for (write_job_t *it = mine; it != nullptr; it = it->next)
+            write_job(it);
+        dr_mutex_lock(writer->lock);
+        for (write_job_t *it = mine; it != nullptr; it = it->next)
+            retire_job(it);
+    }
+    dr_mutex_unlock(writer->lock);
+}
+
+// Hands the thread's full buffer holding [start, end) to its writer thread and
+// switches the thread to a free buffer.  Returns false if no buffer could be
+// allocated, leaving the caller to write the data itself.
+static bool
+queue_buffer_write(void *drcontext, per_thread_t *data, byte *start, byte *end,
+                   ptr_int_t window)
+{
+    async_writer_t *writer = reinterpret_cast<async_writer_t *>(data->writer);
+    byte *next_buf = nullptr;
+    dr_mutex_lock(writer->lock);
+    if (data->num_free_bufs > 0)
+        next_buf = data->free_bufs[--data->num_free_bufs];
+    dr_mutex_unlock(writer->lock);
+    if (next_buf == nullptr) {
+        if (data->num_writer_bufs < op_offline_writer_buffers.get_value()) {
+            // dr_raw_mem_alloc zeroes the new buffer, leaving just the redzone.
+            next_buf = static_cast<byte *>(dr_raw_mem_alloc(
+                max_buf_size, DR_MEMPROT_READ | DR_MEMPROT_WRITE, nullptr));
+            if (next_buf == nullptr)
+                return false;
+            memset(next_buf + trace_buf_size, -1, redzone_size);
+            data->writer_bufs[data->num_writer_bufs++] = next_buf;
+        } else {
+            // All of our other buffers are waiting to be written.
+            wait_for_writes(data, true);
+            dr_mutex_lock(writer->lock);
+            next_buf = data->free_bufs[--data->num_free_bufs];
+            dr_mutex_unlock(writer->lock);
+        }
+    }
+    dr_mutex_lock(writer->lock);
+    write_job_t *job = nullptr;
+    for (uint i = 0; i < MAX_WRITER_BUFFERS; ++i) {
+        if (!data->write_jobs[i].in_use) {
+            job = &data->write_jobs[i];
+            break;
+        }
+    }
+    DR_ASSERT(job != nullptr);
+    job->next = nullptr;
+    job->owner = data;
+    job->buf = data->buf_base;
+    job->start = start;
+    job->end = end;
+    job->window = window;
+    job->tid = dr_get_thread_id(drcontext);
+    job->in_use = true;
+    job->done = 0;
+    if (writer->tail == nullptr)
+        writer->head = job;
+    else
+        writer->tail->next = job;
+    writer->tail = job;
+    ++data->writes_pending;
+    dr_event_signal(writer->work_ready);
+    dr_mutex_unlock(writer->lock);
+    data->buf_base = next_buf;
+    return true;
+}
+
 static void
 close_thread_file(void *drcontext)
 {
     per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    if (data->writer != nullptr)
+        wait_for_writes(data, false);
 #ifdef HAS_SNAPPY
     if (op_offline.get_value() && snappy_enabled()) {
         data->snappy_writer->~snappy_file_writer_t();
@@ -451,12 +704,31 @@ prepend_offline_thread_header(void *drcontext)
     return size;
 }
 
+static inline ssize_t
+get_atomic_write_size()
+{
+#ifdef UNIX
+    if (use_ipc_ring)
+        return ipc_ring.get_atomic_write_size();
+#endif
+    return ipc_pipe.get_atomic_write_size();
+}
+
 static inline byte *
 atomic_pipe_write(void *drcontext, byte *pipe_start, byte *pipe_end, ptr_int_t window)
 {
     ssize_t towrite = pipe_end - pipe_start;
-    DR_ASSERT(towrite <= ipc_pipe.get_atomic_write_size() && towrite > 0);
-    if (ipc_pipe.write((void *)pipe_start, towrite) < (ssize_t)towrite) {
+    DR_ASSERT(towrite <= get_atomic_write_size() && towrite > 0);
+    ssize_t written;
+#ifdef UNIX
+    // The thread id keeps each thread's records in order in a single ring.
+    if (use_ipc_ring)
+        written =
+            ipc_ring.write(dr_get_thread_id(drcontext), (void *)pipe_start, towrite);
+    else
+#endif
+        written = ipc_pipe.write((void *)pipe_start, towrite);
+    if (written < (ssize_t)towrite) {
         FATAL("Fatal error: failed to write to pipe\n");
     }
     // Re-emit buffer unit header to handle split pipe writes.
@@ -475,59 +747,16 @@ write_trace_data(void *drcontext, byte *towrite_start, byte *towrite_end,
         per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
         ssize_t size = towrite_end - towrite_start;
         DR_ASSERT(data->file != INVALID_FILE);
+        if (data->writer != nullptr)
+            wait_for_writes(data, false);
         if (file_ops_func.handoff_buf != NULL) {
             if (!file_ops_func.handoff_buf(data->file, towrite_start, size,
                                            max_buf_size)) {
                 FATAL("Fatal error: failed to hand off trace\n");
             }
         } else {
-            ssize_t wrote;
-#ifdef HAS_SNAPPY
-            if (op_offline.get_value() && snappy_enabled())
-                wrote = data->snappy_writer->compress_and_write(towrite_start, size);
-            else
-#endif
-#ifdef HAS_ZLIB
-                if (op_offline.get_value() &&
-                    (op_raw_compress.get_value() == "zlib" ||
-                     op_raw_compress.get_value() == "gzip")) {
-                data->zstream.next_in = (Bytef *)towrite_start;
-                data->zstream.avail_in = size;
-                int res;
-                do {
-                    data->zstream.next_out = (Bytef *)data->buf_compressed;
-                    data->zstream.avail_out = max_buf_size;
-                    res = deflate(&data->zstream, Z_NO_FLUSH);
-                    NOTIFY(3, "deflate => %d in=%d out=%d => in=%d, out=%d, write=%d\n",
-                           res, size, size, data->zstream.avail_in,
-                           data->zstream.avail_out,
-                           max_buf_size - data->zstream.avail_out);
-                    DR_ASSERT(res != Z_STREAM_ERROR);
-                    wrote =
-                        file_ops_func.write_file(data->file, data->buf_compressed,
-                                                 max_buf_size - data->zstream.avail_out);
-                } while (data->zstream.avail_out == 0);
-                DR_ASSERT(data->zstream.avail_in == 0);
-                wrote = size;
-            } else
-#endif
-#ifdef HAS_LZ4
-                if (op_offline.get_value() && op_raw_compress.get_value() == "lz4") {
-                size_t res =
-                    LZ4F_compressUpdate(data->lzcxt, data->buf_lz4, data->buf_lz4_size,
-                                        towrite_start, size, nullptr);
-                DR_ASSERT(!LZ4F_isError(res));
-                wrote = file_ops_func.write_file(data->file, data->buf_lz4, res);
-                DR_ASSERT(static_cast<size_t>(wrote) == res);
-                wrote = size;
-            } else
-#endif
-                wrote = file_ops_func.write_file(data->file, towrite_start, size);
-            if (wrote < size) {
-                FATAL("Fatal error: failed to write trace for T%d window %zd: wrote %zd "
-                      "of %zd\n",
-                      dr_get_thread_id(drcontext), get_local_window(data), wrote, size);
-            }
+            write_offline_data(data, dr_get_thread_id(drcontext), window, towrite_start,
+                               towrite_end);
         }
         return towrite_start;
     } else {
@@ -685,6 +914,9 @@ output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr
 {
     byte *pipe_start = buf_base;
     byte *pipe_end = pipe_start;
+    bool is_v2p = false;
+    if (buf_base >= data->v2p_buf && buf_base < data->v2p_buf + get_v2p_buffer_size())
+        is_v2p = true;
     if (!op_offline.get_value()) {
         for (byte *mem_ref = buf_base + header_size; mem_ref < buf_ptr;
              mem_ref += instru->sizeof_entry()) {
@@ -700,7 +932,7 @@ output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr
                 // avoid splitting an instr from its subsequent bundle entry.
                 // An alternative is to have the reader use per-thread state.
                 if ((mem_ref + (1 + MAX_NUM_DELAY_ENTRIES) * instru->sizeof_entry() -
-                     pipe_start) > ipc_pipe.get_atomic_write_size()) {
+                     pipe_start) > get_atomic_write_size()) {
                     DR_ASSERT(is_ok_to_split_before(
                         instru->get_entry_type(pipe_start + header_size)));
                     pipe_start = atomic_pipe_write(drcontext, pipe_start, pipe_end,
@@ -714,7 +946,7 @@ output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr
         // XXX i#2638: if we want to support branch target analysis in online
         // traces we'll need to not split after a branch by carrying a write-final
         // branch forward to the next buffer.
-        if ((buf_ptr - pipe_start) > ipc_pipe.get_atomic_write_size()) {
+        if ((buf_ptr - pipe_start) > get_atomic_write_size()) {
             DR_ASSERT(
                 is_ok_to_split_before(instru->get_entry_type(pipe_start + header_size)));
             pipe_start = atomic_pipe_write(drcontext, pipe_start, pipe_end,
@@ -725,7 +957,11 @@ output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr
                 is_ok_to_split_before(instru->get_entry_type(pipe_start + header_size)));
             atomic_pipe_write(drcontext, pipe_start, buf_ptr, get_local_window(data));
         }
-    } else {
+    } else if (data->writer == nullptr || is_v2p ||
+               !queue_buffer_write(drcontext, data, pipe_start, buf_ptr,
+                                   get_local_window(data))) {
+        // The physical address buffer is reused right away, so it is written
+        // here after any queued buffers rather than queued itself.
         write_trace_data(drcontext, pipe_start, buf_ptr, get_local_window(data));
     }
     auto span = buf_ptr - buf_base; // Include the header.
@@ -733,9 +969,6 @@ output_buffer(void *drcontext, per_thread_t *data, byte *buf_base, byte *buf_ptr
     uint current_num_refs = (uint)(span / instru->sizeof_entry());
     data->num_refs += current_num_refs;
     data->bytes_written += buf_ptr - pipe_start;
-    bool is_v2p = false;
-    if (buf_base >= data->v2p_buf && buf_base < data->v2p_buf + get_v2p_buffer_size())
-        is_v2p = true;
     if (is_v2p)
         ++data->num_v2p_writeouts;
     else
@@ -897,6 +1130,7 @@ process_and_output_buffer(void *drcontext, bool skip_size_cap)
     bool do_write = true;
     size_t header_size = 0;
     uint current_num_refs = 0;
+    byte *filled_buf;
 
     if (op_offline.get_value() && data->file == INVALID_FILE) {
         // We've delayed opening a new window file to avoid an empty final file.
@@ -919,6 +1153,7 @@ process_and_output_buffer(void *drcontext, bool skip_size_cap)
     }
 
     header_size = add_buffer_header(drcontext, data, data->buf_base);
+    filled_buf = data->buf_base;
 
     bool window_changed = false;
     if (has_tracing_windows() &&
@@ -998,7 +1233,9 @@ process_and_output_buffer(void *drcontext, bool skip_size_cap)
             output_buffer(drcontext, data, data->buf_base + skip, buf_ptr, header_size);
     }
 
-    if (file_ops_func.handoff_buf == NULL) {
+    // A buffer queued for a writer thread is cleared there, and we have
+    // switched to a clear one.
+    if (file_ops_func.handoff_buf == NULL && data->buf_base == filled_buf) {
         // Our instrumentation reads from buffer and skips the clean call if the
         // content is 0, so we need set zero in the trace buffer and set non-zero
         // in redzone.
@@ -1063,6 +1300,12 @@ init_thread_io(void *drcontext)
     }
 #endif
 
+    if (writers != nullptr && data->writer == nullptr) {
+        data->writer = &writers[next_writer.fetch_add(1) % num_writers];
+        data->writer_bufs[0] = data->buf_base;
+        data->num_writer_bufs = 1;
+    }
+
     if (op_use_physical.get_value()) {
         if (!data->physaddr.init()) {
             FATAL("Unable to open pagemap for physical addresses in thread T%d: check "
@@ -1125,6 +1368,17 @@ exit_thread_io(void *drcontext)
     if (op_offline.get_value() && data->file != INVALID_FILE)
         close_thread_file(drcontext);
 
+    if (data->writer != nullptr) {
+        wait_for_writes(data, false);
+        // The caller frees buf_base.
+        for (uint i = 0; i < data->num_writer_bufs; ++i) {
+            if (data->writer_bufs[i] != data->buf_base)
+                dr_raw_mem_free(data->writer_bufs[i], max_buf_size);
+        }
+        data->num_writer_bufs = 0;
+        data->num_free_bufs = 0;
+    }
+
 #ifdef HAS_ZLIB
     if (op_offline.get_value() &&
         (op_raw_compress.get_value() == "zlib" ||
@@ -1183,13 +1437,56 @@ init_io()
     }
 #endif
 
+    if (op_offline.get_value() && op_offline_writer_threads.get_value() > 0 &&
+        file_ops_func.handoff_buf == NULL)
+        init_writers();
+
     DR_ASSERT(cur_window_instr_count.is_lock_free());
 }
 
+void
+fork_init_io(void *drcontext)
+{
+    if (writers == nullptr)
+        return;
+    // Our writer threads do not survive the fork and their locks may have been
+    // held at the time, so we start over, abandoning the old locks.  The parent
+    // writes out the buffers that were queued.
+    dr_global_free(writers, num_writers * sizeof(async_writer_t));
+    init_writers();
+    per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+    if (data->writer == nullptr)
+        return;
+    data->writer = &writers[next_writer.fetch_add(1) % num_writers];
+    data->writes_pending = 0;
+    data->num_free_bufs = 0;
+    for (uint i = 0; i < MAX_WRITER_BUFFERS; ++i)
+        data->write_jobs[i].in_use = false;
+    for (uint i = 0; i < data->num_writer_bufs; ++i) {
+        byte *buf = data->writer_bufs[i];
+        if (buf == data->buf_base)
+            continue;
+        memset(buf, 0, trace_buf_size);
+        memset(buf + trace_buf_size, -1, redzone_size);
+        data->free_bufs[data->num_free_bufs++] = buf;
+    }
+}
+
 void
 exit_io()
 {
     notify_beyond_global_max_once = 0;
+    if (writers != nullptr) {
+        // DR has suspended the writer threads by now, and each traced thread
+        // waited for its own buffers at exit.
+        for (uint i = 0; i < num_writers; ++i) {
+            dr_mutex_destroy(writers[i].lock);
+            dr_event_destroy(writers[i].work_ready);
+        }
+        dr_global_free(writers, num_writers * sizeof(async_writer_t));
+        writers = nullptr;
+        num_writers = 0;
+    }
 }
 
 } // namespace drmemtrace
@@ -60,6 +60,10 @@ init_buffers(per_thread_t *data);
 void
 init_io();
 
+// Restarts the -offline_writer_threads writer threads in a forked child.
+void
+fork_init_io(void *drcontext);
+
 void
 exit_io();
 
@@ -0,0 +1,514 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "persistent_decode_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#ifdef LINUX
+#    include <elf.h>
+#endif
+
+#include "../common/trace_entry.h"
+#include "../common/utils.h"
+
+#define VPRINT(level, ...)                     \
+    do {                                       \
+        if (this->verbosity_ >= (level)) {     \
+            fprintf(stderr, "[drmemtrace]: "); \
+            fprintf(stderr, __VA_ARGS__);      \
+            fflush(stderr);                    \
+        }                                      \
+    } while (0)
+
+namespace {
+
+const uint32_t kFileMagic = 0x63643272; // "r2dc"
+const uint32_t kFileVersion = 1;
+const char *const kFileSuffix = ".r2tdc";
+const size_t kRecordAlign = 8;
+
+// A 64-bit FNV-1a hash.
+uint64_t
+hash_bytes(const byte *start, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= start[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#ifdef LINUX
+template <typename Ehdr, typename Phdr>
+std::string
+elf_build_id(const byte *base, size_t size)
+{
+    const Ehdr *ehdr = reinterpret_cast<const Ehdr *>(base);
+    if (size < sizeof(*ehdr) || ehdr->e_phoff + ehdr->e_phnum * sizeof(Phdr) > size)
+        return "";
+    const Phdr *phdr = reinterpret_cast<const Phdr *>(base + ehdr->e_phoff);
+    for (int i = 0; i < ehdr->e_phnum; ++i) {
+        // The notes are normally in the first segment, which is mapped from the start
+        // of the file.
+        if (phdr[i].p_type != PT_NOTE || phdr[i].p_offset + phdr[i].p_filesz > size)
+            continue;
+        const byte *note = base + phdr[i].p_offset;
+        const byte *end = note + phdr[i].p_filesz;
+        while (note + sizeof(Elf32_Nhdr) <= end) {
+            const Elf32_Nhdr *nhdr = reinterpret_cast<const Elf32_Nhdr *>(note);
+            const byte *name = note + sizeof(*nhdr);
+            const byte *desc = name + ALIGN_FORWARD(nhdr->n_namesz, 4);
+            const byte *next = desc + ALIGN_FORWARD(nhdr->n_descsz, 4);
+            if (next > end)
+                break;
+            if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_namesz == 4 &&
+                memcmp(name, "GNU", 4) == 0) {
+                std::ostringstream id;
+                for (uint j = 0; j < nhdr->n_descsz; ++j)
+                    id << std::hex << std::setw(2) << std::setfill('0') << (int)desc[j];
+                return id.str();
+            }
+            note = next;
+        }
+    }
+    return "";
+}
+#endif
+
+// Returns a file name for the module's contents, or "" if we cannot identify them.
+std::string
+module_key(const module_t &module)
+{
+    std::string id;
+    if (module.is_external) {
+        std::ostringstream hash;
+        hash << "hash-" << std::hex << module.seg_size << "-"
+             << hash_bytes(module.map_seg_base, module.seg_size);
+        id = hash.str();
+    } else {
+#if defined(LINUX)
+        const byte *base = module.map_seg_base;
+        if (module.seg_size >= EI_NIDENT && memcmp(base, ELFMAG, SELFMAG) == 0) {
+            if (base[EI_CLASS] == ELFCLASS64)
+                id = elf_build_id<Elf64_Ehdr, Elf64_Phdr>(base, module.seg_size);
+            else if (base[EI_CLASS] == ELFCLASS32)
+                id = elf_build_id<Elf32_Ehdr, Elf32_Phdr>(base, module.seg_size);
+        }
+        if (!id.empty())
+            id = "build-" + id;
+#elif defined(WINDOWS)
+        const IMAGE_DOS_HEADER *dos =
+            reinterpret_cast<const IMAGE_DOS_HEADER *>(module.map_seg_base);
+        if (module.seg_size >= sizeof(*dos) && dos->e_magic == IMAGE_DOS_SIGNATURE &&
+            dos->e_lfanew + sizeof(IMAGE_NT_HEADERS) <= module.seg_size) {
+            const IMAGE_NT_HEADERS *nt = reinterpret_cast<const IMAGE_NT_HEADERS *>(
+                module.map_seg_base + dos->e_lfanew);
+            if (nt->Signature == IMAGE_NT_SIGNATURE) {
+                std::ostringstream pe;
+                pe << "pe-" << std::hex << nt->FileHeader.TimeDateStamp << "-"
+                   << nt->OptionalHeader.CheckSum << "-"
+                   << nt->OptionalHeader.SizeOfImage;
+                id = pe.str();
+            }
+        }
+#endif
+    }
+    if (id.empty())
+        return "";
+    // We include the base name to make the files easier to tell apart.
+    std::string name(module.path);
+    size_t sep_index = name.find_last_of(DIRSEP ALT_DIRSEP);
+    if (sep_index != std::string::npos)
+        name = name.substr(sep_index + 1);
+    for (char &c : name) {
+        if (!isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '_' && c != '-')
+            c = '_';
+    }
+    return name + "-" + id;
+}
+
+// Converts a pc-relative operand's address between absolute and relative to the
+// instruction, as the trace-time addresses differ from run to run.
+opnd_t
+rebase_rel_addr(opnd_t opnd, ptr_int_t delta)
+{
+#if defined(X64) || defined(ARM)
+    if (!opnd_is_rel_addr(opnd))
+        return opnd;
+    byte *addr = reinterpret_cast<byte *>(opnd_get_addr(opnd)) + delta;
+#    ifdef X86
+    if (opnd_get_segment(opnd) != DR_REG_NULL) {
+        return opnd_create_far_rel_addr(opnd_get_segment(opnd), addr,
+                                        opnd_get_size(opnd));
+    }
+#    endif
+    return opnd_create_rel_addr(addr, opnd_get_size(opnd));
+#else
+    return opnd;
+#endif
+}
+
+} // namespace
+
+struct persistent_decode_cache_t::file_header_t {
+    uint32_t magic;
+    uint32_t version;
+    // Records hold raw opnd_t values, so they are tied to the DR version and
+    // architecture.
+    uint32_t dr_version;
+    uint32_t opnd_size;
+    uint64_t arch;
+    uint64_t num_entries;
+    uint64_t records_size;
+};
+
+struct persistent_decode_cache_t::index_entry_t {
+    uint64_t offset;
+    uint64_t record;
+};
+
+struct persistent_decode_cache_t::record_t {
+    uint16_t type;
+    uint16_t prefetch_type;
+    uint16_t flush_type;
+    uint16_t opcode;
+    uint8_t length;
+    uint8_t packed;
+    uint8_t num_mem_srcs;
+    uint8_t num_memrefs;
+    // Followed by num_memrefs opnd_t values, with pc-relative addresses stored
+    // relative to the instruction.
+
+    size_t
+    size() const
+    {
+        return ALIGN_FORWARD(sizeof(*this) + num_memrefs * sizeof(opnd_t), kRecordAlign);
+    }
+    opnd_t
+    memref(size_t index) const
+    {
+        opnd_t opnd;
+        memcpy(&opnd,
+               reinterpret_cast<const byte *>(this + 1) + index * sizeof(opnd_t),
+               sizeof(opnd));
+        return opnd;
+    }
+};
+
+persistent_decode_cache_t::persistent_decode_cache_t(const std::string &dir,
+                                                     int worker_count,
+                                                     unsigned int verbosity)
+    : dir_(dir)
+    , verbosity_(verbosity)
+{
+    if (worker_count < 1)
+        worker_count = 1;
+    pending_.resize(worker_count);
+    pending_data_.resize(worker_count);
+}
+
+persistent_decode_cache_t::~persistent_decode_cache_t()
+{
+    unmap_files();
+}
+
+std::string
+persistent_decode_cache_t::load(const std::vector<module_t> &modules)
+{
+    if (!dr_directory_exists(dir_.c_str()) && !dr_create_dir(dir_.c_str()))
+        return "Failed to create decode cache directory " + dir_;
+    for (const module_t &module : modules) {
+        // We skip unmapped modules and secondary segments, which lie inside their
+        // primary segment's mapping.
+        if (module.map_seg_base == nullptr || module.total_map_size == 0)
+            continue;
+        module_info_t info;
+        info.start = module.map_seg_base;
+        info.size = module.total_map_size;
+        info.key = module_key(module);
+        if (!info.key.empty())
+            map_file(&info);
+        VPRINT(1, "Decode cache for %s: %s with %zu entries\n", module.path,
+               info.key.empty() ? "<none>" : info.key.c_str(), info.num_entries);
+        modules_.push_back(info);
+    }
+    std::sort(modules_.begin(), modules_.end(),
+              [](const module_info_t &a, const module_info_t &b) {
+                  return a.start < b.start;
+              });
+    return "";
+}
+
+std::string
+persistent_decode_cache_t::get_file_path(const module_info_t &module) const
+{
+    return dir_ + DIRSEP + module.key + kFileSuffix;
+}
+
+void
+persistent_decode_cache_t::map_file(module_info_t *module)
+{
+    std::string path = get_file_path(*module);
+    file_t file = dr_open_file(path.c_str(), DR_FILE_READ);
+    if (file == INVALID_FILE)
+        return;
+    uint64 file_size;
+    if (dr_file_size(file, &file_size) && file_size >= sizeof(file_header_t)) {
+        size_t map_size = static_cast<size_t>(file_size);
+        byte *map = reinterpret_cast<byte *>(
+            dr_map_file(file, &map_size, 0, nullptr, DR_MEMPROT_READ, 0));
+        const file_header_t *header = reinterpret_cast<const file_header_t *>(map);
+        if (map != nullptr && map_size >= file_size && header->magic == kFileMagic &&
+            header->version == kFileVersion && header->dr_version == _USES_DR_VERSION_ &&
+            header->opnd_size == sizeof(opnd_t) &&
+            header->arch == build_target_arch_type() &&
+            sizeof(*header) + header->num_entries * sizeof(index_entry_t) +
+                    header->records_size <=
+                file_size) {
+            module->map = map;
+            module->map_size = map_size;
+            module->index = reinterpret_cast<const index_entry_t *>(header + 1);
+            module->num_entries = static_cast<size_t>(header->num_entries);
+            module->records =
+                reinterpret_cast<const byte *>(module->index + module->num_entries);
+        } else {
+            VPRINT(1, "Ignoring invalid decode cache file %s\n", path.c_str());
+            if (map != nullptr)
+                dr_unmap_file(map, map_size);
+        }
+    }
+    dr_close_file(file);
+}
+
+void
+persistent_decode_cache_t::unmap_files()
+{
+    for (module_info_t &module : modules_) {
+        if (module.map != nullptr)
+            dr_unmap_file(module.map, module.map_size);
+        module.map = nullptr;
+        module.index = nullptr;
+        module.num_entries = 0;
+        module.records = nullptr;
+    }
+}
+
+const persistent_decode_cache_t::module_info_t *
+persistent_decode_cache_t::find_module(app_pc pc) const
+{
+    auto it = std::upper_bound(
+        modules_.begin(), modules_.end(), pc,
+        [](app_pc pc, const module_info_t &module) { return pc < module.start; });
+    if (it == modules_.begin())
+        return nullptr;
+    --it;
+    if (static_cast<size_t>(pc - it->start) >= it->size || it->key.empty())
+        return nullptr;
+    return &*it;
+}
+
+const persistent_decode_cache_t::record_t *
+persistent_decode_cache_t::find_record(app_pc pc) const
+{
+    const module_info_t *module = find_module(pc);
+    if (module == nullptr || module->num_entries == 0)
+        return nullptr;
+    const uint64_t offset = pc - module->start;
+    const index_entry_t *end = module->index + module->num_entries;
+    const index_entry_t *entry =
+        std::lower_bound(module->index, end, offset,
+                         [](const index_entry_t &entry, uint64_t offset) {
+                             return entry.offset < offset;
+                         });
+    if (entry == end || entry->offset != offset)
+        return nullptr;
+    return reinterpret_cast<const record_t *>(module->records + entry->record);
+}
+
+bool
+persistent_decode_cache_t::lookup(app_pc pc, app_pc orig_pc,
+                                  OUT instr_summary_t *desc) const
+{
+    const record_t *record = find_record(pc);
+    if (record == nullptr)
+        return false;
+    desc->pc_ = pc;
+    desc->next_pc_ = pc + record->length;
+    desc->type_ = record->type;
+    desc->prefetch_type_ = record->prefetch_type;
+    desc->flush_type_ = record->flush_type;
+    desc->opcode_ = record->opcode;
+    desc->length_ = record->length;
+    desc->packed_ = record->packed;
+    desc->num_mem_srcs_ = record->num_mem_srcs;
+    desc->mem_srcs_and_dests_.clear();
+    desc->mem_srcs_and_dests_.reserve(record->num_memrefs);
+    for (size_t i = 0; i < record->num_memrefs; ++i) {
+        desc->mem_srcs_and_dests_.push_back(instr_summary_t::memref_summary_t(
+            rebase_rel_addr(record->memref(i), reinterpret_cast<ptr_int_t>(orig_pc))));
+    }
+    return true;
+}
+
+bool
+persistent_decode_cache_t::lookup_opcode(app_pc pc, OUT int *opcode) const
+{
+    const record_t *record = find_record(pc);
+    if (record == nullptr)
+        return false;
+    *opcode = record->opcode;
+    return true;
+}
+
+void
+persistent_decode_cache_t::record(int worker, const instr_summary_t &desc,
+                                  app_pc orig_pc)
+{
+    const module_info_t *module = find_module(desc.pc());
+    if (module == nullptr)
+        return;
+    record_t rec;
+    rec.type = desc.type_;
+    rec.prefetch_type = desc.prefetch_type_;
+    rec.flush_type = desc.flush_type_;
+    rec.opcode = desc.opcode_;
+    rec.length = desc.length_;
+    rec.packed = desc.packed_;
+    rec.num_mem_srcs = desc.num_mem_srcs_;
+    rec.num_memrefs = static_cast<uint8_t>(desc.mem_srcs_and_dests_.size());
+    std::vector<byte> &data = pending_data_[worker];
+    const size_t pos = data.size();
+    pending_[worker].push_back({ static_cast<size_t>(module - modules_.data()),
+                                 static_cast<uint64_t>(desc.pc() - module->start), pos });
+    data.resize(pos + rec.size());
+    memcpy(&data[pos], &rec, sizeof(rec));
+    for (size_t i = 0; i < rec.num_memrefs; ++i) {
+        opnd_t opnd = rebase_rel_addr(desc.mem_srcs_and_dests_[i].opnd,
+                                      -reinterpret_cast<ptr_int_t>(orig_pc));
+        memcpy(&data[pos + sizeof(rec) + i * sizeof(opnd)], &opnd, sizeof(opnd));
+    }
+}
+
+std::string
+persistent_decode_cache_t::save()
+{
+    // Gather the new records for each module.
+    std::vector<std::vector<std::pair<uint64_t, const byte *>>> additions(
+        modules_.size());
+    for (size_t worker = 0; worker < pending_.size(); ++worker) {
+        for (const pending_t &pending : pending_[worker]) {
+            additions[pending.module].emplace_back(pending.offset,
+                                                   &pending_data_[worker][pending.pos]);
+        }
+    }
+    // We build every new file before unmapping the old ones, whose records we copy.
+    std::vector<std::pair<size_t, std::vector<byte>>> contents;
+    for (size_t i = 0; i < modules_.size(); ++i) {
+        if (additions[i].empty())
+            continue;
+        const module_info_t &module = modules_[i];
+        std::vector<std::pair<uint64_t, const byte *>> records;
+        records.reserve(module.num_entries + additions[i].size());
+        for (size_t j = 0; j < module.num_entries; ++j) {
+            records.emplace_back(module.index[j].offset,
+                                 module.records + module.index[j].record);
+        }
+        records.insert(records.end(), additions[i].begin(), additions[i].end());
+        // Several workers may have decoded the same instruction.
+        std::stable_sort(records.begin(), records.end(),
+                         [](const std::pair<uint64_t, const byte *> &a,
+                            const std::pair<uint64_t, const byte *> &b) {
+                             return a.first < b.first;
+                         });
+        records.erase(std::unique(records.begin(), records.end(),
+                                  [](const std::pair<uint64_t, const byte *> &a,
+                                     const std::pair<uint64_t, const byte *> &b) {
+                                      return a.first == b.first;
+                                  }),
+                      records.end());
+        file_header_t header = {};
+        header.magic = kFileMagic;
+        header.version = kFileVersion;
+        header.dr_version = _USES_DR_VERSION_;
+        header.opnd_size = sizeof(opnd_t);
+        header.arch = build_target_arch_type();
+        header.num_entries = records.size();
+        std::vector<index_entry_t> index;
+        index.reserve(records.size());
+        for (const auto &record : records) {
+            index.push_back({ record.first, header.records_size });
+            header.records_size +=
+                reinterpret_cast<const record_t *>(record.second)->size();
+        }
+        contents.emplace_back(i, std::vector<byte>());
+        std::vector<byte> &data = contents.back().second;
+        data.resize(sizeof(header) + index.size() * sizeof(index_entry_t) +
+                    static_cast<size_t>(header.records_size));
+        memcpy(data.data(), &header, sizeof(header));
+        memcpy(data.data() + sizeof(header), index.data(),
+               index.size() * sizeof(index_entry_t));
+        byte *dst = data.data() + sizeof(header) + index.size() * sizeof(index_entry_t);
+        for (const auto &record : records) {
+            size_t size = reinterpret_cast<const record_t *>(record.second)->size();
+            memcpy(dst, record.second, size);
+            dst += size;
+        }
+    }
+    unmap_files();
+    for (auto &content : contents) {
+        // We write to a temporary file and rename it so that concurrent
+        // conversions never see a partial file.
+        std::string path = get_file_path(modules_[content.first]);
+        std::string tmp_path = path + "." + std::to_string(dr_get_process_id()) + ".tmp";
+        file_t file = dr_open_file(tmp_path.c_str(), DR_FILE_WRITE_OVERWRITE);
+        if (file == INVALID_FILE)
+            return "Failed to create decode cache file " + tmp_path;
+        ssize_t written =
+            dr_write_file(file, content.second.data(), content.second.size());
+        dr_close_file(file);
+        if (written != static_cast<ssize_t>(content.second.size()) ||
+            !dr_rename_file(tmp_path.c_str(), path.c_str(), true)) {
+            dr_delete_file(tmp_path.c_str());
+            return "Failed to write decode cache file " + path;
+        }
+        VPRINT(1, "Wrote decode cache file %s\n", path.c_str());
+    }
+    for (size_t worker = 0; worker < pending_.size(); ++worker) {
+        pending_[worker].clear();
+        pending_data_[worker].clear();
+    }
+    return "";
+}
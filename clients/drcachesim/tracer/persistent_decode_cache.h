@@ -0,0 +1,126 @@
+/* **********************************************************
+ * Copyright (c) 2022 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* persistent_decode_cache: decoded instruction summaries saved across runs. */
+
+#ifndef _PERSISTENT_DECODE_CACHE_H_
+#define _PERSISTENT_DECODE_CACHE_H_ 1
+
+#include <string>
+#include <vector>
+
+#include "dr_api.h"
+#include "raw2trace.h"
+
+// Holds instr_summary_t decodings in one file per module in a cache directory,
+// so that later conversions of traces of the same binaries, and tools such as
+// opcode_mix_t, can skip decoding.  A module's file is named by its identity: its
+// ELF build ID, its PE timestamp and checksum, or for contents embedded in the
+// module list (such as the vdso) a hash of the contents; modules with no identity
+// are not cached.  Each file holds records sorted by module offset and is mapped
+// read-only for lookups, which are thread-safe.  New decodings are queued
+// per worker and merged into the files by save().
+class persistent_decode_cache_t {
+public:
+    persistent_decode_cache_t(const std::string &dir, int worker_count,
+                              unsigned int verbosity = 0);
+    ~persistent_decode_cache_t();
+
+    // Identifies each mapped module and maps its cache file, if any.
+    // Returns "" on success or an error message on failure.
+    std::string
+    load(const std::vector<module_t> &modules);
+
+    // Fills in desc for the instruction mapped at pc, whose address at trace time
+    // was orig_pc, if it is in the cache.  The memref flags are left unset.
+    bool
+    lookup(app_pc pc, app_pc orig_pc, OUT instr_summary_t *desc) const;
+
+    // Returns the opcode of the instruction mapped at pc, if it is in the cache.
+    bool
+    lookup_opcode(app_pc pc, OUT int *opcode) const;
+
+    // Queues desc, whose address at trace time was orig_pc, to be added by save().
+    // Each worker must pass its own index.
+    void
+    record(int worker, const instr_summary_t &desc, app_pc orig_pc);
+
+    // Rewrites the files of modules with queued decodings and unmaps all files.
+    // Returns "" on success or an error message on failure.
+    std::string
+    save();
+
+private:
+    struct file_header_t;
+    struct index_entry_t;
+    struct record_t;
+
+    struct module_info_t {
+        app_pc start = nullptr;
+        size_t size = 0;
+        // Empty if the module has no identity.
+        std::string key;
+        byte *map = nullptr;
+        size_t map_size = 0;
+        const index_entry_t *index = nullptr;
+        size_t num_entries = 0;
+        const byte *records = nullptr;
+    };
+
+    struct pending_t {
+        size_t module;
+        uint64_t offset;
+        // The record's position in pending_data_.
+        size_t pos;
+    };
+
+    const module_info_t *
+    find_module(app_pc pc) const;
+    const record_t *
+    find_record(app_pc pc) const;
+    std::string
+    get_file_path(const module_info_t &module) const;
+    void
+    map_file(module_info_t *module);
+    void
+    unmap_files();
+
+    std::string dir_;
+    unsigned int verbosity_;
+    // Sorted by start.
+    std::vector<module_info_t> modules_;
+    // Per worker.
+    std::vector<std::vector<pending_t>> pending_;
+    std::vector<std::vector<byte>> pending_data_;
+};
+
+#endif /* _PERSISTENT_DECODE_CACHE_H_ */
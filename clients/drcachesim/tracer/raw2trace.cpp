@@ -38,6 +38,7 @@
 #include "drcovlib.h"
 #include "raw2trace.h"
 #include "instru.h"
+#include "persistent_decode_cache.h"
 #include "../common/memref.h"
 #include "../common/trace_entry.h"
 #include <algorithm>
@@ -126,6 +127,7 @@ module_mapper_t::module_mapper_t(
     void *process_cb_user_data, void (*free_cb)(void *data), uint verbosity,
     const std::string &alt_module_dir)
     : modmap_(module_map)
+    , cached_user_parse_(parse_cb)
     , cached_user_free_(free_cb)
     , verbosity_(verbosity)
     , alt_module_dir_(alt_module_dir)
@@ -164,6 +166,10 @@ module_mapper_t::~module_mapper_t()
         drmodtrack_offline_exit(modhandle_) != DRCOVLIB_SUCCESS) {
         WARN("Failed to clean up module table data");
     }
+    for (void *handle : later_modhandles_) {
+        if (drmodtrack_offline_exit(handle) != DRCOVLIB_SUCCESS)
+            WARN("Failed to clean up module table data");
+    }
     user_free_ = nullptr;
     for (std::vector<module_t>::iterator mvi = modvec_.begin(); mvi != modvec_.end();
          ++mvi) {
@@ -293,10 +299,20 @@ module_mapper_t::do_module_parsing()
     if (drmodtrack_offline_read(INVALID_FILE, modmap_, NULL, &modhandle_, &num_mods) !=
         DRCOVLIB_SUCCESS)
         return "Failed to parse module file";
+    return read_module_list(modhandle_, num_mods);
+}
+
+// Appends the entries of the parsed list "handle" beyond those already in modlist_.
+std::string
+module_mapper_t::read_module_list(void *handle, uint num_mods)
+{
+    uint start = static_cast<uint>(modlist_.size());
+    if (num_mods < start)
+        return "Module file is missing earlier modules";
     modlist_.resize(num_mods);
-    for (uint i = 0; i < num_mods; i++) {
+    for (uint i = start; i < num_mods; i++) {
         modlist_[i].struct_size = sizeof(modlist_[i]);
-        if (drmodtrack_offline_lookup(modhandle_, i, &modlist_[i]) != DRCOVLIB_SUCCESS)
+        if (drmodtrack_offline_lookup(handle, i, &modlist_[i]) != DRCOVLIB_SUCCESS)
             return "Failed to query module file";
         if (user_process_ != nullptr) {
             custom_module_data_t *custom = (custom_module_data_t *)modlist_[i].custom;
@@ -316,12 +332,41 @@ raw2trace_t::read_and_map_modules()
         auto err = do_module_parsing();
         if (!err.empty())
             return err;
+        // Workers keep reading the module entries while load_new_modules() adds
+        // more, so they must never move.
+        if (follow_next_thread_cb_ != nullptr)
+            module_mapper_->reserve_modules(1ULL << PC_MODIDX_BITS);
     }
 
     set_modvec_(&module_mapper_->get_loaded_modules());
     return module_mapper_->get_last_error();
 }
 
+// Called when a followed thread file refers to module "modidx" which is not yet
+// known.  The tracer updates its module list before any thread can execute code in
+// a new module, so the latest list is guaranteed to include it.
+std::string
+raw2trace_t::load_new_modules(uint64 modidx)
+{
+    std::lock_guard<std::mutex> guard(follow_modules_mutex_);
+    // Another worker may have loaded it while we waited.
+    if (modidx < follow_num_modules_.load(std::memory_order_acquire))
+        return "";
+    const char *module_map = (*follow_module_map_cb_)(follow_user_data_);
+    if (module_map == nullptr)
+        return "Failed to read the latest module list";
+    std::string error = module_mapper_->add_new_modules(module_map);
+    if (!error.empty())
+        return error;
+    size_t count = module_mapper_->get_loaded_modules().size();
+    VPRINT(1, "Loaded %zu new modules\n",
+           count - follow_num_modules_.load(std::memory_order_relaxed));
+    follow_num_modules_.store(count, std::memory_order_release);
+    if (modidx >= count)
+        return "Module index " + std::to_string(modidx) + " is not in the module list";
+    return "";
+}
+
 // Maps each module into the address space.
 // There are several types of mapping entries in the module list:
 // 1) Raw bits directly stored.  It is simply pointed at.
@@ -335,7 +380,8 @@ module_mapper_t::read_and_map_modules()
 {
     if (!last_error_.empty())
         return;
-    for (auto it = modlist_.begin(); it != modlist_.end(); ++it) {
+    // We skip the modules already mapped by an earlier call.
+    for (auto it = modlist_.begin() + modvec_.size(); it != modlist_.end(); ++it) {
         drmodtrack_info_t &info = *it;
         custom_module_data_t *custom_data = (custom_module_data_t *)info.custom;
         if (custom_data != nullptr && custom_data->contents_size > 0) {
@@ -423,6 +469,52 @@ module_mapper_t::read_and_map_modules()
     VPRINT(1, "Successfully read %zu modules\n", modlist_.size());
 }
 
+std::string
+module_mapper_t::add_new_modules(const char *module_map)
+{
+    if (!last_error_.empty())
+        return last_error_;
+    // As in the constructor, the drmodtrack parser needs our callbacks in globals.
+    DR_ASSERT(user_parse_ == nullptr);
+    DR_ASSERT(user_free_ == nullptr);
+    user_parse_ = cached_user_parse_;
+    user_free_ = cached_user_free_;
+    void *handle = nullptr;
+    uint num_mods = 0;
+    std::string error;
+    if (drmodtrack_add_custom_data(nullptr, nullptr, parse_custom_module_data,
+                                   free_custom_module_data) != DRCOVLIB_SUCCESS)
+        error = "Failed to set up custom module parser";
+    else if (drmodtrack_offline_read(INVALID_FILE, module_map, NULL, &handle,
+                                     &num_mods) != DRCOVLIB_SUCCESS)
+        error = "Failed to parse module file";
+    user_parse_ = nullptr;
+    user_free_ = nullptr;
+    if (!error.empty())
+        return error;
+    // The new entries' paths and custom data point into the handle, so we keep it.
+    later_modhandles_.push_back(handle);
+    if (num_mods > modvec_.capacity())
+        return "Too many modules to add in place";
+    error = read_module_list(handle, num_mods);
+    if (!error.empty())
+        return error;
+    read_and_map_modules();
+    return last_error_;
+}
+
+void
+raw2trace_t::set_follow_callbacks(bool (*next_thread_cb)(void *user_data,
+                                                         OUT std::istream **thread_file,
+                                                         OUT std::ostream **out_file),
+                                  const char *(*module_map_cb)(void *user_data),
+                                  void *user_data)
+{
+    follow_next_thread_cb_ = next_thread_cb;
+    follow_module_map_cb_ = module_map_cb;
+    follow_user_data_ = user_data;
+}
+
 std::string
 raw2trace_t::do_module_parsing_and_mapping()
 {
@@ -617,8 +709,9 @@ raw2trace_t::process_next_thread_buffer(raw2trace_thread_data_t *tdata,
         if (!tdata->error.empty())
             return tdata->error;
     }
-    tdata->error = "";
-    return "";
+    // A failure to load new modules in get_next_entry() ends the loop early and is
+    // recorded here.
+    return tdata->error;
 }
 
 std::string
@@ -671,61 +764,117 @@ raw2trace_t::check_thread_file(std::istream *f)
 }
 
 void
-raw2trace_t::process_tasks(std::vector<raw2trace_thread_data_t *> *tasks)
+raw2trace_t::process_tasks(int worker)
 {
-    if (tasks->empty()) {
-        VPRINT(1, "Worker has no tasks\n");
-        return;
-    }
-    VPRINT(1, "Worker %d assigned %zd task(s)\n", (*tasks)[0]->worker, tasks->size());
-    for (raw2trace_thread_data_t *tdata : *tasks) {
-        VPRINT(1, "Worker %d starting on trace thread %d\n", tdata->worker, tdata->index);
+    while (true) {
+        raw2trace_thread_data_t *tdata;
+        {
+            std::lock_guard<std::mutex> guard(task_mutex_);
+            if (next_task_ == task_queue_.size()) {
+                if (follow_next_thread_cb_ == nullptr || follow_done_)
+                    return;
+                // Other idle workers wait on the lock while we wait on the tracer.
+                std::istream *thread_file;
+                std::ostream *out_file;
+                if (!(*follow_next_thread_cb_)(follow_user_data_, &thread_file,
+                                               &out_file)) {
+                    follow_done_ = true;
+                    return;
+                }
+                thread_data_.emplace_back();
+                thread_data_.back().index = static_cast<int>(thread_data_.size() - 1);
+                thread_data_.back().thread_file = thread_file;
+                thread_data_.back().out_file = out_file;
+                task_queue_.push_back(&thread_data_.back());
+            }
+            tdata = task_queue_[next_task_++];
+            tdata->worker = worker;
+        }
+        VPRINT(1, "Worker %d starting on trace thread %d\n", worker, tdata->index);
+        auto start = std::chrono::steady_clock::now();
         std::string error = process_thread_file(tdata);
+        worker_stats_[worker].busy += std::chrono::steady_clock::now() - start;
+        ++worker_stats_[worker].thread_count;
         if (!error.empty()) {
-            VPRINT(1, "Worker %d hit error %s on trace thread %d\n", tdata->worker,
+            VPRINT(1, "Worker %d hit error %s on trace thread %d\n", worker,
                    error.c_str(), tdata->index);
-            break;
+            return;
         }
-        VPRINT(1, "Worker %d finished trace thread %d\n", tdata->worker, tdata->index);
+        VPRINT(1, "Worker %d finished trace thread %d\n", worker, tdata->index);
     }
 }
 
+void
+raw2trace_t::set_thread_file_sizes(const std::vector<uint64_t> &sizes)
+{
+    thread_file_sizes_ = sizes;
+}
+
 std::string
 raw2trace_t::do_conversion()
 {
     std::string error = read_and_map_modules();
     if (!error.empty())
         return error;
-    if (thread_data_.empty())
+    if (thread_data_.empty() && follow_next_thread_cb_ == nullptr)
         return "No thread files found.";
+    follow_num_modules_.store(modvec_().size(), std::memory_order_release);
+    if (!decode_cache_dir_.empty()) {
+        persistent_cache_.reset(
+            new persistent_decode_cache_t(decode_cache_dir_, worker_count_, verbosity_));
+        error = persistent_cache_->load(modvec_());
+        if (!error.empty())
+            return error;
+    }
     // XXX i#3286: Add a %-completed progress message by looking at the file sizes.
-    if (worker_count_ == 0) {
-        for (size_t i = 0; i < thread_data_.size(); ++i) {
-            error = process_thread_file(&thread_data_[i]);
-            if (!error.empty())
-                return error;
-            count_elided_ += thread_data_[i].count_elided;
-        }
-    } else {
+    // Workers take the thread files from a shared queue, largest first, so that a
+    // dominant thread is started right away rather than after others that happened
+    // to be assigned to the same worker.  When following a live trace the files
+    // are instead added to the queue as they appear.
+    task_queue_.clear();
+    for (auto &tdata : thread_data_)
+        task_queue_.push_back(&tdata);
+    if (thread_file_sizes_.size() == thread_data_.size()) {
+        std::stable_sort(
+            task_queue_.begin(), task_queue_.end(),
+            [this](const raw2trace_thread_data_t *a, const raw2trace_thread_data_t *b) {
+                return thread_file_sizes_[a->index] > thread_file_sizes_[b->index];
+            });
+    }
+    next_task_ = 0;
+    worker_stats_.assign(worker_count_ == 0 ? 1 : worker_count_, worker_stats_t());
+    if (worker_count_ == 0)
+        process_tasks(0);
+    else {
         // The files can be converted concurrently.
         std::vector<std::thread> threads;
         VPRINT(1, "Creating %d worker threads\n", worker_count_);
         threads.reserve(worker_count_);
-        for (int i = 0; i < worker_count_; ++i) {
-            threads.push_back(
-                std::thread(&raw2trace_t::process_tasks, this, &worker_tasks_[i]));
-        }
+        for (int i = 0; i < worker_count_; ++i)
+            threads.push_back(std::thread(&raw2trace_t::process_tasks, this, i));
         for (std::thread &thread : threads)
             thread.join();
-        for (auto &tdata : thread_data_) {
-            if (!tdata.error.empty())
-                return tdata.error;
-            count_elided_ += tdata.count_elided;
-        }
+    }
+    if (thread_data_.empty())
+        return "No thread files found.";
+    for (auto &tdata : thread_data_) {
+        if (!tdata.error.empty())
+            return tdata.error;
+        count_elided_ += tdata.count_elided;
+    }
+    if (persistent_cache_) {
+        error = persistent_cache_->save();
+        if (!error.empty())
+            return error;
     }
     VPRINT(1, "Reconstructed " UINT64_FORMAT_STRING " elided addresses.\n",
            count_elided_);
     VPRINT(1, "Successfully converted %zu thread files\n", thread_data_.size());
+    for (size_t i = 0; i < worker_stats_.size(); ++i) {
+        VPRINT(1, "Worker %zu was busy for %.3f seconds on %d thread files\n", i,
+               std::chrono::duration<double>(worker_stats_[i].busy).count(),
+               worker_stats_[i].thread_count);
+    }
     return "";
 }
 
@@ -791,11 +940,17 @@ raw2trace_t::create_instr_summary(void *tls, uint64 modidx, uint64 modoffs,
         tdata->last_block_summary = block;
     }
     instr_summary_t *desc = &block->instrs[index];
+    if (persistent_cache_ && persistent_cache_->lookup(*pc, orig, desc)) {
+        *pc = desc->next_pc();
+        return desc;
+    }
     if (!instr_summary_t::construct(dcontext_, block_start, pc, orig, desc, verbosity_)) {
         WARN("Encountered invalid/undecodable instr @ %s+" PIFX,
              modvec_()[static_cast<size_t>(modidx)].path, IF_NOT_X64((uint)) modoffs);
         return nullptr;
     }
+    if (persistent_cache_)
+        persistent_cache_->record(tdata->worker, *desc, orig);
     return desc;
 }
 
@@ -877,6 +1032,7 @@ instr_summary_t::construct(void *dcontext, app_pc block_start, INOUT app_pc *pc,
     desc->next_pc_ = *pc;
     DEBUG_ASSERT(desc->next_pc_ > desc->pc_);
     desc->packed_ = 0;
+    desc->opcode_ = static_cast<uint16_t>(instr_get_opcode(instr));
 
     bool is_prefetch = instr_is_prefetch(instr);
     bool is_flush = instru_t::instr_is_flush(instr);
@@ -943,6 +1099,14 @@ raw2trace_t::get_next_entry(void *tls)
         if (!tdata->thread_file->read((char *)&tdata->last_entry,
                                       sizeof(tdata->last_entry)))
             return nullptr;
+        if (follow_module_map_cb_ != nullptr &&
+            tdata->last_entry.pc.type == OFFLINE_TYPE_PC &&
+            tdata->last_entry.pc.modidx >=
+                follow_num_modules_.load(std::memory_order_acquire)) {
+            tdata->error = load_new_modules(tdata->last_entry.pc.modidx);
+            if (!tdata->error.empty())
+                return nullptr;
+        }
     }
     VPRINT(5, "[get_next_entry]: type=%d val=" HEX64_FORMAT_STRING "\n",
            // Some compilers think .addr.type is "int" while others think it's "unsigned
@@ -1118,7 +1282,8 @@ raw2trace_t::raw2trace_t(const char *module_map,
                          const std::vector<std::istream *> &thread_files,
                          const std::vector<std::ostream *> &out_files, void *dcontext,
                          unsigned int verbosity, int worker_count,
-                         const std::string &alt_module_dir)
+                         const std::string &alt_module_dir,
+                         const std::string &decode_cache_dir)
     : trace_converter_t(dcontext)
     , worker_count_(worker_count)
     , user_process_(nullptr)
@@ -1126,6 +1291,7 @@ raw2trace_t::raw2trace_t(const char *module_map,
     , modmap_(module_map)
     , verbosity_(verbosity)
     , alt_module_dir_(alt_module_dir)
+    , decode_cache_dir_(decode_cache_dir)
 {
     if (dcontext == NULL) {
 #ifdef ARM
@@ -1140,25 +1306,14 @@ raw2trace_t::raw2trace_t(const char *module_map,
         thread_data_[i].thread_file = thread_files[i];
         thread_data_[i].out_file = out_files[i];
     }
-    // Since we know the traced-thread count up front, we use a simple round-robin
-    // static work assigment.  This won't be as load balanced as a dynamic work
-    // queue but it is much simpler.
+    // The thread files are handed out to the workers by do_conversion().
     if (worker_count_ < 0) {
         worker_count_ = std::thread::hardware_concurrency();
         if (worker_count_ > kDefaultJobMax)
             worker_count_ = kDefaultJobMax;
     }
     int cache_count = worker_count_;
-    if (worker_count_ > 0) {
-        worker_tasks_.resize(worker_count_);
-        int worker = 0;
-        for (size_t i = 0; i < thread_data_.size(); ++i) {
-            VPRINT(2, "Worker %d assigned trace thread %zd\n", worker, i);
-            worker_tasks_[worker].push_back(&thread_data_[i]);
-            thread_data_[i].worker = worker;
-            worker = (worker + 1) % worker_count_;
-        }
-    } else
+    if (worker_count_ == 0)
         cache_count = 1;
     decode_cache_.resize(cache_count);
     for (int i = 0; i < cache_count; ++i) {
@@ -46,7 +46,10 @@
 #include "drcovlib.h"
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #include "trace_entry.h"
 #include "instru.h"
@@ -76,16 +79,26 @@
 #define WINDOW_SUBDIR_FORMAT "window.%04zd" /* ptr_int_t is the window number type. */
 #define WINDOW_SUBDIR_FIRST "window.0000"
 #define TRACE_SUBDIR "trace"
+#define TRACE_SUFFIX_UNCOMPRESSED "trace"
 #ifdef HAS_ZLIB
 #    define TRACE_SUFFIX "trace.gz"
+#    define TRACE_SUFFIX_CHUNKED "trace.chunked"
 #else
-#    define TRACE_SUFFIX "trace"
+#    define TRACE_SUFFIX TRACE_SUFFIX_UNCOMPRESSED
+#endif
+#ifdef HAS_ZSTD
+#    define TRACE_SUFFIX_ZSTD "trace.zst"
+#endif
+#ifdef HAS_LZ4
+#    define TRACE_SUFFIX_LZ4 "trace.lz4"
 #endif
 
 typedef enum {
     RAW2TRACE_STAT_COUNT_ELIDED,
 } raw2trace_statistic_t;
 
+class persistent_decode_cache_t;
+
 struct module_t {
     module_t(const char *path, app_pc orig, byte *map, size_t offs, size_t size,
              size_t total_size, bool external = false)
@@ -205,6 +218,7 @@ struct instr_summary_t final {
 
 private:
     template <typename T> friend class trace_converter_t;
+    friend class persistent_decode_cache_t;
 
     byte
     length() const
@@ -320,6 +334,8 @@ private:
     std::vector<memref_summary_t> mem_srcs_and_dests_;
     uint8_t num_mem_srcs_ = 0;
     byte packed_ = 0;
+    // Only used by persistent_decode_cache_t, for tools that want the opcode.
+    uint16_t opcode_ = 0;
 };
 
 /**
@@ -452,6 +468,29 @@ public:
                       int (*print_cb)(void *data, char *dst, size_t max_len),
                       OUT size_t *wrote);
 
+    /**
+     * Reserves room for \p count modules in the vector returned by
+     * get_loaded_modules(), so that add_new_modules() does not move its entries.
+     * Must be called before get_loaded_modules().
+     */
+    void
+    reserve_modules(size_t count)
+    {
+        modvec_.reserve(count);
+    }
+
+    /**
+     * For a trace that is still being written, parses \p module_map, a later copy
+     * of the module list passed to create() that may list additional modules, and
+     * maps and appends those modules to the vector returned by get_loaded_modules().
+     * Existing entries are left in place, so other threads may keep reading them,
+     * provided the total fits in the capacity passed to reserve_modules(); otherwise
+     * an error is returned.  \p module_map must remain valid for the lifetime of this
+     * object.  Returns an error message on failure.
+     */
+    std::string
+    add_new_modules(const char *module_map);
+
 protected:
     module_mapper_t(const char *module_map,
                     const char *(*parse_cb)(const char *src, OUT void **data) = nullptr,
@@ -483,9 +522,15 @@ protected:
     std::string
     do_module_parsing();
 
+    std::string
+    read_module_list(void *handle, uint num_mods);
+
     const char *modmap_ = nullptr;
     void *modhandle_ = nullptr;
+    // Handles for the lists passed to add_new_modules().
+    std::vector<void *> later_modhandles_;
     std::vector<module_t> modvec_;
+    const char *(*const cached_user_parse_)(const char *src, OUT void **data) = nullptr;
     void (*const cached_user_free_)(void *data) = nullptr;
 
     // Custom module fields that use drmodtrack are global.
@@ -1528,10 +1573,13 @@ class raw2trace_t : public trace_converter_t<raw2trace_t> {
 public:
     // module_map, thread_files and out_files are all owned and opened/closed by the
     // caller.  module_map is not a string and can contain binary data.
+    // A non-empty decode_cache_dir keeps decoded instructions in files there across
+    // runs: see persistent_decode_cache_t.
     raw2trace_t(const char *module_map, const std::vector<std::istream *> &thread_files,
                 const std::vector<std::ostream *> &out_files, void *dcontext = NULL,
                 unsigned int verbosity = 0, int worker_count = -1,
-                const std::string &alt_module_dir = "");
+                const std::string &alt_module_dir = "",
+                const std::string &decode_cache_dir = "");
     virtual ~raw2trace_t();
 
     /**
@@ -1572,6 +1620,43 @@ public:
     std::string
     do_module_parsing();
 
+    /**
+     * Provides the size of each thread file passed to the constructor, in the same
+     * order, such as its size on disk.  do_conversion() then hands the files to
+     * the workers largest first, rather than in the order given, so that a
+     * dominant thread does not leave the other workers idle at the end.
+     */
+    void
+    set_thread_file_sizes(const std::vector<uint64_t> &sizes);
+
+    /**
+     * Sets up do_conversion() to convert a trace that is still being written by a
+     * tracer running with -offline_streaming, emitting each thread's final trace as
+     * its raw buffers arrive rather than after the application exits.  The thread
+     * files, both those passed to the constructor and those obtained from
+     * \p next_thread_cb, should wait at their current end for more data until the
+     * tracer has exited, as follow_istream_t does.
+     *
+     * Each worker converts one thread file to completion before taking the next,
+     * calling \p next_thread_cb for another once those passed to the constructor
+     * are taken.  \p next_thread_cb should block until the application creates a
+     * new thread file, returning it and its output file in \p thread_file and
+     * \p out_file, or return false once the tracer has exited and every thread file
+     * has been returned.  For every thread to be converted while it runs, the
+     * worker count must be at least the number of simultaneously live threads.
+     *
+     * When a thread file refers to a module beyond those known so far,
+     * \p module_map_cb is called to obtain the tracer's latest module list, which
+     * must remain valid for the lifetime of this object, or nullptr on error.
+     * The callbacks are passed \p user_data.  Calls to each are serialized, but the
+     * two may be called concurrently.
+     */
+    void
+    set_follow_callbacks(bool (*next_thread_cb)(void *user_data,
+                                                OUT std::istream **thread_file,
+                                                OUT std::ostream **out_file),
+                         const char *(*module_map_cb)(void *user_data), void *user_data);
+
     /**
      * This interface is meant to be used with a final trace rather than a raw
      * trace, using the module log file saved from the raw2trace conversion.
@@ -1771,12 +1856,31 @@ private:
     process_thread_file(raw2trace_thread_data_t *tdata);
 
     void
-    process_tasks(std::vector<raw2trace_thread_data_t *> *tasks);
+    process_tasks(int worker);
+
+    std::string
+    load_new_modules(uint64 modidx);
 
-    std::vector<raw2trace_thread_data_t> thread_data_;
+    // A deque so that following a live trace can add threads while others are
+    // being converted.
+    std::deque<raw2trace_thread_data_t> thread_data_;
 
     int worker_count_;
-    std::vector<std::vector<raw2trace_thread_data_t *>> worker_tasks_;
+    // The thread_data_ entries in the order the workers take them.
+    std::vector<raw2trace_thread_data_t *> task_queue_;
+    // Guards taking from and adding to task_queue_, including calling
+    // follow_next_thread_cb_.
+    std::mutex task_mutex_;
+    size_t next_task_ = 0;
+    // Indexed by raw2trace_thread_data_t.index: see set_thread_file_sizes().
+    std::vector<uint64_t> thread_file_sizes_;
+    // Each worker updates only its own entry.
+    struct worker_stats_t {
+        std::chrono::steady_clock::duration busy =
+            std::chrono::steady_clock::duration::zero();
+        int thread_count = 0;
+    };
+    std::vector<worker_stats_t> worker_stats_;
 
     // We use a hashtable to cache decodings.  We compared the performance of
     // hashtable_t to std::map.find, std::map.lower_bound, std::tr1::unordered_map,
@@ -1798,10 +1902,26 @@ private:
     const char *modmap_;
     std::unique_ptr<module_mapper_t> module_mapper_;
 
+    // For following a live trace: see set_follow_callbacks().
+    bool (*follow_next_thread_cb_)(void *user_data, OUT std::istream **thread_file,
+                                   OUT std::ostream **out_file) = nullptr;
+    const char *(*follow_module_map_cb_)(void *user_data) = nullptr;
+    void *follow_user_data_ = nullptr;
+    // Guarded by task_mutex_.
+    bool follow_done_ = false;
+    // Guards adding modules and calling follow_module_map_cb_.
+    std::mutex follow_modules_mutex_;
+    // The count of modvec_() entries that may be read without a lock.
+    std::atomic<size_t> follow_num_modules_ { 0 };
+
     unsigned int verbosity_ = 0;
 
     std::string alt_module_dir_;
 
+    // Backs decode_cache_ across runs, if requested.
+    std::string decode_cache_dir_;
+    std::unique_ptr<persistent_decode_cache_t> persistent_cache_;
+
     // Our decode_cache duplication will not scale forever on very large code
     // footprint traces, so we set a cap for the default.
     static const int kDefaultJobMax = 16;
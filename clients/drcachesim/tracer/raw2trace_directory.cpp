@@ -35,8 +35,12 @@
  */
 
 #include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <thread>
 #include <vector>
 
 #ifdef UNIX
@@ -55,7 +59,9 @@
 #include "raw2trace_directory.h"
 #include "directory_iterator.h"
 #include "utils.h"
+#include "common/follow_istream.h"
 #ifdef HAS_ZLIB
+#    include "common/chunked_ostream.h"
 #    include "common/gzip_istream.h"
 #    include "common/gzip_ostream.h"
 #    include "common/zlib_istream.h"
@@ -65,6 +71,10 @@
 #endif
 #ifdef HAS_LZ4
 #    include "common/lz4_istream.h"
+#    include "common/lz4_ostream.h"
+#endif
+#ifdef HAS_ZSTD
+#    include "common/zstd_ostream.h"
 #endif
 
 #define FATAL_ERROR(msg, ...)                               \
@@ -80,6 +90,9 @@
             FATAL_ERROR(msg, ##__VA_ARGS__); \
     } while (0)
 
+// How often to check for new data when following a trace still being written.
+static const int kFollowPollMs = 100;
+
 #undef VPRINT
 #define VPRINT(level, ...)                     \
     do {                                       \
@@ -185,9 +198,25 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
         ifile = new lz4_istream_t(path);
     }
 #endif
+    if (follow_) {
+        if (ifile != nullptr) {
+            delete ifile;
+            return "Following a trace requires uncompressed raw files: " +
+                std::string(path);
+        }
+        ifile = new follow_istream_t(path, done_path_, kFollowPollMs);
+    }
     if (ifile == nullptr)
         ifile = new std::ifstream(path, std::ifstream::binary);
     in_files_.push_back(ifile);
+    uint64 file_size = 0;
+    file_t size_file = dr_open_file(path, DR_FILE_READ);
+    if (size_file != INVALID_FILE) {
+        if (!dr_file_size(size_file, &file_size))
+            file_size = 0;
+        dr_close_file(size_file);
+    }
+    in_file_sizes_.push_back(file_size);
     if (!(*in_files_.back()))
         return "Failed to open thread log file " + std::string(path);
     std::string error = raw2trace_t::check_thread_file(in_files_.back());
@@ -203,16 +232,42 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
                     basename_pre_suffix - 1 - basename, basename) <= 0) {
         return "Failed to compute output name for file " + std::string(basename);
     }
+    const char *suffix = TRACE_SUFFIX_UNCOMPRESSED;
+#ifdef HAS_ZLIB
+    if (trace_compress_ == "gzip")
+        suffix = chunk_instr_count_ > 0 ? TRACE_SUFFIX_CHUNKED : TRACE_SUFFIX;
+#endif
+#ifdef HAS_ZSTD
+    if (trace_compress_ == "zstd")
+        suffix = TRACE_SUFFIX_ZSTD;
+#endif
+#ifdef HAS_LZ4
+    if (trace_compress_ == "lz4")
+        suffix = TRACE_SUFFIX_LZ4;
+#endif
     if (dr_snprintf(path, BUFFER_SIZE_ELEMENTS(path), "%s%s%s.%s", outdir_.c_str(),
-                    DIRSEP, outname, TRACE_SUFFIX) <= 0) {
+                    DIRSEP, outname, suffix) <= 0) {
         return "Failed to compute full path of output file for " + std::string(basename);
     }
-    std::ostream *ofile;
+    std::ostream *ofile = nullptr;
 #ifdef HAS_ZLIB
-    ofile = new gzip_ostream_t(path);
-#else
-    ofile = new std::ofstream(path, std::ofstream::binary);
+    if (trace_compress_ == "gzip") {
+        if (chunk_instr_count_ > 0)
+            ofile = new chunked_ostream_t(path, chunk_instr_count_);
+        else
+            ofile = new gzip_ostream_t(path);
+    }
+#endif
+#ifdef HAS_ZSTD
+    if (trace_compress_ == "zstd")
+        ofile = new zstd_ostream_t(path, zstd_dict_);
+#endif
+#ifdef HAS_LZ4
+    if (trace_compress_ == "lz4")
+        ofile = new lz4_ostream_t(path);
 #endif
+    if (ofile == nullptr)
+        ofile = new std::ofstream(path, std::ofstream::binary);
     out_files_.push_back(ofile);
     if (!(*out_files_.back()))
         return "Failed to open output file " + std::string(path);
@@ -294,10 +349,46 @@ raw2trace_directory_t::tracedir_from_rawdir(const std::string &rawdir_in)
 }
 
 std::string
-raw2trace_directory_t::initialize(const std::string &indir, const std::string &outdir)
+raw2trace_directory_t::initialize(const std::string &indir, const std::string &outdir,
+                                  uint64_t chunk_instr_count,
+                                  const std::string &trace_compress,
+                                  const std::string &zstd_dict_path, bool follow)
 {
     indir_ = indir;
+    follow_ = follow;
     outdir_ = outdir;
+    chunk_instr_count_ = chunk_instr_count;
+    trace_compress_ = trace_compress;
+    if (trace_compress_.empty()) {
+#ifdef HAS_ZLIB
+        trace_compress_ = "gzip";
+#else
+        trace_compress_ = "none";
+#endif
+    }
+    bool supported = trace_compress_ == "none";
+#ifdef HAS_ZLIB
+    supported = supported || trace_compress_ == "gzip";
+#endif
+#ifdef HAS_ZSTD
+    supported = supported || trace_compress_ == "zstd";
+#endif
+#ifdef HAS_LZ4
+    supported = supported || trace_compress_ == "lz4";
+#endif
+    if (!supported)
+        return "Unsupported trace compression type: " + trace_compress_;
+    if (chunk_instr_count_ > 0 && trace_compress_ != "gzip")
+        return "The chunked trace format requires gzip compression";
+    if (!zstd_dict_path.empty()) {
+        if (trace_compress_ != "zstd")
+            return "A compression dictionary requires zstd compression";
+        std::ifstream dict(zstd_dict_path, std::ifstream::binary);
+        if (!dict)
+            return "Failed to open zstd dictionary " + zstd_dict_path;
+        zstd_dict_.assign(std::istreambuf_iterator<char>(dict),
+                          std::istreambuf_iterator<char>());
+    }
 #ifdef WINDOWS
     // Canonicalize.
     std::replace(indir_.begin(), indir_.end(), ALT_DIRSEP[0], DIRSEP[0]);
@@ -337,13 +428,75 @@ raw2trace_directory_t::initialize(const std::string &indir, const std::string &o
     }
     std::string modfilename =
         modfile_dir + std::string(DIRSEP) + DRMEMTRACE_MODULE_LIST_FILENAME;
+    if (follow_) {
+        // The complete module list is only written at exit, so we use the
+        // snapshot the tracer keeps up to date and wait for it if necessary.
+        modfilename =
+            modfile_dir + std::string(DIRSEP) + DRMEMTRACE_MODULE_SNAPSHOT_FILENAME;
+        modfile_path_ = modfilename;
+        done_path_ = indir_ + std::string(DIRSEP) + DRMEMTRACE_STREAM_DONE_FILENAME;
+        VPRINT(1, "Waiting for %s\n", modfilename.c_str());
+        while (!follow_istreambuf_t::exists(modfilename)) {
+            if (follow_istreambuf_t::exists(done_path_)) {
+                return "Missing " + modfilename +
+                    ": was the trace gathered with -offline_streaming?";
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(kFollowPollMs));
+        }
+    }
     std::string err = read_module_file(modfilename);
     if (!err.empty())
         return err;
 
+    if (follow_)
+        return "";
     return open_thread_files();
 }
 
+bool
+raw2trace_directory_t::follow_next_thread(void *dir_in, OUT std::istream **thread_file,
+                                          OUT std::ostream **out_file)
+{
+    raw2trace_directory_t *dir = reinterpret_cast<raw2trace_directory_t *>(dir_in);
+    while (true) {
+        // We check for the done file before listing the directory so that we
+        // cannot miss a thread file created just before it.
+        bool done = follow_istreambuf_t::exists(dir->done_path_);
+        directory_iterator_t end;
+        directory_iterator_t iter(dir->indir_);
+        CHECK(iter, "Failed to list directory %s: %s", dir->indir_.c_str(),
+              iter.error_string().c_str());
+        for (; iter != end; ++iter) {
+            if (!dir->followed_files_.insert(*iter).second)
+                continue;
+            size_t count = dir->in_files_.size();
+            std::string error = dir->open_thread_log_file((*iter).c_str());
+            CHECK(error.empty(), "%s", error.c_str());
+            if (dir->in_files_.size() > count) {
+                *thread_file = dir->in_files_.back();
+                *out_file = dir->out_files_.back();
+                return true;
+            }
+        }
+        if (done)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(kFollowPollMs));
+    }
+}
+
+const char *
+raw2trace_directory_t::follow_module_map(void *dir_in)
+{
+    raw2trace_directory_t *dir = reinterpret_cast<raw2trace_directory_t *>(dir_in);
+    std::ifstream file(dir->modfile_path_, std::ifstream::binary);
+    if (!file)
+        return nullptr;
+    // Earlier lists stay alive for the module data that points into them.
+    dir->followed_modfiles_.emplace_back(std::istreambuf_iterator<char>(file),
+                                         std::istreambuf_iterator<char>());
+    return dir->followed_modfiles_.back().c_str();
+}
+
 std::string
 raw2trace_directory_t::initialize_module_file(const std::string &module_file_path)
 {
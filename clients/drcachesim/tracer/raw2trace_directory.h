@@ -33,7 +33,9 @@
 #ifndef _RAW2TRACE_DIRECTORY_H_
 #define _RAW2TRACE_DIRECTORY_H_ 1
 
+#include <deque>
 #include <fstream>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -54,9 +56,19 @@ public:
     ~raw2trace_directory_t();
 
     // If outdir.empty() then a peer of indir's OUTFILE_SUBDIR named TRACE_SUBDIR
-    // is used by default.  Returns "" on success or an error message on failure.
+    // is used by default.  If chunk_instr_count is non-zero, the output files use
+    // the seekable chunked format with at least that many instructions per chunk.
+    // trace_compress selects the output compression: "gzip", "zstd", "lz4", or
+    // "none", with "" meaning gzip if available.  For zstd, a non-empty
+    // zstd_dict_path names a dictionary to compress with.  If follow is set, indir
+    // is being written by a tracer running with -offline_streaming: no thread files
+    // are opened here, and instead follow_next_thread() and follow_module_map() are
+    // to be passed to raw2trace_t::set_follow_callbacks() with this object.
+    // Returns "" on success or an error message on failure.
     std::string
-    initialize(const std::string &indir, const std::string &outdir);
+    initialize(const std::string &indir, const std::string &outdir,
+               uint64_t chunk_instr_count = 0, const std::string &trace_compress = "",
+               const std::string &zstd_dict_path = "", bool follow = false);
     // Use this instead of initialize() to only fill in modfile_bytes, for
     // constructing a module_mapper_t.  Returns "" on success or an error message on
     // failure.
@@ -78,8 +90,20 @@ public:
     static bool
     is_window_subdir(const std::string &dir);
 
+    // Callbacks for raw2trace_t::set_follow_callbacks() with a raw2trace_directory_t
+    // as the user_data, after initialize() with follow set.  follow_next_thread()
+    // polls for a thread file not yet returned, opening it so that reads wait for
+    // the tracer to append more data.  follow_module_map() rereads the module list.
+    static bool
+    follow_next_thread(void *dir, OUT std::istream **thread_file,
+                       OUT std::ostream **out_file);
+    static const char *
+    follow_module_map(void *dir);
+
     char *modfile_bytes_;
     std::vector<std::istream *> in_files_;
+    // The on-disk size of each of in_files_, for raw2trace_t::set_thread_file_sizes().
+    std::vector<uint64_t> in_file_sizes_;
     std::vector<std::ostream *> out_files_;
 
 private:
@@ -92,6 +116,16 @@ private:
     file_t modfile_;
     std::string indir_;
     std::string outdir_;
+    uint64_t chunk_instr_count_ = 0;
+    std::string trace_compress_;
+    // The contents of the zstd dictionary, if any.
+    std::string zstd_dict_;
+    // For following a trace still being written.
+    bool follow_ = false;
+    std::string modfile_path_;
+    std::string done_path_;
+    std::set<std::string> followed_files_;
+    std::deque<std::string> followed_modfiles_;
     unsigned int verbosity_;
 };
 
@@ -59,6 +59,14 @@ static droption_t<std::string> op_alt_module_dir(
     "Specifies a directory to look for binaries needed to post-process "
     "the trace.  This directory takes precedence over the recorded path.");
 
+static droption_t<std::string> op_decode_cache_dir(
+    DROPTION_SCOPE_FRONTEND, "decode_cache_dir", "",
+    "Directory for decodings kept across runs",
+    "Specifies a directory in which to keep the decoded form of each instruction, in "
+    "one file per module named by the module's build ID (or checksum on Windows), so "
+    "that later runs on traces of the same binaries need not decode them again.  The "
+    "directory is created if needed and may be shared by concurrent runs.");
+
 static droption_t<unsigned int> op_verbose(DROPTION_SCOPE_FRONTEND, "verbose", 0,
                                            "Verbosity level for diagnostic output",
                                            "Verbosity level for diagnostic output.");
@@ -70,6 +78,44 @@ static droption_t<int>
             "disables concurrency and uses  single thread to perform all operations.  A "
             "negative value sets the job count to the number of hardware threads.");
 
+static droption_t<bytesize_t> op_chunk_instr_count(
+    DROPTION_SCOPE_FRONTEND, "chunk_instr_count", 0,
+    "Instructions per chunk in a seekable output trace",
+    "A non-zero value produces output files in a seekable chunked format rather than "
+    "a single gzip stream.  Each chunk is compressed independently and holds at least "
+    "this many instructions, and an index at the end of the file allows skipping to "
+    "any instruction while only decompressing the chunk that holds it.");
+
+static droption_t<std::string> op_trace_compress(
+    DROPTION_SCOPE_FRONTEND, "trace_compress",
+#ifdef HAS_ZLIB
+    "gzip",
+#else
+    "none",
+#endif
+    "Output compression: \"gzip\",\"zstd\",\"lz4\",\"none\"",
+    "Specifies the compression type to use for the output files: \"gzip\", "
+    "\"zstd\", \"lz4\", or \"none\".  zstd and lz4 files take somewhat more space "
+    "than gzip but decompress several times faster.  Only gzip supports "
+    "-chunk_instr_count.");
+
+static droption_t<std::string> op_zstd_dict(
+    DROPTION_SCOPE_FRONTEND, "zstd_dict", "", "Dictionary for zstd output",
+    "Specifies a dictionary trained with \"zstd --train\" on sample trace files to "
+    "compress with when using -trace_compress zstd.  The same dictionary must be "
+    "supplied when analyzing the output.");
+
+static droption_t<bool> op_follow(
+    DROPTION_SCOPE_FRONTEND, "follow", false,
+    "Convert a trace while it is being written",
+    "Converts a trace being written by a tracer running with -offline_streaming "
+    "while the application is still running, rather than waiting for it to exit.  "
+    "Each thread's buffers are converted as they are written out and new thread files "
+    "are picked up as they appear, until the tracer exits.  Each worker converts one "
+    "thread at a time, so -jobs should be at least the number of application threads "
+    "that are live at once for all of them to be converted as they run.  Only "
+    "-indir naming a single process's directory is supported.");
+
 #define FATAL_ERROR(msg, ...)                               \
     do {                                                    \
         fprintf(stderr, "ERROR: " msg "\n", ##__VA_ARGS__); \
@@ -95,12 +141,19 @@ _tmain(int argc, const TCHAR *targv[])
     }
 
     raw2trace_directory_t dir(op_verbose.get_value());
-    std::string dir_err = dir.initialize(op_indir.get_value(), op_outdir.get_value());
+    std::string dir_err = dir.initialize(
+        op_indir.get_value(), op_outdir.get_value(), op_chunk_instr_count.get_value(),
+        op_trace_compress.get_value(), op_zstd_dict.get_value(), op_follow.get_value());
     if (!dir_err.empty())
         FATAL_ERROR("Directory parsing failed: %s", dir_err.c_str());
     raw2trace_t raw2trace(dir.modfile_bytes_, dir.in_files_, dir.out_files_, NULL,
                           op_verbose.get_value(), op_jobs.get_value(),
-                          op_alt_module_dir.get_value());
+                          op_alt_module_dir.get_value(), op_decode_cache_dir.get_value());
+    raw2trace.set_thread_file_sizes(dir.in_file_sizes_);
+    if (op_follow.get_value()) {
+        raw2trace.set_follow_callbacks(raw2trace_directory_t::follow_next_thread,
+                                       raw2trace_directory_t::follow_module_map, &dir);
+    }
     std::string error = raw2trace.do_conversion();
     if (!error.empty())
         FATAL_ERROR("Conversion failed: %s", error.c_str());
@@ -59,6 +59,9 @@
 #include "func_trace.h"
 #include "../common/trace_entry.h"
 #include "../common/named_pipe.h"
+#ifdef UNIX
+#    include "../common/shm_ring.h"
+#endif
 #include "../common/options.h"
 #include "../common/utils.h"
 
@@ -121,6 +124,13 @@ typedef struct {
 
 /* For online simulation, we write to a single global pipe */
 named_pipe_t ipc_pipe;
+#ifdef UNIX
+/* ...or with -ipc_shm_rings, to rings in a file shared with the simulator. */
+shm_ring_t ipc_ring;
+bool use_ipc_ring;
+static void *ipc_ring_map;
+static size_t ipc_ring_map_size;
+#endif
 
 #define MAX_INSTRU_SIZE 128 /* the max obj size of instr_t or its children */
 instru_t *instru;
@@ -160,6 +170,9 @@ struct file_ops_func_t file_ops_func;
 
 static char modlist_path[MAXIMUM_PATH];
 static char funclist_path[MAXIMUM_PATH];
+/* For -offline_streaming. */
+static char modsnapshot_path[MAXIMUM_PATH];
+static void *modsnapshot_mutex;
 
 /* clean_call sends the memory reference info to the simulator */
 static void
@@ -1414,6 +1427,36 @@ event_thread_exit(void *drcontext)
     dr_thread_free(drcontext, data, sizeof(per_thread_t));
 }
 
+/* For -offline_streaming we replace the module list snapshot as a whole so that
+ * a converter following the thread files never reads a partial list.
+ */
+static void
+write_module_snapshot()
+{
+    char tmp_path[MAXIMUM_PATH];
+    dr_snprintf(tmp_path, BUFFER_SIZE_ELEMENTS(tmp_path), "%s.tmp", modsnapshot_path);
+    NULL_TERMINATE_BUFFER(tmp_path);
+    dr_mutex_lock(modsnapshot_mutex);
+    file_t file = file_ops_func.open_file(tmp_path, DR_FILE_WRITE_OVERWRITE);
+    bool ok = file != INVALID_FILE &&
+        static_cast<offline_instru_t *>(instru)->write_module_list(file);
+    if (file != INVALID_FILE)
+        file_ops_func.close_file(file);
+    if (!ok || !dr_rename_file(tmp_path, modsnapshot_path, true /*replace*/))
+        NOTIFY(0, "Failed to write the module list to %s\n", modsnapshot_path);
+    dr_mutex_unlock(modsnapshot_mutex);
+}
+
+/* We update the snapshot before any code in the new module runs, and thus before
+ * any thread file refers to it.  drmodtrack registered its own module load event
+ * first at the same priority, so the new module is already in its list.
+ */
+static void
+event_module_load_streaming(void *drcontext, const module_data_t *mod, bool loaded)
+{
+    write_module_snapshot();
+}
+
 static void
 event_exit(void)
 {
@@ -1433,6 +1476,9 @@ event_exit(void)
                " physical address markers in " UINT64_FORMAT_STRING " writeouts.\n",
                num_phys_markers, num_v2p_writeouts);
     }
+    if (op_offline_streaming.get_value() &&
+        !drmgr_unregister_module_load_event(event_module_load_streaming))
+        DR_ASSERT(false);
     /* we use placement new for better isolation */
     instru->~instru_t();
     dr_global_free(instru, MAX_INSTRU_SIZE);
@@ -1441,8 +1487,29 @@ event_exit(void)
         file_ops_func.close_file(module_file);
         if (funclist_file != INVALID_FILE)
             file_ops_func.close_file(funclist_file);
-    } else
+        if (op_offline_streaming.get_value()) {
+            /* Every thread has written its final buffer by now. */
+            char done_path[MAXIMUM_PATH];
+            dr_snprintf(done_path, BUFFER_SIZE_ELEMENTS(done_path), "%s%s%s", logsubdir,
+                        DIRSEP, DRMEMTRACE_STREAM_DONE_FILENAME);
+            NULL_TERMINATE_BUFFER(done_path);
+            file_t done_file =
+                file_ops_func.open_file(done_path, DR_FILE_WRITE_OVERWRITE);
+            if (done_file == INVALID_FILE)
+                NOTIFY(0, "Failed to create %s\n", done_path);
+            else
+                file_ops_func.close_file(done_file);
+            dr_mutex_destroy(modsnapshot_mutex);
+        }
+    } else {
         ipc_pipe.close();
+#ifdef UNIX
+        if (use_ipc_ring) {
+            ipc_ring.detach();
+            dr_unmap_file(ipc_ring_map, ipc_ring_map_size);
+        }
+#endif
+    }
 
     if (file_ops_func.exit_cb != NULL)
         (*file_ops_func.exit_cb)(file_ops_func.exit_arg);
@@ -1487,6 +1554,37 @@ event_exit(void)
     droption_parser_t::clear_values();
 }
 
+#ifdef UNIX
+static bool
+init_ipc_ring(void)
+{
+    if (!ipc_ring.set_name(op_ipc_name.get_value().c_str()))
+        return false;
+    /* We map the file ourselves to use DR's own mapping routines. */
+    file_t fd = dr_open_file(ipc_ring.get_name().c_str(),
+                             DR_FILE_READ | DR_FILE_WRITE_APPEND);
+    if (fd == INVALID_FILE)
+        return false;
+    uint64 file_size;
+    if (!dr_file_size(fd, &file_size)) {
+        dr_close_file(fd);
+        return false;
+    }
+    ipc_ring_map_size = (size_t)file_size;
+    ipc_ring_map = dr_map_file(fd, &ipc_ring_map_size, 0, NULL,
+                               DR_MEMPROT_READ | DR_MEMPROT_WRITE, 0);
+    dr_close_file(fd);
+    if (ipc_ring_map == NULL)
+        return false;
+    if (!ipc_ring.attach(ipc_ring_map, ipc_ring_map_size)) {
+        dr_unmap_file(ipc_ring_map, ipc_ring_map_size);
+        return false;
+    }
+    use_ipc_ring = true;
+    return true;
+}
+#endif
+
 static bool
 init_offline_dir(void)
 {
@@ -1544,6 +1642,10 @@ init_offline_dir(void)
     funclist_file = file_ops_func.open_file(
         funclist_path, DR_FILE_WRITE_REQUIRE_NEW IF_UNIX(| DR_FILE_CLOSE_ON_FORK));
 
+    dr_snprintf(modsnapshot_path, BUFFER_SIZE_ELEMENTS(modsnapshot_path), "%s%s%s",
+                logsubdir, DIRSEP, DRMEMTRACE_MODULE_SNAPSHOT_FILENAME);
+    NULL_TERMINATE_BUFFER(modsnapshot_path);
+
     return (module_file != INVALID_FILE && funclist_file != INVALID_FILE);
 }
 
@@ -1572,9 +1674,17 @@ fork_init(void *drcontext)
     data->num_refs = 0;
     if (op_offline.get_value()) {
         data->file = INVALID_FILE;
+        fork_init_io(drcontext);
         if (!init_offline_dir()) {
             FATAL("Failed to create a subdir in %s\n", op_outdir.get_value().c_str());
         }
+        /* The new subdir needs the inherited module list before any buffer. */
+        if (op_offline_streaming.get_value())
+            write_module_snapshot();
+    } else if (use_ipc_ring) {
+        /* We share the parent's mapping but must be counted as a writer. */
+        if (!ipc_ring.register_writer())
+            FATAL("Fatal error: Failed to register with ring file\n");
     }
     init_thread_in_process(drcontext);
 }
@@ -1725,6 +1835,15 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
     if (op_use_physical.get_value() || op_L0I_filter.get_value() ||
         op_L0D_filter.get_value())
         op_disable_optimizations.set_value(true);
+    if (op_offline_streaming.get_value()) {
+        if (!op_offline.get_value() || has_tracing_windows()) {
+            FATAL("Usage error: -offline_streaming requires -offline and does not "
+                  "support tracing windows.\n");
+        }
+        // A converter following the raw files needs each buffer readable as soon as
+        // it is written.
+        op_raw_compress.set_value("none");
+    }
 
     event_inscount_init();
     init_io();
@@ -1752,6 +1871,11 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
             offline_instru_t(insert_load_buf_ptr, op_L0I_filter.get_value(),
                              &scratch_reserve_vec, file_ops_func.write_file, module_file,
                              op_disable_optimizations.get_value(), instru_notify);
+        if (op_offline_streaming.get_value()) {
+            modsnapshot_mutex = dr_mutex_create();
+            if (!drmgr_register_module_load_event(event_module_load_streaming))
+                DR_ASSERT(false);
+        }
     } else {
         void *placement;
         /* we use placement new for better isolation */
@@ -1763,11 +1887,20 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
         if (!ipc_pipe.set_name(op_ipc_name.get_value().c_str()))
             DR_ASSERT(false);
 #ifdef UNIX
-        /* we want an isolated fd so we don't use ipc_pipe.open_for_write() */
-        int fd = dr_open_file(ipc_pipe.get_pipe_path().c_str(), DR_FILE_WRITE_ONLY);
-        DR_ASSERT(fd != INVALID_FILE);
-        if (!ipc_pipe.set_fd(fd))
-            DR_ASSERT(false);
+        if (op_ipc_shm_rings.get_value() > 0) {
+            if (!init_ipc_ring()) {
+                FATAL("Fatal error: Failed to attach to ring file %s.\n",
+                      ipc_ring.get_name().c_str());
+            }
+        } else {
+            /* we want an isolated fd so we don't use ipc_pipe.open_for_write() */
+            int fd = dr_open_file(ipc_pipe.get_pipe_path().c_str(), DR_FILE_WRITE_ONLY);
+            DR_ASSERT(fd != INVALID_FILE);
+            if (!ipc_pipe.set_fd(fd))
+                DR_ASSERT(false);
+            if (!ipc_pipe.maximize_buffer())
+                NOTIFY(1, "Failed to maximize pipe buffer: performance may suffer.\n");
+        }
 #else
         if (!ipc_pipe.open_for_write()) {
             if (GetLastError() == ERROR_PIPE_BUSY) {
@@ -1779,9 +1912,9 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
                       op_ipc_name.get_value().c_str());
             }
         }
-#endif
         if (!ipc_pipe.maximize_buffer())
             NOTIFY(1, "Failed to maximize pipe buffer: performance may suffer.\n");
+#endif
     }
 
     if (op_offline.get_value() &&
@@ -40,6 +40,9 @@
 #include "instru.h"
 #include "../common/options.h"
 #include "../common/named_pipe.h"
+#ifdef UNIX
+#    include "../common/shm_ring.h"
+#endif
 #ifdef HAS_SNAPPY
 #    include <snappy.h>
 #    include "snappy_file_writer.h"
@@ -55,6 +58,10 @@ namespace dynamorio {
 namespace drmemtrace {
 
 extern named_pipe_t ipc_pipe;
+#ifdef UNIX
+extern shm_ring_t ipc_ring;
+extern bool use_ipc_ring;
+#endif
 // A clean exit via dr_exit_process() is not supported from init code, but
 // we do want to at least close the pipe file.
 #define FATAL(...)                       \
@@ -65,6 +72,25 @@ extern named_pipe_t ipc_pipe;
         dr_abort();                      \
     } while (0)
 
+/* The most trace buffers per thread for -offline_writer_threads. */
+#define MAX_WRITER_BUFFERS 8
+
+/* A full trace buffer queued for a -offline_writer_threads writer thread. */
+struct write_job_t {
+    write_job_t *next;
+    void *owner; /* The per_thread_t of the thread that filled the buffer. */
+    byte *buf;   /* Returned to the owner's free buffers once written. */
+    byte *start;
+    byte *end;
+    ptr_int_t window;
+    thread_id_t tid;
+    bool in_use;
+    /* Set with dr_atomic_store32 once the data is written and the buffer is
+     * cleared for reuse, so the owner can wait without the writer's lock.
+     */
+    int done;
+};
+
 /* Thread private data.  This is all set to 0 at thread init. */
 typedef struct {
     byte *seg_base;
@@ -105,6 +131,16 @@ typedef struct {
     uint64 num_phys_markers;
     byte *v2p_buf;
     uint64 num_v2p_writeouts; /* v2p_buf writeout instances. */
+    /* For -offline_writer_threads.  The fields marked as guarded may only be
+     * accessed while holding the writer's lock.
+     */
+    void *writer;
+    uint writes_pending; /* Guarded. */
+    uint num_free_bufs;  /* Guarded. */
+    byte *free_bufs[MAX_WRITER_BUFFERS];
+    write_job_t write_jobs[MAX_WRITER_BUFFERS]; /* Guarded. */
+    uint num_writer_bufs;
+    byte *writer_bufs[MAX_WRITER_BUFFERS]; /* All buffers, including buf_base. */
 } per_thread_t;
 
 /* Allocated TLS slot offsets */